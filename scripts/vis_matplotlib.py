@@ -8,8 +8,8 @@ import matplotlib.pyplot as plt
 f = open('planedata-real.bin', 'rb')
 
 # capture dimensions of data
-nx = struct.unpack('I', f.read(4))[0]
-ny = struct.unpack('I', f.read(4))[0]
+nx = struct.unpack('Q', f.read(8))[0]
+ny = struct.unpack('Q', f.read(8))[0]
 
 # read data
 ip = struct.iter_unpack('f', f.read(nx*ny*4))
@@ -0,0 +1,559 @@
+/**************************************************************************
+ *                                                                        *
+ *   Author: Ivo Filot <i.a.w.filot@tue.nl>                               *
+ *                                                                        *
+ *   EDP is free software:                                                *
+ *   you can redistribute it and/or modify it under the terms of the      *
+ *   GNU General Public License as published by the Free Software         *
+ *   Foundation, either version 3 of the License, or (at your option)     *
+ *   any later version.                                                   *
+ *                                                                        *
+ *   EDP is distributed in the hope that it will be useful,               *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty          *
+ *   of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.              *
+ *   See the GNU General Public License for more details.                 *
+ *                                                                        *
+ *   You should have received a copy of the GNU General Public License    *
+ *   along with this program.  If not, see http://www.gnu.org/licenses/.  *
+ *                                                                        *
+ **************************************************************************/
+
+#include "batch_sampler.h"
+#include "float_tokenizer.h"
+#include "mapped_file.h"
+
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <fstream>
+#include <stdexcept>
+
+#if defined(__AVX2__) || defined(__AVX512F__)
+#include <immintrin.h>
+#endif
+
+namespace {
+
+#if defined(__AVX512F__) && !defined(EDP_DOUBLE_PRECISION)
+/**
+ * @brief      lower corner, upper corner and weight of 16 points along an axis
+ *
+ * @param[in]  d     direct coordinates (inside [0,1] for the active lanes)
+ * @param[in]  nf    number of grid points along the axis
+ * @param[in]  ni    number of grid points along the axis
+ * @param      i0    index of the lower corner
+ * @param      i1    index of the upper corner
+ * @param      w     weight of the upper corner
+ */
+inline void cell_avx512(__m512 d, __m512 nf, __m512i ni, __m512i& i0, __m512i& i1, __m512& w) {
+    const __m512 g = _mm512_mul_ps(d, nf);
+    const __m512 f = _mm512_roundscale_ps(g, _MM_FROUND_TO_NEG_INF | _MM_FROUND_NO_EXC);
+    w = _mm512_sub_ps(g, f);
+    i0 = _mm512_cvttps_epi32(f);
+    i0 = _mm512_mask_sub_epi32(i0, _mm512_cmpge_epi32_mask(i0, ni), i0, ni);
+    i1 = _mm512_mask_add_epi32(i0, _mm512_cmp_ps_mask(w, _mm512_setzero_ps(), _CMP_GT_OQ), i0, _mm512_set1_epi32(1));
+    i1 = _mm512_mask_sub_epi32(i1, _mm512_cmpge_epi32_mask(i1, ni), i1, ni);
+}
+
+/**
+ * @brief      cell and weight of 16 points along an axis of a tiled grid
+ *
+ * Points on the upper face are assigned to the last cell.
+ *
+ * @param[in]  d     direct coordinates (inside [0,1] for the active lanes)
+ * @param[in]  nf    number of grid points along the axis
+ * @param[in]  nm1   number of grid points along the axis minus one
+ * @param      i     index of the lower corner
+ * @param      w     weight of the upper corner
+ */
+inline void tile_cell_avx512(__m512 d, __m512 nf, __m512i nm1, __m512i& i, __m512& w) {
+    const __m512 g = _mm512_mul_ps(d, nf);
+    i = _mm512_min_epi32(_mm512_cvttps_epi32(g), nm1);
+    w = _mm512_sub_ps(g, _mm512_cvtepi32_ps(i));
+}
+#endif
+
+#if defined(__AVX2__) && defined(__FMA__) && !defined(EDP_DOUBLE_PRECISION)
+/**
+ * @brief      cell and weight of 8 points along an axis of a tiled grid
+ *
+ * Points on the upper face are assigned to the last cell.
+ *
+ * @param[in]  d     direct coordinates (inside [0,1] for the active lanes)
+ * @param[in]  nf    number of grid points along the axis
+ * @param[in]  nm1   number of grid points along the axis minus one
+ * @param      i     index of the lower corner
+ * @param      w     weight of the upper corner
+ */
+inline void tile_cell_avx2(__m256 d, __m256 nf, __m256i nm1, __m256i& i, __m256& w) {
+    const __m256 g = _mm256_mul_ps(d, nf);
+    i = _mm256_min_epi32(_mm256_cvttps_epi32(g), nm1);
+    w = _mm256_sub_ps(g, _mm256_cvtepi32_ps(i));
+}
+
+/**
+ * @brief      lower corner, upper corner and weight of 8 points along an axis
+ *
+ * @param[in]  d     direct coordinates (inside [0,1] for the active lanes)
+ * @param[in]  nf    number of grid points along the axis
+ * @param[in]  ni    number of grid points along the axis
+ * @param      i0    index of the lower corner
+ * @param      i1    index of the upper corner
+ * @param      w     weight of the upper corner
+ */
+inline void cell_avx2(__m256 d, __m256 nf, __m256i ni, __m256i& i0, __m256i& i1, __m256& w) {
+    const __m256i nm1 = _mm256_sub_epi32(ni, _mm256_set1_epi32(1));
+    const __m256 g = _mm256_mul_ps(d, nf);
+    const __m256 f = _mm256_floor_ps(g);
+    w = _mm256_sub_ps(g, f);
+    i0 = _mm256_cvttps_epi32(f);
+    i0 = _mm256_sub_epi32(i0, _mm256_and_si256(_mm256_cmpgt_epi32(i0, nm1), ni));
+    // the comparison yields -1 for cells with a nonzero weight
+    i1 = _mm256_sub_epi32(i0, _mm256_castps_si256(_mm256_cmp_ps(w, _mm256_setzero_ps(), _CMP_GT_OQ)));
+    i1 = _mm256_sub_epi32(i1, _mm256_and_si256(_mm256_cmpgt_epi32(i1, nm1), ni));
+}
+#endif
+
+// offsets of the corners of a cell in a tile, in the order of the gathers
+static const int tile_offsets[8] = {
+    0, 1, (int)TiledGrid::STRIDE, (int)TiledGrid::STRIDE + 1,
+    (int)(TiledGrid::STRIDE * TiledGrid::STRIDE), (int)(TiledGrid::STRIDE * TiledGrid::STRIDE) + 1,
+    (int)(TiledGrid::STRIDE * TiledGrid::STRIDE + TiledGrid::STRIDE), (int)(TiledGrid::STRIDE * TiledGrid::STRIDE + TiledGrid::STRIDE) + 1
+};
+
+} // namespace
+
+/**
+ * @brief      construct a sampler
+ *
+ * @param[in]  _grid  grid (x running fastest)
+ * @param[in]  _dims  grid dimensions
+ * @param[in]  imat   inverse of the unit cell matrix
+ */
+BatchSampler::BatchSampler(const fpt* _grid, const std::array<unsigned int, 3>& _dims, const MatrixUnitcell& imat) :
+    grid(_grid),
+    tiles(nullptr),
+    dims(_dims) {
+
+    this->set_matrix(imat);
+    this->indexable = (size_t)this->dims[0] * this->dims[1] * this->dims[2] < ((size_t)1 << 31);
+}
+
+/**
+ * @brief      construct a sampler for a tiled grid
+ *
+ * @param[in]  _tiles  tiled grid
+ * @param[in]  imat    inverse of the unit cell matrix
+ */
+BatchSampler::BatchSampler(const TiledGrid* _tiles, const MatrixUnitcell& imat) :
+    grid(_tiles->data()),
+    tiles(_tiles),
+    dims(_tiles->get_dimensions()) {
+
+    this->set_matrix(imat);
+    this->indexable = _tiles->get_size() < ((size_t)1 << 31);
+}
+
+/**
+ * @brief      interpolate the grid at a set of points
+ *
+ * @param[in]  x         x coordinates in angstrom
+ * @param[in]  y         y coordinates in angstrom
+ * @param[in]  z         z coordinates in angstrom
+ * @param      out       interpolated values
+ * @param[in]  n         number of points
+ * @param[in]  periodic  whether points outside the unit cell are mapped
+ *                       into it; otherwise their value is zero
+ */
+void BatchSampler::sample(const fpt* x, const fpt* y, const fpt* z, fpt* out, size_t n, bool periodic) const {
+    const size_t nr_chunks = (n + CHUNK - 1) / CHUNK;
+
+    #pragma omp parallel for schedule(dynamic)
+    for(size_t c=0; c<nr_chunks; c++) {
+        const size_t i0 = c * CHUNK;
+        const size_t len = std::min(CHUNK, n - i0);
+        this->sample_chunk(x + i0, y + i0, z + i0, out + i0, len, periodic);
+    }
+}
+
+/**
+ * @brief      read a file of points, one point (x y z) per line
+ *
+ * @param[in]  filename  path to the file
+ * @param      x         x coordinates
+ * @param      y         y coordinates
+ * @param      z         z coordinates
+ */
+void BatchSampler::read_points(const std::string& filename, std::vector<fpt>& x, std::vector<fpt>& y, std::vector<fpt>& z) {
+    MappedFile mf(filename);
+
+    // every line holds at most three numbers
+    const size_t nr_lines = std::count(mf.data(), mf.end(), '\n') + 1;
+    std::vector<fpt> values(3 * nr_lines);
+    const char* p = mf.data();
+    const size_t nr_values = FloatTokenizer::parse_block_parallel(p, mf.end(), values.data(), values.size(), 1.0);
+
+    if(FloatTokenizer::skip_whitespace(p, mf.end()) != mf.end() || nr_values % 3 != 0) {
+        throw std::runtime_error("Cannot read " + filename + "; expected three coordinates (x y z) per line.");
+    }
+
+    const size_t n = nr_values / 3;
+    x.resize(n);
+    y.resize(n);
+    z.resize(n);
+    #pragma omp parallel for
+    for(size_t i=0; i<n; i++) {
+        x[i] = values[3*i];
+        y[i] = values[3*i+1];
+        z[i] = values[3*i+2];
+    }
+}
+
+/**
+ * @brief      write values to a file, one value per line
+ *
+ * Every value is written in its shortest representation that reads back
+ * to the same number.
+ *
+ * @param[in]  filename  path to the file
+ * @param[in]  values    values
+ */
+void BatchSampler::write_values(const std::string& filename, const std::vector<fpt>& values) {
+    std::ofstream outfile(filename, std::ios::binary | std::ios::trunc);
+    if(!outfile.is_open()) {
+        throw std::runtime_error("Cannot open " + filename + " for writing!");
+    }
+
+    // a value never exceeds 24 characters
+    const size_t nr_chunks = (values.size() + CHUNK - 1) / CHUNK;
+    std::vector<std::string> buffers(nr_chunks);
+    #pragma omp parallel for schedule(static)
+    for(size_t c=0; c<nr_chunks; c++) {
+        const size_t i0 = c * CHUNK;
+        const size_t i1 = std::min(i0 + CHUNK, values.size());
+        std::string& buffer = buffers[c];
+        buffer.resize((i1 - i0) * 25);
+        char* p = buffer.data();
+        for(size_t i=i0; i<i1; i++) {
+            p = std::to_chars(p, buffer.data() + buffer.size(), values[i]).ptr;
+            *p++ = '\n';
+        }
+        buffer.resize(p - buffer.data());
+    }
+
+    for(const auto& buffer : buffers) {
+        outfile.write(buffer.data(), buffer.size());
+    }
+    outfile.close();
+    if(!outfile) {
+        throw std::runtime_error("Error encountered in writing " + filename);
+    }
+}
+
+/**
+ * @brief      store the transpose of the inverse of the unit cell matrix
+ */
+void BatchSampler::set_matrix(const MatrixUnitcell& imat) {
+    for(unsigned int i=0; i<3; i++) {
+        for(unsigned int j=0; j<3; j++) {
+            this->m[i * 3 + j] = imat(j,i);
+        }
+    }
+}
+
+/**
+ * @brief      interpolate the grid at a chunk of points
+ */
+void BatchSampler::sample_chunk(const fpt* x, const fpt* y, const fpt* z, fpt* out, size_t n, bool periodic) const {
+    size_t i = 0;
+    if(this->indexable) {
+#if defined(__AVX512F__) && !defined(EDP_DOUBLE_PRECISION)
+        i = this->sample_avx512(x, y, z, out, n, periodic);
+#elif defined(__AVX2__) && defined(__FMA__) && !defined(EDP_DOUBLE_PRECISION)
+        i = this->sample_avx2(x, y, z, out, n, periodic);
+#endif
+    }
+    for(; i<n; i++) {
+        out[i] = this->sample_point(x[i], y[i], z[i], periodic);
+    }
+}
+
+/**
+ * @brief      interpolate the grid at a single point
+ */
+fpt BatchSampler::sample_point(fpt x, fpt y, fpt z, bool periodic) const {
+    size_t i0[3], i1[3];
+    fpt w[3];
+    const fpt r[3] = {x, y, z};
+    for(unsigned int a=0; a<3; a++) {
+        fpt d = this->m[a*3] * r[0] + this->m[a*3+1] * r[1] + this->m[a*3+2] * r[2];
+        if(periodic) {
+            d -= std::floor(d);
+        }
+        if(!(d >= 0 && d <= 1)) {
+            return 0.0;
+        }
+        if(this->tiles) {
+            w[a] = d;
+            continue;
+        }
+
+        // a point on the upper face of the cell coincides with the lower one
+        const fpt g = d * (fpt)this->dims[a];
+        const fpt f = std::floor(g);
+        w[a] = g - f;
+        i0[a] = (size_t)f;
+        if(i0[a] >= this->dims[a]) {
+            i0[a] -= this->dims[a];
+        }
+        i1[a] = i0[a] + (w[a] > 0 ? 1 : 0);
+        if(i1[a] >= this->dims[a]) {
+            i1[a] -= this->dims[a];
+        }
+    }
+
+    if(this->tiles) {
+        return this->tiles->get_value_interp(w[0], w[1], w[2]);
+    }
+
+    const size_t nx = this->dims[0];
+    const size_t nxy = nx * this->dims[1];
+    const fpt* r00 = this->grid + i0[2] * nxy + i0[1] * nx;
+    const fpt* r10 = this->grid + i0[2] * nxy + i1[1] * nx;
+    const fpt* r01 = this->grid + i1[2] * nxy + i0[1] * nx;
+    const fpt* r11 = this->grid + i1[2] * nxy + i1[1] * nx;
+
+    const fpt c00 = r00[i0[0]] + w[0] * (r00[i1[0]] - r00[i0[0]]);
+    const fpt c10 = r10[i0[0]] + w[0] * (r10[i1[0]] - r10[i0[0]]);
+    const fpt c01 = r01[i0[0]] + w[0] * (r01[i1[0]] - r01[i0[0]]);
+    const fpt c11 = r11[i0[0]] + w[0] * (r11[i1[0]] - r11[i0[0]]);
+    const fpt c0 = c00 + w[1] * (c10 - c00);
+    const fpt c1 = c01 + w[1] * (c11 - c01);
+    return c0 + w[2] * (c1 - c0);
+}
+
+#if defined(__AVX512F__) && !defined(EDP_DOUBLE_PRECISION)
+/**
+ * @brief      interpolate the grid at points in groups of 16
+ *
+ * Lanes of points outside the unit cell are masked out of the gathers.
+ *
+ * @return     number of points that have been processed
+ */
+size_t BatchSampler::sample_avx512(const fpt* x, const fpt* y, const fpt* z, fpt* out, size_t n, bool periodic) const {
+    __m512 m[9];
+    for(unsigned int j=0; j<9; j++) {
+        m[j] = _mm512_set1_ps(this->m[j]);
+    }
+    const __m512 nxf = _mm512_set1_ps((float)this->dims[0]);
+    const __m512 nyf = _mm512_set1_ps((float)this->dims[1]);
+    const __m512 nzf = _mm512_set1_ps((float)this->dims[2]);
+    const __m512i nxi = _mm512_set1_epi32(this->dims[0]);
+    const __m512i nyi = _mm512_set1_epi32(this->dims[1]);
+    const __m512i nzi = _mm512_set1_epi32(this->dims[2]);
+    const __m512 zero = _mm512_setzero_ps();
+    const __m512 one = _mm512_set1_ps(1.0f);
+
+    // layout of a tiled grid
+    const std::array<unsigned int, 3> nt = this->tiles ? this->tiles->get_nr_tiles() : std::array<unsigned int, 3>{0, 0, 0};
+    const __m512i txi = _mm512_set1_epi32(nt[0]);
+    const __m512i tyi = _mm512_set1_epi32(nt[1]);
+    const __m512i tmask = _mm512_set1_epi32(TiledGrid::TILE - 1);
+    const __m512i stride = _mm512_set1_epi32(TiledGrid::STRIDE);
+    const __m512i tsize = _mm512_set1_epi32(TiledGrid::TILE_SIZE);
+
+    size_t i = 0;
+    for(; i + 16 <= n; i += 16) {
+        const __m512 px = _mm512_loadu_ps(x + i);
+        const __m512 py = _mm512_loadu_ps(y + i);
+        const __m512 pz = _mm512_loadu_ps(z + i);
+        __m512 dx = _mm512_fmadd_ps(m[0], px, _mm512_fmadd_ps(m[1], py, _mm512_mul_ps(m[2], pz)));
+        __m512 dy = _mm512_fmadd_ps(m[3], px, _mm512_fmadd_ps(m[4], py, _mm512_mul_ps(m[5], pz)));
+        __m512 dz = _mm512_fmadd_ps(m[6], px, _mm512_fmadd_ps(m[7], py, _mm512_mul_ps(m[8], pz)));
+        if(periodic) {
+            dx = _mm512_sub_ps(dx, _mm512_roundscale_ps(dx, _MM_FROUND_TO_NEG_INF | _MM_FROUND_NO_EXC));
+            dy = _mm512_sub_ps(dy, _mm512_roundscale_ps(dy, _MM_FROUND_TO_NEG_INF | _MM_FROUND_NO_EXC));
+            dz = _mm512_sub_ps(dz, _mm512_roundscale_ps(dz, _MM_FROUND_TO_NEG_INF | _MM_FROUND_NO_EXC));
+        }
+
+        // NaN fails both comparisons
+        const __mmask16 inside =
+            _mm512_cmp_ps_mask(dx, zero, _CMP_GE_OQ) & _mm512_cmp_ps_mask(dx, one, _CMP_LE_OQ) &
+            _mm512_cmp_ps_mask(dy, zero, _CMP_GE_OQ) & _mm512_cmp_ps_mask(dy, one, _CMP_LE_OQ) &
+            _mm512_cmp_ps_mask(dz, zero, _CMP_GE_OQ) & _mm512_cmp_ps_mask(dz, one, _CMP_LE_OQ);
+
+        // position of the eight corners: (x,y,z) = 000, 100, 010, 110, 001, 101, 011, 111
+        __m512i idx[8];
+        __m512 wx, wy, wz;
+        if(this->tiles) {
+            __m512i ix, iy, iz;
+            tile_cell_avx512(dx, nxf, _mm512_sub_epi32(nxi, _mm512_set1_epi32(1)), ix, wx);
+            tile_cell_avx512(dy, nyf, _mm512_sub_epi32(nyi, _mm512_set1_epi32(1)), iy, wy);
+            tile_cell_avx512(dz, nzf, _mm512_sub_epi32(nzi, _mm512_set1_epi32(1)), iz, wz);
+            const __m512i tile = _mm512_add_epi32(_mm512_mullo_epi32(_mm512_add_epi32(
+                _mm512_mullo_epi32(_mm512_srli_epi32(iz, TiledGrid::TILE_SHIFT), tyi),
+                _mm512_srli_epi32(iy, TiledGrid::TILE_SHIFT)), txi), _mm512_srli_epi32(ix, TiledGrid::TILE_SHIFT));
+            const __m512i local = _mm512_add_epi32(_mm512_mullo_epi32(_mm512_add_epi32(
+                _mm512_mullo_epi32(_mm512_and_si512(iz, tmask), stride),
+                _mm512_and_si512(iy, tmask)), stride), _mm512_and_si512(ix, tmask));
+            idx[0] = _mm512_add_epi32(_mm512_mullo_epi32(tile, tsize), local);
+            for(unsigned int c=1; c<8; c++) {
+                idx[c] = _mm512_add_epi32(idx[0], _mm512_set1_epi32(tile_offsets[c]));
+            }
+        } else {
+            __m512i ix0, ix1, iy0, iy1, iz0, iz1;
+            cell_avx512(dx, nxf, nxi, ix0, ix1, wx);
+            cell_avx512(dy, nyf, nyi, iy0, iy1, wy);
+            cell_avx512(dz, nzf, nzi, iz0, iz1, wz);
+
+            // start of the four rows along x holding the corners
+            const __m512i r00 = _mm512_mullo_epi32(_mm512_add_epi32(_mm512_mullo_epi32(iz0, nyi), iy0), nxi);
+            const __m512i r10 = _mm512_mullo_epi32(_mm512_add_epi32(_mm512_mullo_epi32(iz0, nyi), iy1), nxi);
+            const __m512i r01 = _mm512_mullo_epi32(_mm512_add_epi32(_mm512_mullo_epi32(iz1, nyi), iy0), nxi);
+            const __m512i r11 = _mm512_mullo_epi32(_mm512_add_epi32(_mm512_mullo_epi32(iz1, nyi), iy1), nxi);
+            idx[0] = _mm512_add_epi32(r00, ix0);
+            idx[1] = _mm512_add_epi32(r00, ix1);
+            idx[2] = _mm512_add_epi32(r10, ix0);
+            idx[3] = _mm512_add_epi32(r10, ix1);
+            idx[4] = _mm512_add_epi32(r01, ix0);
+            idx[5] = _mm512_add_epi32(r01, ix1);
+            idx[6] = _mm512_add_epi32(r11, ix0);
+            idx[7] = _mm512_add_epi32(r11, ix1);
+        }
+
+        const __m512 v000 = _mm512_mask_i32gather_ps(zero, inside, idx[0], this->grid, 4);
+        const __m512 v100 = _mm512_mask_i32gather_ps(zero, inside, idx[1], this->grid, 4);
+        const __m512 v010 = _mm512_mask_i32gather_ps(zero, inside, idx[2], this->grid, 4);
+        const __m512 v110 = _mm512_mask_i32gather_ps(zero, inside, idx[3], this->grid, 4);
+        const __m512 v001 = _mm512_mask_i32gather_ps(zero, inside, idx[4], this->grid, 4);
+        const __m512 v101 = _mm512_mask_i32gather_ps(zero, inside, idx[5], this->grid, 4);
+        const __m512 v011 = _mm512_mask_i32gather_ps(zero, inside, idx[6], this->grid, 4);
+        const __m512 v111 = _mm512_mask_i32gather_ps(zero, inside, idx[7], this->grid, 4);
+
+        const __m512 c00 = _mm512_fmadd_ps(wx, _mm512_sub_ps(v100, v000), v000);
+        const __m512 c10 = _mm512_fmadd_ps(wx, _mm512_sub_ps(v110, v010), v010);
+        const __m512 c01 = _mm512_fmadd_ps(wx, _mm512_sub_ps(v101, v001), v001);
+        const __m512 c11 = _mm512_fmadd_ps(wx, _mm512_sub_ps(v111, v011), v011);
+        const __m512 c0 = _mm512_fmadd_ps(wy, _mm512_sub_ps(c10, c00), c00);
+        const __m512 c1 = _mm512_fmadd_ps(wy, _mm512_sub_ps(c11, c01), c01);
+        _mm512_storeu_ps(out + i, _mm512_maskz_mov_ps(inside, _mm512_fmadd_ps(wz, _mm512_sub_ps(c1, c0), c0)));
+    }
+
+#if defined(__AVX2__) && defined(__FMA__)
+    i += this->sample_avx2(x + i, y + i, z + i, out + i, n - i, periodic);
+#endif
+
+    return i;
+}
+#endif
+
+#if defined(__AVX2__) && defined(__FMA__) && !defined(EDP_DOUBLE_PRECISION)
+/**
+ * @brief      interpolate the grid at points in groups of 8
+ *
+ * Lanes of points outside the unit cell are masked out of the gathers.
+ *
+ * @return     number of points that have been processed
+ */
+size_t BatchSampler::sample_avx2(const fpt* x, const fpt* y, const fpt* z, fpt* out, size_t n, bool periodic) const {
+    __m256 m[9];
+    for(unsigned int j=0; j<9; j++) {
+        m[j] = _mm256_set1_ps(this->m[j]);
+    }
+    const __m256 nxf = _mm256_set1_ps((float)this->dims[0]);
+    const __m256 nyf = _mm256_set1_ps((float)this->dims[1]);
+    const __m256 nzf = _mm256_set1_ps((float)this->dims[2]);
+    const __m256i nxi = _mm256_set1_epi32(this->dims[0]);
+    const __m256i nyi = _mm256_set1_epi32(this->dims[1]);
+    const __m256i nzi = _mm256_set1_epi32(this->dims[2]);
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 one = _mm256_set1_ps(1.0f);
+
+    // layout of a tiled grid
+    const std::array<unsigned int, 3> nt = this->tiles ? this->tiles->get_nr_tiles() : std::array<unsigned int, 3>{0, 0, 0};
+    const __m256i txi = _mm256_set1_epi32(nt[0]);
+    const __m256i tyi = _mm256_set1_epi32(nt[1]);
+    const __m256i tmask = _mm256_set1_epi32(TiledGrid::TILE - 1);
+    const __m256i stride = _mm256_set1_epi32(TiledGrid::STRIDE);
+    const __m256i tsize = _mm256_set1_epi32(TiledGrid::TILE_SIZE);
+
+    size_t i = 0;
+    for(; i + 8 <= n; i += 8) {
+        const __m256 px = _mm256_loadu_ps(x + i);
+        const __m256 py = _mm256_loadu_ps(y + i);
+        const __m256 pz = _mm256_loadu_ps(z + i);
+        __m256 dx = _mm256_fmadd_ps(m[0], px, _mm256_fmadd_ps(m[1], py, _mm256_mul_ps(m[2], pz)));
+        __m256 dy = _mm256_fmadd_ps(m[3], px, _mm256_fmadd_ps(m[4], py, _mm256_mul_ps(m[5], pz)));
+        __m256 dz = _mm256_fmadd_ps(m[6], px, _mm256_fmadd_ps(m[7], py, _mm256_mul_ps(m[8], pz)));
+        if(periodic) {
+            dx = _mm256_sub_ps(dx, _mm256_floor_ps(dx));
+            dy = _mm256_sub_ps(dy, _mm256_floor_ps(dy));
+            dz = _mm256_sub_ps(dz, _mm256_floor_ps(dz));
+        }
+
+        // NaN fails both comparisons
+        const __m256 inside = _mm256_and_ps(
+            _mm256_and_ps(_mm256_and_ps(_mm256_cmp_ps(dx, zero, _CMP_GE_OQ), _mm256_cmp_ps(dx, one, _CMP_LE_OQ)),
+                          _mm256_and_ps(_mm256_cmp_ps(dy, zero, _CMP_GE_OQ), _mm256_cmp_ps(dy, one, _CMP_LE_OQ))),
+            _mm256_and_ps(_mm256_cmp_ps(dz, zero, _CMP_GE_OQ), _mm256_cmp_ps(dz, one, _CMP_LE_OQ)));
+
+        // position of the eight corners: (x,y,z) = 000, 100, 010, 110, 001, 101, 011, 111
+        __m256i idx[8];
+        __m256 wx, wy, wz;
+        if(this->tiles) {
+            __m256i ix, iy, iz;
+            tile_cell_avx2(dx, nxf, _mm256_sub_epi32(nxi, _mm256_set1_epi32(1)), ix, wx);
+            tile_cell_avx2(dy, nyf, _mm256_sub_epi32(nyi, _mm256_set1_epi32(1)), iy, wy);
+            tile_cell_avx2(dz, nzf, _mm256_sub_epi32(nzi, _mm256_set1_epi32(1)), iz, wz);
+            const __m256i tile = _mm256_add_epi32(_mm256_mullo_epi32(_mm256_add_epi32(
+                _mm256_mullo_epi32(_mm256_srli_epi32(iz, TiledGrid::TILE_SHIFT), tyi),
+                _mm256_srli_epi32(iy, TiledGrid::TILE_SHIFT)), txi), _mm256_srli_epi32(ix, TiledGrid::TILE_SHIFT));
+            const __m256i local = _mm256_add_epi32(_mm256_mullo_epi32(_mm256_add_epi32(
+                _mm256_mullo_epi32(_mm256_and_si256(iz, tmask), stride),
+                _mm256_and_si256(iy, tmask)), stride), _mm256_and_si256(ix, tmask));
+            idx[0] = _mm256_add_epi32(_mm256_mullo_epi32(tile, tsize), local);
+            for(unsigned int c=1; c<8; c++) {
+                idx[c] = _mm256_add_epi32(idx[0], _mm256_set1_epi32(tile_offsets[c]));
+            }
+        } else {
+            __m256i ix0, ix1, iy0, iy1, iz0, iz1;
+            cell_avx2(dx, nxf, nxi, ix0, ix1, wx);
+            cell_avx2(dy, nyf, nyi, iy0, iy1, wy);
+            cell_avx2(dz, nzf, nzi, iz0, iz1, wz);
+
+            // start of the four rows along x holding the corners
+            const __m256i r00 = _mm256_mullo_epi32(_mm256_add_epi32(_mm256_mullo_epi32(iz0, nyi), iy0), nxi);
+            const __m256i r10 = _mm256_mullo_epi32(_mm256_add_epi32(_mm256_mullo_epi32(iz0, nyi), iy1), nxi);
+            const __m256i r01 = _mm256_mullo_epi32(_mm256_add_epi32(_mm256_mullo_epi32(iz1, nyi), iy0), nxi);
+            const __m256i r11 = _mm256_mullo_epi32(_mm256_add_epi32(_mm256_mullo_epi32(iz1, nyi), iy1), nxi);
+            idx[0] = _mm256_add_epi32(r00, ix0);
+            idx[1] = _mm256_add_epi32(r00, ix1);
+            idx[2] = _mm256_add_epi32(r10, ix0);
+            idx[3] = _mm256_add_epi32(r10, ix1);
+            idx[4] = _mm256_add_epi32(r01, ix0);
+            idx[5] = _mm256_add_epi32(r01, ix1);
+            idx[6] = _mm256_add_epi32(r11, ix0);
+            idx[7] = _mm256_add_epi32(r11, ix1);
+        }
+
+        const __m256 v000 = _mm256_mask_i32gather_ps(zero, this->grid, idx[0], inside, 4);
+        const __m256 v100 = _mm256_mask_i32gather_ps(zero, this->grid, idx[1], inside, 4);
+        const __m256 v010 = _mm256_mask_i32gather_ps(zero, this->grid, idx[2], inside, 4);
+        const __m256 v110 = _mm256_mask_i32gather_ps(zero, this->grid, idx[3], inside, 4);
+        const __m256 v001 = _mm256_mask_i32gather_ps(zero, this->grid, idx[4], inside, 4);
+        const __m256 v101 = _mm256_mask_i32gather_ps(zero, this->grid, idx[5], inside, 4);
+        const __m256 v011 = _mm256_mask_i32gather_ps(zero, this->grid, idx[6], inside, 4);
+        const __m256 v111 = _mm256_mask_i32gather_ps(zero, this->grid, idx[7], inside, 4);
+
+        const __m256 c00 = _mm256_fmadd_ps(wx, _mm256_sub_ps(v100, v000), v000);
+        const __m256 c10 = _mm256_fmadd_ps(wx, _mm256_sub_ps(v110, v010), v010);
+        const __m256 c01 = _mm256_fmadd_ps(wx, _mm256_sub_ps(v101, v001), v001);
+        const __m256 c11 = _mm256_fmadd_ps(wx, _mm256_sub_ps(v111, v011), v011);
+        const __m256 c0 = _mm256_fmadd_ps(wy, _mm256_sub_ps(c10, c00), c00);
+        const __m256 c1 = _mm256_fmadd_ps(wy, _mm256_sub_ps(c11, c01), c01);
+        _mm256_storeu_ps(out + i, _mm256_and_ps(inside, _mm256_fmadd_ps(wz, _mm256_sub_ps(c1, c0), c0)));
+    }
+
+    return i;
+}
+#endif
@@ -0,0 +1,143 @@
+/**************************************************************************
+ *                                                                        *
+ *   Author: Ivo Filot <i.a.w.filot@tue.nl>                               *
+ *                                                                        *
+ *   EDP is free software:                                                *
+ *   you can redistribute it and/or modify it under the terms of the      *
+ *   GNU General Public License as published by the Free Software         *
+ *   Foundation, either version 3 of the License, or (at your option)     *
+ *   any later version.                                                   *
+ *                                                                        *
+ *   EDP is distributed in the hope that it will be useful,               *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty          *
+ *   of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.              *
+ *   See the GNU General Public License for more details.                 *
+ *                                                                        *
+ *   You should have received a copy of the GNU General Public License    *
+ *   along with this program.  If not, see http://www.gnu.org/licenses/.  *
+ *                                                                        *
+ **************************************************************************/
+
+#ifndef _BATCH_SAMPLER_H
+#define _BATCH_SAMPLER_H
+
+#include <array>
+#include <string>
+#include <vector>
+
+#include "math.h"
+#include "tiled_grid.h"
+
+/**
+ * @brief      Trilinear interpolation of a grid at many points at once
+ *
+ * The points are given as separate arrays of x, y and z coordinates
+ * (structure of arrays), such that consecutive points fill the lanes of a
+ * vector register directly. The points are cut into chunks which are
+ * sampled in parallel. Within a chunk, 16 (AVX-512) or 8 (AVX2) points are
+ * converted to direct coordinates and interpolated at once, fetching the
+ * corners of their cells with gather instructions; the remaining points are
+ * handled one by one. The vectorized kernels are only available for single
+ * precision builds and grids holding fewer than 2^31 points (the gathers
+ * take 32-bit indices).
+ *
+ * Grids stored in tiles (see TiledGrid) are sampled in place; the corners
+ * of a cell then lie at fixed offsets from the lower one.
+ *
+ * The results equal those of ScalarField::get_value_interp() up to
+ * rounding.
+ */
+class BatchSampler {
+public:
+    static constexpr size_t CHUNK = 4096;   // number of points per parallel task
+
+    /**
+     * @brief      construct a sampler
+     *
+     * @param[in]  _grid  grid (x running fastest)
+     * @param[in]  _dims  grid dimensions
+     * @param[in]  imat   inverse of the unit cell matrix
+     */
+    BatchSampler(const fpt* _grid, const std::array<unsigned int, 3>& _dims, const MatrixUnitcell& imat);
+
+    /**
+     * @brief      construct a sampler for a tiled grid
+     *
+     * @param[in]  _tiles  tiled grid
+     * @param[in]  imat    inverse of the unit cell matrix
+     */
+    BatchSampler(const TiledGrid* _tiles, const MatrixUnitcell& imat);
+
+    /**
+     * @brief      interpolate the grid at a set of points
+     *
+     * @param[in]  x         x coordinates in angstrom
+     * @param[in]  y         y coordinates in angstrom
+     * @param[in]  z         z coordinates in angstrom
+     * @param      out       interpolated values
+     * @param[in]  n         number of points
+     * @param[in]  periodic  whether points outside the unit cell are mapped
+     *                       into it; otherwise their value is zero
+     */
+    void sample(const fpt* x, const fpt* y, const fpt* z, fpt* out, size_t n, bool periodic) const;
+
+    /**
+     * @brief      read a file of points, one point (x y z) per line
+     *
+     * @param[in]  filename  path to the file
+     * @param      x         x coordinates
+     * @param      y         y coordinates
+     * @param      z         z coordinates
+     */
+    static void read_points(const std::string& filename, std::vector<fpt>& x, std::vector<fpt>& y, std::vector<fpt>& z);
+
+    /**
+     * @brief      write values to a file, one value per line
+     *
+     * @param[in]  filename  path to the file
+     * @param[in]  values    values
+     */
+    static void write_values(const std::string& filename, const std::vector<fpt>& values);
+
+private:
+    const fpt* grid;            // values of the grid or of the tiles
+    const TiledGrid* tiles;     // tiled grid; nullptr for a grid with x running fastest
+    std::array<unsigned int, 3> dims;
+    fpt m[9];                   // imat^T (row-major); maps cartesian to direct coordinates
+    bool indexable;             // whether the grid can be addressed with 32-bit indices
+
+    /**
+     * @brief      store the transpose of the inverse of the unit cell matrix
+     */
+    void set_matrix(const MatrixUnitcell& imat);
+
+    /**
+     * @brief      interpolate the grid at a chunk of points
+     */
+    void sample_chunk(const fpt* x, const fpt* y, const fpt* z, fpt* out, size_t n, bool periodic) const;
+
+    /**
+     * @brief      interpolate the grid at a single point
+     */
+    fpt sample_point(fpt x, fpt y, fpt z, bool periodic) const;
+
+#if defined(__AVX512F__) && !defined(EDP_DOUBLE_PRECISION)
+    /**
+     * @brief      interpolate the grid at points in groups of 16
+     *
+     * @return     number of points that have been processed
+     */
+    size_t sample_avx512(const fpt* x, const fpt* y, const fpt* z, fpt* out, size_t n, bool periodic) const;
+#endif
+
+#if defined(__AVX2__) && defined(__FMA__) && !defined(EDP_DOUBLE_PRECISION)
+    /**
+     * @brief      interpolate the grid at points in groups of 8
+     *
+     * @return     number of points that have been processed
+     */
+    size_t sample_avx2(const fpt* x, const fpt* y, const fpt* z, fpt* out, size_t n, bool periodic) const;
+#endif
+};
+
+#endif // _BATCH_SAMPLER_H
@@ -0,0 +1,283 @@
+/**************************************************************************
+ *                                                                        *
+ *   Author: Ivo Filot <i.a.w.filot@tue.nl>                               *
+ *                                                                        *
+ *   EDP is free software:                                                *
+ *   you can redistribute it and/or modify it under the terms of the      *
+ *   GNU General Public License as published by the Free Software         *
+ *   Foundation, either version 3 of the License, or (at your option)     *
+ *   any later version.                                                   *
+ *                                                                        *
+ *   EDP is distributed in the hope that it will be useful,               *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty          *
+ *   of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.              *
+ *   See the GNU General Public License for more details.                 *
+ *                                                                        *
+ *   You should have received a copy of the GNU General Public License    *
+ *   along with this program.  If not, see http://www.gnu.org/licenses/.  *
+ *                                                                        *
+ **************************************************************************/
+
+/*
+ * PURPOSE
+ * =======
+ *
+ * Compares the grid layouts for sampling planes: the ghost-padded grid with
+ * x running fastest (PaddedGrid) against the cache-blocked tiles
+ * (TiledGrid), both point by point and through the BatchSampler. A smooth
+ * synthetic field on an N x N x N grid is sampled on a square canvas along
+ * two axis-aligned planes and an oblique one. For every combination, the
+ * throughput (in million samples per second) and the number of cache
+ * misses per sample are reported; the latter requires access to the
+ * hardware counters (perf_event_paranoid) and is reported as n/a
+ * otherwise.
+ *
+ * Usage: BenchLayout [grid size] [canvas size] [repetitions]
+ */
+
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <vector>
+#include <boost/format.hpp>
+
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "padded_grid.h"
+#include "tiled_grid.h"
+#include "batch_sampler.h"
+
+/**
+ * @brief      Cache misses of all threads in user space
+ *
+ * Every thread of the OpenMP team counts its own misses, such that the
+ * counts do not depend on the threads being created after the counters.
+ */
+class CacheMisses {
+private:
+    std::vector<int> fds;
+
+public:
+    CacheMisses() {
+#ifdef _OPENMP
+        this->fds.assign(omp_get_max_threads(), -1);
+#else
+        this->fds.assign(1, -1);
+#endif
+        #pragma omp parallel
+        {
+#ifdef _OPENMP
+            const int t = omp_get_thread_num();
+#else
+            const int t = 0;
+#endif
+            perf_event_attr attr;
+            std::memset(&attr, 0, sizeof(attr));
+            attr.size = sizeof(attr);
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.config = PERF_COUNT_HW_CACHE_MISSES;
+            attr.exclude_kernel = 1;
+            attr.exclude_hv = 1;
+            this->fds[t] = syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+        }
+    }
+
+    ~CacheMisses() {
+        for(int fd : this->fds) {
+            if(fd >= 0) {
+                close(fd);
+            }
+        }
+    }
+
+    bool is_available() const {
+        for(int fd : this->fds) {
+            if(fd < 0) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    uint64_t read() const {
+        uint64_t sum = 0;
+        for(int fd : this->fds) {
+            uint64_t count = 0;
+            if(fd >= 0 && ::read(fd, &count, sizeof(count)) == sizeof(count)) {
+                sum += count;
+            }
+        }
+        return sum;
+    }
+};
+
+/**
+ * @brief      plane through the unit cell in direct coordinates
+ */
+struct Plane {
+    const char* name;
+    Vec3 origin;
+    Vec3 u;         // spans the canvas along its rows
+    Vec3 v;         // spans the canvas along its columns
+};
+
+/**
+ * @brief      direct coordinates of a pixel, mapped into the unit cell
+ */
+static inline Vec3 pixel(const Plane& plane, unsigned int i, unsigned int j, unsigned int n) {
+    Vec3 d = plane.origin + plane.u * ((fpt)i / (fpt)n) + plane.v * ((fpt)j / (fpt)n);
+    for(unsigned int a=0; a<3; a++) {
+        d[a] -= std::floor(d[a]);
+    }
+    return d;
+}
+
+/**
+ * @brief      time a sampling routine and count its cache misses
+ *
+ * @param[in]  name         description of the routine
+ * @param[in]  run          routine; returns a checksum
+ * @param[in]  samples      number of samples per run
+ * @param[in]  repetitions  number of runs (the fastest is reported)
+ * @param[in]  counter      cache miss counter
+ */
+static void measure(const std::string& name, const std::function<double()>& run, size_t samples,
+                    unsigned int repetitions, const CacheMisses& counter) {
+    double best = 1e30;
+    double checksum = 0.0;
+    uint64_t misses = 0;
+    for(unsigned int r=0; r<repetitions; r++) {
+        const uint64_t m0 = counter.read();
+        const auto start = std::chrono::steady_clock::now();
+        checksum = run();
+        const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        const uint64_t m1 = counter.read();
+        if(elapsed.count() < best) {
+            best = elapsed.count();
+            misses = m1 - m0;
+        }
+    }
+
+    const std::string miss_str = counter.is_available() ?
+        (boost::format("%8.3f") % ((double)misses / samples)).str() : std::string("     n/a");
+    std::cout << boost::format("  %-24s %9.1f Msamples/s  %s misses/sample  (checksum %.6e)")
+                 % name % (samples / best * 1e-6) % miss_str % checksum << std::endl;
+}
+
+int main(int argc, char* argv[]) {
+    const unsigned int n = argc > 1 ? std::stoi(argv[1]) : 320;
+    const unsigned int canvas = argc > 2 ? std::stoi(argv[2]) : 2000;
+    const unsigned int repetitions = argc > 3 ? std::stoi(argv[3]) : 3;
+    const std::array<unsigned int, 3> dims = {n, n, n};
+    const size_t gridsize = (size_t)n * n * n;
+    const size_t samples = (size_t)canvas * canvas;
+
+    // the counters have to be opened by the threads that do the sampling
+    CacheMisses counter;
+
+    // smooth periodic field with some structure along every axis
+    std::vector<fpt> grid(gridsize);
+    const double f = 2.0 * M_PI / n;
+    #pragma omp parallel for schedule(static)
+    for(unsigned int k=0; k<n; k++) {
+        for(unsigned int j=0; j<n; j++) {
+            for(unsigned int i=0; i<n; i++) {
+                grid[((size_t)k * n + j) * n + i] = std::sin(3 * f * i) * std::cos(2 * f * j) + std::sin(5 * f * k + f * i);
+            }
+        }
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    const PaddedGrid padded(grid.data(), dims);
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    std::cout << boost::format("Grid: %i x %i x %i; padded in %.3f s (%.1f MB)")
+                 % n % n % n % elapsed.count() % (padded.get_size() * sizeof(fpt) / 1048576.0) << std::endl;
+
+    start = std::chrono::steady_clock::now();
+    const TiledGrid tiles(grid.data(), dims);
+    elapsed = std::chrono::steady_clock::now() - start;
+    std::cout << boost::format("Tiles of %i^3 cells built in %.3f s (%.1f MB)")
+                 % TiledGrid::TILE % elapsed.count() % (tiles.get_size() * sizeof(fpt) / 1048576.0) << std::endl;
+    std::cout << boost::format("Canvas: %i x %i; cache misses %s")
+                 % canvas % canvas % (counter.is_available() ? "counted" : "not available") << std::endl;
+
+    // a cubic cell of unit length, such that direct and cartesian coordinates coincide
+    const MatrixUnitcell imat = MatrixUnitcell::Identity();
+    const BatchSampler linear_sampler(grid.data(), dims, imat);
+    const BatchSampler tiled_sampler(&tiles, imat);
+
+    const fpt s2 = std::sqrt(2.0);
+    const fpt s6 = std::sqrt(6.0);
+    const std::vector<Plane> planes = {
+        {"xy-plane", Vec3(0, 0, 0.5), Vec3(1, 0, 0), Vec3(0, 1, 0)},
+        {"xz-plane", Vec3(0, 0.5, 0), Vec3(1, 0, 0), Vec3(0, 0, 1)},
+        {"oblique (110)/(-112)", Vec3(0.1, 0.2, 0.3), Vec3(1, 1, 0) / s2 * 2, Vec3(-1, 1, 2) / s6 * 2},
+    };
+
+    std::vector<fpt> out(samples);
+    std::vector<fpt> x(samples), y(samples), z(samples);
+    for(const Plane& plane : planes) {
+        std::cout << std::endl << plane.name << std::endl;
+
+        // point by point, one row of the canvas after the other
+        const auto by_point = [&](const std::function<fpt(const Vec3&)>& value) {
+            double sum = 0.0;
+            #pragma omp parallel for schedule(static) reduction(+:sum)
+            for(unsigned int j=0; j<canvas; j++) {
+                for(unsigned int i=0; i<canvas; i++) {
+                    const fpt val = value(pixel(plane, i, j, canvas));
+                    out[(size_t)j * canvas + i] = val;
+                    sum += val;
+                }
+            }
+            return sum;
+        };
+        measure("padded, per point", [&]() {
+            return by_point([&padded](const Vec3& d) {
+                return padded.get_value_interp(d[0], d[1], d[2]);
+            });
+        }, samples, repetitions, counter);
+        measure("tiled, per point", [&]() {
+            return by_point([&tiles](const Vec3& d) {
+                return tiles.get_value_interp(d[0], d[1], d[2]);
+            });
+        }, samples, repetitions, counter);
+
+        // batches of points
+        #pragma omp parallel for schedule(static)
+        for(unsigned int j=0; j<canvas; j++) {
+            for(unsigned int i=0; i<canvas; i++) {
+                const Vec3 d = pixel(plane, i, j, canvas);
+                const size_t idx = (size_t)j * canvas + i;
+                x[idx] = d[0];
+                y[idx] = d[1];
+                z[idx] = d[2];
+            }
+        }
+        const auto by_batch = [&](const BatchSampler& sampler) {
+            sampler.sample(x.data(), y.data(), z.data(), out.data(), samples, false);
+            double sum = 0.0;
+            #pragma omp parallel for schedule(static) reduction(+:sum)
+            for(size_t i=0; i<samples; i++) {
+                sum += out[i];
+            }
+            return sum;
+        };
+        measure("linear, batch sampler", [&]() {
+            return by_batch(linear_sampler);
+        }, samples, repetitions, counter);
+        measure("tiled, batch sampler", [&]() {
+            return by_batch(tiled_sampler);
+        }, samples, repetitions, counter);
+    }
+
+    return 0;
+}
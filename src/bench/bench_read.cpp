@@ -0,0 +1,194 @@
+/**************************************************************************
+ *                                                                        *
+ *   Author: Ivo Filot <i.a.w.filot@tue.nl>                               *
+ *                                                                        *
+ *   EDP is free software:                                                *
+ *   you can redistribute it and/or modify it under the terms of the      *
+ *   GNU General Public License as published by the Free Software         *
+ *   Foundation, either version 3 of the License, or (at your option)     *
+ *   any later version.                                                   *
+ *                                                                        *
+ *   EDP is distributed in the hope that it will be useful,               *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty          *
+ *   of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.              *
+ *   See the GNU General Public License for more details.                 *
+ *                                                                        *
+ *   You should have received a copy of the GNU General Public License    *
+ *   along with this program.  If not, see http://www.gnu.org/licenses/.  *
+ *                                                                        *
+ **************************************************************************/
+
+/*
+ * PURPOSE
+ * =======
+ *
+ * Measures the throughput (in MB/s of the volumetric data block) of the
+ * line-based Boost.Spirit reader that EDP used to have against the
+ * memory-mapped FloatTokenizer path.
+ *
+ * Usage: BenchRead <CHGCAR> [repetitions]
+ */
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <limits>
+#include <boost/format.hpp>
+
+#include "scalar_field.h"
+#include "float_parser.h"
+
+/**
+ * @brief      locate the byte range of the first volumetric data block
+ *
+ * @param[in]  mf        mapped file
+ * @param[in]  dims      grid dimensions
+ *
+ * @return     begin and end offsets of the block
+ */
+static std::pair<size_t, size_t> find_block(const MappedFile& mf, const std::array<unsigned int, 3>& dims) {
+    const char* p = mf.data();
+    const char* end = mf.end();
+    std::string line;
+    std::vector<std::string> pieces;
+    while(p < end) {
+        const char* eol = static_cast<const char*>(memchr(p, '\n', end - p));
+        eol = eol == nullptr ? end : eol;
+        line.assign(p, eol);
+        p = eol + 1;
+
+        // VASP pads the grid line with a variable amount of whitespace
+        boost::trim(line);
+        boost::split(pieces, line, boost::is_any_of("\t "), boost::token_compress_on);
+        if(pieces.size() == 3 && pieces[0] == std::to_string(dims[0]) &&
+           pieces[1] == std::to_string(dims[1]) && pieces[2] == std::to_string(dims[2])) {
+            break;
+        }
+    }
+
+    const size_t gridsize = (size_t)dims[0] * dims[1] * dims[2];
+    const char* q = p;
+    std::vector<fpt> dummy(gridsize);
+    FloatTokenizer::parse_block(q, end, &dummy[0], gridsize, 1.0f);
+    return std::make_pair(p - mf.data(), q - mf.data());
+}
+
+/**
+ * @brief      reference implementation: getline, regex and Boost.Spirit
+ */
+static size_t read_legacy(const std::string& filename, size_t offset, const std::string& gridline,
+                          size_t gridsize, fpt volume, std::vector<fpt>& gridptr) {
+    std::ifstream infile(filename);
+    infile.seekg(offset);
+
+    float_parser p;
+    static const boost::regex regex_augmentation("augmentation.*");
+    std::string line;
+    gridptr.clear();
+    while(std::getline(infile, line)) {
+        if(line.compare(gridline) == 0) {
+            break;
+        }
+
+        boost::smatch what;
+        if(boost::regex_match(line, what, regex_augmentation)) {
+            break;
+        }
+
+        std::string::const_iterator b = line.begin();
+        std::string::const_iterator e = line.end();
+        std::vector<fpt> fpts;
+        boost::spirit::qi::phrase_parse(b, e, p, boost::spirit::ascii::space, fpts);
+
+        size_t cursize = gridptr.size();
+        gridptr.resize(cursize + fpts.size());
+        for(unsigned int j=0; j<fpts.size(); j++) {
+            gridptr[cursize + j] = fpts[j] / volume;
+        }
+
+        if(gridptr.size() >= gridsize) {
+            break;
+        }
+    }
+
+    return gridptr.size();
+}
+
+/**
+ * @brief      memory-mapped tokenizer
+ */
+static size_t read_tokenizer(const std::string& filename, size_t offset, size_t gridsize,
+                             fpt volume, std::vector<fpt>& gridptr) {
+    MappedFile mf(filename);
+    const char* p = mf.data() + offset;
+    gridptr.resize(gridsize);
+    return FloatTokenizer::parse_block(p, mf.end(), &gridptr[0], gridsize, volume);
+}
+
+int main(int argc, char* argv[]) {
+    if(argc < 2) {
+        std::cerr << "Usage: " << argv[0] << " <CHGCAR> [repetitions]" << std::endl;
+        return -1;
+    }
+
+    const std::string filename = argv[1];
+    const unsigned int repetitions = argc > 2 ? std::stoi(argv[2]) : 3;
+
+    // every repetition should parse the file rather than map its cache entry
+    setenv("EDP_NO_CACHE", "1", 1);
+
+    ScalarField sf(filename, false);
+    sf.read_header_and_atoms();
+    const auto& dims = sf.get_grid_dimensions();
+    const size_t gridsize = (size_t)dims[0] * dims[1] * dims[2];
+    const std::string gridline = (boost::format("%i %i %i") % dims[0] % dims[1] % dims[2]).str();
+
+    std::pair<size_t, size_t> block;
+    {
+        MappedFile mf(filename);
+        block = find_block(mf, dims);
+    }
+    const double mb = (block.second - block.first) / (1024.0 * 1024.0);
+
+    std::cout << boost::format("Grid: %i x %i x %i (%.1f MB of text)") % dims[0] % dims[1] % dims[2] % mb << std::endl;
+
+    std::vector<fpt> ref, grid;
+    double t_legacy = 1e30, t_tokenizer = 1e30, t_sf = 1e30;
+    for(unsigned int r=0; r<repetitions; r++) {
+        auto start = std::chrono::steady_clock::now();
+        size_t n1 = read_legacy(filename, block.first, gridline, gridsize, sf.get_volume(), ref);
+        auto mid = std::chrono::steady_clock::now();
+        size_t n2 = read_tokenizer(filename, block.first, gridsize, sf.get_volume(), grid);
+        auto stop = std::chrono::steady_clock::now();
+
+        ScalarField sf2(filename, false);
+        auto start_sf = std::chrono::steady_clock::now();
+        sf2.read();
+        auto stop_sf = std::chrono::steady_clock::now();
+
+        if(n1 != gridsize || n2 != gridsize) {
+            std::cerr << "Number of values read does not match the grid size" << std::endl;
+            return -1;
+        }
+
+        t_legacy = std::min(t_legacy, std::chrono::duration<double>(mid - start).count());
+        t_tokenizer = std::min(t_tokenizer, std::chrono::duration<double>(stop - mid).count());
+        t_sf = std::min(t_sf, std::chrono::duration<double>(stop_sf - start_sf).count());
+    }
+
+    // verify that both readers produce the same grid; Boost.Spirit is not
+    // correctly rounded, so allow for a few ulp and ignore denormals
+    size_t mismatches = 0;
+    for(size_t i=0; i<gridsize; i++) {
+        if(std::fabs(ref[i] - grid[i]) > 1e-6f * std::fabs(ref[i]) + std::numeric_limits<fpt>::min()) {
+            mismatches++;
+        }
+    }
+
+    std::cout << boost::format("%-28s %10.4f s %10.1f MB/s") % "getline + Boost.Spirit" % t_legacy % (mb / t_legacy) << std::endl;
+    std::cout << boost::format("%-28s %10.4f s %10.1f MB/s") % "mmap + FloatTokenizer" % t_tokenizer % (mb / t_tokenizer) << std::endl;
+    std::cout << boost::format("%-28s %10.4f s %10.1f MB/s") % "ScalarField::read()" % t_sf % (mb / t_sf) << std::endl;
+    std::cout << boost::format("Speedup: %.2fx, mismatching values: %i") % (t_legacy / t_tokenizer) % mismatches << std::endl;
+
+    return mismatches == 0 ? 0 : -1;
+}
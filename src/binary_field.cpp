@@ -0,0 +1,268 @@
+/**************************************************************************
+ *                                                                        *
+ *   Author: Ivo Filot <i.a.w.filot@tue.nl>                               *
+ *                                                                        *
+ *   EDP is free software:                                                *
+ *   you can redistribute it and/or modify it under the terms of the      *
+ *   GNU General Public License as published by the Free Software         *
+ *   Foundation, either version 3 of the License, or (at your option)     *
+ *   any later version.                                                   *
+ *                                                                        *
+ *   EDP is distributed in the hope that it will be useful,               *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty          *
+ *   of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.              *
+ *   See the GNU General Public License for more details.                 *
+ *                                                                        *
+ *   You should have received a copy of the GNU General Public License    *
+ *   along with this program.  If not, see http://www.gnu.org/licenses/.  *
+ *                                                                        *
+ **************************************************************************/
+
+#include "binary_field.h"
+#include "scalar_field.h"
+#include "tar_archive.h"
+
+#include <sys/stat.h>
+
+/**
+ * @brief      check whether a file is stored in the binary format
+ *
+ * @param[in]  filename  path to the file
+ *
+ * @return     True if binary, False otherwise.
+ */
+bool BinaryField::probe(const std::string& filename) {
+    std::ifstream infile(filename, std::ios::binary);
+    char magic[sizeof(MAGIC)];
+    if(!infile.read(magic, sizeof(magic))) {
+        return false;
+    }
+    return std::memcmp(magic, MAGIC, sizeof(MAGIC)) == 0;
+}
+
+/**
+ * @brief      read the header of a binary file
+ *
+ * @param[in]  filename  path to the file
+ *
+ * @return     header
+ */
+BinaryField::Header BinaryField::read_file_header(const std::string& filename) {
+    std::ifstream infile(filename, std::ios::binary);
+    if(!infile.is_open()) {
+        throw std::runtime_error("Cannot open " + filename + "!");
+    }
+
+    Header header;
+    if(!infile.read(reinterpret_cast<char*>(&header), sizeof(Header)) ||
+       std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0) {
+        throw std::runtime_error(filename + " is not an EDP binary field file.");
+    }
+    if(header.version != VERSION) {
+        throw std::runtime_error("Unsupported version " + std::to_string(header.version) + " of binary field file " + filename);
+    }
+    if(header.byte_order != BYTE_ORDER_MARK) {
+        throw std::runtime_error(filename + " has been written on a machine with a different byte order.");
+    }
+    if(header.value_size != sizeof(fpt)) {
+        throw std::runtime_error(filename + " stores " + std::to_string(header.value_size) +
+                                 "-byte values, expected " + std::to_string(sizeof(fpt)) + " bytes.");
+    }
+
+    return header;
+}
+
+/**
+ * @brief      populate the header and atoms of a scalar field
+ *
+ * @param      sf    scalar field (its filename points to a binary file)
+ */
+void BinaryField::read_header(ScalarField* sf) {
+    const Header header = read_file_header(sf->filename);
+
+    const uint64_t sections_end = sizeof(Header) +
+                                  header.nr_species * sizeof(uint64_t) +
+                                  header.nr_charges * sizeof(uint32_t) +
+                                  header.nr_atoms * 3 * sizeof(double) +
+                                  header.comment_length;
+    const uint64_t gridsize = header.grid_dimensions[0] * header.grid_dimensions[1] * header.grid_dimensions[2];
+    if(header.grid_offset < sections_end ||
+       header.grid_offset + gridsize * header.value_size > boost::filesystem::file_size(sf->filename)) {
+        throw std::runtime_error("Binary field file " + sf->filename + " is truncated or corrupt.");
+    }
+
+    std::ifstream infile(sf->filename, std::ios::binary);
+    infile.seekg(sizeof(Header));
+
+    std::vector<uint64_t> nrat(header.nr_species);
+    std::vector<uint32_t> charges(header.nr_charges);
+    std::vector<double> pos(header.nr_atoms * 3);
+    std::string comment(header.comment_length, '\0');
+    infile.read(reinterpret_cast<char*>(nrat.data()), nrat.size() * sizeof(uint64_t));
+    infile.read(reinterpret_cast<char*>(charges.data()), charges.size() * sizeof(uint32_t));
+    infile.read(reinterpret_cast<char*>(pos.data()), pos.size() * sizeof(double));
+    infile.read(&comment[0], comment.size());
+    if(!infile) {
+        throw std::runtime_error("Error encountered in reading atoms from " + sf->filename);
+    }
+
+    sf->comment = comment;
+    sf->scalar = header.scalar;
+    for(unsigned int i=0; i<3; i++) {
+        for(unsigned int j=0; j<3; j++) {
+            sf->mat(i,j) = header.mat[i*3+j];
+        }
+    }
+    sf->imat = sf->mat.inverse();
+    sf->volume = sf->mat.determinant();
+
+    sf->nrat.assign(nrat.begin(), nrat.end());
+    sf->atom_charges.assign(charges.begin(), charges.end());
+    sf->atom_pos.clear();
+    for(uint64_t i=0; i<header.nr_atoms; i++) {
+        sf->atom_pos.emplace_back(pos[i*3], pos[i*3+1], pos[i*3+2]);
+    }
+
+    for(unsigned int i=0; i<3; i++) {
+        sf->grid_dimensions[i] = header.grid_dimensions[i];
+    }
+    sf->gridsize = gridsize;
+    sf->gridline = std::to_string(header.grid_dimensions[0]) + " " +
+                   std::to_string(header.grid_dimensions[1]) + " " +
+                   std::to_string(header.grid_dimensions[2]);
+    sf->grid_offset = header.grid_offset;
+    sf->vasp5_input = header.flags & FLAG_VASP5;
+    sf->flag_is_locpot = header.flags & FLAG_LOCPOT;
+    sf->header_read = true;
+}
+
+/**
+ * @brief      map the grid of a binary file into a scalar field
+ *
+ * The header of the scalar field should have been read; the grid
+ * dimensions of the binary file have to match.
+ *
+ * @param      sf        scalar field
+ * @param[in]  filename  path to the binary file
+ */
+void BinaryField::read_grid(ScalarField* sf, const std::string& filename) {
+    const Header header = read_file_header(filename);
+    for(unsigned int i=0; i<3; i++) {
+        if(header.grid_dimensions[i] != sf->grid_dimensions[i]) {
+            throw std::runtime_error("Grid dimensions of " + filename + " do not match those of " + sf->filename);
+        }
+    }
+
+    auto mf = std::make_shared<MappedFile>(filename);
+    sf->gridptr.map(mf, header.grid_offset, sf->gridsize);
+    sf->has_read = true;
+}
+
+/**
+ * @brief      write a scalar field in the binary format
+ *
+ * The grid of the scalar field should have been read. The size and
+ * modification time of the source file of the scalar field are recorded
+ * in the header.
+ *
+ * @param[in]  sf        scalar field
+ * @param[in]  filename  path to the output file
+ */
+void BinaryField::write(const ScalarField& sf, const std::string& filename) {
+    if(!sf.has_read) {
+        throw std::runtime_error("Cannot write " + filename + "; the grid of " + sf.filename + " has not been read.");
+    }
+
+    Header header;
+    std::memset(&header, 0, sizeof(Header));
+    std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.version = VERSION;
+    header.byte_order = BYTE_ORDER_MARK;
+    header.flags = (sf.flag_is_locpot ? FLAG_LOCPOT : 0) | (sf.vasp5_input ? FLAG_VASP5 : 0);
+    header.value_size = sizeof(fpt);
+    header.scalar = sf.scalar;
+    for(unsigned int i=0; i<3; i++) {
+        for(unsigned int j=0; j<3; j++) {
+            header.mat[i*3+j] = sf.mat(i,j);
+        }
+        header.grid_dimensions[i] = sf.grid_dimensions[i];
+    }
+    header.nr_species = sf.nrat.size();
+    header.nr_charges = sf.atom_charges.size();
+    header.nr_atoms = sf.atom_pos.size();
+    header.comment_length = sf.comment.size();
+    // standard input has neither a size nor a modification time; for
+    // members of an archive, those of the archive are recorded
+    const std::string source = TarArchive::get_source(sf.filename);
+    if(boost::filesystem::is_regular_file(source)) {
+        header.source_size = boost::filesystem::file_size(source);
+        header.source_mtime = get_mtime(source);
+    }
+
+    const uint64_t sections_end = sizeof(Header) +
+                                  header.nr_species * sizeof(uint64_t) +
+                                  header.nr_charges * sizeof(uint32_t) +
+                                  header.nr_atoms * 3 * sizeof(double) +
+                                  header.comment_length;
+    header.grid_offset = (sections_end + GRID_ALIGNMENT - 1) / GRID_ALIGNMENT * GRID_ALIGNMENT;
+
+    std::vector<uint64_t> nrat(sf.nrat.begin(), sf.nrat.end());
+    std::vector<uint32_t> charges(sf.atom_charges.begin(), sf.atom_charges.end());
+    std::vector<double> pos;
+    for(const auto& atom : sf.atom_pos) {
+        pos.insert(pos.end(), {atom[0], atom[1], atom[2]});
+    }
+    std::vector<char> padding(header.grid_offset - sections_end, 0);
+
+    // write to a temporary file first such that readers never observe a
+    // partially written file
+    const std::string tmpfile = get_temp_name(filename);
+    {
+        std::ofstream outfile(tmpfile, std::ios::binary | std::ios::trunc);
+        if(!outfile.is_open()) {
+            throw std::runtime_error("Cannot open " + tmpfile + " for writing!");
+        }
+        outfile.write(reinterpret_cast<const char*>(&header), sizeof(Header));
+        outfile.write(reinterpret_cast<const char*>(nrat.data()), nrat.size() * sizeof(uint64_t));
+        outfile.write(reinterpret_cast<const char*>(charges.data()), charges.size() * sizeof(uint32_t));
+        outfile.write(reinterpret_cast<const char*>(pos.data()), pos.size() * sizeof(double));
+        outfile.write(sf.comment.data(), sf.comment.size());
+        outfile.write(padding.data(), padding.size());
+        outfile.write(reinterpret_cast<const char*>(sf.get_grid_ptr()), sf.gridptr.size() * sizeof(fpt));
+        if(!outfile) {
+            boost::filesystem::remove(tmpfile);
+            throw std::runtime_error("Error encountered in writing " + tmpfile);
+        }
+    }
+    boost::filesystem::rename(tmpfile, filename);
+}
+
+/**
+ * @brief      get the modification time of a file
+ *
+ * @param[in]  filename  path to the file
+ *
+ * @return     modification time in nanoseconds since epoch
+ */
+int64_t BinaryField::get_mtime(const std::string& filename) {
+    struct stat st;
+    if(stat(filename.c_str(), &st) != 0) {
+        throw std::runtime_error("Cannot stat " + filename + "!");
+    }
+#ifdef _APPLE
+    return (int64_t)st.st_mtimespec.tv_sec * 1000000000 + st.st_mtimespec.tv_nsec;
+#else
+    return (int64_t)st.st_mtim.tv_sec * 1000000000 + st.st_mtim.tv_nsec;
+#endif
+}
+
+/**
+ * @brief      get a unique temporary path next to a file
+ *
+ * @param[in]  filename  path to the file
+ *
+ * @return     path ending in ".part-" followed by random characters
+ */
+std::string BinaryField::get_temp_name(const std::string& filename) {
+    return filename + ".part-" + boost::filesystem::unique_path("%%%%%%%%%%%%%%%%").string();
+}
@@ -0,0 +1,152 @@
+/**************************************************************************
+ *                                                                        *
+ *   Author: Ivo Filot <i.a.w.filot@tue.nl>                               *
+ *                                                                        *
+ *   EDP is free software:                                                *
+ *   you can redistribute it and/or modify it under the terms of the      *
+ *   GNU General Public License as published by the Free Software         *
+ *   Foundation, either version 3 of the License, or (at your option)     *
+ *   any later version.                                                   *
+ *                                                                        *
+ *   EDP is distributed in the hope that it will be useful,               *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty          *
+ *   of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.              *
+ *   See the GNU General Public License for more details.                 *
+ *                                                                        *
+ *   You should have received a copy of the GNU General Public License    *
+ *   along with this program.  If not, see http://www.gnu.org/licenses/.  *
+ *                                                                        *
+ **************************************************************************/
+
+#ifndef _BINARY_FIELD_H
+#define _BINARY_FIELD_H
+
+#include <string>
+#include <cstdint>
+
+class ScalarField;
+
+/**
+ * @brief      Native binary representation of a scalar field
+ *
+ * The file starts with a fixed-size header holding the unit cell, the grid
+ * dimensions and the location of the remaining sections, followed by the
+ * atoms, the comment line of the original file and finally the grid. The grid
+ * is stored as raw (native-endian) floating point values that have already
+ * been divided by the cell volume and it starts at a page boundary, such that
+ * it can be memory-mapped straight into a ScalarField without any parsing or
+ * copying.
+ *
+ * Layout:
+ *
+ *   BinaryField::Header
+ *   uint64 nrat[nr_species]
+ *   uint32 atom_charges[nr_charges]        (empty for VASP4 files)
+ *   double atom_pos[nr_atoms][3]           (direct coordinates)
+ *   char   comment[comment_length]
+ *   <zero padding up to grid_offset>
+ *   fpt    grid[nx * ny * nz]              (x runs fastest)
+ */
+class BinaryField {
+public:
+    static constexpr char MAGIC[8] = {'E','D','P','F','I','E','L','D'};
+    static constexpr uint32_t VERSION = 1;
+    static constexpr uint32_t BYTE_ORDER_MARK = 0x01020304;
+    static constexpr uint64_t GRID_ALIGNMENT = 4096;
+
+    static constexpr uint32_t FLAG_LOCPOT = 1 << 0;
+    static constexpr uint32_t FLAG_VASP5 = 1 << 1;
+
+    /**
+     * @brief      fixed-size header at the start of the file
+     */
+    struct Header {
+        char magic[8];
+        uint32_t version;
+        uint32_t byte_order;
+        uint32_t flags;
+        uint32_t value_size;        // size of a single grid value in bytes
+        double scalar;
+        double mat[9];              // unit cell (row vectors), scalar applied
+        uint64_t grid_dimensions[3];
+        uint64_t nr_species;
+        uint64_t nr_charges;
+        uint64_t nr_atoms;
+        uint64_t comment_length;
+        uint64_t source_size;       // size of the file this one was converted from
+        int64_t source_mtime;       // modification time of that file (ns since epoch)
+        uint64_t grid_offset;       // byte offset of the grid
+    };
+
+    /**
+     * @brief      check whether a file is stored in the binary format
+     *
+     * @param[in]  filename  path to the file
+     *
+     * @return     True if binary, False otherwise.
+     */
+    static bool probe(const std::string& filename);
+
+    /**
+     * @brief      read the header of a binary file
+     *
+     * @param[in]  filename  path to the file
+     *
+     * @return     header
+     */
+    static Header read_file_header(const std::string& filename);
+
+    /**
+     * @brief      populate the header and atoms of a scalar field
+     *
+     * @param      sf    scalar field (its filename points to a binary file)
+     */
+    static void read_header(ScalarField* sf);
+
+    /**
+     * @brief      map the grid of a binary file into a scalar field
+     *
+     * The header of the scalar field should have been read; the grid
+     * dimensions of the binary file have to match.
+     *
+     * @param      sf        scalar field
+     * @param[in]  filename  path to the binary file
+     */
+    static void read_grid(ScalarField* sf, const std::string& filename);
+
+    /**
+     * @brief      write a scalar field in the binary format
+     *
+     * The grid of the scalar field should have been read. The size and
+     * modification time of the source file of the scalar field are recorded
+     * in the header.
+     *
+     * @param[in]  sf        scalar field
+     * @param[in]  filename  path to the output file
+     */
+    static void write(const ScalarField& sf, const std::string& filename);
+
+    /**
+     * @brief      get the modification time of a file
+     *
+     * @param[in]  filename  path to the file
+     *
+     * @return     modification time in nanoseconds since epoch
+     */
+    static int64_t get_mtime(const std::string& filename);
+
+    /**
+     * @brief      get a unique temporary path next to a file
+     *
+     * Files are written to such a path first and then renamed, such that
+     * readers never observe a partially written file and concurrent
+     * writers of the same file do not interfere.
+     *
+     * @param[in]  filename  path to the file
+     *
+     * @return     path ending in ".part-" followed by random characters
+     */
+    static std::string get_temp_name(const std::string& filename);
+};
+
+#endif // _BINARY_FIELD_H
@@ -0,0 +1,168 @@
+/**************************************************************************
+ *                                                                        *
+ *   Author: Ivo Filot <i.a.w.filot@tue.nl>                               *
+ *                                                                        *
+ *   EDP is free software:                                                *
+ *   you can redistribute it and/or modify it under the terms of the      *
+ *   GNU General Public License as published by the Free Software         *
+ *   Foundation, either version 3 of the License, or (at your option)     *
+ *   any later version.                                                   *
+ *                                                                        *
+ *   EDP is distributed in the hope that it will be useful,               *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty          *
+ *   of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.              *
+ *   See the GNU General Public License for more details.                 *
+ *                                                                        *
+ *   You should have received a copy of the GNU General Public License    *
+ *   along with this program.  If not, see http://www.gnu.org/licenses/.  *
+ *                                                                        *
+ **************************************************************************/
+
+#include "bricked_grid.h"
+
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+
+/**
+ * @brief      construct the bricks from a grid
+ *
+ * The extrema of all bricks are determined in parallel, after which the
+ * bricks that are not constant are numbered in order and their values are
+ * copied, again in parallel.
+ *
+ * @param[in]  grid       grid (x running fastest)
+ * @param[in]  _dims      grid dimensions
+ * @param[in]  threshold  largest spread of the values of a constant brick
+ */
+BrickedGrid::BrickedGrid(const fpt* grid, const std::array<unsigned int, 3>& _dims, fpt threshold) {
+    this->dims = _dims;
+    for(unsigned int d=0; d<3; d++) {
+        this->nbricks[d] = (this->dims[d] + BRICK - 1) / BRICK;
+    }
+    this->bricks.resize((size_t)this->nbricks[0] * this->nbricks[1] * this->nbricks[2]);
+
+    const size_t nx = this->dims[0];
+    const size_t nxy = nx * this->dims[1];
+
+    #pragma omp parallel for schedule(dynamic)
+    for(size_t b=0; b<this->bricks.size(); b++) {
+        const unsigned int bi = b % this->nbricks[0];
+        const unsigned int bj = (b / this->nbricks[0]) % this->nbricks[1];
+        const unsigned int bk = b / ((size_t)this->nbricks[0] * this->nbricks[1]);
+        const unsigned int i1 = std::min((bi + 1) * BRICK, this->dims[0]);
+        const unsigned int j1 = std::min((bj + 1) * BRICK, this->dims[1]);
+        const unsigned int k1 = std::min((bk + 1) * BRICK, this->dims[2]);
+
+        fpt vmin = std::numeric_limits<fpt>::max();
+        fpt vmax = std::numeric_limits<fpt>::lowest();
+        for(unsigned int k=bk*BRICK; k<k1; k++) {
+            for(unsigned int j=bj*BRICK; j<j1; j++) {
+                const fpt* row = grid + k * nxy + j * nx;
+                for(unsigned int i=bi*BRICK; i<i1; i++) {
+                    vmin = std::min(vmin, row[i]);
+                    vmax = std::max(vmax, row[i]);
+                }
+            }
+        }
+
+        Brick& brick = this->bricks[b];
+        brick.min = vmin;
+        brick.max = vmax;
+        brick.value = (vmin + vmax) / (fpt)2.0;
+        brick.index = vmax - vmin <= threshold ? CONSTANT : 0;
+    }
+
+    size_t nr_stored = 0;
+    for(Brick& brick : this->bricks) {
+        if(brick.index != CONSTANT) {
+            if(nr_stored == CONSTANT) {
+                throw std::runtime_error("The grid holds too many bricks to be stored sparsely.");
+            }
+            brick.index = nr_stored++;
+        }
+    }
+    this->values.resize(nr_stored << (3 * BRICK_SHIFT));
+
+    #pragma omp parallel for schedule(dynamic)
+    for(size_t b=0; b<this->bricks.size(); b++) {
+        const Brick& brick = this->bricks[b];
+        if(brick.index == CONSTANT) {
+            continue;
+        }
+        const unsigned int bi = b % this->nbricks[0];
+        const unsigned int bj = (b / this->nbricks[0]) % this->nbricks[1];
+        const unsigned int bk = b / ((size_t)this->nbricks[0] * this->nbricks[1]);
+
+        // points beyond the edges of the grid are never accessed and
+        // keep the value of the brick
+        fpt* out = this->values.data() + ((size_t)brick.index << (3 * BRICK_SHIFT));
+        std::fill(out, out + BRICK * BRICK * BRICK, brick.value);
+        for(unsigned int k=0; k<BRICK && bk*BRICK+k<this->dims[2]; k++) {
+            for(unsigned int j=0; j<BRICK && bj*BRICK+j<this->dims[1]; j++) {
+                const fpt* row = grid + (bk*BRICK + k) * nxy + (bj*BRICK + j) * nx + bi*BRICK;
+                const unsigned int n = std::min(BRICK, this->dims[0] - bi*BRICK);
+                std::copy(row, row + n, out + (k * BRICK + j) * BRICK);
+            }
+        }
+    }
+}
+
+/**
+ * @brief      sum of the values in a plane of constant z
+ *
+ * Constant bricks contribute their value times the number of points of
+ * the brick in the plane.
+ *
+ * @param[in]  k     index of the plane
+ *
+ * @return     sum
+ */
+fpa BrickedGrid::get_slab_sum(unsigned int k) const {
+    const size_t offset = (size_t)(k >> BRICK_SHIFT) * this->nbricks[0] * this->nbricks[1];
+    const size_t layer = (size_t)(k & (BRICK - 1)) * BRICK * BRICK;
+
+    fpa sum = 0.0;
+    #pragma omp parallel for collapse(2) reduction(+:sum)
+    for(unsigned int bj=0; bj<this->nbricks[1]; bj++) {
+        for(unsigned int bi=0; bi<this->nbricks[0]; bi++) {
+            const Brick& brick = this->bricks[offset + (size_t)bj * this->nbricks[0] + bi];
+            const unsigned int nx = std::min(BRICK, this->dims[0] - bi*BRICK);
+            const unsigned int ny = std::min(BRICK, this->dims[1] - bj*BRICK);
+            if(brick.index == CONSTANT) {
+                sum += (fpa)brick.value * (nx * ny);
+                continue;
+            }
+            const fpt* values = this->values.data() + ((size_t)brick.index << (3 * BRICK_SHIFT)) + layer;
+            for(unsigned int j=0; j<ny; j++) {
+                for(unsigned int i=0; i<nx; i++) {
+                    sum += values[j * BRICK + i];
+                }
+            }
+        }
+    }
+
+    return sum;
+}
+
+/**
+ * @brief      minimum value of the grid
+ */
+fpt BrickedGrid::get_min() const {
+    fpt vmin = std::numeric_limits<fpt>::max();
+    for(const Brick& brick : this->bricks) {
+        vmin = std::min(vmin, brick.min);
+    }
+    return vmin;
+}
+
+/**
+ * @brief      maximum value of the grid
+ */
+fpt BrickedGrid::get_max() const {
+    fpt vmax = std::numeric_limits<fpt>::lowest();
+    for(const Brick& brick : this->bricks) {
+        vmax = std::max(vmax, brick.max);
+    }
+    return vmax;
+}
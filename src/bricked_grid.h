@@ -0,0 +1,151 @@
+/**************************************************************************
+ *                                                                        *
+ *   Author: Ivo Filot <i.a.w.filot@tue.nl>                               *
+ *                                                                        *
+ *   EDP is free software:                                                *
+ *   you can redistribute it and/or modify it under the terms of the      *
+ *   GNU General Public License as published by the Free Software         *
+ *   Foundation, either version 3 of the License, or (at your option)     *
+ *   any later version.                                                   *
+ *                                                                        *
+ *   EDP is distributed in the hope that it will be useful,               *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty          *
+ *   of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.              *
+ *   See the GNU General Public License for more details.                 *
+ *                                                                        *
+ *   You should have received a copy of the GNU General Public License    *
+ *   along with this program.  If not, see http://www.gnu.org/licenses/.  *
+ *                                                                        *
+ **************************************************************************/
+
+#ifndef _BRICKED_GRID_H
+#define _BRICKED_GRID_H
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+#include "math.h"
+
+/**
+ * @brief      Block-sparse storage for a scalar field
+ *
+ * The grid is divided into bricks of BRICK^3 points (bricks at the upper
+ * edges of the grid are truncated). Every brick records the minimum and
+ * maximum of its values. A brick whose values span at most a threshold,
+ * such as a brick in the vacuum of a slab or molecule, is represented by
+ * a single constant (the midpoint of its range); only the remaining bricks
+ * store their values, brick by brick with x running fastest. Hence, the
+ * error of any value is at most half the threshold, whereas the extrema
+ * are retained exactly.
+ */
+class BrickedGrid {
+public:
+    static constexpr unsigned int BRICK = 8;    // number of points per brick along each axis
+    static constexpr unsigned int BRICK_SHIFT = 3;
+
+private:
+    static constexpr uint32_t CONSTANT = UINT32_MAX;    // index of bricks without stored values
+
+    struct Brick {
+        fpt min;
+        fpt max;
+        fpt value;          // value of a constant brick
+        uint32_t index;     // index of the stored values; CONSTANT for constant bricks
+    };
+
+    std::array<unsigned int, 3> dims;       // grid dimensions
+    std::array<unsigned int, 3> nbricks;    // number of bricks along each axis
+    std::vector<Brick> bricks;
+    std::vector<fpt> values;                // values of the stored bricks
+
+public:
+    /**
+     * @brief      construct the bricks from a grid
+     *
+     * @param[in]  grid       grid (x running fastest)
+     * @param[in]  _dims      grid dimensions
+     * @param[in]  threshold  largest spread of the values of a constant brick
+     */
+    BrickedGrid(const fpt* grid, const std::array<unsigned int, 3>& _dims, fpt threshold);
+
+    /**
+     * @brief      value at a grid point
+     */
+    inline fpt get_value(unsigned int i, unsigned int j, unsigned int k) const {
+        const Brick& b = this->get_brick(i, j, k);
+        if(b.index == CONSTANT) {
+            return b.value;
+        }
+        const size_t local = (((k & (BRICK - 1)) << BRICK_SHIFT | (j & (BRICK - 1))) << BRICK_SHIFT) | (i & (BRICK - 1));
+        return this->values[((size_t)b.index << (3 * BRICK_SHIFT)) + local];
+    }
+
+    /**
+     * @brief      whether two opposite corners of a cell lie in the same
+     *             constant brick
+     *
+     * @param[in]  i0,j0,k0  lower corner
+     * @param[in]  i1,j1,k1  upper corner
+     * @param      value     set to the value of the brick if so
+     *
+     * @return     True if the cell is constant, False otherwise.
+     */
+    inline bool is_constant(unsigned int i0, unsigned int j0, unsigned int k0,
+                            unsigned int i1, unsigned int j1, unsigned int k1, fpt* value) const {
+        if(((i0 ^ i1) | (j0 ^ j1) | (k0 ^ k1)) >> BRICK_SHIFT) {
+            return false;
+        }
+        const Brick& b = this->get_brick(i0, j0, k0);
+        *value = b.value;
+        return b.index == CONSTANT;
+    }
+
+    /**
+     * @brief      sum of the values in a plane of constant z
+     *
+     * @param[in]  k     index of the plane
+     *
+     * @return     sum
+     */
+    fpa get_slab_sum(unsigned int k) const;
+
+    /**
+     * @brief      minimum value of the grid
+     */
+    fpt get_min() const;
+
+    /**
+     * @brief      maximum value of the grid
+     */
+    fpt get_max() const;
+
+    /**
+     * @brief      number of grid points
+     */
+    inline size_t get_size() const {
+        return (size_t)this->dims[0] * this->dims[1] * this->dims[2];
+    }
+
+    /**
+     * @brief      total number of bricks
+     */
+    inline size_t get_nr_bricks() const {
+        return this->bricks.size();
+    }
+
+    /**
+     * @brief      number of bricks whose values are stored
+     */
+    inline size_t get_nr_stored_bricks() const {
+        return this->values.size() >> (3 * BRICK_SHIFT);
+    }
+
+private:
+    inline const Brick& get_brick(unsigned int i, unsigned int j, unsigned int k) const {
+        return this->bricks[((size_t)(k >> BRICK_SHIFT) * this->nbricks[1] + (j >> BRICK_SHIFT)) * this->nbricks[0] +
+                            (i >> BRICK_SHIFT)];
+    }
+};
+
+#endif // _BRICKED_GRID_H
@@ -0,0 +1,125 @@
+/**************************************************************************
+ *                                                                        *
+ *   Author: Ivo Filot <i.a.w.filot@tue.nl>                               *
+ *                                                                        *
+ *   EDP is free software:                                                *
+ *   you can redistribute it and/or modify it under the terms of the      *
+ *   GNU General Public License as published by the Free Software         *
+ *   Foundation, either version 3 of the License, or (at your option)     *
+ *   any later version.                                                   *
+ *                                                                        *
+ *   EDP is distributed in the hope that it will be useful,               *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty          *
+ *   of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.              *
+ *   See the GNU General Public License for more details.                 *
+ *                                                                        *
+ *   You should have received a copy of the GNU General Public License    *
+ *   along with this program.  If not, see http://www.gnu.org/licenses/.  *
+ *                                                                        *
+ **************************************************************************/
+
+#include "bspline.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+/**
+ * @brief      convert a grid into the coefficients of the B-spline
+ *
+ * The lines along x are filtered one by one; the lines along y and z are
+ * filtered side by side, such that every step of the recursion runs over
+ * contiguous memory.
+ *
+ * @param      values  grid (x running fastest); overwritten by the coefficients
+ * @param[in]  dims    grid dimensions
+ */
+void CubicBSpline::prefilter(fpt* values, const std::array<unsigned int, 3>& dims) {
+    const size_t nx = dims[0];
+    const size_t ny = dims[1];
+    const size_t nz = dims[2];
+    const size_t nxy = nx * ny;
+
+    #pragma omp parallel for schedule(static)
+    for(size_t row=0; row<ny*nz; row++) {
+        filter_lines(values + row * nx, nx, 1, 1);
+    }
+
+    #pragma omp parallel for schedule(static)
+    for(size_t k=0; k<nz; k++) {
+        filter_lines(values + k * nxy, ny, nx, nx);
+    }
+
+    static const size_t COLUMNS = 1024;     // number of lines along z per task
+    const size_t nr_chunks = (nxy + COLUMNS - 1) / COLUMNS;
+    #pragma omp parallel for schedule(static)
+    for(size_t c=0; c<nr_chunks; c++) {
+        const size_t start = c * COLUMNS;
+        filter_lines(values + start, nz, nxy, std::min(COLUMNS, nxy - start));
+    }
+}
+
+/**
+ * @brief      apply the prefilter to interleaved lines of values
+ *
+ * The recursions start from the sums over the periodic continuation of the
+ * line, which are truncated once the powers of the pole drop below the
+ * precision of a double.
+ *
+ * @param      values  values
+ * @param[in]  n       number of values per line
+ * @param[in]  stride  distance between consecutive values of a line
+ * @param[in]  width   number of lines
+ */
+void CubicBSpline::filter_lines(fpt* values, size_t n, size_t stride, size_t width) {
+    const double z = std::sqrt(3.0) - 2.0;
+    const double gain = 6.0;
+    const size_t horizon = std::min<size_t>(n, HORIZON);
+    const double norm = 1.0 / (1.0 - std::pow(z, (double)n));
+    std::vector<double> sum(width);
+
+    // causal recursion: c+(m) = gain * s(m) + z * c+(m-1), starting from
+    // c+(0) = gain * sum_k z^k s(-k)
+    std::fill(sum.begin(), sum.end(), 0.0);
+    double zk = 1.0;
+    for(size_t k=0; k<horizon; k++) {
+        const fpt* v = values + ((n - k) % n) * stride;
+        for(size_t l=0; l<width; l++) {
+            sum[l] += zk * v[l];
+        }
+        zk *= z;
+    }
+    for(size_t l=0; l<width; l++) {
+        values[l] = gain * norm * sum[l];
+    }
+    for(size_t m=1; m<n; m++) {
+        fpt* v = values + m * stride;
+        const fpt* prev = v - stride;
+        for(size_t l=0; l<width; l++) {
+            v[l] = gain * v[l] + z * prev[l];
+        }
+    }
+
+    // anti-causal recursion: c(m) = z * (c(m+1) - c+(m)), starting from
+    // c(n-1) = -z * sum_k z^k c+(n-1+k)
+    std::fill(sum.begin(), sum.end(), 0.0);
+    zk = 1.0;
+    for(size_t k=0; k<horizon; k++) {
+        const fpt* v = values + ((n - 1 + k) % n) * stride;
+        for(size_t l=0; l<width; l++) {
+            sum[l] += zk * v[l];
+        }
+        zk *= z;
+    }
+    fpt* last = values + (n - 1) * stride;
+    for(size_t l=0; l<width; l++) {
+        last[l] = -z * norm * sum[l];
+    }
+    for(size_t m=n-1; m-->0; ) {
+        fpt* v = values + m * stride;
+        const fpt* next = v + stride;
+        for(size_t l=0; l<width; l++) {
+            v[l] = z * (next[l] - v[l]);
+        }
+    }
+}
@@ -0,0 +1,84 @@
+/**************************************************************************
+ *                                                                        *
+ *   Author: Ivo Filot <i.a.w.filot@tue.nl>                               *
+ *                                                                        *
+ *   EDP is free software:                                                *
+ *   you can redistribute it and/or modify it under the terms of the      *
+ *   GNU General Public License as published by the Free Software         *
+ *   Foundation, either version 3 of the License, or (at your option)     *
+ *   any later version.                                                   *
+ *                                                                        *
+ *   EDP is distributed in the hope that it will be useful,               *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty          *
+ *   of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.              *
+ *   See the GNU General Public License for more details.                 *
+ *                                                                        *
+ *   You should have received a copy of the GNU General Public License    *
+ *   along with this program.  If not, see http://www.gnu.org/licenses/.  *
+ *                                                                        *
+ **************************************************************************/
+
+#ifndef _BSPLINE_H
+#define _BSPLINE_H
+
+#include <array>
+
+#include "math.h"
+
+/**
+ * @brief      Interpolation of a periodic grid with cubic B-splines
+ *
+ * A cubic B-spline through the grid points has a continuous first and
+ * second derivative, such that contour lines remain smooth at a lower
+ * sampling density than with trilinear interpolation. Its coefficients are
+ * not the grid values themselves: they follow from the grid by a
+ * prefilter (the inverse of the discrete B-spline kernel [1 4 1]/6) that
+ * is applied along each axis in turn. The prefilter is implemented as a
+ * causal and an anti-causal first-order recursion with pole sqrt(3)-2,
+ * initialized for periodic boundaries (Unser, IEEE Signal Process. Mag.
+ * 16 (1999) 22).
+ */
+class CubicBSpline {
+public:
+    /**
+     * @brief      weights of the four coefficients around a position
+     *
+     * @param[in]  t     position relative to the second coefficient (inside [0,1])
+     * @param      w     weights of the coefficients at -1, 0, 1 and 2
+     */
+    static inline void weights(fpt t, fpt* w) {
+        const fpt s = 1.0 - t;
+        const fpt t2 = t * t;
+        const fpt t3 = t2 * t;
+        w[0] = s * s * s / 6.0;
+        w[1] = (fpt)(2.0 / 3.0) - t2 + (fpt)0.5 * t3;
+        w[3] = t3 / 6.0;
+        w[2] = 1.0 - w[0] - w[1] - w[3];
+    }
+
+    /**
+     * @brief      convert a grid into the coefficients of the B-spline
+     *
+     * @param      values  grid (x running fastest); overwritten by the coefficients
+     * @param[in]  dims    grid dimensions
+     */
+    static void prefilter(fpt* values, const std::array<unsigned int, 3>& dims);
+
+private:
+    static constexpr unsigned int HORIZON = 32;     // number of terms of the initial sums
+
+    /**
+     * @brief      apply the prefilter to interleaved lines of values
+     *
+     * The m-th value of line l is found at values[m * stride + l], such
+     * that the lines are filtered side by side.
+     *
+     * @param      values  values
+     * @param[in]  n       number of values per line
+     * @param[in]  stride  distance between consecutive values of a line
+     * @param[in]  width   number of lines
+     */
+    static void filter_lines(fpt* values, size_t n, size_t stride, size_t width);
+};
+
+#endif // _BSPLINE_H
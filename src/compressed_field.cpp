@@ -0,0 +1,557 @@
+/**************************************************************************
+ *                                                                        *
+ *   Author: Ivo Filot <i.a.w.filot@tue.nl>                               *
+ *                                                                        *
+ *   EDP is free software:                                                *
+ *   you can redistribute it and/or modify it under the terms of the      *
+ *   GNU General Public License as published by the Free Software         *
+ *   Foundation, either version 3 of the License, or (at your option)     *
+ *   any later version.                                                   *
+ *                                                                        *
+ *   EDP is distributed in the hope that it will be useful,               *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty          *
+ *   of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.              *
+ *   See the GNU General Public License for more details.                 *
+ *                                                                        *
+ *   You should have received a copy of the GNU General Public License    *
+ *   along with this program.  If not, see http://www.gnu.org/licenses/.  *
+ *                                                                        *
+ **************************************************************************/
+
+#include "compressed_field.h"
+#include "scalar_field.h"
+
+#include <cmath>
+#include <exception>
+#include <limits>
+#include <mutex>
+
+#include <boost/iostreams/copy.hpp>
+#include <boost/iostreams/device/array.hpp>
+#include <boost/iostreams/device/back_inserter.hpp>
+#include <boost/iostreams/filter/zstd.hpp>
+#include <boost/iostreams/filtering_stream.hpp>
+
+constexpr char CompressedField::MAGIC[8];
+
+namespace {
+
+static const uint32_t ZSTD_LEVEL = 3;
+
+// quantized values must be exactly representable in an int64 (and a double)
+static const double QUANTIZATION_LIMIT = 4503599627370496.0;   // 2^52
+
+/**
+ * @brief      number of bricks along each axis
+ */
+inline std::array<unsigned int, 3> get_nr_bricks(const std::array<unsigned int, 3>& dims) {
+    std::array<unsigned int, 3> n;
+    for(unsigned int d=0; d<3; d++) {
+        n[d] = (dims[d] + CompressedField::BRICK - 1) / CompressedField::BRICK;
+    }
+    return n;
+}
+
+/**
+ * @brief      number of points of a brick along each axis
+ */
+inline std::array<unsigned int, 3> get_extent(const std::array<unsigned int, 3>& dims, const std::array<unsigned int, 3>& brick) {
+    std::array<unsigned int, 3> extent;
+    for(unsigned int d=0; d<3; d++) {
+        extent[d] = std::min(CompressedField::BRICK, dims[d] - brick[d] * CompressedField::BRICK);
+    }
+    return extent;
+}
+
+/**
+ * @brief      Lorenzo prediction of a quantized value from its (already
+ *             visited) neighbours
+ *
+ * The quantized values are stored with a border of zeros at the lower
+ * edges, such that no bounds checks are required.
+ *
+ * @param[in]  q     quantized value at the position to predict
+ * @param[in]  sx    stride along y
+ * @param[in]  sxy   stride along z
+ */
+inline int64_t predict(const int64_t* q, size_t sx, size_t sxy) {
+    return q[-1] + q[-(ptrdiff_t)sx] + q[-(ptrdiff_t)sxy]
+         - q[-1-(ptrdiff_t)sx] - q[-1-(ptrdiff_t)sxy] - q[-(ptrdiff_t)(sx+sxy)]
+         + q[-1-(ptrdiff_t)(sx+sxy)];
+}
+
+inline void put_varint(std::string& out, int64_t value) {
+    uint64_t u = ((uint64_t)value << 1) ^ (uint64_t)(value >> 63);    // zigzag
+    while(u >= 0x80) {
+        out.push_back((char)(u | 0x80));
+        u >>= 7;
+    }
+    out.push_back((char)u);
+}
+
+inline bool get_varint(const char*& p, const char* end, int64_t* value) {
+    uint64_t u = 0;
+    for(unsigned int shift=0; p < end && shift < 64; shift += 7) {
+        const uint8_t c = *p++;
+        u |= (uint64_t)(c & 0x7f) << shift;
+        if(!(c & 0x80)) {
+            *value = (int64_t)(u >> 1) ^ -(int64_t)(u & 1);
+            return true;
+        }
+    }
+    return false;
+}
+
+} // namespace
+
+/**
+ * @brief      check whether a file is stored in the compressed format
+ *
+ * @param[in]  filename  path to the file
+ *
+ * @return     True if compressed, False otherwise.
+ */
+bool CompressedField::probe(const std::string& filename) {
+    std::ifstream infile(filename, std::ios::binary);
+    char magic[sizeof(MAGIC)];
+    if(!infile.read(magic, sizeof(magic))) {
+        return false;
+    }
+    return std::memcmp(magic, MAGIC, sizeof(MAGIC)) == 0;
+}
+
+/**
+ * @brief      read the header of a compressed file
+ *
+ * @param[in]  filename  path to the file
+ *
+ * @return     header
+ */
+CompressedField::Header CompressedField::read_file_header(const std::string& filename) {
+    std::ifstream infile(filename, std::ios::binary);
+    if(!infile.is_open()) {
+        throw std::runtime_error("Cannot open " + filename + "!");
+    }
+
+    Header header;
+    if(!infile.read(reinterpret_cast<char*>(&header), sizeof(Header)) ||
+       std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0) {
+        throw std::runtime_error(filename + " is not an EDP compressed field file.");
+    }
+    if(header.version != VERSION) {
+        throw std::runtime_error("Unsupported version " + std::to_string(header.version) + " of compressed field file " + filename);
+    }
+    if(header.byte_order != BYTE_ORDER_MARK) {
+        throw std::runtime_error(filename + " has been written on a machine with a different byte order.");
+    }
+    if(header.brick_size != BRICK) {
+        throw std::runtime_error(filename + " uses bricks of " + std::to_string(header.brick_size) +
+                                 " points, expected " + std::to_string(BRICK) + " points.");
+    }
+
+    return header;
+}
+
+/**
+ * @brief      populate the header and atoms of a scalar field
+ *
+ * @param      sf    scalar field (its filename points to a compressed file)
+ */
+void CompressedField::read_header(ScalarField* sf) {
+    const Header header = read_file_header(sf->filename);
+
+    const uint64_t sections_end = sizeof(Header) +
+                                  header.nr_species * sizeof(uint64_t) +
+                                  header.nr_charges * sizeof(uint32_t) +
+                                  header.nr_atoms * 3 * sizeof(double) +
+                                  header.comment_length;
+    std::array<unsigned int, 3> dims;
+    for(unsigned int i=0; i<3; i++) {
+        dims[i] = header.grid_dimensions[i];
+    }
+    const auto nbricks = get_nr_bricks(dims);
+    const uint64_t index_size = ((uint64_t)nbricks[0] * nbricks[1] * nbricks[2] + 1) * sizeof(uint64_t);
+    if(header.index_offset < sections_end ||
+       header.index_offset + index_size > boost::filesystem::file_size(sf->filename)) {
+        throw std::runtime_error("Compressed field file " + sf->filename + " is truncated or corrupt.");
+    }
+
+    std::ifstream infile(sf->filename, std::ios::binary);
+    infile.seekg(sizeof(Header));
+
+    std::vector<uint64_t> nrat(header.nr_species);
+    std::vector<uint32_t> charges(header.nr_charges);
+    std::vector<double> pos(header.nr_atoms * 3);
+    std::string comment(header.comment_length, '\0');
+    infile.read(reinterpret_cast<char*>(nrat.data()), nrat.size() * sizeof(uint64_t));
+    infile.read(reinterpret_cast<char*>(charges.data()), charges.size() * sizeof(uint32_t));
+    infile.read(reinterpret_cast<char*>(pos.data()), pos.size() * sizeof(double));
+    infile.read(&comment[0], comment.size());
+    if(!infile) {
+        throw std::runtime_error("Error encountered in reading atoms from " + sf->filename);
+    }
+
+    sf->comment = comment;
+    sf->scalar = header.scalar;
+    for(unsigned int i=0; i<3; i++) {
+        for(unsigned int j=0; j<3; j++) {
+            sf->mat(i,j) = header.mat[i*3+j];
+        }
+    }
+    sf->imat = sf->mat.inverse();
+    sf->volume = sf->mat.determinant();
+
+    sf->nrat.assign(nrat.begin(), nrat.end());
+    sf->atom_charges.assign(charges.begin(), charges.end());
+    sf->atom_pos.clear();
+    for(uint64_t i=0; i<header.nr_atoms; i++) {
+        sf->atom_pos.emplace_back(pos[i*3], pos[i*3+1], pos[i*3+2]);
+    }
+
+    sf->grid_dimensions = dims;
+    sf->gridsize = (size_t)dims[0] * dims[1] * dims[2];
+    sf->gridline = std::to_string(dims[0]) + " " + std::to_string(dims[1]) + " " + std::to_string(dims[2]);
+    sf->grid_offset = sections_end;
+    sf->vasp5_input = header.flags & FLAG_VASP5;
+    sf->flag_is_locpot = header.flags & FLAG_LOCPOT;
+    sf->header_read = true;
+}
+
+/**
+ * @brief      decode all bricks into the (allocated) grid of a scalar field
+ *
+ * @param      sf    scalar field
+ */
+void CompressedField::read_grid(ScalarField* sf) {
+    const Header header = read_file_header(sf->filename);
+    const MappedFile mf(sf->filename);
+    const uint64_t* index = reinterpret_cast<const uint64_t*>(mf.data() + header.index_offset);
+
+    const auto& dims = sf->grid_dimensions;
+    const auto nbricks = get_nr_bricks(dims);
+    const size_t nr_bricks = (size_t)nbricks[0] * nbricks[1] * nbricks[2];
+    fpt* grid = sf->gridptr.data();
+
+    // exceptions cannot cross the boundary of the parallel region
+    std::exception_ptr error;
+    #pragma omp parallel for schedule(dynamic)
+    for(size_t b=0; b<nr_bricks; b++) {
+        try {
+            const std::array<unsigned int, 3> brick = {(unsigned int)(b % nbricks[0]),
+                                                       (unsigned int)(b / nbricks[0] % nbricks[1]),
+                                                       (unsigned int)(b / ((size_t)nbricks[0] * nbricks[1]))};
+            if(index[b] > index[b+1] || index[b+1] > header.index_offset) {
+                throw std::runtime_error("Compressed field file " + sf->filename + " is corrupt.");
+            }
+            fpt* out = grid + ((size_t)brick[2] * BRICK * dims[1] + (size_t)brick[1] * BRICK) * dims[0] + brick[0] * BRICK;
+            decode_brick(mf.data() + index[b], index[b+1] - index[b], out, dims, get_extent(dims, brick), header.step);
+        } catch(...) {
+            #pragma omp critical
+            error = std::current_exception();
+        }
+    }
+
+    if(error) {
+        std::rethrow_exception(error);
+    }
+}
+
+/**
+ * @brief      create a loader that decodes the layer of bricks holding a
+ *             z-slab upon its first request
+ *
+ * A decoded layer is kept until all of its slabs have been handed to the
+ * loader.
+ *
+ * @param      sf    scalar field
+ *
+ * @return     loader
+ */
+std::unique_ptr<SlabLoader> CompressedField::create_slab_loader(ScalarField* sf) {
+    struct Layers {
+        Header header;
+        std::shared_ptr<MappedFile> mf;
+        std::array<unsigned int, 3> dims;
+        std::unique_ptr<std::mutex[]> locks;
+        std::vector<std::vector<fpt>> values;
+        std::vector<unsigned int> nr_delivered;
+    };
+
+    auto layers = std::make_shared<Layers>();
+    layers->header = read_file_header(sf->filename);
+    layers->mf = std::make_shared<MappedFile>(sf->filename);
+    layers->dims = sf->grid_dimensions;
+    const unsigned int nr_layers = get_nr_bricks(layers->dims)[2];
+    layers->locks.reset(new std::mutex[nr_layers]);
+    layers->values.resize(nr_layers);
+    layers->nr_delivered.resize(nr_layers, 0);
+
+    return SlabLoader::create([layers](unsigned int k, fpt* out) {
+        const auto& dims = layers->dims;
+        const auto nbricks = get_nr_bricks(dims);
+        const unsigned int bk = k / BRICK;
+        const unsigned int depth = std::min(BRICK, dims[2] - bk * BRICK);
+        const size_t slab_size = (size_t)dims[0] * dims[1];
+        const uint64_t* index = reinterpret_cast<const uint64_t*>(layers->mf->data() + layers->header.index_offset);
+
+        std::lock_guard<std::mutex> lock(layers->locks[bk]);
+        std::vector<fpt>& values = layers->values[bk];
+        if(values.empty()) {
+            // a layer that fails to decode is not retained
+            std::vector<fpt> decoded(slab_size * depth);
+            for(unsigned int bj=0; bj<nbricks[1]; bj++) {
+                for(unsigned int bi=0; bi<nbricks[0]; bi++) {
+                    const size_t b = ((size_t)bk * nbricks[1] + bj) * nbricks[0] + bi;
+                    if(index[b] > index[b+1] || index[b+1] > layers->header.index_offset) {
+                        throw std::runtime_error("Compressed field file " + layers->mf->get_filename() + " is corrupt.");
+                    }
+                    fpt* dest = decoded.data() + (size_t)bj * BRICK * dims[0] + bi * BRICK;
+                    decode_brick(layers->mf->data() + index[b], index[b+1] - index[b], dest, dims,
+                                 get_extent(dims, {bi, bj, bk}), layers->header.step);
+                }
+            }
+            values.swap(decoded);
+        }
+
+        std::copy(values.data() + (k % BRICK) * slab_size, values.data() + (k % BRICK + 1) * slab_size, out);
+        if(++layers->nr_delivered[bk] == depth) {
+            std::vector<fpt>().swap(values);
+        }
+    }, sf->gridptr.data(), sf->grid_dimensions);
+}
+
+/**
+ * @brief      write a scalar field in the compressed format
+ *
+ * The bricks are compressed in parallel and written in order, followed by
+ * their index.
+ *
+ * @param[in]  sf           scalar field (grid should have been read)
+ * @param[in]  filename     path to the output file
+ * @param[in]  error_bound  largest absolute error of a value (positive)
+ */
+void CompressedField::write(const ScalarField& sf, const std::string& filename, fpt error_bound) {
+    if(!sf.has_read) {
+        throw std::runtime_error("Cannot write " + filename + "; the grid of " + sf.filename + " has not been read.");
+    }
+    if(!(error_bound > 0)) {
+        throw std::runtime_error("The error bound for " + filename + " should be positive.");
+    }
+
+    Header header;
+    std::memset(&header, 0, sizeof(Header));
+    std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.version = VERSION;
+    header.byte_order = BYTE_ORDER_MARK;
+    header.flags = (sf.flag_is_locpot ? FLAG_LOCPOT : 0) | (sf.vasp5_input ? FLAG_VASP5 : 0);
+    header.brick_size = BRICK;
+    header.scalar = sf.scalar;
+    for(unsigned int i=0; i<3; i++) {
+        for(unsigned int j=0; j<3; j++) {
+            header.mat[i*3+j] = sf.mat(i,j);
+        }
+        header.grid_dimensions[i] = sf.grid_dimensions[i];
+    }
+    header.nr_species = sf.nrat.size();
+    header.nr_charges = sf.atom_charges.size();
+    header.nr_atoms = sf.atom_pos.size();
+    header.comment_length = sf.comment.size();
+    header.error_bound = error_bound;
+    header.step = 2.0 * (double)error_bound;
+
+    // compress all bricks
+    const fpt* grid = sf.get_grid_ptr();
+    const auto& dims = sf.grid_dimensions;
+    const auto nbricks = get_nr_bricks(dims);
+    std::vector<std::string> bricks((size_t)nbricks[0] * nbricks[1] * nbricks[2]);
+    std::exception_ptr error;
+    #pragma omp parallel for schedule(dynamic)
+    for(size_t b=0; b<bricks.size(); b++) {
+        try {
+            bricks[b] = encode_brick(grid, dims, {(unsigned int)(b % nbricks[0]),
+                                                  (unsigned int)(b / nbricks[0] % nbricks[1]),
+                                                  (unsigned int)(b / ((size_t)nbricks[0] * nbricks[1]))}, header.step);
+        } catch(...) {
+            #pragma omp critical
+            error = std::current_exception();
+        }
+    }
+    if(error) {
+        std::rethrow_exception(error);
+    }
+
+    const uint64_t sections_end = sizeof(Header) +
+                                  header.nr_species * sizeof(uint64_t) +
+                                  header.nr_charges * sizeof(uint32_t) +
+                                  header.nr_atoms * 3 * sizeof(double) +
+                                  header.comment_length;
+    std::vector<uint64_t> index(1, sections_end);
+    for(const auto& brick : bricks) {
+        index.push_back(index.back() + brick.size());
+    }
+    header.index_offset = index.back();
+
+    std::vector<uint64_t> nrat(sf.nrat.begin(), sf.nrat.end());
+    std::vector<uint32_t> charges(sf.atom_charges.begin(), sf.atom_charges.end());
+    std::vector<double> pos;
+    for(const auto& atom : sf.atom_pos) {
+        pos.insert(pos.end(), {atom[0], atom[1], atom[2]});
+    }
+
+    // write to a temporary file first such that readers never observe a
+    // partially written file
+    const std::string tmpfile = filename + ".part";
+    {
+        std::ofstream outfile(tmpfile, std::ios::binary | std::ios::trunc);
+        if(!outfile.is_open()) {
+            throw std::runtime_error("Cannot open " + tmpfile + " for writing!");
+        }
+        outfile.write(reinterpret_cast<const char*>(&header), sizeof(Header));
+        outfile.write(reinterpret_cast<const char*>(nrat.data()), nrat.size() * sizeof(uint64_t));
+        outfile.write(reinterpret_cast<const char*>(charges.data()), charges.size() * sizeof(uint32_t));
+        outfile.write(reinterpret_cast<const char*>(pos.data()), pos.size() * sizeof(double));
+        outfile.write(sf.comment.data(), sf.comment.size());
+        for(const auto& brick : bricks) {
+            outfile.write(brick.data(), brick.size());
+        }
+        outfile.write(reinterpret_cast<const char*>(index.data()), index.size() * sizeof(uint64_t));
+        if(!outfile) {
+            boost::filesystem::remove(tmpfile);
+            throw std::runtime_error("Error encountered in writing " + tmpfile);
+        }
+    }
+    boost::filesystem::rename(tmpfile, filename);
+}
+
+/**
+ * @brief      error bound relative to the range of the values of a grid
+ *
+ * @param[in]  sf        scalar field (grid should have been read)
+ * @param[in]  relative  error relative to the range of the grid
+ *
+ * @return     absolute error bound (positive)
+ */
+fpt CompressedField::get_relative_error_bound(const ScalarField& sf, fpt relative) {
+    const fpt min = sf.get_min();
+    const fpt max = sf.get_max();
+    for(fpt range : {max - min, std::max(std::fabs(max), std::fabs(min))}) {
+        const fpt bound = relative * range;
+        if(bound > 0) {
+            return bound;
+        }
+    }
+    return std::numeric_limits<fpt>::min();
+}
+
+/**
+ * @brief      largest deviation between a scalar field and its compressed copy
+ *
+ * @param[in]  sf        scalar field (grid should have been read)
+ * @param[in]  filename  path to the compressed file
+ *
+ * @return     largest absolute difference of a value
+ */
+fpt CompressedField::verify(const ScalarField& sf, const std::string& filename) {
+    ScalarField restored(filename, sf.flag_is_locpot);
+    restored.read();
+    if(restored.get_grid_dimensions() != sf.grid_dimensions) {
+        throw std::runtime_error("Grid dimensions of " + filename + " do not match those of " + sf.filename);
+    }
+
+    const fpt* a = sf.get_grid_ptr();
+    const fpt* b = restored.get_grid_ptr();
+    fpt max_error = 0.0;
+    #pragma omp parallel for reduction(max:max_error)
+    for(size_t i=0; i<sf.gridsize; i++) {
+        max_error = std::max(max_error, std::fabs(a[i] - b[i]));
+    }
+    return max_error;
+}
+
+/**
+ * @brief      compress a single brick
+ *
+ * @param[in]  grid   grid (x running fastest)
+ * @param[in]  dims   grid dimensions
+ * @param[in]  brick  index of the brick along each axis
+ * @param[in]  step   quantization step
+ *
+ * @return     compressed brick
+ */
+std::string CompressedField::encode_brick(const fpt* grid, const std::array<unsigned int, 3>& dims,
+                                          const std::array<unsigned int, 3>& brick, double step) {
+    const auto extent = get_extent(dims, brick);
+    const size_t sx = extent[0] + 1;
+    const size_t sxy = sx * (extent[1] + 1);
+    std::vector<int64_t> q(sxy * (extent[2] + 1), 0);
+
+    std::string raw;
+    raw.reserve((size_t)extent[0] * extent[1] * extent[2] * 2);
+    for(unsigned int k=0; k<extent[2]; k++) {
+        for(unsigned int j=0; j<extent[1]; j++) {
+            const fpt* row = grid + ((size_t)(brick[2] * BRICK + k) * dims[1] + brick[1] * BRICK + j) * dims[0] + brick[0] * BRICK;
+            int64_t* qrow = q.data() + (k + 1) * sxy + (j + 1) * sx + 1;
+            for(unsigned int i=0; i<extent[0]; i++) {
+                const double s = std::nearbyint(row[i] / step);
+                if(!(std::fabs(s) < QUANTIZATION_LIMIT)) {
+                    throw std::runtime_error("Cannot quantize the value " + std::to_string(row[i]) +
+                                             " with an error bound of " + std::to_string(step / 2.0));
+                }
+                qrow[i] = (int64_t)s;
+                put_varint(raw, qrow[i] - predict(qrow + i, sx, sxy));
+            }
+        }
+    }
+
+    std::string out;
+    {
+        boost::iostreams::filtering_ostream os;
+        os.push(boost::iostreams::zstd_compressor(boost::iostreams::zstd_params(ZSTD_LEVEL)));
+        os.push(boost::iostreams::back_inserter(out));
+        os.write(raw.data(), raw.size());
+    }
+    return out;
+}
+
+/**
+ * @brief      decompress a single brick
+ *
+ * @param[in]  data   compressed brick
+ * @param[in]  size   size of the compressed brick in bytes
+ * @param      out    storage of the first point of the brick in a grid
+ *                    (x running fastest)
+ * @param[in]  dims   grid dimensions
+ * @param[in]  extent number of points of the brick along each axis
+ * @param[in]  step   quantization step
+ */
+void CompressedField::decode_brick(const char* data, size_t size, fpt* out, const std::array<unsigned int, 3>& dims,
+                                   const std::array<unsigned int, 3>& extent, double step) {
+    std::string raw;
+    {
+        boost::iostreams::filtering_istream is;
+        is.push(boost::iostreams::zstd_decompressor());
+        is.push(boost::iostreams::array_source(data, size));
+        boost::iostreams::copy(is, boost::iostreams::back_inserter(raw));
+    }
+
+    const size_t sx = extent[0] + 1;
+    const size_t sxy = sx * (extent[1] + 1);
+    std::vector<int64_t> q(sxy * (extent[2] + 1), 0);
+
+    const char* p = raw.data();
+    const char* end = raw.data() + raw.size();
+    for(unsigned int k=0; k<extent[2]; k++) {
+        for(unsigned int j=0; j<extent[1]; j++) {
+            fpt* row = out + ((size_t)k * dims[1] + j) * dims[0];
+            int64_t* qrow = q.data() + (k + 1) * sxy + (j + 1) * sx + 1;
+            for(unsigned int i=0; i<extent[0]; i++) {
+                int64_t residual;
+                if(!get_varint(p, end, &residual)) {
+                    throw std::runtime_error("Compressed brick holds too few values.");
+                }
+                qrow[i] = predict(qrow + i, sx, sxy) + residual;
+                row[i] = (fpt)((double)qrow[i] * step);
+            }
+        }
+    }
+}
@@ -0,0 +1,195 @@
+/**************************************************************************
+ *                                                                        *
+ *   Author: Ivo Filot <i.a.w.filot@tue.nl>                               *
+ *                                                                        *
+ *   EDP is free software:                                                *
+ *   you can redistribute it and/or modify it under the terms of the      *
+ *   GNU General Public License as published by the Free Software         *
+ *   Foundation, either version 3 of the License, or (at your option)     *
+ *   any later version.                                                   *
+ *                                                                        *
+ *   EDP is distributed in the hope that it will be useful,               *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty          *
+ *   of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.              *
+ *   See the GNU General Public License for more details.                 *
+ *                                                                        *
+ *   You should have received a copy of the GNU General Public License    *
+ *   along with this program.  If not, see http://www.gnu.org/licenses/.  *
+ *                                                                        *
+ **************************************************************************/
+
+#ifndef _COMPRESSED_FIELD_H
+#define _COMPRESSED_FIELD_H
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include "math.h"
+#include "slab_loader.h"
+
+class ScalarField;
+
+/**
+ * @brief      Lossy compressed archival format for scalar fields
+ *
+ * The grid is divided into bricks of BRICK^3 points (truncated at the upper
+ * edges of the grid) that are compressed independently. Every value is
+ * quantized to the nearest multiple of twice the (absolute) error bound,
+ * after which the quantized values of a brick are predicted from their
+ * already visited neighbours (the 3D Lorenzo predictor). The residuals are
+ * zigzag-encoded as variable-length integers and entropy-coded with zstd.
+ * Hence, every value is restored within the error bound, up to the
+ * rounding of the restored value to fpt.
+ *
+ * An index of the bricks at the end of the file allows any brick to be
+ * decoded on its own; reading a single xy-plane only decodes the layer of
+ * bricks holding it.
+ *
+ * Layout:
+ *
+ *   Header
+ *   uint64 nrat[nr_species]
+ *   uint32 atom_charges[nr_charges]        (empty for VASP4 files)
+ *   double atom_pos[nr_atoms][3]           (direct coordinates)
+ *   char   comment[comment_length]
+ *   <compressed bricks>                    (x-bricks run fastest)
+ *   uint64 brick_offsets[nr_bricks + 1]    (at index_offset)
+ */
+class CompressedField {
+public:
+    static constexpr char MAGIC[8] = {'E','D','P','Z','F','L','D','1'};
+    static constexpr uint32_t VERSION = 1;
+    static constexpr uint32_t BYTE_ORDER_MARK = 0x01020304;
+    static constexpr unsigned int BRICK = 32;   // number of points per brick along each axis
+
+    static constexpr uint32_t FLAG_LOCPOT = 1 << 0;
+    static constexpr uint32_t FLAG_VASP5 = 1 << 1;
+
+    /**
+     * @brief      fixed-size header at the start of the file
+     */
+    struct Header {
+        char magic[8];
+        uint32_t version;
+        uint32_t byte_order;
+        uint32_t flags;
+        uint32_t brick_size;        // number of points per brick along each axis
+        double scalar;
+        double mat[9];              // unit cell (row vectors), scalar applied
+        uint64_t grid_dimensions[3];
+        uint64_t nr_species;
+        uint64_t nr_charges;
+        uint64_t nr_atoms;
+        uint64_t comment_length;
+        double error_bound;         // largest absolute error of a value
+        double step;                // quantization step
+        uint64_t index_offset;      // byte offset of the brick index
+    };
+
+    /**
+     * @brief      check whether a file is stored in the compressed format
+     *
+     * @param[in]  filename  path to the file
+     *
+     * @return     True if compressed, False otherwise.
+     */
+    static bool probe(const std::string& filename);
+
+    /**
+     * @brief      read the header of a compressed file
+     *
+     * @param[in]  filename  path to the file
+     *
+     * @return     header
+     */
+    static Header read_file_header(const std::string& filename);
+
+    /**
+     * @brief      populate the header and atoms of a scalar field
+     *
+     * @param      sf    scalar field (its filename points to a compressed file)
+     */
+    static void read_header(ScalarField* sf);
+
+    /**
+     * @brief      decode all bricks into the (allocated) grid of a scalar field
+     *
+     * @param      sf    scalar field
+     */
+    static void read_grid(ScalarField* sf);
+
+    /**
+     * @brief      create a loader that decodes the layer of bricks holding a
+     *             z-slab upon its first request
+     *
+     * @param      sf    scalar field
+     *
+     * @return     loader
+     */
+    static std::unique_ptr<SlabLoader> create_slab_loader(ScalarField* sf);
+
+    /**
+     * @brief      write a scalar field in the compressed format
+     *
+     * @param[in]  sf           scalar field (grid should have been read)
+     * @param[in]  filename     path to the output file
+     * @param[in]  error_bound  largest absolute error of a value (positive)
+     */
+    static void write(const ScalarField& sf, const std::string& filename, fpt error_bound);
+
+    /**
+     * @brief      error bound relative to the range of the values of a grid
+     *
+     * For a constant grid, the bound is taken relative to the magnitude of
+     * its value instead; a grid of zeros, which is stored exactly under any
+     * bound, receives the smallest positive bound.
+     *
+     * @param[in]  sf        scalar field (grid should have been read)
+     * @param[in]  relative  error relative to the range of the grid
+     *
+     * @return     absolute error bound (positive)
+     */
+    static fpt get_relative_error_bound(const ScalarField& sf, fpt relative);
+
+    /**
+     * @brief      largest deviation between a scalar field and its compressed copy
+     *
+     * @param[in]  sf        scalar field (grid should have been read)
+     * @param[in]  filename  path to the compressed file
+     *
+     * @return     largest absolute difference of a value
+     */
+    static fpt verify(const ScalarField& sf, const std::string& filename);
+
+private:
+    /**
+     * @brief      compress a single brick
+     *
+     * @param[in]  grid   grid (x running fastest)
+     * @param[in]  dims   grid dimensions
+     * @param[in]  brick  index of the brick along each axis
+     * @param[in]  step   quantization step
+     *
+     * @return     compressed brick
+     */
+    static std::string encode_brick(const fpt* grid, const std::array<unsigned int, 3>& dims,
+                                    const std::array<unsigned int, 3>& brick, double step);
+
+    /**
+     * @brief      decompress a single brick
+     *
+     * @param[in]  data   compressed brick
+     * @param[in]  size   size of the compressed brick in bytes
+     * @param      out    storage of the first point of the brick in a grid
+     *                    (x running fastest)
+     * @param[in]  dims   grid dimensions
+     * @param[in]  extent number of points of the brick along each axis
+     * @param[in]  step   quantization step
+     */
+    static void decode_brick(const char* data, size_t size, fpt* out, const std::array<unsigned int, 3>& dims,
+                             const std::array<unsigned int, 3>& extent, double step);
+};
+
+#endif // _COMPRESSED_FIELD_H
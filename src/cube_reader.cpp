@@ -0,0 +1,211 @@
+/**************************************************************************
+ *                                                                        *
+ *   Author: Ivo Filot <i.a.w.filot@tue.nl>                               *
+ *                                                                        *
+ *   EDP is free software:                                                *
+ *   you can redistribute it and/or modify it under the terms of the      *
+ *   GNU General Public License as published by the Free Software         *
+ *   Foundation, either version 3 of the License, or (at your option)     *
+ *   any later version.                                                   *
+ *                                                                        *
+ *   EDP is distributed in the hope that it will be useful,               *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty          *
+ *   of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.              *
+ *   See the GNU General Public License for more details.                 *
+ *                                                                        *
+ *   You should have received a copy of the GNU General Public License    *
+ *   along with this program.  If not, see http://www.gnu.org/licenses/.  *
+ *                                                                        *
+ **************************************************************************/
+
+#include "cube_reader.h"
+#include "field_writer.h"
+#include "scalar_field.h"
+
+#include <cstdlib>
+
+/**
+ * @brief      whether the start of a file is in this format
+ *
+ * Cube files have two comment lines followed by four lines that each hold
+ * an integer and three numbers: the number of atoms and the origin, and
+ * the number of voxels and the voxel vector for each axis.
+ *
+ * @param[in]  head  first (at most SNIFF_SIZE) bytes of the file
+ *
+ * @return     True if recognized, False otherwise.
+ */
+bool CubeReader::sniff(const std::string& head) const {
+    const char* p = head.data();
+    const char* end = p + head.size();
+    std::string line;
+    for(unsigned int i=0; i<2; i++) {
+        if(!next_line(p, end, line)) {
+            return false;
+        }
+    }
+
+    for(unsigned int i=0; i<4; i++) {
+        if(!next_line(p, end, line)) {
+            return false;
+        }
+        const auto pieces = split(line);
+        // the line holding the number of atoms may hold the number of values per voxel
+        if(!(pieces.size() == 4 || (i == 0 && pieces.size() == 5)) || !is_integer(pieces[0])) {
+            return false;
+        }
+        for(unsigned int j=1; j<4; j++) {
+            if(!is_number(pieces[j])) {
+                return false;
+            }
+        }
+        if(i > 0 && std::atoi(pieces[0].c_str()) == 0) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/**
+ * @brief      read the unit cell, the atoms and the grid dimensions
+ *
+ * A negative number of voxels along the first axis indicates that lengths
+ * are given in angstrom instead of bohr. A negative number of atoms
+ * indicates that the atoms are followed by a line listing orbitals. The
+ * grid is taken to start at the origin of the unit cell, so the atoms are
+ * stored relative to the origin of the grid.
+ *
+ * @param      sf    scalar field
+ */
+void CubeReader::read_header(ScalarField* sf) const {
+    const std::string& filename = sf->get_filename();
+    MappedFile mf(filename);
+    const char* p = mf.data();
+    const char* end = mf.end();
+
+    std::string comment, line;
+    if(!next_line(p, end, comment) || !next_line(p, end, line) || !next_line(p, end, line)) {
+        throw std::runtime_error("Unexpected end of header encountered in " + filename);
+    }
+
+    try {
+        auto pieces = split(line);
+        const int nr_atoms = boost::lexical_cast<int>(pieces.at(0));
+        if(pieces.size() > 4 && boost::lexical_cast<int>(pieces[4]) != 1) {
+            throw std::runtime_error("Cube files with multiple values per voxel are not supported: " + filename);
+        }
+        const Vec3 origin(boost::lexical_cast<fpt>(pieces.at(1)),
+                          boost::lexical_cast<fpt>(pieces.at(2)),
+                          boost::lexical_cast<fpt>(pieces.at(3)));
+
+        std::array<unsigned int, 3> grid_dimensions;
+        MatrixUnitcell mat;
+        fpt unit = FieldWriter::BOHR;
+        for(unsigned int i=0; i<3; i++) {
+            if(!next_line(p, end, line)) {
+                throw std::runtime_error("Unexpected end of header encountered in " + filename);
+            }
+            pieces = split(line);
+            const int n = boost::lexical_cast<int>(pieces.at(0));
+            if(i == 0 && n < 0) {
+                unit = 1.0;
+            }
+            grid_dimensions[i] = std::abs(n);
+            for(unsigned int j=0; j<3; j++) {
+                mat(i,j) = boost::lexical_cast<fpt>(pieces.at(j+1)) * unit * grid_dimensions[i];
+            }
+        }
+
+        std::vector<unsigned int> elnrs;
+        std::vector<Vec3> positions;
+        for(int i=0; i<std::abs(nr_atoms); i++) {
+            if(!next_line(p, end, line)) {
+                throw std::runtime_error("Unexpected end of header encountered in " + filename);
+            }
+            pieces = split(line);
+            elnrs.push_back(boost::lexical_cast<unsigned int>(pieces.at(0)));
+            const Vec3 position(boost::lexical_cast<fpt>(pieces.at(2)),
+                                boost::lexical_cast<fpt>(pieces.at(3)),
+                                boost::lexical_cast<fpt>(pieces.at(4)));
+            positions.push_back((position - origin) * unit);
+        }
+
+        // skip the list of orbitals
+        if(nr_atoms < 0 && !next_line(p, end, line)) {
+            throw std::runtime_error("Unexpected end of header encountered in " + filename);
+        }
+
+        set_header(sf, boost::trim_copy(comment), mat, elnrs, positions, grid_dimensions, p - mf.data());
+    } catch(const boost::bad_lexical_cast&) {
+        throw std::runtime_error("Error encountered in reading header of cube file " + filename);
+    } catch(const std::out_of_range&) {
+        throw std::runtime_error("Error encountered in reading header of cube file " + filename);
+    }
+}
+
+/**
+ * @brief      read the grid into the (allocated) grid of the scalar field
+ *
+ * Electron densities are converted from electrons per cubic bohr to
+ * electrons per cubic angstrom; potentials are read as is.
+ *
+ * @param      sf    scalar field
+ */
+void CubeReader::read_grid(ScalarField* sf) const {
+    const auto& grid_dimensions = sf->get_grid_dimensions();
+    const size_t gridsize = (size_t)grid_dimensions[0] * grid_dimensions[1] * grid_dimensions[2];
+    const fpt divisor = sf->is_locpot() ? 1.0 : FieldWriter::BOHR * FieldWriter::BOHR * FieldWriter::BOHR;
+
+    MappedFile mf(sf->get_filename());
+    const char* p = mf.data() + std::min(get_grid_offset(sf), mf.size());
+    const char* end = mf.end();
+    mf.advise_sequential(p - mf.data(), end - p);
+
+    GridBuffer scratch;
+    scratch.allocate(gridsize);
+    const size_t nread = FloatTokenizer::parse_block_parallel(p, end, scratch.data(), gridsize, divisor);
+    if(nread != gridsize) {
+        throw std::runtime_error("Could only read " + std::to_string(nread) + " out of " +
+                                 std::to_string(gridsize) + " grid points from " +
+                                 sf->get_filename());
+    }
+
+    transpose(scratch.data(), get_grid(sf), grid_dimensions);
+}
+
+/**
+ * @brief      transpose a grid from z-fastest to x-fastest order
+ *
+ * For every y, the (x,z) plane is a matrix that is transposed tile by
+ * tile, such that both the reads and the writes stay within a few cache
+ * lines; the tiles are distributed over the threads.
+ *
+ * @param[in]  in               grid with z running fastest
+ * @param      out              grid with x running fastest
+ * @param[in]  grid_dimensions  dimensions of the grid
+ */
+void CubeReader::transpose(const fpt* in, fpt* out, const std::array<unsigned int, 3>& grid_dimensions) {
+    static const size_t TILE = 32;
+    const size_t nx = grid_dimensions[0];
+    const size_t ny = grid_dimensions[1];
+    const size_t nz = grid_dimensions[2];
+    const size_t ntx = (nx + TILE - 1) / TILE;
+    const size_t ntz = (nz + TILE - 1) / TILE;
+
+    #pragma omp parallel for collapse(2) schedule(static)
+    for(size_t iy=0; iy<ny; iy++) {
+        for(size_t t=0; t<ntx*ntz; t++) {
+            const size_t x0 = (t / ntz) * TILE;
+            const size_t z0 = (t % ntz) * TILE;
+            const size_t x1 = std::min(x0 + TILE, nx);
+            const size_t z1 = std::min(z0 + TILE, nz);
+            for(size_t iz=z0; iz<z1; iz++) {
+                fpt* dst = out + (iz * ny + iy) * nx;
+                for(size_t ix=x0; ix<x1; ix++) {
+                    dst[ix] = in[(ix * ny + iy) * nz + iz];
+                }
+            }
+        }
+    }
+}
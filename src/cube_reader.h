@@ -0,0 +1,56 @@
+/**************************************************************************
+ *                                                                        *
+ *   Author: Ivo Filot <i.a.w.filot@tue.nl>                               *
+ *                                                                        *
+ *   EDP is free software:                                                *
+ *   you can redistribute it and/or modify it under the terms of the      *
+ *   GNU General Public License as published by the Free Software         *
+ *   Foundation, either version 3 of the License, or (at your option)     *
+ *   any later version.                                                   *
+ *                                                                        *
+ *   EDP is distributed in the hope that it will be useful,               *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty          *
+ *   of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.              *
+ *   See the GNU General Public License for more details.                 *
+ *                                                                        *
+ *   You should have received a copy of the GNU General Public License    *
+ *   along with this program.  If not, see http://www.gnu.org/licenses/.  *
+ *                                                                        *
+ **************************************************************************/
+
+#ifndef _CUBE_READER_H
+#define _CUBE_READER_H
+
+#include "field_reader.h"
+
+/**
+ * @brief      Reader for Gaussian cube files (e.g. from Quantum ESPRESSO or CP2K)
+ *
+ * Cube files are in atomic units and run through the grid with z fastest.
+ * The grid is tokenized in parallel into a scratch buffer and subsequently
+ * transposed into the x-fastest layout of EDP in cache-sized tiles.
+ */
+class CubeReader : public FieldReader {
+public:
+    const char* get_name() const override {
+        return "cube";
+    }
+
+    bool sniff(const std::string& head) const override;
+
+    void read_header(ScalarField* sf) const override;
+
+    void read_grid(ScalarField* sf) const override;
+
+private:
+    /**
+     * @brief      transpose a grid from z-fastest to x-fastest order
+     *
+     * @param[in]  in               grid with z running fastest
+     * @param      out              grid with x running fastest
+     * @param[in]  grid_dimensions  dimensions of the grid
+     */
+    static void transpose(const fpt* in, fpt* out, const std::array<unsigned int, 3>& grid_dimensions);
+};
+
+#endif // _CUBE_READER_H
@@ -34,15 +34,340 @@
  */
 
 #include <iostream>
+#include <algorithm>
 #include <chrono>
+#include <limits>
 #include <tclap/CmdLine.h>
 #include <boost/format.hpp>
 
 #include "scalar_field.h"
+#include "batch_sampler.h"
+#include "binary_field.h"
+#include "compressed_field.h"
+#include "field_info.h"
+#include "field_writer.h"
+#include "tar_archive.h"
+#include "thread_placement.h"
 #include "planeprojector.h"
 #include "config.h"
 
+/**
+ * @brief      identify whether a file is a locpot based on its name
+ *
+ * @param[in]  filename  path to the file
+ *
+ * @return     True if locpot, False otherwise.
+ */
+static bool identify_locpot(const std::string& filename) {
+    // for members of an archive, the name of the member is decisive
+    std::string archive, member;
+    const std::string path = TarArchive::split(filename, &archive, &member) ? member : filename;
+    const std::string basename = boost::filesystem::path(path).filename().string();
+    return basename.size() >= 6 && basename.substr(0,6).compare("LOCPOT") == 0;
+}
+
+/**
+ * @brief      convert a CHGCAR/LOCPOT file to the native binary format,
+ *             the lossy compressed format, a CHGCAR file or a Gaussian
+ *             cube file
+ *
+ * Usage: edp convert -i CHGCAR -o CHGCAR.edpf
+ *        edp convert -i CHGCAR -o CHGCAR.edpz -r 1e-5 --verify
+ *        edp convert -i CHGCAR.edpf -o density.cube
+ *
+ * @param[in]  argc  number of arguments (excluding the program name)
+ * @param      argv  arguments (starting with "convert")
+ *
+ * @return     exit code
+ */
+static int run_convert(int argc, char *argv[]) {
+    try {
+        TCLAP::CmdLine cmd("Converts a CHGCAR/LOCPOT file to the native (binary or compressed) formats of EDP, CHGCAR or Gaussian cube.", ' ', PROGRAM_VERSION);
+
+        // input filename
+        TCLAP::ValueArg<std::string> arg_input_filename("i","input","Input file (i.e. CHGCAR)",true,"CHGCAR","filename");
+        cmd.add(arg_input_filename);
+
+        // output filename
+        TCLAP::ValueArg<std::string> arg_output_filename("o","output","File to write to",true,"CHGCAR.edpf","filename");
+        cmd.add(arg_output_filename);
+
+        // output format
+        std::vector<std::string> formats = {"edpf", "edpz", "chgcar", "cube"};
+        TCLAP::ValuesConstraint<std::string> format_constraint(formats);
+        TCLAP::ValueArg<std::string> arg_format("f","format","Output format (default: derived from the output filename)",false,"",&format_constraint);
+        cmd.add(arg_format);
+
+        // force LOCPOT interpretation
+        TCLAP::SwitchArg arg_locpot("L","locpot","Treat the input as a LOCPOT file", cmd, false);
+
+        // spin component
+        std::vector<std::string> spins = {"total", "up", "down", "mag", "mx", "my", "mz"};
+        TCLAP::ValuesConstraint<std::string> spin_constraint(spins);
+        TCLAP::ValueArg<std::string> arg_spin("S","spin","Spin component to convert",false,"total",&spin_constraint);
+        cmd.add(arg_spin);
+
+        // error bound of the compressed format
+        TCLAP::ValueArg<double> arg_error("e","error","Largest absolute error of a value (compressed format)",false,0.0,"bound");
+        TCLAP::ValueArg<double> arg_relative_error("r","relative-error","Largest error of a value relative to the range of the grid (compressed format; default: 1e-5)",false,1e-5,"bound");
+        cmd.add(arg_error);
+        cmd.add(arg_relative_error);
+
+        // verify the compressed file
+        TCLAP::SwitchArg arg_verify("","verify","Report the largest error of the compressed file", cmd, false);
+
+        cmd.parse(argc, argv);
+
+        const std::string input_filename = arg_input_filename.getValue();
+        const std::string output_filename = arg_output_filename.getValue();
+        if(arg_error.isSet() && arg_relative_error.isSet()) {
+            throw std::runtime_error("Either supply an absolute (-e) or a relative (-r) error bound, not both.");
+        }
+
+        // files named like VASP output are written as such; anything else
+        // (e.g. *.edpf) is written in the native binary format
+        std::string format = arg_format.getValue();
+        if(format.empty()) {
+            const std::string basename = boost::filesystem::path(output_filename).filename().string();
+            if(boost::filesystem::path(output_filename).extension() == ".cube") {
+                format = "cube";
+            } else if(boost::filesystem::path(output_filename).extension() == ".edpz") {
+                format = "edpz";
+            } else if(boost::filesystem::path(output_filename).extension() != ".edpf" &&
+                      (basename.substr(0,3) == "CHG" || basename.substr(0,6) == "LOCPOT" || basename.substr(0,6) == "PARCHG")) {
+                format = "chgcar";
+            } else {
+                format = "edpf";
+            }
+        }
+
+        auto start = std::chrono::system_clock::now();
+        fpt error_bound = 0.0;
+        ScalarField sf(input_filename, arg_locpot.getValue() || identify_locpot(input_filename),
+                       SpinDensity::parse(arg_spin.getValue()));
+        sf.read();
+        if(format == "cube") {
+            FieldWriter::write_cube(sf, output_filename);
+        } else if(format == "chgcar") {
+            FieldWriter::write_chgcar(sf, output_filename);
+        } else if(format == "edpz") {
+            error_bound = arg_error.isSet() ? arg_error.getValue() :
+                          CompressedField::get_relative_error_bound(sf, arg_relative_error.getValue());
+            CompressedField::write(sf, output_filename, error_bound);
+        } else {
+            BinaryField::write(sf, output_filename);
+        }
+        auto end = std::chrono::system_clock::now();
+        std::chrono::duration<double> elapsed_seconds = end-start;
+
+        const auto& dims = sf.get_grid_dimensions();
+        std::cout << boost::format("Converted %s (%i x %i x %i, %s) to %s in %f seconds.")
+                     % input_filename % dims[0] % dims[1] % dims[2]
+                     % (sf.is_locpot() ? "LOCPOT" : "CHGCAR") % output_filename
+                     % elapsed_seconds.count() << std::endl;
+
+        if(format == "edpz") {
+            std::cout << boost::format("Compressed %i bytes of grid to %i bytes with an error bound of %g.")
+                         % (sf.get_size() * sizeof(fpt)) % boost::filesystem::file_size(output_filename)
+                         % error_bound << std::endl;
+        }
+
+        if(arg_verify.getValue()) {
+            if(format != "edpz") {
+                throw std::runtime_error("Only compressed files (-f edpz) can be verified.");
+            }
+            const fpt max_error = CompressedField::verify(sf, output_filename);
+            // the restored values are rounded to fpt
+            const fpt tolerance = error_bound + std::numeric_limits<fpt>::epsilon() *
+                                  std::max(std::fabs(sf.get_max()), std::fabs(sf.get_min()));
+            std::cout << boost::format("Largest error: %g (bound: %g)") % max_error % error_bound << std::endl;
+            if(max_error > tolerance) {
+                std::cerr << "error: " << output_filename << " exceeds the error bound" << std::endl;
+                return -1;
+            }
+        }
+
+        return 0;
+
+    } catch (TCLAP::ArgException &e) {
+        std::cerr << "error: " << e.error() <<
+                     " for arg " << e.argId() << std::endl;
+        return -1;
+    }
+}
+
+/**
+ * @brief      print the metadata of a file or catalogue a directory
+ *
+ * Only the headers of the files are read, never their grids.
+ *
+ * Usage: edp info -i CHGCAR
+ *        edp info -d calculations -o catalogue.json
+ *
+ * @param[in]  argc  number of arguments (excluding the program name)
+ * @param      argv  arguments (starting with "info")
+ *
+ * @return     exit code
+ */
+static int run_info(int argc, char *argv[]) {
+    try {
+        TCLAP::CmdLine cmd("Prints the metadata of CHGCAR/LOCPOT files as JSON.", ' ', PROGRAM_VERSION);
+
+        // input filename
+        TCLAP::ValueArg<std::string> arg_input_filename("i","input","Input file (i.e. CHGCAR)",false,"","filename");
+
+        // input directory
+        TCLAP::ValueArg<std::string> arg_directory("d","directory","Directory to scan recursively",false,"","directory");
+        cmd.xorAdd(arg_input_filename, arg_directory);
+
+        // output filename
+        TCLAP::ValueArg<std::string> arg_output_filename("o","output","Catalogue to write to (default: standard output)",false,"","filename");
+        cmd.add(arg_output_filename);
+
+        cmd.parse(argc, argv);
+
+        std::vector<FieldInfo> infos;
+        if(arg_directory.isSet()) {
+            infos = FieldInfo::scan(arg_directory.getValue());
+        } else {
+            infos.push_back(FieldInfo::probe(arg_input_filename.getValue()));
+        }
+
+        if(arg_output_filename.isSet()) {
+            FieldInfo::write_catalogue(infos, arg_output_filename.getValue());
+        } else if(arg_directory.isSet()) {
+            std::cout << "[" << std::endl;
+            for(size_t i=0; i<infos.size(); i++) {
+                std::cout << infos[i].to_json() << (i + 1 < infos.size() ? "," : "") << std::endl;
+            }
+            std::cout << "]" << std::endl;
+        } else {
+            std::cout << infos.front().to_json() << std::endl;
+        }
+
+        // a single file that cannot be probed is an error
+        return (!arg_directory.isSet() && !infos.front().error.empty()) ? -1 : 0;
+
+    } catch (TCLAP::ArgException &e) {
+        std::cerr << "error: " << e.error() <<
+                     " for arg " << e.argId() << std::endl;
+        return -1;
+    }
+}
+
+/**
+ * @brief      interpolate the field at the points listed in a file
+ *
+ * Usage: edp sample -i CHGCAR -p points.txt -o values.txt
+ *        edp sample -i CHGCAR -p points.txt -o values.txt --interpolation cubic
+ *
+ * @param[in]  argc  number of arguments (excluding the program name)
+ * @param      argv  arguments (starting with "sample")
+ *
+ * @return     exit code
+ */
+static int run_sample(int argc, char *argv[]) {
+    try {
+        TCLAP::CmdLine cmd("Interpolates a CHGCAR/LOCPOT file at a list of points.", ' ', PROGRAM_VERSION);
+
+        // input filename
+        TCLAP::ValueArg<std::string> arg_input_filename("i","input","Input file (i.e. CHGCAR)",true,"CHGCAR","filename");
+        cmd.add(arg_input_filename);
+
+        // points
+        TCLAP::ValueArg<std::string> arg_points("p","points","File holding the cartesian coordinates (x y z) of a point per line",true,"points.txt","filename");
+        cmd.add(arg_points);
+
+        // output filename
+        TCLAP::ValueArg<std::string> arg_output_filename("o","output","File to write the values to, one per line",true,"values.txt","filename");
+        cmd.add(arg_output_filename);
+
+        // force LOCPOT interpretation
+        TCLAP::SwitchArg arg_locpot("L","locpot","Treat the input as a LOCPOT file", cmd, false);
+
+        // spin component
+        std::vector<std::string> spins = {"total", "up", "down", "mag", "mx", "my", "mz"};
+        TCLAP::ValuesConstraint<std::string> spin_constraint(spins);
+        TCLAP::ValueArg<std::string> arg_spin("S","spin","Spin component to sample",false,"total",&spin_constraint);
+        cmd.add(arg_spin);
+
+        // interpolation between the grid points
+        std::vector<std::string> interpolations = {"linear", "cubic"};
+        TCLAP::ValuesConstraint<std::string> interpolation_constraint(interpolations);
+        TCLAP::ValueArg<std::string> arg_interpolation("","interpolation","Interpolation between the grid points (default: linear)",false,"linear",&interpolation_constraint);
+        cmd.add(arg_interpolation);
+
+        // whether to store the grid in cache-blocked tiles
+        TCLAP::SwitchArg arg_tiled("","tiled","Store the grid in tiles, which speeds up scattered points", cmd, false);
+
+        // periodic images
+        TCLAP::SwitchArg arg_wrap("","wrap","Map points outside the unit cell into it (otherwise their value is zero)", cmd, false);
+
+        cmd.parse(argc, argv);
+
+        const std::string input_filename = arg_input_filename.getValue();
+
+        auto start = std::chrono::system_clock::now();
+        std::vector<fpt> x, y, z;
+        BatchSampler::read_points(arg_points.getValue(), x, y, z);
+
+        ScalarField sf(input_filename, arg_locpot.getValue() || identify_locpot(input_filename),
+                       SpinDensity::parse(arg_spin.getValue()));
+        sf.read();
+        if(arg_interpolation.getValue() == "cubic") {
+            if(arg_tiled.getValue()) {
+                throw std::runtime_error("The grid can only be stored in tiles (--tiled) when it is interpolated linearly.");
+            }
+            sf.set_interpolation(ScalarField::Interpolation::CUBIC);
+        }
+        if(arg_tiled.getValue()) {
+            sf.tile();
+        }
+
+        std::vector<fpt> values(x.size());
+        sf.get_values_interp(x.data(), y.data(), z.data(), values.data(), values.size(), arg_wrap.getValue());
+        BatchSampler::write_values(arg_output_filename.getValue(), values);
+        auto end = std::chrono::system_clock::now();
+        std::chrono::duration<double> elapsed_seconds = end-start;
+
+        std::cout << boost::format("Sampled %s at %i points in %f seconds.")
+                     % input_filename % values.size() % elapsed_seconds.count() << std::endl;
+
+        return 0;
+
+    } catch (TCLAP::ArgException &e) {
+        std::cerr << "error: " << e.error() <<
+                     " for arg " << e.argId() << std::endl;
+        return -1;
+    }
+}
+
 int main(int argc, char *argv[]) {
+    // dispatch subcommands
+    if(argc > 1 && std::string(argv[1]) == "convert") {
+        return run_convert(argc - 1, argv + 1);
+    }
+    if(argc > 1 && std::string(argv[1]) == "info") {
+        return run_info(argc - 1, argv + 1);
+    }
+    if(argc > 1 && std::string(argv[1]) == "sample") {
+        return run_sample(argc - 1, argv + 1);
+    }
+
+    // "--info" anywhere on the command line only prints the metadata of
+    // the input file; all options that concern the projection are ignored
+    if(std::find_if(argv + 1, argv + argc, [](const char* arg) { return std::string(arg) == "--info"; }) != argv + argc) {
+        std::vector<char*> args = {argv[0]};
+        for(int i=1; i+1<argc; i++) {
+            const std::string arg(argv[i]);
+            if(arg == "-i" || arg == "--input") {
+                args.push_back(argv[i]);
+                args.push_back(argv[++i]);
+            }
+        }
+        return run_info(args.size(), args.data());
+    }
+
     // command line grabbing
     try {
         TCLAP::CmdLine cmd("Projects the electrondensity of a CHGCAR file onto a image file.", ' ', PROGRAM_VERSION);
@@ -99,18 +424,73 @@ int main(int argc, char *argv[]) {
         // whether or not to write out a z-average extraction
         TCLAP::SwitchArg arg_z("z","zaverage","Averaging over z", cmd, false);
 
+        // whether to only read the parts of the grid that are required
+        TCLAP::SwitchArg arg_lazy("","lazy","Only read the z-layers of the grid that are required", cmd, false);
+
+        // whether to store the grid in half precision
+        TCLAP::SwitchArg arg_compact("","compact","Store the grid in half precision", cmd, false);
+
+        // whether to skip the vacuum by storing the grid in bricks
+        TCLAP::ValueArg<double> arg_vacuum("","vacuum","Skip bricks of the grid whose values span less than this",false, 0.0, "threshold");
+        cmd.add(arg_vacuum);
+
+        // whether to store the grid in cache-blocked tiles
+        TCLAP::SwitchArg arg_tiled("","tiled","Store the grid in tiles, which speeds up oblique planes", cmd, false);
+
+        // whether to interpolate on a ghost-padded copy of the grid
+        TCLAP::SwitchArg arg_padded("","padded","Interpolate on a padded copy of the grid, which speeds up planes", cmd, false);
+
+        // interpolation between the grid points
+        std::vector<std::string> interpolations = {"linear", "cubic"};
+        TCLAP::ValuesConstraint<std::string> interpolation_constraint(interpolations);
+        TCLAP::ValueArg<std::string> arg_interpolation("","interpolation","Interpolation between the grid points (default: linear)",false,"linear",&interpolation_constraint);
+        cmd.add(arg_interpolation);
+
         // graph value bounds (for coloring purposes)
         TCLAP::ValueArg<std::string> arg_b("b","bounds","Lower and upper bounds",false, "", "-3,2");
         cmd.add(arg_b);
 
+        // spin component
+        std::vector<std::string> spins = {"total", "up", "down", "mag", "mx", "my", "mz"};
+        TCLAP::ValuesConstraint<std::string> spin_constraint(spins);
+        TCLAP::ValueArg<std::string> arg_spin("S","spin","Spin component to project",false,"total",&spin_constraint);
+        cmd.add(arg_spin);
+
+        // number of threads and their placement
+        TCLAP::ValueArg<unsigned int> arg_threads("","threads","Number of threads (default: OMP_NUM_THREADS or all CPUs)",false,0,"n");
+        cmd.add(arg_threads);
+        std::vector<std::string> policies = {"close", "spread"};
+        TCLAP::ValuesConstraint<std::string> bind_constraint(policies);
+        TCLAP::ValueArg<std::string> arg_bind("","bind","Pin the threads to consecutive (close) or evenly spaced (spread) CPUs",false,"",&bind_constraint);
+        cmd.add(arg_bind);
+
         cmd.parse(argc, argv);
 
+        // place the threads before any grid is allocated
+        if(arg_threads.isSet()) {
+            ThreadPlacement::set_nr_threads(arg_threads.getValue());
+        }
+        if(arg_bind.isSet()) {
+            ThreadPlacement::bind(arg_bind.getValue());
+        }
+
         //**************************************
         // Inform user about execution
         //**************************************
         std::cout << "--------------------------------------------------------------" << std::endl;
         std::cout << "Executing EDP v." << PROGRAM_VERSION << std::endl;
         std::cout << "Author: Ivo Filot <i.a.w.filot@tue.nl>" << std::endl;
+        std::cout << "Precision: " << (sizeof(fpt) == sizeof(double) ? "double" : "float")
+                  << " (accumulation: " << (sizeof(fpa) == sizeof(double) ? "double" : "float") << ")" << std::endl;
+        std::cout << "Threads: " << ThreadPlacement::get_nr_threads();
+        if(arg_bind.isSet()) {
+            std::cout << " (" << arg_bind.getValue() << ", CPUs";
+            for(int cpu : ThreadPlacement::get_cpus()) {
+                std::cout << " " << cpu;
+            }
+            std::cout << ")";
+        }
+        std::cout << std::endl;
         std::cout << "--------------------------------------------------------------" << std::endl;
 
         //**************************************
@@ -119,27 +499,27 @@ int main(int argc, char *argv[]) {
         std::string input_filename = arg_input_filename.getValue();
         std::string output_filename = arg_output_filename.getValue();
 
-        //***************************************)
+        //***************************************
         // identify whether this file is a locpot
         //***************************************
-        bool is_locpot = false;
-        if(input_filename.size() >= 6) {
-            if(input_filename.substr(0,6).compare("LOCPOT") == 0) {
-                is_locpot = true;
-            }
-        }
-        if(is_locpot) {
+        ScalarField sf(input_filename.c_str(), identify_locpot(input_filename), SpinDensity::parse(arg_spin.getValue()));
+        const std::string format = sf.get_format();
+        if(format != "vasp" && format != "binary") {
+            std::cout << input_filename << " is identified as a " << format << " file." << std::endl;
+        } else if(sf.is_locpot()) {
             std::cout << input_filename << " is identified as a LOCPOT file. This means that we use scalar field as is and perform *no* volume correction on it." << std::endl;
         } else {
             std::cout << input_filename << " is identified as a CHGCAR/PARCHG file. This means that we perform a volume correction on it as described in the link below:" << std::endl;
             std::cout << "https://www.vasp.at/wiki/index.php/CHGCAR" << std::endl;
         }
+        if(sf.get_spin_component() != SpinDensity::Component::TOTAL) {
+            std::cout << "Using the " << arg_spin.getValue() << " spin component." << std::endl;
+        }
         std::cout << std::endl;
 
         //**************************************
         // read header and atoms
         //**************************************
-        ScalarField sf(input_filename.c_str(), is_locpot);
         sf.read_header_and_atoms();
 
         //**************************************
@@ -224,22 +604,77 @@ int main(int argc, char *argv[]) {
         //**************************************
         // read grid
         //**************************************
+        if(arg_lazy.getValue() && (arg_compact.getValue() || arg_vacuum.isSet())) {
+            throw std::runtime_error("The grid can only be compacted (--compact, --vacuum) when it is read completely (no --lazy).");
+        }
+        if(arg_compact.getValue() && arg_vacuum.isSet()) {
+            throw std::runtime_error("Either store the grid in half precision (--compact) or in bricks (--vacuum), not both.");
+        }
+        const bool cubic = arg_interpolation.getValue() == "cubic";
+        if(cubic && (arg_lazy.getValue() || arg_compact.getValue() || arg_vacuum.isSet())) {
+            throw std::runtime_error("Cubic interpolation requires the complete grid in full precision (no --lazy, --compact or --vacuum).");
+        }
+        if(arg_tiled.getValue() && (cubic || arg_lazy.getValue() || arg_compact.getValue() || arg_vacuum.isSet())) {
+            throw std::runtime_error("The grid can only be stored in tiles (--tiled) when it is read completely in full precision "
+                                     "and interpolated linearly (no --lazy, --compact, --vacuum or --interpolation cubic).");
+        }
+        if(arg_padded.getValue() && (arg_tiled.getValue() || cubic || arg_lazy.getValue() || arg_compact.getValue() || arg_vacuum.isSet())) {
+            throw std::runtime_error("The grid can only be padded (--padded) when it is read completely in full precision "
+                                     "and interpolated linearly (no --tiled, --lazy, --compact, --vacuum or --interpolation cubic).");
+        }
         std::cout << "Start reading " << input_filename << "..." << std::endl;
         auto start = std::chrono::system_clock::now();
-        sf.read();
+        if(arg_lazy.getValue()) {
+            sf.read_lazy();
+        } else {
+            sf.read();
+        }
         auto end = std::chrono::system_clock::now();
         std::chrono::duration<double> elapsed_seconds = end-start;
         std::cout << "Done reading " << input_filename << " in " << elapsed_seconds.count() << " seconds." << std::endl;
-        std::cout << "Minimum value: " << sf.get_min() << std::endl;
-        std::cout << "Maximum value: " << sf.get_max() << std::endl;
-        std::cout << std::endl;
 
-        if(sf.get_min() < 1e-4 && !arg_negative.getValue()) {
-            std::cout << "------------------- NOTE -------------------" << std::endl;
-            std::cout << "Significant negative values are encountered." << std::endl;
-            std::cout << "If you want to parse these, consider setting" << std::endl;
-            std::cout << "the `-n` argument." << std::endl;
-            std::cout << "------------------- NOTE -------------------" << std::endl;
+        if(cubic) {
+            start = std::chrono::system_clock::now();
+            sf.set_interpolation(ScalarField::Interpolation::CUBIC);
+            elapsed_seconds = std::chrono::system_clock::now() - start;
+            std::cout << "Prefiltered the grid for cubic interpolation in " << elapsed_seconds.count() << " seconds." << std::endl;
+        }
+        if(arg_compact.getValue()) {
+            sf.compact();
+            std::cout << "Stored the grid in half precision." << std::endl;
+        }
+        if(arg_vacuum.isSet()) {
+            sf.sparsify(arg_vacuum.getValue());
+            const BrickedGrid* bricks = sf.get_bricked_grid();
+            std::cout << "Stored " << bricks->get_nr_stored_bricks() << " of " << bricks->get_nr_bricks()
+                      << " bricks of the grid; the others are constant within " << arg_vacuum.getValue() << "." << std::endl;
+        }
+        if(arg_tiled.getValue()) {
+            start = std::chrono::system_clock::now();
+            sf.tile();
+            elapsed_seconds = std::chrono::system_clock::now() - start;
+            std::cout << "Stored the grid in tiles in " << elapsed_seconds.count() << " seconds." << std::endl;
+        }
+        if(arg_padded.getValue()) {
+            start = std::chrono::system_clock::now();
+            sf.pad();
+            elapsed_seconds = std::chrono::system_clock::now() - start;
+            std::cout << "Padded the grid in " << elapsed_seconds.count() << " seconds." << std::endl;
+        }
+
+        // the extrema would require the complete grid
+        if(!arg_lazy.getValue()) {
+            std::cout << "Minimum value: " << sf.get_min() << std::endl;
+            std::cout << "Maximum value: " << sf.get_max() << std::endl;
+            std::cout << std::endl;
+
+            if(sf.get_min() < 1e-4 && !arg_negative.getValue()) {
+                std::cout << "------------------- NOTE -------------------" << std::endl;
+                std::cout << "Significant negative values are encountered." << std::endl;
+                std::cout << "If you want to parse these, consider setting" << std::endl;
+                std::cout << "the `-n` argument." << std::endl;
+                std::cout << "------------------- NOTE -------------------" << std::endl;
+            }
         }
 
         //**************************************
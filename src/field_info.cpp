@@ -0,0 +1,312 @@
+/**************************************************************************
+ *                                                                        *
+ *   Author: Ivo Filot <i.a.w.filot@tue.nl>                               *
+ *                                                                        *
+ *   EDP is free software:                                                *
+ *   you can redistribute it and/or modify it under the terms of the      *
+ *   GNU General Public License as published by the Free Software         *
+ *   Foundation, either version 3 of the License, or (at your option)     *
+ *   any later version.                                                   *
+ *                                                                        *
+ *   EDP is distributed in the hope that it will be useful,               *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty          *
+ *   of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.              *
+ *   See the GNU General Public License for more details.                 *
+ *                                                                        *
+ *   You should have received a copy of the GNU General Public License    *
+ *   along with this program.  If not, see http://www.gnu.org/licenses/.  *
+ *                                                                        *
+ **************************************************************************/
+
+#include "field_info.h"
+#include "scalar_field.h"
+#include "binary_field.h"
+#include "tar_archive.h"
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <boost/filesystem.hpp>
+#include <boost/algorithm/string/predicate.hpp>
+
+namespace {
+
+/**
+ * @brief      escape a string for use in JSON
+ *
+ * @param[in]  str   string
+ *
+ * @return     quoted and escaped string
+ */
+std::string json_string(const std::string& str) {
+    std::ostringstream out;
+    out << '"';
+    for(const char c : str) {
+        switch(c) {
+            case '"':  out << "\\\""; break;
+            case '\\': out << "\\\\"; break;
+            case '\n': out << "\\n";  break;
+            case '\r': out << "\\r";  break;
+            case '\t': out << "\\t";  break;
+            default:
+                if(static_cast<unsigned char>(c) < 0x20) {
+                    out << "\\u" << std::hex << std::setw(4) << std::setfill('0') << (int)c << std::dec;
+                } else {
+                    out << c;
+                }
+        }
+    }
+    out << '"';
+    return out.str();
+}
+
+/**
+ * @brief      name of the file or, for members of archives, of the member
+ *
+ * @param[in]  filename  path to the file
+ *
+ * @return     basename
+ */
+std::string get_basename(const std::string& filename) {
+    std::string archive, member;
+    const std::string path = TarArchive::split(filename, &archive, &member) ? member : filename;
+    return boost::filesystem::path(path).filename().string();
+}
+
+} // namespace
+
+/**
+ * @brief      probe a file
+ *
+ * Errors are recorded in the error field rather than thrown, such that
+ * a single corrupt file does not interrupt a scan.
+ *
+ * @param[in]  filename  path to the file
+ *
+ * @return     metadata of the file
+ */
+FieldInfo FieldInfo::probe(const std::string& filename) {
+    FieldInfo info;
+    info.filename = filename;
+    for(auto& row : info.lattice) {
+        row.fill(0.0);
+    }
+
+    try {
+        const std::string basename = get_basename(filename);
+        static const std::vector<std::pair<std::string, std::string>> types = {
+            {"LOCPOT", "LOCPOT"}, {"PARCHG", "PARCHG"}, {"ELFCAR", "ELFCAR"},
+            {"AECCAR", "CHGCAR"}, {"CHG", "CHGCAR"}
+        };
+        info.type = "unknown";
+        for(const auto& type : types) {
+            if(boost::starts_with(basename, type.first)) {
+                info.type = type.second;
+                break;
+            }
+        }
+
+        ScalarField sf(filename, info.type == "LOCPOT");
+        sf.read_header_and_atoms();
+
+        // archive members report their own size
+        std::string archive, member;
+        if(TarArchive::split(filename, &archive, &member)) {
+            info.file_size = TarArchive::find_member(archive, member).size;
+        } else if(filename != "-") {
+            info.file_size = boost::filesystem::file_size(filename);
+        }
+        info.compressed = filename != "-" &&
+                          StreamReader::detect(TarArchive::get_source(filename)) != StreamReader::Compression::NONE;
+
+        if(sf.binary_input) {
+            info.format = "binary";
+            if(sf.is_locpot()) {
+                info.type = "LOCPOT";
+            }
+        } else if(std::string(sf.get_format()) == "vasp") {
+            info.format = sf.vasp5_input ? "vasp5" : "vasp4";
+        } else {
+            info.format = sf.get_format();
+        }
+        info.comment = boost::trim_copy(sf.comment);
+
+        for(unsigned int i=0; i<3; i++) {
+            for(unsigned int j=0; j<3; j++) {
+                info.lattice[i][j] = sf.mat(i,j);
+            }
+        }
+        info.volume = sf.volume;
+        info.grid_dimensions = sf.grid_dimensions;
+        info.counts = sf.nrat;
+        for(unsigned int elnr : sf.atom_charges) {
+            info.elements.push_back(PeriodicTable::get().get_label_elnr(elnr));
+        }
+
+        // the native binary format holds a single grid without augmentation
+        // occupancies; sequential inputs cannot be seeked
+        if(sf.binary_input) {
+            info.nr_grids = 1;
+            info.augmentation = 0;
+        } else if(!sf.streamed_input && sf.reader->has_fixed_layout()) {
+            info.probe_blocks(sf.grid_offset);
+        }
+    } catch(const std::exception& e) {
+        info.error = e.what();
+    }
+
+    return info;
+}
+
+/**
+ * @brief      probe all volumetric files in a directory (recursively)
+ *
+ * Files are recognized by their name (CHGCAR, CHG, AECCAR, LOCPOT,
+ * PARCHG or ELFCAR followed by anything) or by the .edpf extension, and
+ * are probed in parallel.
+ *
+ * @param[in]  directory  path to the directory
+ *
+ * @return     metadata of the files (sorted by filename)
+ */
+std::vector<FieldInfo> FieldInfo::scan(const std::string& directory) {
+    if(!boost::filesystem::is_directory(directory)) {
+        throw std::runtime_error("Cannot open directory " + directory + "!");
+    }
+
+    std::vector<std::string> filenames;
+    boost::system::error_code ec;
+    for(boost::filesystem::recursive_directory_iterator it(directory, ec), end; it != end; it.increment(ec)) {
+        if(ec) {
+            continue;
+        }
+        if(boost::filesystem::is_regular_file(it->path()) && is_recognized(it->path().string())) {
+            filenames.push_back(it->path().string());
+        }
+    }
+    std::sort(filenames.begin(), filenames.end());
+
+    // probing is dominated by the latency of opening the files
+    std::vector<FieldInfo> infos(filenames.size());
+    #pragma omp parallel for schedule(dynamic)
+    for(size_t i=0; i<filenames.size(); i++) {
+        infos[i] = probe(filenames[i]);
+    }
+
+    return infos;
+}
+
+/**
+ * @brief      write the metadata of a number of files as a JSON array
+ *
+ * @param[in]  infos     metadata
+ * @param[in]  filename  path to the output file
+ */
+void FieldInfo::write_catalogue(const std::vector<FieldInfo>& infos, const std::string& filename) {
+    std::ofstream outfile(filename);
+    if(!outfile.is_open()) {
+        throw std::runtime_error("Cannot open " + filename + " for writing!");
+    }
+
+    // one file per line, such that the catalogue can be grepped
+    outfile << "[" << std::endl;
+    for(size_t i=0; i<infos.size(); i++) {
+        outfile << infos[i].to_json() << (i + 1 < infos.size() ? "," : "") << std::endl;
+    }
+    outfile << "]" << std::endl;
+
+    if(!outfile.good()) {
+        throw std::runtime_error("Error encountered in writing " + filename + "!");
+    }
+}
+
+/**
+ * @brief      represent the metadata as a (single-line) JSON object
+ *
+ * @return     JSON string
+ */
+std::string FieldInfo::to_json() const {
+    std::ostringstream out;
+    out << std::setprecision(10);
+    out << "{\"filename\": " << json_string(this->filename);
+    if(!this->error.empty()) {
+        out << ", \"error\": " << json_string(this->error) << "}";
+        return out.str();
+    }
+
+    out << ", \"type\": " << json_string(this->type)
+        << ", \"format\": " << json_string(this->format)
+        << ", \"comment\": " << json_string(this->comment)
+        << ", \"file_size\": " << this->file_size
+        << ", \"compressed\": " << (this->compressed ? "true" : "false");
+
+    out << ", \"lattice\": [";
+    for(unsigned int i=0; i<3; i++) {
+        out << (i > 0 ? ", " : "") << "[" << this->lattice[i][0] << ", "
+            << this->lattice[i][1] << ", " << this->lattice[i][2] << "]";
+    }
+    out << "], \"volume\": " << this->volume;
+
+    out << ", \"grid_dimensions\": [" << this->grid_dimensions[0] << ", "
+        << this->grid_dimensions[1] << ", " << this->grid_dimensions[2] << "]";
+
+    out << ", \"elements\": [";
+    for(size_t i=0; i<this->elements.size(); i++) {
+        out << (i > 0 ? ", " : "") << json_string(this->elements[i]);
+    }
+    out << "], \"counts\": [";
+    for(size_t i=0; i<this->counts.size(); i++) {
+        out << (i > 0 ? ", " : "") << this->counts[i];
+    }
+    out << "]";
+
+    if(this->nr_grids < 0) {
+        out << ", \"nr_grids\": null, \"spin\": null";
+    } else {
+        out << ", \"nr_grids\": " << this->nr_grids << ", \"spin\": "
+            << (this->nr_grids >= 4 ? "\"noncollinear\"" : this->nr_grids >= 2 ? "\"collinear\"" : "\"none\"");
+    }
+    out << ", \"augmentation\": "
+        << (this->augmentation < 0 ? "null" : this->augmentation ? "true" : "false");
+    out << "}";
+
+    return out.str();
+}
+
+/**
+ * @brief      whether a filename designates a volumetric VASP file
+ *
+ * @param[in]  filename  path to the file
+ *
+ * @return     True if recognized, False otherwise.
+ */
+bool FieldInfo::is_recognized(const std::string& filename) {
+    static const std::vector<std::string> prefixes = {"CHG", "AECCAR", "LOCPOT", "PARCHG", "ELFCAR"};
+    const std::string basename = get_basename(filename);
+    for(const auto& prefix : prefixes) {
+        if(boost::starts_with(basename, prefix)) {
+            return true;
+        }
+    }
+    return boost::ends_with(basename, ".edpf");
+}
+
+/**
+ * @brief      find the blocks that follow the first grid of a text file
+ *
+ * See VaspReader::locate_grids().
+ *
+ * @param[in]  grid_offset  byte offset of the first grid
+ */
+void FieldInfo::probe_blocks(size_t grid_offset) {
+    MappedFile mf(this->filename);
+    bool augmentation = false;
+    const auto grids = VaspReader::locate_grids(mf.data() + grid_offset, mf.end(), this->grid_dimensions, &augmentation);
+    if(grids.empty()) {
+        return; // incomplete grid; leave the fields undetermined
+    }
+
+    this->nr_grids = grids.size();
+    this->augmentation = augmentation ? 1 : 0;
+}
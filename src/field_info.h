@@ -0,0 +1,115 @@
+/**************************************************************************
+ *                                                                        *
+ *   Author: Ivo Filot <i.a.w.filot@tue.nl>                               *
+ *                                                                        *
+ *   EDP is free software:                                                *
+ *   you can redistribute it and/or modify it under the terms of the      *
+ *   GNU General Public License as published by the Free Software         *
+ *   Foundation, either version 3 of the License, or (at your option)     *
+ *   any later version.                                                   *
+ *                                                                        *
+ *   EDP is distributed in the hope that it will be useful,               *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty          *
+ *   of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.              *
+ *   See the GNU General Public License for more details.                 *
+ *                                                                        *
+ *   You should have received a copy of the GNU General Public License    *
+ *   along with this program.  If not, see http://www.gnu.org/licenses/.  *
+ *                                                                        *
+ **************************************************************************/
+
+#ifndef _FIELD_INFO_H
+#define _FIELD_INFO_H
+
+#include <array>
+#include <string>
+#include <vector>
+#include <cstdint>
+
+/**
+ * @brief      Metadata of a CHGCAR/LOCPOT/PARCHG file
+ *
+ * The metadata is obtained from the header of the file only; the grid
+ * itself is never parsed. For text files with the fixed-width layout
+ * written by VASP, the blocks following the first grid (augmentation
+ * occupancies and the grids of the spin components) are found by seeking
+ * past each grid.
+ */
+class FieldInfo {
+public:
+    std::string filename;
+    std::string error;                  // empty when the file could be probed
+    std::string format;                 // "vasp4", "vasp5", "binary", "cube" or "xsf"
+    std::string type;                   // "CHGCAR", "LOCPOT", "PARCHG" or "unknown"
+    std::string comment;
+    uint64_t file_size = 0;
+    bool compressed = false;
+
+    std::array<std::array<double, 3>, 3> lattice;
+    double volume = 0.0;
+    std::array<unsigned int, 3> grid_dimensions = {0, 0, 0};
+    std::vector<std::string> elements;  // empty for VASP4 files
+    std::vector<unsigned int> counts;   // number of atoms per species
+
+    int nr_grids = -1;                  // number of grids in the file; -1 if unknown
+    int augmentation = -1;              // whether augmentation occupancies are present; -1 if unknown
+
+    /**
+     * @brief      probe a file
+     *
+     * Errors are recorded in the error field rather than thrown, such that
+     * a single corrupt file does not interrupt a scan.
+     *
+     * @param[in]  filename  path to the file
+     *
+     * @return     metadata of the file
+     */
+    static FieldInfo probe(const std::string& filename);
+
+    /**
+     * @brief      probe all volumetric files in a directory (recursively)
+     *
+     * Files are recognized by their name (CHGCAR, CHG, AECCAR, LOCPOT,
+     * PARCHG or ELFCAR followed by anything) or by the .edpf extension, and
+     * are probed in parallel.
+     *
+     * @param[in]  directory  path to the directory
+     *
+     * @return     metadata of the files (sorted by filename)
+     */
+    static std::vector<FieldInfo> scan(const std::string& directory);
+
+    /**
+     * @brief      write the metadata of a number of files as a JSON array
+     *
+     * @param[in]  infos     metadata
+     * @param[in]  filename  path to the output file
+     */
+    static void write_catalogue(const std::vector<FieldInfo>& infos, const std::string& filename);
+
+    /**
+     * @brief      represent the metadata as a (single-line) JSON object
+     *
+     * @return     JSON string
+     */
+    std::string to_json() const;
+
+    /**
+     * @brief      whether a filename designates a volumetric VASP file
+     *
+     * @param[in]  filename  path to the file
+     *
+     * @return     True if recognized, False otherwise.
+     */
+    static bool is_recognized(const std::string& filename);
+
+private:
+    /**
+     * @brief      find the blocks that follow the first grid of a text file
+     *
+     * @param[in]  grid_offset  byte offset of the first grid
+     */
+    void probe_blocks(size_t grid_offset);
+};
+
+#endif // _FIELD_INFO_H
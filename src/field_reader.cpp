@@ -0,0 +1,453 @@
+/**************************************************************************
+ *                                                                        *
+ *   Author: Ivo Filot <i.a.w.filot@tue.nl>                               *
+ *                                                                        *
+ *   EDP is free software:                                                *
+ *   you can redistribute it and/or modify it under the terms of the      *
+ *   GNU General Public License as published by the Free Software         *
+ *   Foundation, either version 3 of the License, or (at your option)     *
+ *   any later version.                                                   *
+ *                                                                        *
+ *   EDP is distributed in the hope that it will be useful,               *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty          *
+ *   of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.              *
+ *   See the GNU General Public License for more details.                 *
+ *                                                                        *
+ *   You should have received a copy of the GNU General Public License    *
+ *   along with this program.  If not, see http://www.gnu.org/licenses/.  *
+ *                                                                        *
+ **************************************************************************/
+
+#include "field_reader.h"
+#include "scalar_field.h"
+#include "binary_field.h"
+#include "compressed_field.h"
+#include "cube_reader.h"
+#include "xsf_reader.h"
+#include "vaspout_reader.h"
+
+namespace {
+
+/**
+ * @brief      parse a line holding three unsigned integers
+ *
+ * @param[in]  p     begin of line
+ * @param[in]  end   end of line
+ * @param      dims  parsed integers
+ *
+ * @return     whether the line holds exactly three integers
+ */
+bool parse_dimensions(const char* p, const char* end, std::array<unsigned int, 3>& dims) {
+    for(unsigned int i=0; i<3; i++) {
+        while(p < end && (*p == ' ' || *p == '\t')) {
+            p++;
+        }
+        if(p == end || *p < '0' || *p > '9') {
+            return false;
+        }
+        dims[i] = 0;
+        while(p < end && *p >= '0' && *p <= '9') {
+            dims[i] = dims[i] * 10 + (*p++ - '0');
+        }
+    }
+    while(p < end && (*p == ' ' || *p == '\t' || *p == '\r')) {
+        p++;
+    }
+    return p == end;
+}
+
+} // namespace
+
+/**
+ * @brief      add a reader to the registry
+ *
+ * Readers that are added later take precedence over earlier ones.
+ *
+ * @param[in]  reader  reader
+ */
+void FieldReader::add(std::unique_ptr<FieldReader> reader) {
+    auto& registry = get_registry();
+    registry.insert(registry.begin(), std::move(reader));
+}
+
+/**
+ * @brief      find the reader for a file
+ *
+ * Compressed files, members of archives and standard input are always
+ * read as VASP files.
+ *
+ * @param[in]  filename  path to the file
+ *
+ * @return     reader
+ */
+const FieldReader* FieldReader::detect(const std::string& filename) {
+    static const VaspReader vasp_reader;
+    if(StreamReader::is_streamed(filename)) {
+        return &vasp_reader;
+    }
+
+    std::ifstream infile(filename, std::ios::binary);
+    std::string head(SNIFF_SIZE, '\0');
+    infile.read(&head[0], head.size());
+    head.resize(infile.gcount());
+
+    for(const auto& reader : get_registry()) {
+        if(reader->sniff(head)) {
+            return reader.get();
+        }
+    }
+
+    return &vasp_reader;
+}
+
+/**
+ * @brief      store the header of a file in a scalar field
+ *
+ * Consecutive atoms of the same element are grouped, as in the species
+ * of a VASP file.
+ *
+ * @param      sf               scalar field
+ * @param[in]  comment          description of the file
+ * @param[in]  mat              unit cell matrix (rows are lattice vectors in angstrom)
+ * @param[in]  elnrs            atomic number of each atom
+ * @param[in]  positions        cartesian position of each atom in angstrom
+ * @param[in]  grid_dimensions  dimensions of the grid
+ * @param[in]  grid_offset      byte offset of the grid in the file
+ */
+void FieldReader::set_header(ScalarField* sf, const std::string& comment, const MatrixUnitcell& mat,
+                             const std::vector<unsigned int>& elnrs, const std::vector<Vec3>& positions,
+                             const std::array<unsigned int, 3>& grid_dimensions, size_t grid_offset) {
+    sf->comment = comment;
+    sf->scalar = 1.0;
+    sf->mat = mat;
+    sf->imat = mat.inverse();
+    sf->volume = mat.determinant();
+
+    sf->nrat.clear();
+    sf->atom_charges.clear();
+    sf->atom_pos.clear();
+    for(size_t i=0; i<elnrs.size(); i++) {
+        if(i == 0 || elnrs[i] != elnrs[i-1]) {
+            sf->atom_charges.push_back(elnrs[i]);
+            sf->nrat.push_back(0);
+        }
+        sf->nrat.back()++;
+        sf->atom_pos.push_back(sf->imat.transpose() * positions[i]);
+    }
+    sf->vasp5_input = true;
+
+    sf->grid_dimensions = grid_dimensions;
+    sf->gridsize = (size_t)grid_dimensions[0] * grid_dimensions[1] * grid_dimensions[2];
+    sf->gridline = std::to_string(grid_dimensions[0]) + " " +
+                   std::to_string(grid_dimensions[1]) + " " +
+                   std::to_string(grid_dimensions[2]);
+    sf->grid_offset = grid_offset;
+    sf->header_read = true;
+}
+
+/**
+ * @brief      grid of a scalar field
+ */
+fpt* FieldReader::get_grid(ScalarField* sf) {
+    return sf->gridptr.data();
+}
+
+/**
+ * @brief      byte offset of the grid in the file
+ */
+size_t FieldReader::get_grid_offset(const ScalarField* sf) {
+    return sf->grid_offset;
+}
+
+/**
+ * @brief      read the next line of a buffer
+ *
+ * @param      p     current position; moved to the start of the next line
+ * @param[in]  end   end of the buffer
+ * @param      line  line (without line ending)
+ *
+ * @return     False when the end of the buffer has been reached
+ */
+bool FieldReader::next_line(const char*& p, const char* end, std::string& line) {
+    if(p >= end) {
+        return false;
+    }
+
+    const char* eol = static_cast<const char*>(memchr(p, '\n', end - p));
+    const char* line_end = eol ? eol : end;
+    line.assign(p, line_end);
+    if(!line.empty() && line.back() == '\r') {
+        line.pop_back();
+    }
+    p = eol ? eol + 1 : end;
+    return true;
+}
+
+/**
+ * @brief      split a line into whitespace-separated tokens
+ */
+std::vector<std::string> FieldReader::split(const std::string& line) {
+    std::vector<std::string> pieces;
+    const std::string trimmed = boost::trim_copy(line);
+    if(!trimmed.empty()) {
+        boost::split(pieces, trimmed, boost::is_any_of("\t "), boost::token_compress_on);
+    }
+    return pieces;
+}
+
+/**
+ * @brief      whether a token is a (signed) integer
+ */
+bool FieldReader::is_integer(const std::string& token) {
+    size_t i = (!token.empty() && (token[0] == '-' || token[0] == '+')) ? 1 : 0;
+    if(i == token.size()) {
+        return false;
+    }
+    for(; i<token.size(); i++) {
+        if(token[i] < '0' || token[i] > '9') {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief      whether a token is a floating point number
+ */
+bool FieldReader::is_number(const std::string& token) {
+    char* endptr = nullptr;
+    std::strtod(token.c_str(), &endptr);
+    return !token.empty() && endptr == token.c_str() + token.size();
+}
+
+/**
+ * @brief      read the header of a VASP file
+ */
+void FieldReader::read_vasp_header(ScalarField* sf) {
+    sf->read_header();
+}
+
+/**
+ * @brief      read the grid of a VASP file
+ */
+void FieldReader::read_vasp_grid(ScalarField* sf) {
+    sf->parse_grid();
+}
+
+/**
+ * @brief      registered readers, in order of precedence
+ */
+std::vector<std::unique_ptr<FieldReader>>& FieldReader::get_registry() {
+    static std::vector<std::unique_ptr<FieldReader>> registry = []() {
+        std::vector<std::unique_ptr<FieldReader>> readers;
+        readers.emplace_back(new BinaryReader());
+        readers.emplace_back(new CompressedReader());
+        readers.emplace_back(new CubeReader());
+        readers.emplace_back(new XsfReader());
+#ifdef HAS_HDF5
+        readers.emplace_back(new VaspoutReader());
+#endif
+        return readers;
+    }();
+    return registry;
+}
+
+/**
+ * @brief      VASP files have no signature; any text file is accepted
+ */
+bool VaspReader::sniff(const std::string& head) const {
+    (void)head;
+    return true;
+}
+
+void VaspReader::read_header(ScalarField* sf) const {
+    read_vasp_header(sf);
+}
+
+void VaspReader::read_grid(ScalarField* sf) const {
+    read_vasp_grid(sf);
+}
+
+/**
+ * @brief      slabs are located using the fixed line width of the grid
+ */
+std::unique_ptr<SlabLoader> VaspReader::create_slab_loader(ScalarField* sf) const {
+    const fpt divisor = sf->is_locpot() ? 1.0f : sf->get_volume();
+    auto mf = std::make_shared<MappedFile>(sf->get_filename());
+    return SlabLoader::create(mf, get_grid_offset(sf), get_grid(sf), sf->get_grid_dimensions(), divisor);
+}
+
+/**
+ * @brief      locate the grids of a VASP file
+ *
+ * Spin-polarized and non-collinear calculations store further grids
+ * (the magnetization densities) after the total density, each preceded
+ * by a repetition of the line holding the grid dimensions. Grids are
+ * skipped in their entirety using their fixed layout; only the
+ * (comparatively short) lines in between, e.g. the augmentation
+ * occupancies, are inspected.
+ *
+ * @param[in]  p             start of the first grid
+ * @param[in]  end           end of the file
+ * @param[in]  dims          grid dimensions
+ * @param      augmentation  set to whether augmentation occupancies are present (optional)
+ *
+ * @return     start of each grid
+ */
+std::vector<const char*> VaspReader::locate_grids(const char* p, const char* end,
+                                                  const std::array<unsigned int, 3>& dims,
+                                                  bool* augmentation) {
+    const size_t n = (size_t)dims[0] * dims[1] * dims[2];
+    std::vector<const char*> grids;
+    if(augmentation) {
+        *augmentation = false;
+    }
+
+    while(p < end) {
+        const char* grid_end = skip_grid(p, end, n);
+        if(!grid_end) {
+            break;  // incomplete grid; the grids found so far are returned
+        }
+        grids.push_back(p);
+        p = grid_end;
+
+        // inspect the lines up to the next grid (if any)
+        bool next_grid = false;
+        while(p < end && !next_grid) {
+            const char* eol = static_cast<const char*>(memchr(p, '\n', end - p));
+            const char* line_end = eol ? eol : end;
+            const char* q = p;
+            while(q < line_end && (*q == ' ' || *q == '\t')) {
+                q++;
+            }
+
+            std::array<unsigned int, 3> line_dims;
+            if(line_end - q >= 12 && std::memcmp(q, "augmentation", 12) == 0) {
+                if(augmentation) {
+                    *augmentation = true;
+                }
+            } else if(parse_dimensions(q, line_end, line_dims) && line_dims == dims) {
+                next_grid = true;
+            }
+            p = eol ? eol + 1 : end;
+        }
+    }
+
+    return grids;
+}
+
+/**
+ * @brief      skip a grid of a VASP file
+ *
+ * When the grid is written in lines of fixed width, its end is computed
+ * directly; otherwise its values are tokenized one by one.
+ *
+ * @param[in]  p     start of the grid
+ * @param[in]  end   end of the file
+ * @param[in]  n     number of values in the grid
+ *
+ * @return     start of the line following the grid; nullptr if the grid
+ *             holds fewer than n values
+ */
+const char* VaspReader::skip_grid(const char* p, const char* end, size_t n) {
+    size_t line_width = 0;
+    size_t values_per_line = 0;
+    if(FloatTokenizer::detect_fixed_layout(p, end, n, &line_width, &values_per_line)) {
+        p += (n / values_per_line) * line_width;
+        if(n % values_per_line == 0) {
+            return p;
+        }
+    } else {
+        double value = 0.0;
+        for(size_t i=0; i<n; i++) {
+            if(!FloatTokenizer::parse(p, end, value)) {
+                return nullptr;
+            }
+        }
+    }
+
+    // move to the start of the next line
+    const char* eol = static_cast<const char*>(memchr(p, '\n', end - p));
+    return eol ? eol + 1 : end;
+}
+
+/**
+ * @brief      parse the augmentation occupancies that follow a grid
+ *
+ * Every atom has a section starting with "augmentation occupancies",
+ * followed by the index of the atom and the number of occupancies.
+ * Parsing stops at the first line that does not start such a section.
+ *
+ * @param[in]  p         start of the line following the grid
+ * @param[in]  end       end of the file
+ * @param[in]  nr_atoms  number of atoms
+ *
+ * @return     occupancies per atom; empty for atoms without a section
+ */
+AugmentationOccupancies VaspReader::read_augmentation(const char* p, const char* end, unsigned int nr_atoms) {
+    static const char KEYWORD[] = "augmentation occupancies";
+    static const size_t KEYWORD_LENGTH = sizeof(KEYWORD) - 1;
+
+    AugmentationOccupancies occupancies(nr_atoms);
+    while(p < end) {
+        const char* q = FloatTokenizer::skip_whitespace(p, end);
+        if(end - q < (ptrdiff_t)KEYWORD_LENGTH || std::memcmp(q, KEYWORD, KEYWORD_LENGTH) != 0) {
+            break;
+        }
+        q += KEYWORD_LENGTH;
+
+        double atid = 0.0;
+        double count = 0.0;
+        if(!FloatTokenizer::parse(q, end, atid) || !FloatTokenizer::parse(q, end, count) ||
+           atid < 1 || atid > nr_atoms || count < 0) {
+            throw std::runtime_error("Invalid augmentation occupancies encountered");
+        }
+
+        auto& values = occupancies[(unsigned int)atid - 1];
+        values.resize((size_t)count);
+        if(FloatTokenizer::parse_block(q, end, values.data(), values.size(), 1.0f) != values.size()) {
+            throw std::runtime_error("Incomplete augmentation occupancies encountered");
+        }
+
+        const char* eol = static_cast<const char*>(memchr(q, '\n', end - q));
+        p = eol ? eol + 1 : end;
+    }
+
+    return occupancies;
+}
+
+/**
+ * @brief      binary files start with a magic number
+ */
+bool BinaryReader::sniff(const std::string& head) const {
+    return head.size() >= sizeof(BinaryField::MAGIC) &&
+           head.compare(0, sizeof(BinaryField::MAGIC), BinaryField::MAGIC, sizeof(BinaryField::MAGIC)) == 0;
+}
+
+void BinaryReader::read_header(ScalarField* sf) const {
+    BinaryField::read_header(sf);
+}
+
+void BinaryReader::read_grid(ScalarField* sf) const {
+    BinaryField::read_grid(sf, sf->get_filename());
+}
+
+/**
+ * @brief      compressed files start with a magic number
+ */
+bool CompressedReader::sniff(const std::string& head) const {
+    return head.size() >= sizeof(CompressedField::MAGIC) &&
+           head.compare(0, sizeof(CompressedField::MAGIC), CompressedField::MAGIC, sizeof(CompressedField::MAGIC)) == 0;
+}
+
+void CompressedReader::read_header(ScalarField* sf) const {
+    CompressedField::read_header(sf);
+}
+
+void CompressedReader::read_grid(ScalarField* sf) const {
+    CompressedField::read_grid(sf);
+}
+
+std::unique_ptr<SlabLoader> CompressedReader::create_slab_loader(ScalarField* sf) const {
+    return CompressedField::create_slab_loader(sf);
+}
@@ -0,0 +1,329 @@
+/**************************************************************************
+ *                                                                        *
+ *   Author: Ivo Filot <i.a.w.filot@tue.nl>                               *
+ *                                                                        *
+ *   EDP is free software:                                                *
+ *   you can redistribute it and/or modify it under the terms of the      *
+ *   GNU General Public License as published by the Free Software         *
+ *   Foundation, either version 3 of the License, or (at your option)     *
+ *   any later version.                                                   *
+ *                                                                        *
+ *   EDP is distributed in the hope that it will be useful,               *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty          *
+ *   of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.              *
+ *   See the GNU General Public License for more details.                 *
+ *                                                                        *
+ *   You should have received a copy of the GNU General Public License    *
+ *   along with this program.  If not, see http://www.gnu.org/licenses/.  *
+ *                                                                        *
+ **************************************************************************/
+
+#ifndef _FIELD_READER_H
+#define _FIELD_READER_H
+
+#include <array>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "math.h"
+#include "slab_loader.h"
+
+class ScalarField;
+
+typedef std::vector<std::vector<fpt>> AugmentationOccupancies;  // PAW occupancies per atom
+
+/**
+ * @brief      Reader for a file format holding a scalar field
+ *
+ * Readers are stateless; everything that is read is stored in the
+ * ScalarField. The format of a file is established by handing the first
+ * bytes of the file to every registered reader in turn (content sniffing),
+ * such that the name of the file is irrelevant. VASP files lack a
+ * recognizable signature and are therefore used as the fallback.
+ */
+class FieldReader {
+public:
+    static constexpr size_t SNIFF_SIZE = 4096;  // number of bytes handed to sniff()
+
+    virtual ~FieldReader() = default;
+
+    /**
+     * @brief      short name of the format
+     */
+    virtual const char* get_name() const = 0;
+
+    /**
+     * @brief      whether the start of a file is in this format
+     *
+     * @param[in]  head  first (at most SNIFF_SIZE) bytes of the file
+     *
+     * @return     True if recognized, False otherwise.
+     */
+    virtual bool sniff(const std::string& head) const = 0;
+
+    /**
+     * @brief      read the unit cell, the atoms and the grid dimensions
+     *
+     * @param      sf    scalar field
+     */
+    virtual void read_header(ScalarField* sf) const = 0;
+
+    /**
+     * @brief      read the grid into the (allocated) grid of the scalar field
+     *
+     * The values are stored with x running fastest and are divided by the
+     * cell volume for CHGCAR-type files, as for VASP files.
+     *
+     * @param      sf    scalar field
+     */
+    virtual void read_grid(ScalarField* sf) const = 0;
+
+    /**
+     * @brief      whether the grid is stored with x running fastest in lines
+     *             of fixed width, such that z-slabs can be located directly
+     */
+    virtual bool has_fixed_layout() const {
+        return false;
+    }
+
+    /**
+     * @brief      whether the file can hold several spin components (see
+     *             SpinDensity), of which one is read into the grid
+     */
+    virtual bool has_spin_components() const {
+        return false;
+    }
+
+    /**
+     * @brief      whether the grid is worth storing in the grid cache (see
+     *             GridCache) after it has been read
+     */
+    virtual bool is_cacheable() const {
+        return true;
+    }
+
+    /**
+     * @brief      create a loader for the z-slabs of the (allocated) grid
+     *
+     * @param      sf    scalar field
+     *
+     * @return     loader; empty if the grid cannot be loaded on demand
+     */
+    virtual std::unique_ptr<SlabLoader> create_slab_loader(ScalarField* sf) const {
+        (void)sf;
+        return nullptr;
+    }
+
+    /**
+     * @brief      add a reader to the registry
+     *
+     * Readers that are added later take precedence over earlier ones.
+     *
+     * @param[in]  reader  reader
+     */
+    static void add(std::unique_ptr<FieldReader> reader);
+
+    /**
+     * @brief      find the reader for a file
+     *
+     * Compressed files, members of archives and standard input are always
+     * read as VASP files.
+     *
+     * @param[in]  filename  path to the file
+     *
+     * @return     reader
+     */
+    static const FieldReader* detect(const std::string& filename);
+
+protected:
+    /**
+     * @brief      store the header of a file in a scalar field
+     *
+     * Consecutive atoms of the same element are grouped, as in the species
+     * of a VASP file.
+     *
+     * @param      sf               scalar field
+     * @param[in]  comment          description of the file
+     * @param[in]  mat              unit cell matrix (rows are lattice vectors in angstrom)
+     * @param[in]  elnrs            atomic number of each atom
+     * @param[in]  positions        cartesian position of each atom in angstrom
+     * @param[in]  grid_dimensions  dimensions of the grid
+     * @param[in]  grid_offset      byte offset of the grid in the file
+     */
+    static void set_header(ScalarField* sf, const std::string& comment, const MatrixUnitcell& mat,
+                           const std::vector<unsigned int>& elnrs, const std::vector<Vec3>& positions,
+                           const std::array<unsigned int, 3>& grid_dimensions, size_t grid_offset);
+
+    /**
+     * @brief      grid of a scalar field
+     */
+    static fpt* get_grid(ScalarField* sf);
+
+    /**
+     * @brief      byte offset of the grid in the file
+     */
+    static size_t get_grid_offset(const ScalarField* sf);
+
+    /**
+     * @brief      read the next line of a buffer
+     *
+     * @param      p     current position; moved to the start of the next line
+     * @param[in]  end   end of the buffer
+     * @param      line  line (without line ending)
+     *
+     * @return     False when the end of the buffer has been reached
+     */
+    static bool next_line(const char*& p, const char* end, std::string& line);
+
+    /**
+     * @brief      split a line into whitespace-separated tokens
+     */
+    static std::vector<std::string> split(const std::string& line);
+
+    /**
+     * @brief      whether a token is a (signed) integer
+     */
+    static bool is_integer(const std::string& token);
+
+    /**
+     * @brief      whether a token is a floating point number
+     */
+    static bool is_number(const std::string& token);
+
+    /**
+     * @brief      read the header of a VASP file
+     */
+    static void read_vasp_header(ScalarField* sf);
+
+    /**
+     * @brief      read the grid of a VASP file
+     */
+    static void read_vasp_grid(ScalarField* sf);
+
+private:
+    /**
+     * @brief      registered readers, in order of precedence
+     */
+    static std::vector<std::unique_ptr<FieldReader>>& get_registry();
+};
+
+/**
+ * @brief      Reader for CHGCAR, LOCPOT and PARCHG files of VASP
+ */
+class VaspReader : public FieldReader {
+public:
+    const char* get_name() const override {
+        return "vasp";
+    }
+
+    bool sniff(const std::string& head) const override;
+
+    void read_header(ScalarField* sf) const override;
+
+    void read_grid(ScalarField* sf) const override;
+
+    bool has_fixed_layout() const override {
+        return true;
+    }
+
+    std::unique_ptr<SlabLoader> create_slab_loader(ScalarField* sf) const override;
+
+    bool has_spin_components() const override {
+        return true;
+    }
+
+    /**
+     * @brief      locate the grids of a VASP file
+     *
+     * Spin-polarized and non-collinear calculations store further grids
+     * (the magnetization densities) after the total density, each preceded
+     * by a repetition of the line holding the grid dimensions. Grids are
+     * skipped in their entirety using their fixed layout; only the
+     * (comparatively short) lines in between, e.g. the augmentation
+     * occupancies, are inspected.
+     *
+     * @param[in]  p             start of the first grid
+     * @param[in]  end           end of the file
+     * @param[in]  dims          grid dimensions
+     * @param      augmentation  set to whether augmentation occupancies are present (optional)
+     *
+     * @return     start of each grid
+     */
+    static std::vector<const char*> locate_grids(const char* p, const char* end,
+                                                 const std::array<unsigned int, 3>& dims,
+                                                 bool* augmentation = nullptr);
+
+    /**
+     * @brief      skip a grid of a VASP file
+     *
+     * When the grid is written in lines of fixed width, its end is computed
+     * directly; otherwise its values are tokenized one by one.
+     *
+     * @param[in]  p     start of the grid
+     * @param[in]  end   end of the file
+     * @param[in]  n     number of values in the grid
+     *
+     * @return     start of the line following the grid; nullptr if the grid
+     *             holds fewer than n values
+     */
+    static const char* skip_grid(const char* p, const char* end, size_t n);
+
+    /**
+     * @brief      parse the augmentation occupancies that follow a grid
+     *
+     * Every atom has a section starting with "augmentation occupancies",
+     * followed by the index of the atom and the number of occupancies.
+     * Parsing stops at the first line that does not start such a section.
+     *
+     * @param[in]  p         start of the line following the grid
+     * @param[in]  end       end of the file
+     * @param[in]  nr_atoms  number of atoms
+     *
+     * @return     occupancies per atom; empty for atoms without a section
+     */
+    static AugmentationOccupancies read_augmentation(const char* p, const char* end, unsigned int nr_atoms);
+};
+
+/**
+ * @brief      Reader for the native binary format (see BinaryField)
+ */
+class BinaryReader : public FieldReader {
+public:
+    const char* get_name() const override {
+        return "binary";
+    }
+
+    bool sniff(const std::string& head) const override;
+
+    void read_header(ScalarField* sf) const override;
+
+    void read_grid(ScalarField* sf) const override;
+};
+
+/**
+ * @brief      Reader for the lossy compressed format (see CompressedField)
+ *
+ * Decoding is much faster than parsing text and the decoded grid would take
+ * up many times the size of the file, so the grid is never cached.
+ */
+class CompressedReader : public FieldReader {
+public:
+    const char* get_name() const override {
+        return "compressed";
+    }
+
+    bool sniff(const std::string& head) const override;
+
+    void read_header(ScalarField* sf) const override;
+
+    void read_grid(ScalarField* sf) const override;
+
+    std::unique_ptr<SlabLoader> create_slab_loader(ScalarField* sf) const override;
+
+    bool is_cacheable() const override {
+        return false;
+    }
+};
+
+#endif // _FIELD_READER_H
@@ -0,0 +1,265 @@
+/**************************************************************************
+ *                                                                        *
+ *   Author: Ivo Filot <i.a.w.filot@tue.nl>                               *
+ *                                                                        *
+ *   EDP is free software:                                                *
+ *   you can redistribute it and/or modify it under the terms of the      *
+ *   GNU General Public License as published by the Free Software         *
+ *   Foundation, either version 3 of the License, or (at your option)     *
+ *   any later version.                                                   *
+ *                                                                        *
+ *   EDP is distributed in the hope that it will be useful,               *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty          *
+ *   of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.              *
+ *   See the GNU General Public License for more details.                 *
+ *                                                                        *
+ *   You should have received a copy of the GNU General Public License    *
+ *   along with this program.  If not, see http://www.gnu.org/licenses/.  *
+ *                                                                        *
+ **************************************************************************/
+
+#include "field_writer.h"
+#include "scalar_field.h"
+
+#include <charconv>
+#include <future>
+#include <vector>
+#include <boost/format.hpp>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+namespace {
+
+// number of lines that each thread formats per round
+static const size_t LINES_PER_CHUNK = 16384;
+
+/**
+ * @brief      format a single value in scientific notation
+ *
+ * @param      p          output position
+ * @param[in]  value      value
+ * @param[in]  width      (minimum) width of the field
+ * @param[in]  precision  number of digits after the decimal point
+ *
+ * @return     position after the field
+ */
+inline char* format_value(char* p, fpt value, size_t width, int precision) {
+    char tmp[32];
+    const auto result = std::to_chars(tmp, tmp + sizeof(tmp), value, std::chars_format::scientific, precision);
+    const size_t len = result.ptr - tmp;
+
+    // right-align; consecutive values are always separated by a space
+    const size_t pad = width > len ? width - len : 1;
+    std::memset(p, ' ', pad);
+    p += pad;
+    for(size_t i=0; i<len; i++) {
+        *p++ = tmp[i] == 'e' ? 'E' : tmp[i];
+    }
+    return p;
+}
+
+} // namespace
+
+/**
+ * @brief      write a scalar field as a CHGCAR (or LOCPOT) file
+ *
+ * For CHGCAR files, the grid is multiplied by the cell volume, which
+ * undoes the division performed when reading the file.
+ *
+ * @param[in]  sf        scalar field (grid should have been read)
+ * @param[in]  filename  path to the output file
+ */
+void FieldWriter::write_chgcar(const ScalarField& sf, const std::string& filename) {
+    if(!sf.has_read) {
+        throw std::runtime_error("Cannot write " + filename + "; the grid of " + sf.filename + " has not been read.");
+    }
+
+    std::ofstream outfile;
+    open(outfile, filename);
+
+    // the scaling factor has already been absorbed in the unit cell matrix
+    outfile << sf.comment << "\n";
+    outfile << "   1.00000000000000\n";
+    for(unsigned int i=0; i<3; i++) {
+        outfile << boost::format(" %12.6f%12.6f%12.6f\n") % sf.mat(i,0) % sf.mat(i,1) % sf.mat(i,2);
+    }
+    if(sf.vasp5_input) {
+        for(unsigned int elnr : sf.atom_charges) {
+            outfile << boost::format("%5s") % PeriodicTable::get().get_label_elnr(elnr);
+        }
+        outfile << "\n";
+    }
+    for(unsigned int n : sf.nrat) {
+        outfile << boost::format("%6i") % n;
+    }
+    outfile << "\nDirect\n";
+    for(const auto& pos : sf.atom_pos) {
+        outfile << boost::format("%10.6f%10.6f%10.6f\n") % pos[0] % pos[1] % pos[2];
+    }
+    outfile << "\n" << boost::format("%5i%5i%5i\n") % sf.grid_dimensions[0] % sf.grid_dimensions[1] % sf.grid_dimensions[2];
+
+    // VASP writes five values per line, running through the grid with x fastest
+    const fpt* grid = sf.get_grid_ptr();
+    const fpt multiplier = sf.flag_is_locpot ? 1.0f : sf.volume;
+    const Layout layout = {sf.gridptr.size(), 5, 18, 10};
+    write_block(outfile, sf.gridptr.size(), layout, [grid, multiplier](size_t i) {
+        return grid[i] * multiplier;
+    });
+
+    close(outfile, filename);
+}
+
+/**
+ * @brief      write a scalar field as a Gaussian cube file
+ *
+ * Lengths are converted to bohr and electron densities to electrons per
+ * cubic bohr; potentials are written as is.
+ *
+ * @param[in]  sf        scalar field (grid should have been read)
+ * @param[in]  filename  path to the output file
+ */
+void FieldWriter::write_cube(const ScalarField& sf, const std::string& filename) {
+    if(!sf.has_read) {
+        throw std::runtime_error("Cannot write " + filename + "; the grid of " + sf.filename + " has not been read.");
+    }
+
+    std::ofstream outfile;
+    open(outfile, filename);
+
+    const auto& dims = sf.grid_dimensions;
+    outfile << sf.comment << "\n";
+    outfile << (sf.flag_is_locpot ? "Potential" : "Electron density in e/bohr^3") << ", written by EDP\n";
+    outfile << boost::format("%5i%12.6f%12.6f%12.6f\n") % sf.atom_pos.size() % 0.0 % 0.0 % 0.0;
+    for(unsigned int i=0; i<3; i++) {
+        outfile << boost::format("%5i%12.6f%12.6f%12.6f\n") % dims[i]
+                   % (sf.mat(i,0) / dims[i] / BOHR) % (sf.mat(i,1) / dims[i] / BOHR) % (sf.mat(i,2) / dims[i] / BOHR);
+    }
+
+    // VASP4 files do not list the elements
+    unsigned int atid = 0;
+    for(unsigned int s=0; s<sf.nrat.size(); s++) {
+        const unsigned int elnr = s < sf.atom_charges.size() ? sf.atom_charges[s] : 0;
+        for(unsigned int a=0; a<sf.nrat[s] && atid<sf.atom_pos.size(); a++, atid++) {
+            const Vec3 pos = sf.get_atom_position(atid) / BOHR;
+            outfile << boost::format("%5i%12.6f%12.6f%12.6f%12.6f\n") % elnr % (double)elnr % pos[0] % pos[1] % pos[2];
+        }
+    }
+
+    // cube files run through the grid with z fastest and start a new line
+    // for every row along z
+    const fpt* grid = sf.get_grid_ptr();
+    const fpt multiplier = sf.flag_is_locpot ? 1.0 : BOHR * BOHR * BOHR;
+    const size_t nx = dims[0];
+    const size_t ny = dims[1];
+    const size_t nz = dims[2];
+    const Layout layout = {nz, 6, 13, 5};
+    write_block(outfile, sf.gridptr.size(), layout, [grid, multiplier, nx, ny, nz](size_t i) {
+        const size_t row = i / nz;
+        const size_t ix = row / ny;
+        const size_t iy = row % ny;
+        const size_t iz = i % nz;
+        return grid[ix + nx * (iy + ny * iz)] * multiplier;
+    });
+
+    close(outfile, filename);
+}
+
+/**
+ * @brief      format and write a numeric block
+ *
+ * @param      out         output stream
+ * @param[in]  n           total number of values
+ * @param[in]  layout      layout of the block
+ * @param[in]  value       function yielding the value of the i-th number in the block
+ */
+template<typename Value>
+void FieldWriter::write_block(std::ostream& out, size_t n, const Layout& layout, const Value& value) {
+    const size_t vpl = layout.values_per_line;
+    const size_t lines_per_record = (layout.record_length + vpl - 1) / vpl;
+    const size_t nr_lines = (n / layout.record_length) * lines_per_record;
+
+    // a value never exceeds precision + 7 characters ("-d.", "E+dd")
+    const size_t max_line_length = vpl * std::max<size_t>(layout.field_width, layout.precision + 8) + 1;
+
+#ifdef _OPENMP
+    const size_t nr_chunks = omp_get_max_threads();
+#else
+    const size_t nr_chunks = 1;
+#endif
+
+    // one round is being formatted while the previous one is being written
+    std::vector<std::string> buffers[2];
+    std::future<void> writer;
+    unsigned int current = 0;
+    for(size_t line=0; line<nr_lines; ) {
+        const size_t round_lines = std::min(nr_lines - line, nr_chunks * LINES_PER_CHUNK);
+        std::vector<std::string>& chunks = buffers[current];
+        chunks.resize(nr_chunks);
+
+        #pragma omp parallel for schedule(static)
+        for(size_t c=0; c<nr_chunks; c++) {
+            const size_t l0 = line + c * round_lines / nr_chunks;
+            const size_t l1 = line + (c + 1) * round_lines / nr_chunks;
+            std::string& buffer = chunks[c];
+            buffer.resize((l1 - l0) * max_line_length);
+            char* p = buffer.data();
+            for(size_t l=l0; l<l1; l++) {
+                const size_t offset = (l / lines_per_record) * layout.record_length;
+                const size_t j0 = (l % lines_per_record) * vpl;
+                const size_t j1 = std::min(j0 + vpl, layout.record_length);
+                for(size_t j=j0; j<j1; j++) {
+                    p = format_value(p, value(offset + j), layout.field_width, layout.precision);
+                }
+                *p++ = '\n';
+            }
+            buffer.resize(p - buffer.data());
+        }
+
+        if(writer.valid()) {
+            writer.get();
+        }
+        writer = std::async(std::launch::async, [&out, &chunks]() {
+            for(const auto& chunk : chunks) {
+                out.write(chunk.data(), chunk.size());
+            }
+        });
+
+        current = 1 - current;
+        line += round_lines;
+    }
+
+    if(writer.valid()) {
+        writer.get();
+    }
+}
+
+/**
+ * @brief      open the temporary file that is moved in place when complete
+ *
+ * @param      outfile   output stream
+ * @param[in]  filename  path to the output file
+ */
+void FieldWriter::open(std::ofstream& outfile, const std::string& filename) {
+    outfile.open(filename + ".part", std::ios::binary | std::ios::trunc);
+    if(!outfile.is_open()) {
+        throw std::runtime_error("Cannot open " + filename + ".part for writing!");
+    }
+}
+
+/**
+ * @brief      close the temporary file and move it in place
+ *
+ * @param      outfile   output stream
+ * @param[in]  filename  path to the output file
+ */
+void FieldWriter::close(std::ofstream& outfile, const std::string& filename) {
+    const std::string tmpfile = filename + ".part";
+    outfile.close();
+    if(!outfile) {
+        boost::filesystem::remove(tmpfile);
+        throw std::runtime_error("Error encountered in writing " + tmpfile);
+    }
+    boost::filesystem::rename(tmpfile, filename);
+}
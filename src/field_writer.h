@@ -0,0 +1,104 @@
+/**************************************************************************
+ *                                                                        *
+ *   Author: Ivo Filot <i.a.w.filot@tue.nl>                               *
+ *                                                                        *
+ *   EDP is free software:                                                *
+ *   you can redistribute it and/or modify it under the terms of the      *
+ *   GNU General Public License as published by the Free Software         *
+ *   Foundation, either version 3 of the License, or (at your option)     *
+ *   any later version.                                                   *
+ *                                                                        *
+ *   EDP is distributed in the hope that it will be useful,               *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty          *
+ *   of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.              *
+ *   See the GNU General Public License for more details.                 *
+ *                                                                        *
+ *   You should have received a copy of the GNU General Public License    *
+ *   along with this program.  If not, see http://www.gnu.org/licenses/.  *
+ *                                                                        *
+ **************************************************************************/
+
+#ifndef _FIELD_WRITER_H
+#define _FIELD_WRITER_H
+
+#include <string>
+#include <fstream>
+
+#include "math.h"
+
+class ScalarField;
+
+/**
+ * @brief      Writers for scalar fields in text formats of other programs
+ *
+ * The numeric block dominates the size of these files. It is formatted in
+ * parallel: every thread converts a contiguous range of lines into its own
+ * buffer using std::to_chars, after which the buffers are written out in
+ * order while the next range is being formatted.
+ */
+class FieldWriter {
+public:
+    static constexpr double BOHR = 0.529177210903;     // Bohr radius in angstrom
+
+    /**
+     * @brief      write a scalar field as a CHGCAR (or LOCPOT) file
+     *
+     * For CHGCAR files, the grid is multiplied by the cell volume, which
+     * undoes the division performed when reading the file.
+     *
+     * @param[in]  sf        scalar field (grid should have been read)
+     * @param[in]  filename  path to the output file
+     */
+    static void write_chgcar(const ScalarField& sf, const std::string& filename);
+
+    /**
+     * @brief      write a scalar field as a Gaussian cube file
+     *
+     * Lengths are converted to bohr and electron densities to electrons per
+     * cubic bohr; potentials are written as is.
+     *
+     * @param[in]  sf        scalar field (grid should have been read)
+     * @param[in]  filename  path to the output file
+     */
+    static void write_cube(const ScalarField& sf, const std::string& filename);
+
+private:
+    /**
+     * @brief      layout of the numeric block
+     */
+    struct Layout {
+        size_t record_length;       // number of values after which a line is always ended
+        size_t values_per_line;
+        size_t field_width;         // number of characters per value (right-aligned)
+        int precision;              // number of digits after the decimal point
+    };
+
+    /**
+     * @brief      format and write a numeric block
+     *
+     * @param      out         output stream
+     * @param[in]  n           total number of values
+     * @param[in]  layout      layout of the block
+     * @param[in]  value       function yielding the value of the i-th number in the block
+     */
+    template<typename Value>
+    static void write_block(std::ostream& out, size_t n, const Layout& layout, const Value& value);
+
+    /**
+     * @brief      open the temporary file that is moved in place when complete
+     *
+     * @param      outfile   output stream
+     * @param[in]  filename  path to the output file
+     */
+    static void open(std::ofstream& outfile, const std::string& filename);
+
+    /**
+     * @brief      close the temporary file and move it in place
+     *
+     * @param      outfile   output stream
+     * @param[in]  filename  path to the output file
+     */
+    static void close(std::ofstream& outfile, const std::string& filename);
+};
+
+#endif // _FIELD_WRITER_H
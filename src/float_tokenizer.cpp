@@ -0,0 +1,285 @@
+/**************************************************************************
+ *                                                                        *
+ *   Author: Ivo Filot <i.a.w.filot@tue.nl>                               *
+ *                                                                        *
+ *   EDP is free software:                                                *
+ *   you can redistribute it and/or modify it under the terms of the      *
+ *   GNU General Public License as published by the Free Software         *
+ *   Foundation, either version 3 of the License, or (at your option)     *
+ *   any later version.                                                   *
+ *                                                                        *
+ *   EDP is distributed in the hope that it will be useful,               *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty          *
+ *   of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.              *
+ *   See the GNU General Public License for more details.                 *
+ *                                                                        *
+ *   You should have received a copy of the GNU General Public License    *
+ *   along with this program.  If not, see http://www.gnu.org/licenses/.  *
+ *                                                                        *
+ **************************************************************************/
+
+#include "float_tokenizer.h"
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+// blocks smaller than this are not worth distributing over threads
+static const size_t PARALLEL_THRESHOLD = 1 << 16;
+
+/**
+ * @brief      parse a block of numbers using all available threads
+ *
+ * @param      p        current position; advanced past the last number read
+ * @param[in]  end      end of buffer
+ * @param      out      output array (should hold at least n values)
+ * @param[in]  n        number of values to read
+ * @param[in]  divisor  value by which each number is divided
+ *
+ * @return     number of values that have been read
+ */
+size_t FloatTokenizer::parse_block_parallel(const char*& p, const char* end, fpt* out, size_t n, fpt divisor) {
+#ifdef _OPENMP
+    if(n < PARALLEL_THRESHOLD || omp_get_max_threads() == 1) {
+        return parse_block(p, end, out, n, divisor);
+    }
+
+    if(parse_fixed_width(p, end, out, n, divisor)) {
+        return n;
+    }
+
+    return parse_prefix_count(p, end, out, n, divisor);
+#else
+    return parse_block(p, end, out, n, divisor);
+#endif
+}
+
+/**
+ * @brief      establish whether a block of n values has a fixed layout
+ *
+ * @param[in]  p                begin of block (start of a line)
+ * @param[in]  end              end of buffer
+ * @param[in]  n                number of values in the block
+ * @param      line_width       number of bytes per line (including line ending)
+ * @param      values_per_line  number of values per line
+ *
+ * @return     whether the block has a fixed layout
+ */
+bool FloatTokenizer::detect_fixed_layout(const char* p, const char* end, size_t n,
+                                         size_t* line_width, size_t* values_per_line) {
+    const char* eol = static_cast<const char*>(memchr(p, '\n', end - p));
+    if(eol == nullptr) {
+        return false;
+    }
+    const size_t width = eol - p + 1;
+
+    // count the values on the first line
+    size_t nvals = 0;
+    const char* q = p;
+    double value;
+    while(q < eol && parse(q, eol, value)) {
+        nvals++;
+    }
+    if(nvals == 0 || skip_whitespace(q, eol) != eol) {
+        return false;
+    }
+
+    // all full lines should end at a multiple of the line width
+    const size_t nlines = n / nvals;
+    if(nlines == 0 || (size_t)(end - p) < nlines * width) {
+        return false;
+    }
+
+    // probe a number of line endings spread over the block, which catches
+    // any deviation in the line width
+    static const size_t NPROBES = 1024;
+    for(size_t i=0; i<=NPROBES; i++) {
+        const size_t line = 1 + i * (nlines - 1) / NPROBES;
+        if(p[line * width - 1] != '\n') {
+            return false;
+        }
+    }
+
+    *line_width = width;
+    *values_per_line = nvals;
+    return true;
+}
+
+/**
+ * @brief      parse a block wherein every line has the same width
+ *
+ * @return     whether the block could be parsed using the fixed layout
+ */
+bool FloatTokenizer::parse_fixed_width(const char*& p, const char* end, fpt* out, size_t n, fpt divisor) {
+    size_t width = 0;
+    size_t nvals = 0;
+    if(!detect_fixed_layout(p, end, n, &width, &nvals)) {
+        return false;
+    }
+
+    // the (partially filled) final line is assigned to the last chunk
+    const size_t nlines = (n + nvals - 1) / nvals;
+    const size_t nchunks = std::min<size_t>(nlines, omp_get_max_threads() * 8);
+    const char* begin = p;
+    bool success = true;
+    const char* block_end = begin;
+
+    #pragma omp parallel for schedule(dynamic) reduction(&&:success)
+    for(size_t c=0; c<nchunks; c++) {
+        const size_t l0 = c * nlines / nchunks;
+        const size_t l1 = (c + 1) * nlines / nchunks;
+        const size_t i0 = l0 * nvals;
+        const size_t i1 = std::min(l1 * nvals, n);
+
+        const char* q = begin + l0 * width;
+        const char* chunk_end = std::min(begin + l1 * width, end);
+        if(parse_block(q, chunk_end, out + i0, i1 - i0, divisor) != i1 - i0) {
+            success = false;
+            continue;
+        }
+
+        // the chunk should have been consumed up to its final line ending
+        if(c + 1 < nchunks && skip_whitespace(q, chunk_end) != chunk_end) {
+            success = false;
+        }
+
+        if(c + 1 == nchunks) {
+            block_end = q;
+        }
+    }
+
+    if(success) {
+        p = block_end;
+    }
+    return success;
+}
+
+/**
+ * @brief      parse a block using a token-counting pass and prefix sum
+ *
+ * @return     number of values that have been read
+ */
+size_t FloatTokenizer::parse_prefix_count(const char*& p, const char* end, fpt* out, size_t n, fpt divisor) {
+    const char* begin = p;
+    const unsigned int nthreads = omp_get_max_threads();
+
+    // estimate the extent of the block from its first line to avoid having
+    // to count the remainder of the file (e.g. a second spin block)
+    const char* eol = static_cast<const char*>(memchr(begin, '\n', end - begin));
+    size_t window = end - begin;
+    if(eol != nullptr) {
+        const size_t nfirst = std::max<size_t>(1, count_numbers(begin, eol));
+        window = std::min(window, (size_t)((eol - begin + 1) * 1.25 * n / nfirst) + 4096);
+    }
+
+    while(true) {
+        // let the window end on a line boundary such that no number is cut
+        const char* window_end = begin + window;
+        if(window_end < end) {
+            const char* nl = static_cast<const char*>(memchr(window_end, '\n', end - window_end));
+            window_end = nl == nullptr ? end : nl + 1;
+        }
+
+        // cut the window into chunks at line boundaries
+        const size_t nchunks = nthreads * 8;
+        std::vector<const char*> bounds(nchunks + 1);
+        bounds[0] = begin;
+        for(size_t c=1; c<nchunks; c++) {
+            const char* q = std::max(bounds[c-1], begin + c * window / nchunks);
+            const char* nl = q < window_end ? static_cast<const char*>(memchr(q, '\n', window_end - q)) : nullptr;
+            bounds[c] = nl == nullptr ? window_end : nl + 1;
+        }
+        bounds[nchunks] = window_end;
+
+        // count the number of values per chunk
+        std::vector<size_t> offsets(nchunks + 1, 0);
+        #pragma omp parallel for schedule(dynamic)
+        for(size_t c=0; c<nchunks; c++) {
+            offsets[c+1] = count_numbers(bounds[c], bounds[c+1]);
+        }
+        for(size_t c=0; c<nchunks; c++) {
+            offsets[c+1] += offsets[c];
+        }
+
+        // grow the window when it turns out to be too small
+        if(offsets[nchunks] < n && window_end != end) {
+            window = end - begin;
+            continue;
+        }
+
+        // parse the chunks that overlap with the first n values
+        std::vector<size_t> nread(nchunks, 0);
+        const char* block_end = begin;
+        #pragma omp parallel for schedule(dynamic)
+        for(size_t c=0; c<nchunks; c++) {
+            if(offsets[c] >= n) {
+                continue;
+            }
+            const size_t count = std::min(offsets[c+1], n) - offsets[c];
+            const char* q = bounds[c];
+            nread[c] = parse_block(q, bounds[c+1], out + offsets[c], count, divisor);
+            if(offsets[c+1] >= n) {
+                block_end = q;
+            }
+        }
+
+        // values are only valid up to the first chunk that fell short
+        size_t total = 0;
+        for(size_t c=0; c<nchunks && offsets[c] < n; c++) {
+            total += nread[c];
+            if(nread[c] != std::min(offsets[c+1], n) - offsets[c]) {
+                p = bounds[c];
+                return total;
+            }
+        }
+
+        p = total == n ? block_end : bounds[nchunks];
+        return total;
+    }
+}
+
+/**
+ * @brief      count the numbers in a buffer without converting them
+ *
+ * A new number starts after whitespace or at a sign that does not belong
+ * to an exponent. As in parse(), a sign directly following the digits of a
+ * mantissa is taken to be the start of a (marker-less) exponent.
+ *
+ * @param[in]  p     begin of buffer
+ * @param[in]  end   end of buffer
+ *
+ * @return     number of numbers
+ */
+size_t FloatTokenizer::count_numbers(const char* p, const char* end) {
+    size_t count = 0;
+    bool in_number = false;
+    bool has_exponent = false;
+    char prev = ' ';
+
+    for(; p < end; ++p) {
+        const char c = *p;
+        if(c == ' ' || c == '\n' || c == '\r' || c == '\t') {
+            in_number = false;
+        } else if(!in_number) {
+            in_number = true;
+            has_exponent = false;
+            count++;
+        } else if(c == 'E' || c == 'e' || c == 'D' || c == 'd') {
+            has_exponent = true;
+        } else if((c == '-' || c == '+') && prev != 'E' && prev != 'e' && prev != 'D' && prev != 'd') {
+            if(has_exponent) {
+                has_exponent = false;
+                count++;
+            } else {
+                has_exponent = true;
+            }
+        }
+        prev = c;
+    }
+
+    return count;
+}
@@ -0,0 +1,271 @@
+/**************************************************************************
+ *                                                                        *
+ *   Author: Ivo Filot <i.a.w.filot@tue.nl>                               *
+ *                                                                        *
+ *   EDP is free software:                                                *
+ *   you can redistribute it and/or modify it under the terms of the      *
+ *   GNU General Public License as published by the Free Software         *
+ *   Foundation, either version 3 of the License, or (at your option)     *
+ *   any later version.                                                   *
+ *                                                                        *
+ *   EDP is distributed in the hope that it will be useful,               *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty          *
+ *   of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.              *
+ *   See the GNU General Public License for more details.                 *
+ *                                                                        *
+ *   You should have received a copy of the GNU General Public License    *
+ *   along with this program.  If not, see http://www.gnu.org/licenses/.  *
+ *                                                                        *
+ **************************************************************************/
+
+#ifndef _FLOAT_TOKENIZER_H
+#define _FLOAT_TOKENIZER_H
+
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <cstddef>
+
+#include "math.h"
+
+/**
+ * @brief      Scanner for the Fortran-formatted floating point numbers
+ *             found in the volumetric data blocks of VASP files
+ *
+ * Numbers are parsed straight from a character buffer without any
+ * intermediate allocations. The scanner accepts the usual decimal notation
+ * including 'E' and 'D' exponent markers, as well as the Fortran convention
+ * wherein the exponent marker is dropped for three-digit exponents
+ * (e.g. 0.12345678901-100). Consecutive numbers do not need to be separated
+ * by whitespace as long as the second one starts with a sign.
+ */
+class FloatTokenizer {
+private:
+    static constexpr int POW_MIN = -400;
+    static constexpr int POW_MAX = 400;
+
+public:
+    /**
+     * @brief      skip whitespace (spaces, tabs and line endings)
+     *
+     * @param[in]  p     current position
+     * @param[in]  end   end of buffer
+     *
+     * @return     position of first non-whitespace character
+     */
+    static inline const char* skip_whitespace(const char* p, const char* end) {
+        while(p < end && (*p == ' ' || *p == '\n' || *p == '\r' || *p == '\t')) {
+            ++p;
+        }
+        return p;
+    }
+
+    /**
+     * @brief      parse a single number
+     *
+     * @param      p      current position; advanced past the number on success
+     * @param[in]  end    end of buffer
+     * @param      value  parsed value
+     *
+     * @return     whether a number could be parsed
+     */
+    static inline bool parse(const char*& p, const char* end, double& value) {
+        const char* s = skip_whitespace(p, end);
+
+        bool negative = false;
+        if(s < end && (*s == '-' || *s == '+')) {
+            negative = (*s == '-');
+            ++s;
+        }
+
+        // accumulate up to 19 significant digits in an integer mantissa
+        uint64_t mantissa = 0;
+        int exponent = 0;
+        unsigned int ndigits = 0;
+        while(s < end && (unsigned int)(*s - '0') < 10) {
+            if(mantissa < 1000000000000000000ULL) {
+                mantissa = mantissa * 10 + (*s - '0');
+            } else {
+                exponent++;
+            }
+            ++s;
+            ++ndigits;
+        }
+        if(s < end && *s == '.') {
+            ++s;
+            while(s < end && (unsigned int)(*s - '0') < 10) {
+                if(mantissa < 1000000000000000000ULL) {
+                    mantissa = mantissa * 10 + (*s - '0');
+                    exponent--;
+                }
+                ++s;
+                ++ndigits;
+            }
+        }
+
+        if(ndigits == 0) {
+            return false;
+        }
+
+        // exponent; the marker is optional when directly followed by a sign
+        if(s < end && (*s == 'E' || *s == 'e' || *s == 'D' || *s == 'd')) {
+            ++s;
+        } else if(!(s + 1 < end && (*s == '-' || *s == '+') && (unsigned int)(s[1] - '0') < 10)) {
+            value = to_double(negative, mantissa, exponent);
+            p = s;
+            return true;
+        }
+
+        bool negative_exponent = false;
+        if(s < end && (*s == '-' || *s == '+')) {
+            negative_exponent = (*s == '-');
+            ++s;
+        }
+        if(s >= end || (unsigned int)(*s - '0') >= 10) {
+            return false;
+        }
+        int e = 0;
+        while(s < end && (unsigned int)(*s - '0') < 10) {
+            if(e < 10000) {
+                e = e * 10 + (*s - '0');
+            }
+            ++s;
+        }
+        exponent += negative_exponent ? -e : e;
+
+        value = to_double(negative, mantissa, exponent);
+        p = s;
+        return true;
+    }
+
+    /**
+     * @brief      parse a block of numbers and divide them by a constant
+     *
+     * The division is fused into the parsing such that the values do not
+     * have to be visited a second time.
+     *
+     * @param      p        current position; advanced past the last number read
+     * @param[in]  end      end of buffer
+     * @param      out      output array (should hold at least n values)
+     * @param[in]  n        number of values to read
+     * @param[in]  divisor  value by which each number is divided
+     *
+     * @return     number of values that have been read
+     */
+    static inline size_t parse_block(const char*& p, const char* end, fpt* out, size_t n, fpt divisor) {
+        size_t i = 0;
+        double value = 0.0;
+        while(i < n && parse(p, end, value)) {
+            out[i++] = (fpt)value / divisor;
+        }
+        return i;
+    }
+
+    /**
+     * @brief      parse a block of numbers using all available threads
+     *
+     * The block is cut into chunks at line boundaries which are parsed
+     * concurrently, each chunk writing directly into its final position in
+     * the output array. When all lines have the same width and hold the same
+     * number of values (as is the case for the fixed-format blocks written by
+     * VASP), the starting index of each chunk follows from its byte offset.
+     * Otherwise, the number of values per chunk is established first and the
+     * starting indices are obtained from a prefix sum.
+     *
+     * @param      p        current position; advanced past the last number read
+     * @param[in]  end      end of buffer
+     * @param      out      output array (should hold at least n values)
+     * @param[in]  n        number of values to read
+     * @param[in]  divisor  value by which each number is divided
+     *
+     * @return     number of values that have been read
+     */
+    static size_t parse_block_parallel(const char*& p, const char* end, fpt* out, size_t n, fpt divisor);
+
+    /**
+     * @brief      establish whether a block of n values has a fixed layout
+     *
+     * The layout is taken from the first line of the block and is verified
+     * by checking that the line endings are found at the expected positions
+     * throughout the block.
+     *
+     * @param[in]  p                begin of block (start of a line)
+     * @param[in]  end              end of buffer
+     * @param[in]  n                number of values in the block
+     * @param      line_width       number of bytes per line (including line ending)
+     * @param      values_per_line  number of values per line
+     *
+     * @return     whether the block has a fixed layout
+     */
+    static bool detect_fixed_layout(const char* p, const char* end, size_t n,
+                                    size_t* line_width, size_t* values_per_line);
+
+private:
+    /**
+     * @brief      parse a block wherein every line has the same width
+     *
+     * @return     whether the block could be parsed using the fixed layout
+     */
+    static bool parse_fixed_width(const char*& p, const char* end, fpt* out, size_t n, fpt divisor);
+
+    /**
+     * @brief      parse a block using a token-counting pass and prefix sum
+     *
+     * @return     number of values that have been read
+     */
+    static size_t parse_prefix_count(const char*& p, const char* end, fpt* out, size_t n, fpt divisor);
+
+    /**
+     * @brief      count the numbers in a buffer without converting them
+     *
+     * @param[in]  p     begin of buffer
+     * @param[in]  end   end of buffer
+     *
+     * @return     number of numbers
+     */
+    static size_t count_numbers(const char* p, const char* end);
+
+    /**
+     * @brief      combine sign, mantissa and base-10 exponent into a double
+     */
+    static inline double to_double(bool negative, uint64_t mantissa, int exponent) {
+        // exactly representable powers of ten give a correctly rounded result
+        static constexpr double exact[] = {
+            1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+            1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+        };
+
+        double value = (double)mantissa;
+        if(mantissa == 0) {
+            // nothing to scale
+        } else if(exponent < 0 && exponent >= -22) {
+            value /= exact[-exponent];
+        } else if(exponent >= 0 && exponent <= 22) {
+            value *= exact[exponent];
+        } else if(exponent < POW_MIN) {
+            value = 0.0;
+        } else if(exponent > POW_MAX) {
+            value = HUGE_VAL;
+        } else {
+            value *= get_powers()[exponent - POW_MIN];
+        }
+
+        return negative ? -value : value;
+    }
+
+    /**
+     * @brief      table of powers of ten for exponents outside of the exact range
+     */
+    static const double* get_powers() {
+        static const std::array<double, POW_MAX - POW_MIN + 1> powers = [] {
+            std::array<double, POW_MAX - POW_MIN + 1> p;
+            for(int i=POW_MIN; i<=POW_MAX; i++) {
+                p[i - POW_MIN] = std::pow(10.0, (double)i);
+            }
+            return p;
+        }();
+        return powers.data();
+    }
+};
+
+#endif // _FLOAT_TOKENIZER_H
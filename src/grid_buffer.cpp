@@ -0,0 +1,187 @@
+/**************************************************************************
+ *                                                                        *
+ *   Author: Ivo Filot <i.a.w.filot@tue.nl>                               *
+ *                                                                        *
+ *   EDP is free software:                                                *
+ *   you can redistribute it and/or modify it under the terms of the      *
+ *   GNU General Public License as published by the Free Software         *
+ *   Foundation, either version 3 of the License, or (at your option)     *
+ *   any later version.                                                   *
+ *                                                                        *
+ *   EDP is distributed in the hope that it will be useful,               *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty          *
+ *   of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.              *
+ *   See the GNU General Public License for more details.                 *
+ *                                                                        *
+ *   You should have received a copy of the GNU General Public License    *
+ *   along with this program.  If not, see http://www.gnu.org/licenses/.  *
+ *                                                                        *
+ **************************************************************************/
+
+#include "grid_buffer.h"
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <sys/mman.h>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+// align the values to a cache line to allow for aligned vector loads
+static const size_t GRID_ALIGNMENT = 64;
+
+// blocks of at least a huge page are mapped rather than allocated on the heap
+static const size_t HUGE_PAGE_SIZE = 2 * 1024 * 1024;
+
+namespace {
+
+/**
+ * @brief      map anonymous memory, backed by huge pages where possible
+ *
+ * @param[in]  size  size in bytes (a multiple of HUGE_PAGE_SIZE)
+ *
+ * @return     start of the memory (aligned to HUGE_PAGE_SIZE)
+ */
+void* map_pages(size_t size) {
+#ifdef MAP_HUGETLB
+    if(getenv("EDP_HUGETLB") != nullptr) {
+        void* mem = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if(mem != MAP_FAILED) {
+            return mem;
+        }
+    }
+#endif
+
+    // transparent huge pages require the memory to be aligned to a huge
+    // page, so map an extra huge page and trim both ends
+    void* mem = mmap(nullptr, size + HUGE_PAGE_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if(mem == MAP_FAILED) {
+        return nullptr;
+    }
+    const uintptr_t start = reinterpret_cast<uintptr_t>(mem);
+    const uintptr_t aligned = (start + HUGE_PAGE_SIZE - 1) & ~(uintptr_t)(HUGE_PAGE_SIZE - 1);
+    if(aligned > start) {
+        munmap(mem, aligned - start);
+    }
+    if(start + HUGE_PAGE_SIZE > aligned) {
+        munmap(reinterpret_cast<void*>(aligned + size), start + HUGE_PAGE_SIZE - aligned);
+    }
+#ifdef MADV_HUGEPAGE
+    madvise(reinterpret_cast<void*>(aligned), size, MADV_HUGEPAGE);
+#endif
+    return reinterpret_cast<void*>(aligned);
+}
+
+/**
+ * @brief      zero a block of values, each thread taking the range that a
+ *             static schedule assigns to it
+ *
+ * @param      ptr   values
+ * @param[in]  n     number of values
+ */
+void first_touch(fpt* ptr, size_t n) {
+    #pragma omp parallel
+    {
+#ifdef _OPENMP
+        const size_t t = omp_get_thread_num();
+        const size_t nt = omp_get_num_threads();
+#else
+        const size_t t = 0;
+        const size_t nt = 1;
+#endif
+        const size_t begin = n * t / nt;
+        const size_t end = n * (t + 1) / nt;
+        std::memset(ptr + begin, 0, (end - begin) * sizeof(fpt));
+    }
+}
+
+} // namespace
+
+/**
+ * @brief      construct an empty buffer
+ */
+GridBuffer::GridBuffer() {
+    this->ptr = nullptr;
+    this->n = 0;
+    this->reserved = 0;
+}
+
+/**
+ * @brief      allocate memory for a number of values
+ *
+ * @param[in]  _n     number of values
+ * @param[in]  touch  whether to zero the values in parallel
+ */
+void GridBuffer::allocate(size_t _n, bool touch) {
+    this->clear();
+
+    if(_n == 0) {
+        return;
+    }
+
+    void* mem = nullptr;
+    const size_t bytes = _n * sizeof(fpt);
+    if(bytes >= HUGE_PAGE_SIZE) {
+        const size_t size = (bytes + HUGE_PAGE_SIZE - 1) / HUGE_PAGE_SIZE * HUGE_PAGE_SIZE;
+        mem = map_pages(size);
+        if(mem != nullptr) {
+            this->reserved = size;
+        }
+    } else if(posix_memalign(&mem, GRID_ALIGNMENT, bytes) != 0) {
+        mem = nullptr;
+    }
+    if(mem == nullptr) {
+        throw std::runtime_error("Could not allocate memory for " + std::to_string(_n) + " grid points.");
+    }
+    this->ptr = static_cast<fpt*>(mem);
+    this->n = _n;
+
+    if(touch) {
+        first_touch(this->ptr, this->n);
+    }
+}
+
+/**
+ * @brief      use values stored in a memory-mapped file
+ *
+ * @param[in]  mf      mapped file
+ * @param[in]  offset  byte offset of the first value in the file
+ * @param[in]  _n      number of values
+ */
+void GridBuffer::map(const std::shared_ptr<MappedFile>& mf, size_t offset, size_t _n) {
+    if(offset + _n * sizeof(fpt) > mf->size()) {
+        throw std::runtime_error(mf->get_filename() + " is too small to hold " + std::to_string(_n) + " grid points.");
+    }
+    if(offset % sizeof(fpt) != 0) {
+        throw std::runtime_error("Grid points in " + mf->get_filename() + " are not aligned.");
+    }
+
+    this->clear();
+    this->mapping = mf;
+    this->ptr = const_cast<fpt*>(reinterpret_cast<const fpt*>(mf->data() + offset));
+    this->n = _n;
+}
+
+/**
+ * @brief      release the values
+ */
+void GridBuffer::clear() {
+    if(this->reserved > 0) {
+        munmap(this->ptr, this->reserved);
+    } else if(!this->mapping) {
+        free(this->ptr);
+    }
+    this->mapping.reset();
+    this->ptr = nullptr;
+    this->n = 0;
+    this->reserved = 0;
+}
+
+/**
+ * @brief      release the values
+ */
+GridBuffer::~GridBuffer() {
+    this->clear();
+}
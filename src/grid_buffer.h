@@ -0,0 +1,117 @@
+/**************************************************************************
+ *                                                                        *
+ *   Author: Ivo Filot <i.a.w.filot@tue.nl>                               *
+ *                                                                        *
+ *   EDP is free software:                                                *
+ *   you can redistribute it and/or modify it under the terms of the      *
+ *   GNU General Public License as published by the Free Software         *
+ *   Foundation, either version 3 of the License, or (at your option)     *
+ *   any later version.                                                   *
+ *                                                                        *
+ *   EDP is distributed in the hope that it will be useful,               *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty          *
+ *   of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.              *
+ *   See the GNU General Public License for more details.                 *
+ *                                                                        *
+ *   You should have received a copy of the GNU General Public License    *
+ *   along with this program.  If not, see http://www.gnu.org/licenses/.  *
+ *                                                                        *
+ **************************************************************************/
+
+#ifndef _GRID_BUFFER_H
+#define _GRID_BUFFER_H
+
+#include <memory>
+#include <stdexcept>
+
+#include "math.h"
+#include "mapped_file.h"
+
+/**
+ * @brief      Storage for the values of a scalar field
+ *
+ * The values either live in an (aligned) block of memory owned by the
+ * buffer or directly in a memory-mapped file, in which case no copy of
+ * the data is made. In the latter case, the values are read-only.
+ *
+ * Large blocks are mapped at a huge page boundary and transparent huge
+ * pages are requested for them; when the environment variable EDP_HUGETLB
+ * is set, (reserved) huge pages are used instead if available. The pages
+ * of a block are touched first by all threads in a static schedule, such
+ * that on NUMA systems they are spread over the memory of the sockets in
+ * the same way as the loops over the grid are spread over the threads.
+ */
+class GridBuffer {
+private:
+    fpt* ptr;
+    size_t n;
+    size_t reserved;        // size of the mapped memory in bytes; 0 if allocated on the heap
+    std::shared_ptr<MappedFile> mapping;
+
+public:
+    /**
+     * @brief      construct an empty buffer
+     */
+    GridBuffer();
+
+    GridBuffer(const GridBuffer&) = delete;
+    GridBuffer& operator=(const GridBuffer&) = delete;
+
+    /**
+     * @brief      allocate memory for a number of values
+     *
+     * @param[in]  _n     number of values
+     * @param[in]  touch  whether to zero the values in parallel (see above);
+     *                    otherwise the values are uninitialized
+     */
+    void allocate(size_t _n, bool touch = true);
+
+    /**
+     * @brief      use values stored in a memory-mapped file
+     *
+     * @param[in]  mf      mapped file
+     * @param[in]  offset  byte offset of the first value in the file
+     * @param[in]  _n      number of values
+     */
+    void map(const std::shared_ptr<MappedFile>& mf, size_t offset, size_t _n);
+
+    /**
+     * @brief      release the values
+     */
+    void clear();
+
+    inline fpt* data() {
+        return this->ptr;
+    }
+
+    inline const fpt* data() const {
+        return this->ptr;
+    }
+
+    inline size_t size() const {
+        return this->n;
+    }
+
+    inline bool empty() const {
+        return this->n == 0;
+    }
+
+    inline bool is_mapped() const {
+        return (bool)this->mapping;
+    }
+
+    inline fpt operator[](size_t idx) const {
+        return this->ptr[idx];
+    }
+
+    inline fpt& operator[](size_t idx) {
+        return this->ptr[idx];
+    }
+
+    /**
+     * @brief      release the values
+     */
+    ~GridBuffer();
+};
+
+#endif // _GRID_BUFFER_H
@@ -0,0 +1,205 @@
+/**************************************************************************
+ *                                                                        *
+ *   Author: Ivo Filot <i.a.w.filot@tue.nl>                               *
+ *                                                                        *
+ *   EDP is free software:                                                *
+ *   you can redistribute it and/or modify it under the terms of the      *
+ *   GNU General Public License as published by the Free Software         *
+ *   Foundation, either version 3 of the License, or (at your option)     *
+ *   any later version.                                                   *
+ *                                                                        *
+ *   EDP is distributed in the hope that it will be useful,               *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty          *
+ *   of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.              *
+ *   See the GNU General Public License for more details.                 *
+ *                                                                        *
+ *   You should have received a copy of the GNU General Public License    *
+ *   along with this program.  If not, see http://www.gnu.org/licenses/.  *
+ *                                                                        *
+ **************************************************************************/
+
+#include "grid_cache.h"
+#include "binary_field.h"
+#include "scalar_field.h"
+#include "tar_archive.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <ctime>
+#include <vector>
+#include <boost/format.hpp>
+
+/**
+ * @brief      get the path of the cache entry for a file
+ *
+ * @param[in]  filename   path to the source file
+ * @param[in]  extension  extension of the cache entry
+ *
+ * @return     path to the cache entry; empty if the file cannot be cached
+ */
+std::string GridCache::locate(const std::string& filename, const std::string& extension) {
+    if(getenv("EDP_NO_CACHE") != nullptr) {
+        return "";
+    }
+
+    std::string archive, member;
+    const bool is_member = TarArchive::split(filename, &archive, &member);
+
+    boost::system::error_code ec;
+    const boost::filesystem::path path = boost::filesystem::canonical(is_member ? archive : filename, ec);
+    if(ec || !boost::filesystem::is_regular_file(path, ec)) {
+        return "";
+    }
+
+    const char* cachedir = getenv("EDP_CACHE_DIR");
+    if(cachedir != nullptr && cachedir[0] != '\0') {
+        // name the entry after a (FNV-1a) hash of the absolute path
+        const std::string key = is_member ? path.string() + ":" + member : path.string();
+        uint64_t hash = 14695981039346656037ULL;
+        for(char c : key) {
+            hash = (hash ^ (unsigned char)c) * 1099511628211ULL;
+        }
+        return (boost::filesystem::path(cachedir) /
+                ((boost::format("%016x") % hash).str() + extension)).string();
+    }
+
+    std::string name = "." + path.filename().string();
+    if(is_member) {
+        std::string flat = member;
+        std::replace(flat.begin(), flat.end(), '/', '_');
+        name += "#" + flat;
+    }
+    return (path.parent_path() / (name + extension)).string();
+}
+
+/**
+ * @brief      check whether a cache entry is valid for a file
+ *
+ * @param[in]  cachefile  path to the cache entry
+ * @param[in]  filename   path to the source file
+ * @param[in]  is_locpot  whether the source file is read as a LOCPOT
+ *
+ * @return     True if valid, False otherwise.
+ */
+bool GridCache::is_valid(const std::string& cachefile, const std::string& filename, bool is_locpot) {
+    try {
+        if(!BinaryField::probe(cachefile)) {
+            return false;
+        }
+
+        const BinaryField::Header header = BinaryField::read_file_header(cachefile);
+        const std::string source = TarArchive::get_source(filename);
+        return header.source_size == boost::filesystem::file_size(source) &&
+               header.source_mtime == BinaryField::get_mtime(source) &&
+               (bool)(header.flags & BinaryField::FLAG_LOCPOT) == is_locpot;
+    } catch(const std::exception&) {
+        return false;
+    }
+}
+
+/**
+ * @brief      mark a cache entry as recently used
+ *
+ * @param[in]  cachefile  path to the cache entry
+ */
+void GridCache::touch(const std::string& cachefile) {
+    // the modification time of the entry itself serves as its LRU stamp
+    boost::system::error_code ec;
+    boost::filesystem::last_write_time(cachefile, std::time(nullptr), ec);
+}
+
+/**
+ * @brief      store the grid of a scalar field in the cache
+ *
+ * Errors are silently ignored; a failure to write the cache should
+ * never interfere with the program.
+ *
+ * @param[in]  sf         scalar field
+ * @param[in]  cachefile  path to the cache entry
+ */
+void GridCache::store(const ScalarField& sf, const std::string& cachefile) {
+    try {
+        const boost::filesystem::path directory = boost::filesystem::path(cachefile).parent_path();
+        boost::filesystem::create_directories(directory);
+        BinaryField::write(sf, cachefile);
+        evict(directory.string(), get_max_size());
+    } catch(const std::exception&) {
+        // the cache is merely an optimization
+    }
+}
+
+/**
+ * @brief      evict the least recently used entries from a directory
+ *
+ * @param[in]  directory  cache directory
+ * @param[in]  max_size   maximum total size of the entries in bytes
+ */
+void GridCache::evict(const std::string& directory, uint64_t max_size) {
+    struct Entry {
+        boost::filesystem::path path;
+        uint64_t size;
+        std::time_t last_used;
+    };
+
+    std::vector<Entry> entries;
+    uint64_t total = 0;
+    boost::system::error_code ec;
+    const std::time_t now = std::time(nullptr);
+    for(boost::filesystem::directory_iterator it(directory, ec), end; !ec && it != end; it.increment(ec)) {
+        const boost::filesystem::path& path = it->path();
+        if(!boost::filesystem::is_regular_file(path, ec)) {
+            continue;
+        }
+
+        // temporary files that are no longer written to are abandoned
+        const std::string name = path.filename().string();
+        if(name.find(std::string(EXTENSION) + ".part") != std::string::npos ||
+           name.find(std::string(TarArchive::INDEX_EXTENSION) + ".part") != std::string::npos) {
+            const std::time_t last_written = boost::filesystem::last_write_time(path, ec);
+            if(!ec && now - last_written > STALE_AGE) {
+                boost::filesystem::remove(path, ec);
+            }
+            continue;
+        }
+
+        if(path.extension() != EXTENSION) {
+            continue;
+        }
+        Entry entry{path, boost::filesystem::file_size(path, ec), boost::filesystem::last_write_time(path, ec)};
+        if(!ec) {
+            total += entry.size;
+            entries.push_back(entry);
+        }
+    }
+
+    std::sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& b) {
+        return a.last_used < b.last_used;
+    });
+
+    for(const Entry& entry : entries) {
+        if(total <= max_size) {
+            break;
+        }
+        if(boost::filesystem::remove(entry.path, ec)) {
+            total -= entry.size;
+        }
+    }
+}
+
+/**
+ * @brief      maximum total size of the cache entries in a directory
+ *
+ * @return     size in bytes
+ */
+uint64_t GridCache::get_max_size() {
+    uint64_t max_size_mb = DEFAULT_MAX_SIZE_MB;
+    const char* env = getenv("EDP_CACHE_MAX_MB");
+    if(env != nullptr) {
+        try {
+            max_size_mb = std::stoull(env);
+        } catch(const std::exception&) {
+            // keep the default
+        }
+    }
+    return max_size_mb * 1024 * 1024;
+}
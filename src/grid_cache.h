@@ -0,0 +1,115 @@
+/**************************************************************************
+ *                                                                        *
+ *   Author: Ivo Filot <i.a.w.filot@tue.nl>                               *
+ *                                                                        *
+ *   EDP is free software:                                                *
+ *   you can redistribute it and/or modify it under the terms of the      *
+ *   GNU General Public License as published by the Free Software         *
+ *   Foundation, either version 3 of the License, or (at your option)     *
+ *   any later version.                                                   *
+ *                                                                        *
+ *   EDP is distributed in the hope that it will be useful,               *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty          *
+ *   of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.              *
+ *   See the GNU General Public License for more details.                 *
+ *                                                                        *
+ *   You should have received a copy of the GNU General Public License    *
+ *   along with this program.  If not, see http://www.gnu.org/licenses/.  *
+ *                                                                        *
+ **************************************************************************/
+
+#ifndef _GRID_CACHE_H
+#define _GRID_CACHE_H
+
+#include <string>
+#include <cstdint>
+#include <ctime>
+
+class ScalarField;
+
+/**
+ * @brief      Cache of parsed grids
+ *
+ * After a text file has been parsed, its grid is stored in the native binary
+ * format (see BinaryField) such that subsequent reads of the same file can map
+ * the cache entry instead of parsing the text. An entry is only used when the
+ * size and modification time of the source file (and the LOCPOT flag) match
+ * the values recorded in the entry.
+ *
+ * The entries are stored in the directory given by the environment variable
+ * EDP_CACHE_DIR and are named after a hash of the absolute path of the source
+ * file. When this variable is not set, the entry is stored as a hidden sidecar
+ * file next to the source file. Setting EDP_NO_CACHE disables the cache.
+ * For members of tar archives (see TarArchive), the entry is keyed by the
+ * path of the member and validated against the archive.
+ *
+ * The total size of the entries in a directory is capped by EDP_CACHE_MAX_MB
+ * (default: 4096); the least recently used entries are evicted first.
+ */
+class GridCache {
+public:
+    static constexpr const char* EXTENSION = ".edpc";
+    static constexpr uint64_t DEFAULT_MAX_SIZE_MB = 4096;
+    static constexpr std::time_t STALE_AGE = 3600;     // age in seconds after which a temporary file is abandoned
+
+    /**
+     * @brief      get the path of the cache entry for a file
+     *
+     * @param[in]  filename   path to the source file
+     * @param[in]  extension  extension of the cache entry
+     *
+     * @return     path to the cache entry; empty if the file cannot be cached
+     */
+    static std::string locate(const std::string& filename, const std::string& extension = EXTENSION);
+
+    /**
+     * @brief      check whether a cache entry is valid for a file
+     *
+     * @param[in]  cachefile  path to the cache entry
+     * @param[in]  filename   path to the source file
+     * @param[in]  is_locpot  whether the source file is read as a LOCPOT
+     *
+     * @return     True if valid, False otherwise.
+     */
+    static bool is_valid(const std::string& cachefile, const std::string& filename, bool is_locpot);
+
+    /**
+     * @brief      mark a cache entry as recently used
+     *
+     * @param[in]  cachefile  path to the cache entry
+     */
+    static void touch(const std::string& cachefile);
+
+    /**
+     * @brief      store the grid of a scalar field in the cache
+     *
+     * Errors are silently ignored; a failure to write the cache should
+     * never interfere with the program.
+     *
+     * @param[in]  sf         scalar field
+     * @param[in]  cachefile  path to the cache entry
+     */
+    static void store(const ScalarField& sf, const std::string& cachefile);
+
+    /**
+     * @brief      evict the least recently used entries from a directory
+     *
+     * Temporary files of entries and archive indices (see
+     * BinaryField::get_temp_name()) that have not been written to for
+     * STALE_AGE seconds are left behind by interrupted writers and are
+     * removed as well.
+     *
+     * @param[in]  directory  cache directory
+     * @param[in]  max_size   maximum total size of the entries in bytes
+     */
+    static void evict(const std::string& directory, uint64_t max_size);
+
+    /**
+     * @brief      maximum total size of the cache entries in a directory
+     *
+     * @return     size in bytes
+     */
+    static uint64_t get_max_size();
+};
+
+#endif // _GRID_CACHE_H
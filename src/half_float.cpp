@@ -0,0 +1,76 @@
+/**************************************************************************
+ *                                                                        *
+ *   Author: Ivo Filot <i.a.w.filot@tue.nl>                               *
+ *                                                                        *
+ *   EDP is free software:                                                *
+ *   you can redistribute it and/or modify it under the terms of the      *
+ *   GNU General Public License as published by the Free Software         *
+ *   Foundation, either version 3 of the License, or (at your option)     *
+ *   any later version.                                                   *
+ *                                                                        *
+ *   EDP is distributed in the hope that it will be useful,               *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty          *
+ *   of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.              *
+ *   See the GNU General Public License for more details.                 *
+ *                                                                        *
+ *   You should have received a copy of the GNU General Public License    *
+ *   along with this program.  If not, see http://www.gnu.org/licenses/.  *
+ *                                                                        *
+ **************************************************************************/
+
+#include "half_float.h"
+
+/**
+ * @brief      convert a block of values to half precision
+ *
+ * @param[in]  in    values
+ * @param      out   half precision numbers
+ * @param[in]  n     number of values
+ */
+void HalfFloat::encode_block(const fpt* in, uint16_t* out, size_t n) {
+    size_t i = 0;
+#if defined(__F16C__) && !defined(EDP_DOUBLE_PRECISION)
+    // clamp to the finite range; NaN is passed as the second operand and hence preserved
+#ifdef __AVX512F__
+    const __m512 hi16 = _mm512_set1_ps(MAX);
+    const __m512 lo16 = _mm512_set1_ps(-MAX);
+    for(; i + 16 <= n; i += 16) {
+        const __m512 v = _mm512_min_ps(hi16, _mm512_max_ps(lo16, _mm512_loadu_ps(in + i)));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), _mm512_cvtps_ph(v, _MM_FROUND_TO_NEAREST_INT));
+    }
+#endif
+    const __m256 hi8 = _mm256_set1_ps(MAX);
+    const __m256 lo8 = _mm256_set1_ps(-MAX);
+    for(; i + 8 <= n; i += 8) {
+        const __m256 v = _mm256_min_ps(hi8, _mm256_max_ps(lo8, _mm256_loadu_ps(in + i)));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), _mm256_cvtps_ph(v, _MM_FROUND_TO_NEAREST_INT));
+    }
+#endif
+    for(; i<n; i++) {
+        out[i] = encode(in[i]);
+    }
+}
+
+/**
+ * @brief      convert a block of half precision numbers to fpt
+ *
+ * @param[in]  in    half precision numbers
+ * @param      out   values
+ * @param[in]  n     number of values
+ */
+void HalfFloat::decode_block(const uint16_t* in, fpt* out, size_t n) {
+    size_t i = 0;
+#if defined(__F16C__) && !defined(EDP_DOUBLE_PRECISION)
+#ifdef __AVX512F__
+    for(; i + 16 <= n; i += 16) {
+        _mm512_storeu_ps(out + i, _mm512_cvtph_ps(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + i))));
+    }
+#endif
+    for(; i + 8 <= n; i += 8) {
+        _mm256_storeu_ps(out + i, _mm256_cvtph_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i))));
+    }
+#endif
+    for(; i<n; i++) {
+        out[i] = decode(in[i]);
+    }
+}
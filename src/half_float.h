@@ -0,0 +1,139 @@
+/**************************************************************************
+ *                                                                        *
+ *   Author: Ivo Filot <i.a.w.filot@tue.nl>                               *
+ *                                                                        *
+ *   EDP is free software:                                                *
+ *   you can redistribute it and/or modify it under the terms of the      *
+ *   GNU General Public License as published by the Free Software         *
+ *   Foundation, either version 3 of the License, or (at your option)     *
+ *   any later version.                                                   *
+ *                                                                        *
+ *   EDP is distributed in the hope that it will be useful,               *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty          *
+ *   of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.              *
+ *   See the GNU General Public License for more details.                 *
+ *                                                                        *
+ *   You should have received a copy of the GNU General Public License    *
+ *   along with this program.  If not, see http://www.gnu.org/licenses/.  *
+ *                                                                        *
+ **************************************************************************/
+
+#ifndef _HALF_FLOAT_H
+#define _HALF_FLOAT_H
+
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+
+#ifdef __F16C__
+#include <immintrin.h>
+#endif
+
+#include "math.h"
+
+/**
+ * @brief      Conversion between fpt and IEEE 754 half precision numbers
+ *
+ * Half precision numbers have an 11-bit significand (a relative error of
+ * at most 4.9e-4) and cover magnitudes from 6.0e-8 (subnormal) up to
+ * 65504; larger magnitudes are clamped to the latter. When the compiler
+ * targets a CPU with F16C, the hardware conversions are used; otherwise
+ * the conversions are done with integer arithmetic, yielding the same
+ * (round to nearest even) results.
+ */
+class HalfFloat {
+public:
+    static constexpr float MAX = 65504.0f;  // largest finite half precision number
+
+    /**
+     * @brief      convert a value to half precision
+     *
+     * @param[in]  value  value
+     *
+     * @return     bits of the half precision number
+     */
+    static inline uint16_t encode(fpt value) {
+        const float f = value > MAX ? MAX : (value < -MAX ? -MAX : (float)value);
+#ifdef __F16C__
+        return _cvtss_sh(f, _MM_FROUND_TO_NEAREST_INT);
+#else
+        uint32_t u;
+        std::memcpy(&u, &f, sizeof(u));
+        const uint32_t sign = u & 0x80000000u;
+        u ^= sign;
+
+        uint16_t h;
+        if(u > 0x7f800000u) {                   // NaN
+            h = 0x7e00;
+        } else if(u < (113u << 23)) {           // subnormal; let the FPU round
+            float g;
+            std::memcpy(&g, &u, sizeof(g));
+            g += DENORM_MAGIC;
+            std::memcpy(&u, &g, sizeof(u));
+            h = (uint16_t)(u - DENORM_MAGIC_BITS);
+        } else {                                // normal; round to nearest even
+            const uint32_t mant_odd = (u >> 13) & 1;
+            u += ((uint32_t)(15 - 127) << 23) + 0xfff + mant_odd;
+            h = (uint16_t)(u >> 13);
+        }
+        return h | (uint16_t)(sign >> 16);
+#endif
+    }
+
+    /**
+     * @brief      convert a half precision number to fpt
+     *
+     * @param[in]  h     bits of the half precision number
+     *
+     * @return     value
+     */
+    static inline fpt decode(uint16_t h) {
+#ifdef __F16C__
+        return _cvtsh_ss(h);
+#else
+        uint32_t u = (uint32_t)(h & 0x7fff) << 13;
+        const uint32_t exp = u & (0x7c00u << 13);
+        u += (uint32_t)(127 - 15) << 23;
+
+        float f;
+        if(exp == (0x7c00u << 13)) {            // Inf or NaN
+            u += (uint32_t)(128 - 16) << 23;
+            std::memcpy(&f, &u, sizeof(f));
+        } else if(exp == 0) {                   // zero or subnormal
+            u += 1u << 23;
+            std::memcpy(&f, &u, sizeof(f));
+            f -= SUBNORMAL_MAGIC;
+        } else {
+            std::memcpy(&f, &u, sizeof(f));
+        }
+        return (h & 0x8000) ? -f : f;
+#endif
+    }
+
+    /**
+     * @brief      convert a block of values to half precision
+     *
+     * @param[in]  in    values
+     * @param      out   half precision numbers
+     * @param[in]  n     number of values
+     */
+    static void encode_block(const fpt* in, uint16_t* out, size_t n);
+
+    /**
+     * @brief      convert a block of half precision numbers to fpt
+     *
+     * @param[in]  in    half precision numbers
+     * @param      out   values
+     * @param[in]  n     number of values
+     */
+    static void decode_block(const uint16_t* in, fpt* out, size_t n);
+
+private:
+#ifndef __F16C__
+    static constexpr float DENORM_MAGIC = 0.5f;             // 2^-1; aligns the half subnormals
+    static constexpr uint32_t DENORM_MAGIC_BITS = 126u << 23;
+    static constexpr float SUBNORMAL_MAGIC = 6.103515625e-5f;  // 2^-14
+#endif
+};
+
+#endif // _HALF_FLOAT_H
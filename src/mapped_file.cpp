@@ -0,0 +1,93 @@
+/**************************************************************************
+ *                                                                        *
+ *   Author: Ivo Filot <i.a.w.filot@tue.nl>                               *
+ *                                                                        *
+ *   EDP is free software:                                                *
+ *   you can redistribute it and/or modify it under the terms of the      *
+ *   GNU General Public License as published by the Free Software         *
+ *   Foundation, either version 3 of the License, or (at your option)     *
+ *   any later version.                                                   *
+ *                                                                        *
+ *   EDP is distributed in the hope that it will be useful,               *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty          *
+ *   of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.              *
+ *   See the GNU General Public License for more details.                 *
+ *                                                                        *
+ *   You should have received a copy of the GNU General Public License    *
+ *   along with this program.  If not, see http://www.gnu.org/licenses/.  *
+ *                                                                        *
+ **************************************************************************/
+
+#include "mapped_file.h"
+
+#include <algorithm>
+#include <fstream>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+/**
+ * @brief      map a file into memory
+ *
+ * @param[in]  _filename  path to the file
+ */
+MappedFile::MappedFile(const std::string& _filename) {
+    this->filename = _filename;
+    this->ptr = nullptr;
+    this->filesize = 0;
+    this->is_mapped = false;
+
+    int fd = open(this->filename.c_str(), O_RDONLY);
+    if(fd < 0) {
+        throw std::runtime_error("Cannot open " + this->filename + "!");
+    }
+
+    struct stat st;
+    if(fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+        void* addr = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if(addr != MAP_FAILED) {
+            this->ptr = static_cast<const char*>(addr);
+            this->filesize = st.st_size;
+            this->is_mapped = true;
+        }
+    }
+    close(fd);
+
+    // fall back to reading the complete file into memory
+    if(!this->is_mapped) {
+        std::ifstream infile(this->filename, std::ios::binary);
+        this->buffer.assign(std::istreambuf_iterator<char>(infile),
+                            std::istreambuf_iterator<char>());
+        this->ptr = this->buffer.data();
+        this->filesize = this->buffer.size();
+    }
+}
+
+/**
+ * @brief      hint the kernel that a byte range is read sequentially
+ *
+ * @param[in]  offset  starting byte of the range
+ * @param[in]  length  length of the range in bytes
+ */
+void MappedFile::advise_sequential(size_t offset, size_t length) const {
+    if(!this->is_mapped || offset >= this->filesize) {
+        return;
+    }
+
+    // madvise requires a page-aligned starting address
+    static const size_t pagesize = sysconf(_SC_PAGESIZE);
+    const size_t start = offset - offset % pagesize;
+    length = std::min(length + (offset - start), this->filesize - start);
+    madvise((void*)(this->ptr + start), length, MADV_SEQUENTIAL);
+    madvise((void*)(this->ptr + start), length, MADV_WILLNEED);
+}
+
+/**
+ * @brief      unmap the file
+ */
+MappedFile::~MappedFile() {
+    if(this->is_mapped) {
+        munmap((void*)this->ptr, this->filesize);
+    }
+}
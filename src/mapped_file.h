@@ -0,0 +1,94 @@
+/**************************************************************************
+ *                                                                        *
+ *   Author: Ivo Filot <i.a.w.filot@tue.nl>                               *
+ *                                                                        *
+ *   EDP is free software:                                                *
+ *   you can redistribute it and/or modify it under the terms of the      *
+ *   GNU General Public License as published by the Free Software         *
+ *   Foundation, either version 3 of the License, or (at your option)     *
+ *   any later version.                                                   *
+ *                                                                        *
+ *   EDP is distributed in the hope that it will be useful,               *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty          *
+ *   of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.              *
+ *   See the GNU General Public License for more details.                 *
+ *                                                                        *
+ *   You should have received a copy of the GNU General Public License    *
+ *   along with this program.  If not, see http://www.gnu.org/licenses/.  *
+ *                                                                        *
+ **************************************************************************/
+
+#ifndef _MAPPED_FILE_H
+#define _MAPPED_FILE_H
+
+#include <string>
+#include <vector>
+#include <stdexcept>
+
+/**
+ * @brief      Read-only view on the contents of a file
+ *
+ * The file is memory-mapped such that the kernel pages in the data on
+ * demand and no intermediate copies are made. When the file cannot be
+ * mapped (e.g. for special files), the contents are read into a buffer
+ * instead so that callers can use the same interface in both cases.
+ */
+class MappedFile {
+private:
+    std::string filename;
+    const char* ptr;
+    size_t filesize;
+    bool is_mapped;
+    std::vector<char> buffer;   // only used when mmap is not available
+
+public:
+    /**
+     * @brief      map a file into memory
+     *
+     * @param[in]  _filename  path to the file
+     */
+    MappedFile(const std::string& _filename);
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    /**
+     * @brief      pointer to the first byte of the file
+     */
+    inline const char* data() const {
+        return this->ptr;
+    }
+
+    /**
+     * @brief      pointer one past the last byte of the file
+     */
+    inline const char* end() const {
+        return this->ptr + this->filesize;
+    }
+
+    /**
+     * @brief      size of the file in bytes
+     */
+    inline size_t size() const {
+        return this->filesize;
+    }
+
+    inline const std::string& get_filename() const {
+        return this->filename;
+    }
+
+    /**
+     * @brief      hint the kernel that a byte range is read sequentially
+     *
+     * @param[in]  offset  starting byte of the range
+     * @param[in]  length  length of the range in bytes
+     */
+    void advise_sequential(size_t offset, size_t length) const;
+
+    /**
+     * @brief      unmap the file
+     */
+    ~MappedFile();
+};
+
+#endif // _MAPPED_FILE_H
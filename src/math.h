@@ -23,9 +23,23 @@
 
 #include <Eigen/Dense>
 
-typedef Eigen::Matrix<float, 3, 3, Eigen::RowMajor> MatrixUnitcell;
-typedef Eigen::Vector3f Vec3f;
-typedef Vec3f Vec3;
-typedef float fpt;  // general floating point type
+// The precision is selected at compile time (see EDP_PRECISION and
+// EDP_ACCUMULATION in CMakeLists.txt). Grids and the geometry are stored
+// as fpt; sums over many grid points are accumulated as fpa, such that
+// single-precision grids can still be integrated accurately.
+#ifdef EDP_DOUBLE_PRECISION
+typedef double fpt;  // general floating point type
+#else
+typedef float fpt;   // general floating point type
+#endif
+
+#ifdef EDP_FLOAT_ACCUMULATION
+typedef float fpa;   // floating point type for accumulation
+#else
+typedef double fpa;  // floating point type for accumulation
+#endif
+
+typedef Eigen::Matrix<fpt, 3, 3, Eigen::RowMajor> MatrixUnitcell;
+typedef Eigen::Matrix<fpt, 3, 1> Vec3;
 
 #endif // _MATRICES_H
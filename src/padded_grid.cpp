@@ -0,0 +1,69 @@
+/**************************************************************************
+ *                                                                        *
+ *   Author: Ivo Filot <i.a.w.filot@tue.nl>                               *
+ *                                                                        *
+ *   EDP is free software:                                                *
+ *   you can redistribute it and/or modify it under the terms of the      *
+ *   GNU General Public License as published by the Free Software         *
+ *   Foundation, either version 3 of the License, or (at your option)     *
+ *   any later version.                                                   *
+ *                                                                        *
+ *   EDP is distributed in the hope that it will be useful,               *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty          *
+ *   of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.              *
+ *   See the GNU General Public License for more details.                 *
+ *                                                                        *
+ *   You should have received a copy of the GNU General Public License    *
+ *   along with this program.  If not, see http://www.gnu.org/licenses/.  *
+ *                                                                        *
+ **************************************************************************/
+
+#include "padded_grid.h"
+
+/**
+ * @brief      construct the padded grid in parallel
+ *
+ * Every row along x of the padded grid is copied from the corresponding
+ * (periodic) row of the grid, after which its ghost points are filled.
+ *
+ * @param[in]  grid    grid (x running fastest)
+ * @param[in]  _dims   grid dimensions
+ * @param[in]  _ghost  number of ghost layers on each face
+ */
+PaddedGrid::PaddedGrid(const fpt* grid, const std::array<unsigned int, 3>& _dims, unsigned int _ghost) :
+    ghost(_ghost),
+    dims(_dims) {
+
+    const int nx = this->dims[0];
+    const int ny = this->dims[1];
+    const int nz = this->dims[2];
+    const int g = this->ghost;
+    for(unsigned int i=0; i<3; i++) {
+        this->fdims[i] = (fpt)this->dims[i];
+    }
+    this->sy = nx + 2 * g;
+    this->sz = this->sy * (ny + 2 * g);
+    this->values.allocate(this->sz * (nz + 2 * g), false);
+    fpt* base = this->values.data() + g * (this->sz + this->sy + 1);
+    this->origin = base;
+
+    // index of the periodic image inside the grid (also for grids that are
+    // thinner than the ghost layers)
+    auto wrap = [](int i, int n) {
+        return ((i % n) + n) % n;
+    };
+
+    // the rows are first touched by the thread that fills them
+    #pragma omp parallel for collapse(2)
+    for(int k=-g; k<nz+g; k++) {
+        for(int j=-g; j<ny+g; j++) {
+            const fpt* src = grid + ((size_t)wrap(k, nz) * ny + wrap(j, ny)) * nx;
+            fpt* dest = base + (ptrdiff_t)k * this->sz + (ptrdiff_t)j * this->sy;
+            std::copy(src, src + nx, dest);
+            for(int i=1; i<=g; i++) {
+                dest[-i] = src[wrap(-i, nx)];
+                dest[nx + i - 1] = src[wrap(i - 1, nx)];
+            }
+        }
+    }
+}
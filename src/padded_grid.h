@@ -0,0 +1,178 @@
+/**************************************************************************
+ *                                                                        *
+ *   Author: Ivo Filot <i.a.w.filot@tue.nl>                               *
+ *                                                                        *
+ *   EDP is free software:                                                *
+ *   you can redistribute it and/or modify it under the terms of the      *
+ *   GNU General Public License as published by the Free Software         *
+ *   Foundation, either version 3 of the License, or (at your option)     *
+ *   any later version.                                                   *
+ *                                                                        *
+ *   EDP is distributed in the hope that it will be useful,               *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty          *
+ *   of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.              *
+ *   See the GNU General Public License for more details.                 *
+ *                                                                        *
+ *   You should have received a copy of the GNU General Public License    *
+ *   along with this program.  If not, see http://www.gnu.org/licenses/.  *
+ *                                                                        *
+ **************************************************************************/
+
+#ifndef _PADDED_GRID_H
+#define _PADDED_GRID_H
+
+#include <algorithm>
+#include <array>
+
+#include "math.h"
+#include "bspline.h"
+#include "grid_buffer.h"
+
+#if defined(__FMA__) && !defined(EDP_DOUBLE_PRECISION)
+#include <immintrin.h>
+#endif
+
+/**
+ * @brief      Copy of a periodic grid surrounded by ghost layers
+ *
+ * Every face of the grid is extended by ghost layers holding the periodic
+ * images of the opposite face, such that the neighbours of any grid point
+ * can be read without wrapping the indices. The trilinear interpolation
+ * hence reduces to a truncation to the lower corner of the cell and eight
+ * loads from four rows of contiguous pairs, without modulo operations or
+ * branches. Periodicity only has to be handled when mapping a position to
+ * direct coordinates inside the unit cell.
+ *
+ * With two ghost layers, the grid can hold the coefficients of a cubic
+ * B-spline (see CubicBSpline), which are evaluated from 4x4x4 points.
+ */
+class PaddedGrid {
+private:
+    unsigned int ghost;                     // number of ghost layers on each face
+    std::array<unsigned int, 3> dims;       // grid dimensions (without ghost layers)
+    std::array<fpt, 3> fdims;               // grid dimensions as fpt
+    size_t sy;                              // stride between rows along y
+    size_t sz;                              // stride between planes along z
+    GridBuffer values;                      // padded grid (x running fastest)
+    const fpt* origin;                      // position of grid point (0,0,0)
+
+public:
+    /**
+     * @brief      construct the padded grid in parallel
+     *
+     * @param[in]  grid    grid (x running fastest)
+     * @param[in]  _dims   grid dimensions
+     * @param[in]  _ghost  number of ghost layers on each face
+     */
+    PaddedGrid(const fpt* grid, const std::array<unsigned int, 3>& _dims, unsigned int _ghost = 1);
+
+    PaddedGrid(const PaddedGrid&) = delete;
+    PaddedGrid& operator=(const PaddedGrid&) = delete;
+
+    /**
+     * @brief      value at a grid point
+     *
+     * @param[in]  i,j,k  indices; may exceed the grid by the number of ghost layers
+     */
+    inline fpt get_value(int i, int j, int k) const {
+        return this->origin[(ptrdiff_t)k * this->sz + (ptrdiff_t)j * this->sy + i];
+    }
+
+    /**
+     * @brief      trilinear interpolation at a position in direct coordinates
+     *
+     * Points on the upper faces of the unit cell are interpolated in the
+     * last cell with a weight of one for its upper corner.
+     *
+     * @param[in]  dx,dy,dz  direct coordinates (inside [0,1])
+     *
+     * @return     interpolated value
+     */
+    inline fpt get_value_interp(fpt dx, fpt dy, fpt dz) const {
+        const fpt gx = dx * this->fdims[0];
+        const fpt gy = dy * this->fdims[1];
+        const fpt gz = dz * this->fdims[2];
+
+        // the coordinates are not negative, so truncation equals floor
+        const unsigned int i = std::min((unsigned int)gx, this->dims[0] - 1);
+        const unsigned int j = std::min((unsigned int)gy, this->dims[1] - 1);
+        const unsigned int k = std::min((unsigned int)gz, this->dims[2] - 1);
+        const fpt wx = gx - (fpt)i;
+        const fpt wy = gy - (fpt)j;
+        const fpt wz = gz - (fpt)k;
+
+        const fpt* p00 = this->origin + k * this->sz + j * this->sy + i;
+        const fpt* p10 = p00 + this->sy;
+        const fpt* p01 = p00 + this->sz;
+        const fpt* p11 = p01 + this->sy;
+
+        const fpt c00 = p00[0] + wx * (p00[1] - p00[0]);
+        const fpt c10 = p10[0] + wx * (p10[1] - p10[0]);
+        const fpt c01 = p01[0] + wx * (p01[1] - p01[0]);
+        const fpt c11 = p11[0] + wx * (p11[1] - p11[0]);
+        const fpt c0 = c00 + wy * (c10 - c00);
+        const fpt c1 = c01 + wy * (c11 - c01);
+        return c0 + wz * (c1 - c0);
+    }
+
+    /**
+     * @brief      evaluate the cubic B-spline whose coefficients are held by
+     *             the grid at a position in direct coordinates
+     *
+     * The 4x4x4 coefficients around the position are combined four at a
+     * time: the rows along x are summed with the weights along y and z,
+     * after which the sum is weighted along x. Requires two ghost layers.
+     *
+     * @param[in]  dx,dy,dz  direct coordinates (inside [0,1])
+     *
+     * @return     value of the spline
+     */
+    inline fpt get_value_bspline(fpt dx, fpt dy, fpt dz) const {
+        const fpt gx = dx * this->fdims[0];
+        const fpt gy = dy * this->fdims[1];
+        const fpt gz = dz * this->fdims[2];
+        const unsigned int i = std::min((unsigned int)gx, this->dims[0] - 1);
+        const unsigned int j = std::min((unsigned int)gy, this->dims[1] - 1);
+        const unsigned int k = std::min((unsigned int)gz, this->dims[2] - 1);
+
+        fpt wx[4], wy[4], wz[4];
+        CubicBSpline::weights(gx - (fpt)i, wx);
+        CubicBSpline::weights(gy - (fpt)j, wy);
+        CubicBSpline::weights(gz - (fpt)k, wz);
+
+        // first of the 4x4x4 coefficients, one point below the cell along each axis
+        const fpt* p = this->origin + ((ptrdiff_t)(k * this->sz + j * this->sy + i) - (ptrdiff_t)(this->sz + this->sy + 1));
+#if defined(__FMA__) && !defined(EDP_DOUBLE_PRECISION)
+        __m128 acc = _mm_setzero_ps();
+        for(unsigned int c=0; c<4; c++) {
+            __m128 plane = _mm_setzero_ps();
+            for(unsigned int b=0; b<4; b++) {
+                plane = _mm_fmadd_ps(_mm_set1_ps(wy[b]), _mm_loadu_ps(p + c * this->sz + b * this->sy), plane);
+            }
+            acc = _mm_fmadd_ps(_mm_set1_ps(wz[c]), plane, acc);
+        }
+        acc = _mm_mul_ps(acc, _mm_loadu_ps(wx));
+        acc = _mm_add_ps(acc, _mm_movehl_ps(acc, acc));
+        acc = _mm_add_ss(acc, _mm_shuffle_ps(acc, acc, 1));
+        return _mm_cvtss_f32(acc);
+#else
+        fpt sum = 0.0;
+        for(unsigned int c=0; c<4; c++) {
+            for(unsigned int b=0; b<4; b++) {
+                const fpt* row = p + c * this->sz + b * this->sy;
+                sum += wz[c] * wy[b] * (wx[0] * row[0] + wx[1] * row[1] + wx[2] * row[2] + wx[3] * row[3]);
+            }
+        }
+        return sum;
+#endif
+    }
+
+    /**
+     * @brief      number of values including the ghost layers
+     */
+    inline size_t get_size() const {
+        return this->values.size();
+    }
+};
+
+#endif // _PADDED_GRID_H
@@ -20,6 +20,11 @@
 
  #include "planeprojector.h"
 
+#include <exception>
+#include <limits>
+#include <type_traits>
+#include <vector>
+
 /**
  * @brief      constructor
  *
@@ -97,38 +102,87 @@ void PlaneProjector::extract(Vec3 _v1, Vec3 _v2, const Vec3& _p, fpt _scale, fpt
     this->planegrid_real = new fpt[this->ix * this->iy];
     this->planegrid_box =  new bool[this->ix * this->iy];
 
-    #pragma omp parallel for collapse(2)
-    for(int i=0; i<this->ix; i++) {
-        for(int j=0; j<this->iy; j++) {
-            const fpt x = _v1[0] * fpt(i - this->ix / 2) / _scale + _v2[0] * fpt(j - this->iy / 2) / _scale + _p[0];
-            const fpt y = _v1[1] * fpt(i - this->ix / 2) / _scale + _v2[1] * fpt(j - this->iy / 2) / _scale + _p[1];
-            const fpt z = _v1[2] * fpt(i - this->ix / 2) / _scale + _v2[2] * fpt(j - this->iy / 2) / _scale + _p[2];
-
-            const bool is_inside = this->sf->is_inside(x,y,z);
-            const fpt val = this->sf->get_value_interp(x,y,z);
-
-            if(!is_inside) {
-                this->planegrid_box[j * this->ix + i] = false;
-                this->planegrid_log[j * this->ix + i] = 0.0f;
-                this->planegrid_real[j * this->ix + i] = 0.0f;
-                continue;
-            } else {
-                this->planegrid_box[j * this->ix + i] = true;
-            }
+    // the direct coordinates of the pixels are an affine function of the
+    // pixel indices; they are stepped in double precision, such that the
+    // rounding error does not accumulate along the rows
+    const MatrixUnitcell& imat = this->sf->get_mat_unitcell_inverse();
+    double d0[3], di[3], dj[3];
+    for(unsigned int a=0; a<3; a++) {
+        d0[a] = di[a] = dj[a] = 0.0;
+        for(unsigned int b=0; b<3; b++) {
+            di[a] += (double)imat(b,a) * _v1[b] / _scale;
+            dj[a] += (double)imat(b,a) * _v2[b] / _scale;
+            d0[a] += (double)imat(b,a) * _p[b];
+        }
+        d0[a] -= di[a] * (this->ix / 2) + dj[a] * (this->iy / 2);
+    }
 
-            if(this->flag_negative) {
-                this->planegrid_log[j * this->ix + i] = this->calculate_scaled_value_log(val);
-            } else {
-                if(val > 0) {
-                    this->planegrid_log[j * this->ix + i] = this->calculate_scaled_value_log(val);
-                } else {
-                    this->planegrid_log[j * this->ix + i] = -12;
+    // pixels within this distance (in direct coordinates) of a face of the
+    // unit cell lie on it; it covers the rounding of the inverse unit cell
+    // matrix and of the stepping
+    const double tolerance = std::max(1e-9, 8.0 * std::numeric_limits<fpt>::epsilon());
+
+    // the plane is traversed in tiles of pixels, row by row within a tile,
+    // such that neighbouring rows reuse the cells of the grid in the cache
+    const int ntx = (this->ix + PIXEL_TILE - 1) / PIXEL_TILE;
+    const int nty = (this->iy + PIXEL_TILE - 1) / PIXEL_TILE;
+
+    // a grid that is read lazily loads its slabs while sampling, which may
+    // fail; exceptions cannot cross the boundary of the parallel region
+    std::exception_ptr error;
+    #pragma omp parallel for schedule(dynamic)
+    for(int t=0; t<ntx * nty; t++) {
+        try {
+            const int i0 = (t % ntx) * PIXEL_TILE;
+            const int j0 = (t / ntx) * PIXEL_TILE;
+            const int i1 = std::min(i0 + PIXEL_TILE, this->ix);
+            const int j1 = std::min(j0 + PIXEL_TILE, this->iy);
+            for(int j=j0; j<j1; j++) {
+                double d[3];
+                for(unsigned int a=0; a<3; a++) {
+                    d[a] = d0[a] + di[a] * i0 + dj[a] * j;
+                }
+                for(int i=i0; i<i1; i++) {
+                    // the faces of the unit cell belong to it, also when stepping
+                    // has rounded the coordinates of a pixel slightly outside
+                    const size_t idx = (size_t)j * this->ix + i;
+                    bool is_inside = true;
+                    Vec3 r;
+                    for(unsigned int a=0; a<3; a++) {
+                        is_inside = is_inside && d[a] >= -tolerance && d[a] <= 1.0 + tolerance;
+                        r[a] = std::min(std::max(d[a], 0.0), 1.0);
+                    }
+
+                    if(!is_inside) {
+                        this->planegrid_box[idx] = false;
+                        this->planegrid_log[idx] = 0.0f;
+                        this->planegrid_real[idx] = 0.0f;
+                    } else {
+                        const fpt val = this->sf->get_value_interp_direct(r);
+                        this->planegrid_box[idx] = true;
+                        if(this->flag_negative || val > 0) {
+                            this->planegrid_log[idx] = this->calculate_scaled_value_log(val);
+                        } else {
+                            this->planegrid_log[idx] = -12;
+                        }
+                        this->planegrid_real[idx] = val;
+                    }
+
+                    for(unsigned int a=0; a<3; a++) {
+                        d[a] += di[a];
+                    }
                 }
             }
-            this->planegrid_real[j * this->ix + i] = val;
+        } catch(...) {
+            #pragma omp critical
+            error = std::current_exception();
         }
     }
 
+    if(error) {
+        std::rethrow_exception(error);
+    }
+
     this->cut_and_recast_plane();
 }
 
@@ -179,23 +233,13 @@ void PlaneProjector::extract_line(Vec3 e, const Vec3& p, fpt _scale, fpt li, fpt
 void PlaneProjector::extract_plane_average() {
     const auto& dimensions = sf->get_grid_dimensions();
 
-    const fpt* grid = this->sf->get_grid_ptr();
     std::vector<fpt> avg;
     std::vector<fpt> z;
 
-    const fpt sz = (fpt)(dimensions[0] * dimensions[1]);
+    const fpa sz = (fpa)dimensions[0] * dimensions[1];
 
     for(unsigned int i=0; i<dimensions[2]; i++) {   // loop over z-axis
-        fpt sum = 0.0f;
-        #pragma omp parallel for collapse(2) reduction(+:sum)
-        for(unsigned int j=0; j<dimensions[1]; j++) {   // loop over y-axis
-            for(unsigned int k=0; k<dimensions[0]; k++) {   // loop over x-axis
-                sum += grid[i * dimensions[0] * dimensions[1] +   // z
-                            j * dimensions[0] +                   // y
-                            k];                                   // x
-            }
-        }
-        avg.push_back(sum / sz);
+        avg.push_back(this->sf->get_slab_sum(i) / sz);
         z.push_back(i / (fpt)dimensions[2]);
     }
 
@@ -230,7 +274,7 @@ void PlaneProjector::extract_sphere_average(const Vec3& p, fpt radius) {
 
     // integrate over points
     for(fpt r = 0.0; r <= radius; r += 0.01f) {
-        fpt sum = 0.0f;
+        fpa sum = 0.0;
         //#pragma omp parallel for reduction(+:sum)
         for(unsigned int i=0; i<Quadrature::num_lebedev_points[level]; i++) {
             Vec3 pp = p + Vec3(Quadrature::lebedev_coefficients[i][0],
@@ -579,25 +623,31 @@ fpt PlaneProjector::calculate_scaled_value_log(fpt input) {
     return sgn(input) * (logval - this->log_min) / scale;
 }
 
-void PlaneProjector::store_field(const std::string& filename, fpt* field, uint32_t nx, uint32_t ny) {
+void PlaneProjector::store_field(const std::string& filename, fpt* field, uint64_t nx, uint64_t ny) {
     std::cout << "Storing field in " << filename << std::endl;
     std::ofstream out(filename, std::ios::out | std::ios::binary);
     if (out.is_open()) {
-        out.write((const char*)&nx, sizeof(uint32_t));
-        out.write((const char*)&ny, sizeof(uint32_t));
-        out.write((const char*)field, nx * ny * sizeof(fpt));
+        out.write((const char*)&nx, sizeof(uint64_t));
+        out.write((const char*)&ny, sizeof(uint64_t));
+        // the values are always stored in single precision, independent of fpt
+        if(std::is_same<fpt, float>::value) {
+            out.write((const char*)field, nx * ny * sizeof(float));
+        } else {
+            const std::vector<float> values(field, field + nx * ny);
+            out.write((const char*)values.data(), values.size() * sizeof(float));
+        }
     } else {
         throw std::runtime_error("Cannot open file for writing.");
     }
     out.close();
 }
 
-void PlaneProjector::store_field_uin8t(const std::string& filename, uint8_t* field, uint32_t nx, uint32_t ny) {
+void PlaneProjector::store_field_uin8t(const std::string& filename, uint8_t* field, uint64_t nx, uint64_t ny) {
     std::cout << "Storing field in " << filename << std::endl;
     std::ofstream out(filename, std::ios::out | std::ios::binary);
     if (out.is_open()) {
-        out.write((const char*)&nx, sizeof(uint32_t));
-        out.write((const char*)&ny, sizeof(uint32_t));
+        out.write((const char*)&nx, sizeof(uint64_t));
+        out.write((const char*)&ny, sizeof(uint64_t));
         out.write((const char*)field, nx * ny * sizeof(uint8_t));
     } else {
         throw std::runtime_error("Cannot open file for writing.");
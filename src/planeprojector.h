@@ -30,6 +30,8 @@
 
 class PlaneProjector {
 private:
+    static constexpr int PIXEL_TILE = 32;   // number of pixels along each side of the tiles traversed by extract()
+
     ColorScheme* scheme;
     ScalarField* sf;
     Plotter* plt;
@@ -185,9 +187,18 @@ private:
      */
     fpt calculate_scaled_value_log(fpt input);
 
-    void store_field(const std::string& filename, fpt* field, uint32_t nx, uint32_t ny);
+    /**
+     * @brief      store a field as its dimensions (two uint64) followed by
+     *             its values in single precision, also when fpt is double
+     *
+     * @param[in]  filename  path to the output file
+     * @param[in]  field     values (x running fastest)
+     * @param[in]  nx        number of values along x
+     * @param[in]  ny        number of values along y
+     */
+    void store_field(const std::string& filename, fpt* field, uint64_t nx, uint64_t ny);
 
-    void store_field_uin8t(const std::string& filename, uint8_t* field, uint32_t nx, uint32_t ny);
+    void store_field_uin8t(const std::string& filename, uint8_t* field, uint64_t nx, uint64_t ny);
 };
 
 /**
@@ -19,25 +19,50 @@
  **************************************************************************/
 
 #include "scalar_field.h"
+#include "batch_sampler.h"
+#include "binary_field.h"
+#include "compressed_field.h"
+#include "grid_cache.h"
+#include "tar_archive.h"
+
+#include <deque>
 
 /**
  * @brief      constructor
  *
  * @param[in]  _filename   url to filename
  * @param[in]  _flag_is_locpot  whether this file is a locpot
+ * @param[in]  _spin       spin component to read (see SpinDensity)
  */
-ScalarField::ScalarField(const std::string &_filename, bool _flag_is_locpot) {
+ScalarField::ScalarField(const std::string &_filename, bool _flag_is_locpot, SpinDensity::Component _spin) {
     this->filename = _filename;
     this->scalar = -1;
     this->vasp5_input = false;
+    this->binary_input = false;
     this->has_read = false;
     this->header_read = false;
+    this->grid_offset = 0;
+    this->gridsize = 0;
+    this->compact_storage = false;
     this->flag_is_locpot = _flag_is_locpot;
+    this->spin = _spin;
 
     // test existence of file, else throw an error
-    if (!boost::filesystem::exists(this->filename)) {
+    if (this->filename != "-" && !boost::filesystem::exists(TarArchive::get_source(this->filename))) {
         throw std::runtime_error("Cannot open " + this->filename + "!");
     }
+
+    // compressed files, members of archives and standard input are read sequentially
+    this->streamed_input = StreamReader::is_streamed(this->filename);
+    this->reader = FieldReader::detect(this->filename);
+
+    // binary and compressed files know whether they hold a LOCPOT
+    if(!this->streamed_input && BinaryField::probe(this->filename)) {
+        this->binary_input = true;
+        this->flag_is_locpot = BinaryField::read_file_header(this->filename).flags & BinaryField::FLAG_LOCPOT;
+    } else if(!this->streamed_input && CompressedField::probe(this->filename)) {
+        this->flag_is_locpot = CompressedField::read_file_header(this->filename).flags & CompressedField::FLAG_LOCPOT;
+    }
 }
 
 /*
@@ -81,62 +106,19 @@ void ScalarField::output() const {
     std::cout << std::endl;
 }
 
-/*
- * void read()
- *
- * Wrapper function that reads in the OUTCAR file
- *
- * Usage: sf.read(true);
+/**
+ * @brief      read the header and the atoms of the file
  *
+ * This function can be called separately from read() to obtain the unit
+ * cell, the atomic positions and the grid dimensions without reading the
+ * (much larger) grid itself.
  */
 void ScalarField::read_header_and_atoms() {
     if(this->header_read) {
         return;
     }
 
-    this->test_vasp5();
-
-    // read scalar multiplication value
-    try {
-        this->read_scalar();
-    } catch(const std::exception& e) {
-        std::cout << "Error encountered in reading scalar value from CHGCAR" << std::endl;
-        throw e;
-    }
-
-    // read matrix
-    try {
-        this->read_matrix();
-    } catch(const std::exception& e) {
-        std::cout << "Error encountered in reading unitcell matrix from CHGCAR" << std::endl;
-        throw e;
-    }
-
-    // read number of atoms
-    try {
-        this->read_nr_atoms();
-    } catch(const std::exception& e) {
-        std::cout << "Error encountered in reading number of atoms from CHGCAR" << std::endl;
-        throw e;
-    }
-
-    // read atomic positions
-    try {
-        this->read_atom_positions();
-    } catch(const std::exception& e) {
-        std::cout << "Error encountered in reading atomic positions from CHGCAR" << std::endl;
-        std::cout << "ERROR: " << e.what() << std::endl;
-        throw e;
-    }
-
-    // read grid dimensions
-    try {
-        this->read_grid_dimensions();
-    } catch(const std::exception& e) {
-        std::cout << "Error encountered in reading grid dimensions from CHGCAR" << std::endl;
-        throw e;
-    }
-
+    this->reader->read_header(this);
 }
 
 /*
@@ -156,293 +138,424 @@ void ScalarField::read() {
     this->read_grid();
 }
 
-/*
- * void test_vasp5()
- *
- * Test if the input file is a VASP5 output file
+/**
+ * @brief      read the header and load the grid on demand
  *
+ * Only the z-slabs of the grid that are touched by get_value() are
+ * parsed, which is much faster than read() when e.g. a single plane
+ * is extracted. This requires a format whose slabs can be located
+ * directly (VASP files, vaspout.h5 and the lossy compressed format of
+ * CompressedField); other files (and files compressed with e.g. gzip)
+ * are read completely, as are spin components other than the total
+ * density.
  */
-void ScalarField::test_vasp5() {
-    std::ifstream infile(this->filename.c_str());
-    std::string line;
-    for(unsigned int i=0; i<5; i++) { // discard first two lines
-        std::getline(infile, line);
-    }
-    std::getline(infile, line);
-    // check if this line contains atomic information (i.e. alpha-characters)
-    boost::regex regex_vasp_version("^(.*[A-Za-z]+.*)$");
-    boost::smatch what;
-    if(boost::regex_match(line, what, regex_vasp_version)) {
-        this->vasp5_input = true;
+void ScalarField::read_lazy() {
+    if(this->has_read) {
+        return;
     }
-}
 
-/*
- * void read_scalar()
- *
- * Read the scalar value from the 2nd line of the
- * CHGCAR file. Note that all read_* functions can
- * be used seperately, although they may depend
- * on each other and have to be used in some
- * consecutive order as is done in the read()
- * wrapper function.
- *
- */
-void ScalarField::read_scalar() {
-    std::ifstream infile(this->filename.c_str());
-    std::string line;
-    std::getline(infile, line); // discard this line
+    this->read_header_and_atoms();
 
-    std::getline(infile, line);
-    boost::regex regex_scalar("^\\s*([0-9.-]+)\\s*$");
-    boost::smatch what;
-    if(boost::regex_match(line, what, regex_scalar)) {
-        this->scalar = boost::lexical_cast<fpt>(what[1]);
-    } else {
-        this->scalar = -1;
+    // binary files are mapped, and hence loaded on demand, anyway
+    if(this->binary_input || this->streamed_input || this->spin != SpinDensity::Component::TOTAL) {
+        this->read_grid();
+        return;
     }
-}
-
-/*
- * void read_matrix()
- *
- * Reads the matrix that defines the unit cell
- * in the CHGCAR file. The inverse of that matrix
- * is automatically constructed.
- *
- * Note that all read_* functions can
- * be used seperately, although they may depend
- * on each other and have to be used in some
- * consecutive order as is done in the read()
- * wrapper function.
- *
- */
-void ScalarField::read_matrix() {
-    std::ifstream infile(this->filename.c_str());
-    std::string line;
-    for(unsigned int i=0; i<2; i++) { // discard first two lines
-        std::getline(infile, line);
+    if(this->reader->is_cacheable() && this->read_grid_from_cache(GridCache::locate(this->filename))) {
+        return;
     }
 
-    // setup match pattern
-    boost::regex regex_vasp_matrix_line("^\\s*([0-9.-]+)\\s+([0-9.-]+)\\s+([0-9.-]+)\\s*$");
-    for(unsigned int i=0; i<3; i++) {
-        std::getline(infile, line);
-        boost::smatch what;
-        if(boost::regex_match(line, what, regex_vasp_matrix_line)) {
-            for(unsigned int j=0; j<3; j++) {
-                mat(i,j) = boost::lexical_cast<fpt>(what[j+1]) * this->scalar;
-            }
-        }
+    // not every format can locate the slabs of its grid; the pages of the
+    // slabs are touched first by the threads that load them
+    this->gridptr.allocate(this->gridsize, false);
+    this->slab_loader = this->reader->create_slab_loader(this);
+    if(!this->slab_loader) {
+        this->read_grid();
+        return;
     }
 
-    // calculate matrix inverse and volume of unit cell
-    this->imat = mat.inverse();
-    this->volume = mat.determinant();
+    this->has_read = true;
 }
 
 /*
- * void read_nr_atoms()
+ * void read_header()
  *
- * Read the number of atoms of each element. These
- * numbers are used to skip the required amount of
- * lines.
+ * Read the header of the CHGCAR file in a single pass. The file
+ * is opened once and every line is handed to a state machine that
+ * moves through the consecutive sections of the header:
  *
- * Note that all read_* functions can
- * be used seperately, although they may depend
- * on each other and have to be used in some
- * consecutive order as is done in the read()
- * wrapper function.
+ *   comment -> scalar -> lattice (3 lines) -> [elements] -> counts ->
+ *   [selective dynamics] -> coordinate mode -> positions -> grid dimensions
+ *
+ * The element line is only present for VASP5 files and is recognized
+ * by the presence of alphabetic characters. The byte offset at which
+ * the grid starts is stored such that read_grid() can directly
+ * seek to that position.
  *
  */
-void ScalarField::read_nr_atoms() {
-    std::ifstream infile(this->filename.c_str());
-    std::string line;
-    for(unsigned int i=0; i<5; i++) {
-        std::getline(infile, line);
-    }
-
-    // store atom types
-    if(this->vasp5_input) {
-        std::getline(infile, line);
-        std::vector<std::string> pieces;
-        boost::trim(line);
-        boost::split(pieces, line, boost::is_any_of("\t "), boost::token_compress_on);
-        for(const auto piece: pieces) {
-            this->atom_charges.push_back(PeriodicTable::get().get_elnr(piece));
+void ScalarField::read_header() {
+    enum class HeaderState {
+        COMMENT,
+        SCALAR,
+        LATTICE,
+        ELEMENTS,
+        COUNTS,
+        COORDINATE_MODE,
+        POSITIONS,
+        GRID_DIMENSIONS,
+        DONE
+    };
+
+    // streamed inputs keep their reader such that read_grid() can continue
+    // right after the header
+    std::ifstream file;
+    std::istream infile(nullptr);
+    if(this->streamed_input) {
+        this->stream_reader = std::make_unique<StreamReader>(this->filename);
+        infile.rdbuf(this->stream_reader.get());
+        infile.exceptions(std::ios::badbit);
+    } else {
+        file.open(this->filename.c_str(), std::ios::binary);
+        if(!file.is_open()) {
+            throw std::runtime_error("Cannot open " + this->filename + "!");
         }
+        infile.rdbuf(file.rdbuf());
     }
 
-    // skip another line
-    std::getline(infile, line);
+    static const boost::regex regex_scalar("^\\s*([0-9.-]+)\\s*$");
+    static const boost::regex regex_vasp_matrix_line("^\\s*([0-9.-]+)\\s+([0-9.-]+)\\s+([0-9.-]+)\\s*$");
+    static const boost::regex regex_vasp_version("^(.*[A-Za-z]+.*)$");
+    boost::smatch what;
 
+    HeaderState state = HeaderState::COMMENT;
+    unsigned int lattice_row = 0;
+    unsigned int nr_atoms = 0;
+    bool cartesian = false;
+    size_t offset = 0;
+    std::string line;
     std::vector<std::string> pieces;
-    boost::trim(line);
-    boost::split(pieces, line, boost::is_any_of("\t "), boost::token_compress_on);
-    for(unsigned int i=0; i<pieces.size(); i++) {
-        boost::trim(pieces[i]);
-        this->nrat.push_back(boost::lexical_cast<unsigned int>(pieces[i]));
-    }
 
-    infile.close();
-}
+    this->nrat.clear();
+    this->atom_charges.clear();
+    this->atom_pos.clear();
+    this->vasp5_input = false;
 
-void ScalarField::read_atom_positions() {
-    std::ifstream infile(this->filename.c_str());
-    std::string line;
-    // skip lines that contain atoms
-    for(unsigned int i=0; i<(this->vasp5_input ? 8 : 7); i++) {
-        std::getline(infile, line);
-    }
-
-    // read the atom positions
-    for(unsigned int i=0; i<this->nrat.size(); i++) {
-        for(unsigned int j=0; j<this->nrat[i]; j++) {
-            std::getline(infile, line);
-            boost::trim(line);
-            // std::cout << line << std::endl;
-            std::vector<std::string> pieces;
-            boost::split(pieces, line, boost::is_any_of("\t "), boost::token_compress_on);
-            // std::cout << pieces[0] << std::endl;
-            // std::cout << pieces[1] << std::endl;
-            // std::cout << pieces[2] << std::endl;
-
-            fpt x = boost::lexical_cast<fpt>(pieces[0]);
-            fpt y = boost::lexical_cast<fpt>(pieces[1]);
-            fpt z = boost::lexical_cast<fpt>(pieces[2]);
-
-            this->atom_pos.push_back(Vec3(x,y,z));
+    while(state != HeaderState::DONE && std::getline(infile, line)) {
+        offset += line.size() + (infile.eof() ? 0 : 1);
+        if(!line.empty() && line.back() == '\r') {
+            line.pop_back();
         }
+
+        switch(state) {
+            case HeaderState::COMMENT:
+                this->comment = line;
+                state = HeaderState::SCALAR;
+            break;
+            case HeaderState::SCALAR:
+                if(boost::regex_match(line, what, regex_scalar)) {
+                    this->scalar = boost::lexical_cast<fpt>(what[1]);
+                } else {
+                    this->scalar = -1;
+                }
+                state = HeaderState::LATTICE;
+            break;
+            case HeaderState::LATTICE:
+                if(!boost::regex_match(line, what, regex_vasp_matrix_line)) {
+                    throw std::runtime_error("Error encountered in reading unitcell matrix from " + this->filename);
+                }
+                for(unsigned int j=0; j<3; j++) {
+                    this->mat(lattice_row,j) = boost::lexical_cast<fpt>(what[j+1]) * this->scalar;
+                }
+                if(++lattice_row == 3) {
+                    // calculate matrix inverse and volume of unit cell
+                    this->imat = this->mat.inverse();
+                    this->volume = this->mat.determinant();
+                    state = HeaderState::ELEMENTS;
+                }
+            break;
+            case HeaderState::ELEMENTS:
+                // VASP5 files list the elements before the number of atoms
+                if(boost::regex_match(line, what, regex_vasp_version)) {
+                    this->vasp5_input = true;
+                    boost::trim(line);
+                    boost::split(pieces, line, boost::is_any_of("\t "), boost::token_compress_on);
+                    for(const auto& piece : pieces) {
+                        this->atom_charges.push_back(PeriodicTable::get().get_elnr(piece));
+                    }
+                    state = HeaderState::COUNTS;
+                    break;
+                }
+                [[fallthrough]];
+            case HeaderState::COUNTS:
+                boost::trim(line);
+                boost::split(pieces, line, boost::is_any_of("\t "), boost::token_compress_on);
+                try {
+                    for(const auto& piece : pieces) {
+                        this->nrat.push_back(boost::lexical_cast<unsigned int>(piece));
+                        nr_atoms += this->nrat.back();
+                    }
+                } catch(const boost::bad_lexical_cast&) {
+                    throw std::runtime_error("Error encountered in reading number of atoms from " + this->filename);
+                }
+                state = HeaderState::COORDINATE_MODE;
+            break;
+            case HeaderState::COORDINATE_MODE:
+                boost::trim(line);
+                // skip the (optional) selective dynamics line
+                if(!line.empty() && (line[0] == 'S' || line[0] == 's')) {
+                    break;
+                }
+                cartesian = !line.empty() && (line[0] == 'C' || line[0] == 'c' || line[0] == 'K' || line[0] == 'k');
+                state = nr_atoms > 0 ? HeaderState::POSITIONS : HeaderState::GRID_DIMENSIONS;
+            break;
+            case HeaderState::POSITIONS: {
+                boost::trim(line);
+                boost::split(pieces, line, boost::is_any_of("\t "), boost::token_compress_on);
+                if(pieces.size() < 3) {
+                    throw std::runtime_error("Error encountered in reading atomic positions from " + this->filename);
+                }
+                Vec3 pos(boost::lexical_cast<fpt>(pieces[0]),
+                         boost::lexical_cast<fpt>(pieces[1]),
+                         boost::lexical_cast<fpt>(pieces[2]));
+                if(cartesian) {
+                    pos = this->imat.transpose() * (pos * std::fabs(this->scalar));
+                }
+                this->atom_pos.push_back(pos);
+                if(this->atom_pos.size() == nr_atoms) {
+                    state = HeaderState::GRID_DIMENSIONS;
+                }
+            }
+            break;
+            case HeaderState::GRID_DIMENSIONS:
+                boost::trim(line);
+                // skip the empty line that separates the atoms from the grid
+                if(line.empty()) {
+                    break;
+                }
+                this->gridline = line;
+                boost::split(pieces, line, boost::is_any_of("\t "), boost::token_compress_on);
+                if(pieces.size() != 3) {
+                    throw std::runtime_error("Error encountered in reading grid dimensions from " + this->filename);
+                }
+                for(unsigned int i=0; i<3; i++) {
+                    this->grid_dimensions[i] = boost::lexical_cast<unsigned int>(pieces[i]);
+                }
+                this->gridsize = (size_t)this->grid_dimensions[0] * this->grid_dimensions[1] * this->grid_dimensions[2];
+                this->grid_offset = offset;
+                state = HeaderState::DONE;
+            break;
+            case HeaderState::DONE:
+            break;
+        }
+    }
+
+    if(state != HeaderState::DONE) {
+        throw std::runtime_error("Unexpected end of header encountered in " + this->filename);
     }
 
-    infile.close();
+    this->header_read = true;
 }
 
 /*
- * void read_grid_dimensions()
+ * void read_grid()
+ *
+ * Read all the grid points. This function depends
+ * on the the gridsize and the grid offset being set
+ * via the read_header() function.
  *
- * Read the number of gridpoints in each
- * direction.
+ * The grid is read by the reader for the format of the
+ * file (see FieldReader). For VASP files, the file is
+ * memory-mapped and exactly gridsize values are tokenized
+ * straight into the preallocated grid, distributing the
+ * work over all available threads. Compressed files and
+ * standard input are tokenized while being decompressed
+ * by a StreamReader.
  *
- * Note that all read_* functions can
- * be used seperately, although they may depend
- * on each other and have to be used in some
- * consecutive order as is done in the read()
- * wrapper function.
+ * When a valid entry of the grid cache (see GridCache)
+ * exists, it is mapped instead; otherwise the entry is
+ * written in the background after parsing. Only the
+ * total density is cached.
  *
  */
-void ScalarField::read_grid_dimensions() {
-    std::ifstream infile(this->filename.c_str());
-    std::string line;
-    // skip lines
-    for(unsigned int i=0; i<(this->vasp5_input ? 10 : 9); i++) {
-        std::getline(infile, line);
+void ScalarField::read_grid() {
+    this->read_header_and_atoms();
+
+    if(this->spin != SpinDensity::Component::TOTAL && !this->reader->has_spin_components()) {
+        throw std::runtime_error(std::string("Cannot select the ") + SpinDensity::get_name(this->spin) +
+                                 " component; " + this->filename + " holds a single grid");
     }
 
-    // // skip atom positions
-    for(unsigned int i=0; i<this->nrat.size(); i++) {
-        for(unsigned int j=0; j<this->nrat[i]; j++) {
-            std::getline(infile, line);
-        }
+    // binary files are mapped as is
+    if(this->binary_input) {
+        BinaryField::read_grid(this, this->filename);
+        return;
     }
 
-    boost::trim(line);
-    this->gridline = line;
+    // map the cached grid when the source file has not changed since
+    const std::string cachefile = this->spin == SpinDensity::Component::TOTAL && this->reader->is_cacheable() ?
+                                  GridCache::locate(this->filename) : "";
+    if(this->read_grid_from_cache(cachefile)) {
+        return;
+    }
 
-    std::vector<std::string> pieces;
-    boost::split(pieces, line, boost::is_any_of("\t "), boost::token_compress_on);
-    for(unsigned int i=0; i<pieces.size(); i++) {
-        this->grid_dimensions[i] = boost::lexical_cast<unsigned int>(pieces[i]);
+    this->slab_loader.reset();
+    this->gridptr.allocate(this->gridsize);
+    try {
+        this->reader->read_grid(this);
+    } catch(...) {
+        this->gridptr.clear();
+        throw;
     }
 
-    this->gridsize = this->grid_dimensions[0] * this->grid_dimensions[1] * this->grid_dimensions[2];
-    this->header_read = true;
+    this->has_read = true;
 
-    infile.close();
+    // the grid is only read from here on, so the cache can be written
+    // concurrently; the future blocks on destruction until it is done
+    if(!cachefile.empty()) {
+        this->cache_writer = std::async(std::launch::async, GridCache::store, std::cref(*this), cachefile);
+    }
 }
 
-/*
- * void read_grid()
- *
- * Read all the grid points. This function depends
- * on the the gridsize being set via the
- * read_grid_dimensions() function.
+/**
+ * @brief      map the grid from the grid cache
  *
- * Note that all read_* functions can
- * be used seperately, although they may depend
- * on each other and have to be used in some
- * consecutive order as is done in the read()
- * wrapper function.
+ * @param[in]  cachefile  path to the cache entry (may be empty)
  *
+ * @return     whether a valid cache entry was mapped
  */
-void ScalarField::read_grid() {
-    this->read_header_and_atoms();
+bool ScalarField::read_grid_from_cache(const std::string& cachefile) {
+    if(cachefile.empty() || !GridCache::is_valid(cachefile, this->filename, this->flag_is_locpot)) {
+        return false;
+    }
 
-    this->infile.open(this->filename.c_str());
-    std::string line;
-    // skip irrelevant lines
-    for(unsigned int i=0; i<(this->vasp5_input ? 10 : 9); i++) {
-        std::getline(this->infile, line);
+    try {
+        BinaryField::read_grid(this, cachefile);
+        GridCache::touch(cachefile);
+        this->stream_reader.reset();
+        return true;
+    } catch(const std::exception&) {
+        // fall back to parsing the file
+        return false;
     }
-    for(unsigned int i=0; i<this->atom_pos.size(); i++) {
-        std::getline(this->infile, line);
+}
+
+/**
+ * @brief      parse the grid of a VASP file into the allocated grid
+ *
+ * The grid is read by element count; anything beyond the first gridsize
+ * values (augmentation occupancies, spin density) is not touched unless
+ * another spin component than the total density has been selected.
+ */
+void ScalarField::parse_grid() {
+    // For CHGCAR type files, the electron density is multiplied by the cell volume
+    // as described by the link below:
+    // https://cms.mpi.univie.ac.at/vasp/vasp/CHGCAR_file.html#file-chgcar
+    // Hence, for these files, we have to divide the value at the grid point by the
+    // cell volume. For LOCPOT files, we should *not* do this.
+    const fpt divisor = this->flag_is_locpot ? 1.0f : this->volume;
+
+    if(this->spin != SpinDensity::Component::TOTAL) {
+        this->parse_spin_grids(divisor);
+        return;
     }
 
-    float_parser p;
+    size_t nread = 0;
+    if(this->streamed_input) {
+        // continue reading the stream where read_header() left off
+        if(!this->stream_reader) {
+            this->read_header();
+        }
+        nread = this->stream_reader->parse_block(this->gridptr.data(), this->gridsize, divisor);
+        this->stream_reader.reset();
+    } else {
+        // directly jump to the start of the grid as found by read_header()
+        MappedFile mf(this->filename);
+        const char* p = mf.data() + std::min(this->grid_offset, mf.size());
+        const char* end = mf.end();
+        mf.advise_sequential(p - mf.data(), end - p);
+        nread = FloatTokenizer::parse_block_parallel(p, end, this->gridptr.data(), this->gridsize, divisor);
+    }
 
-    /* read spin up */
-    unsigned int linecounter=0; // for the counter
-    static const boost::regex regex_augmentation("augmentation.*");
+    if(nread != this->gridsize) {
+        throw std::runtime_error("Could only read " + std::to_string(nread) + " out of " +
+                                 std::to_string(this->gridsize) + " grid points from " +
+                                 this->filename);
+    }
+}
 
-    while(std::getline(this->infile, line)) {
-        // stop looping when a second gridline appears (this
-        // is where the spin down part starts)
-        if(line.compare(this->gridline) == 0) {
-            std::cout << "I am breaking the loop" << std::endl;
-            break;
+/**
+ * @brief      parse the grids of a VASP file from which the selected
+ *             spin component is derived
+ *
+ * For mapped files, the grids are located by seeking past them (see
+ * VaspReader::locate_grids) such that only the required grids are
+ * tokenized. Sequential inputs cannot seek; there, every grid is parsed
+ * in the same pass over the stream. The first required grid is parsed
+ * into the grid itself, in which the component is then assembled.
+ *
+ * @param[in]  divisor  value by which each number is divided
+ */
+void ScalarField::parse_spin_grids(fpt divisor) {
+    const auto check = [this](size_t nread) {
+        if(nread != this->gridsize) {
+            throw std::runtime_error("Could only read " + std::to_string(nread) + " out of " +
+                                     std::to_string(this->gridsize) + " grid points from " +
+                                     this->filename);
         }
+    };
 
-        boost::smatch what;
-        if(boost::regex_match(line, what, regex_augmentation)) {
-            std::cout << "Augmentation break encountered" << std::endl;
-            break;
-        }
+    std::deque<GridBuffer> buffers;     // grids besides the one in gridptr
+    std::vector<const fpt*> grids;
 
-        // set iterators
-        std::string::const_iterator b = line.begin();
-        std::string::const_iterator e = line.end();
-
-        // parse
-        std::vector<fpt> fpts;
-        boost::spirit::qi::phrase_parse(b, e, p, boost::spirit::ascii::space, fpts);
-
-        // expand gridptr with the new size
-        unsigned int cursize = this->gridptr.size();
-        this->gridptr.resize(cursize + fpts.size());
-
-        // For CHGCAR type files, the electron density is multiplied by the cell volume
-        // as described by the link below:
-        // https://cms.mpi.univie.ac.at/vasp/vasp/CHGCAR_file.html#file-chgcar
-        // Hence, for these files, we have to divide the value at the grid point by the
-        // cell volume. For LOCPOT files, we should *not* do this.
-        if(this->flag_is_locpot) {      // LOCPOT type files
-            for(unsigned int j=0; j<fpts.size(); j++) {
-                this->gridptr[cursize + j] = fpts[j];
-            }
-        } else {    // CHGCAR type files
-            for(unsigned int j=0; j<fpts.size(); j++) {
-                this->gridptr[cursize + j] = fpts[j] / this->volume;
+    if(this->streamed_input) {
+        if(!this->stream_reader) {
+            this->read_header();
+        }
+        check(this->stream_reader->parse_block(this->gridptr.data(), this->gridsize, divisor));
+        std::vector<const fpt*> all = {this->gridptr.data()};
+
+        // every repetition of the grid dimensions starts another grid
+        std::istream in(this->stream_reader.get());
+        std::string line;
+        while(std::getline(in, line)) {
+            std::istringstream iss(line);
+            std::array<unsigned int, 3> dims;
+            std::string rest;
+            if(iss >> dims[0] >> dims[1] >> dims[2] && !(iss >> rest) && dims == this->grid_dimensions) {
+                buffers.emplace_back();
+                buffers.back().allocate(this->gridsize);
+                check(this->stream_reader->parse_block(buffers.back().data(), this->gridsize, divisor));
+                all.push_back(buffers.back().data());
             }
         }
+        this->stream_reader.reset();
 
-        linecounter++;
-
-        if(this->gridptr.size() >= this->gridsize) {
-            this->has_read = true;
+        for(unsigned int idx : SpinDensity::get_grids(this->spin, all.size(), this->filename)) {
+            grids.push_back(all[idx]);
+        }
+    } else {
+        MappedFile mf(this->filename);
+        const char* start = mf.data() + std::min(this->grid_offset, mf.size());
+        const auto all = VaspReader::locate_grids(start, mf.end(), this->grid_dimensions);
+        for(unsigned int idx : SpinDensity::get_grids(this->spin, all.size(), this->filename)) {
+            fpt* out = this->gridptr.data();
+            if(!grids.empty()) {
+                buffers.emplace_back();
+                buffers.back().allocate(this->gridsize);
+                out = buffers.back().data();
+            }
+            const char* p = all[idx];
+            check(FloatTokenizer::parse_block_parallel(p, mf.end(), out, this->gridsize, divisor));
+            grids.push_back(out);
         }
     }
 
-    infile.close();
+    // the first grid may be overwritten in place
+    if(grids[0] != this->gridptr.data()) {
+        std::copy(grids[0], grids[0] + this->gridsize, this->gridptr.data());
+        grids[0] = this->gridptr.data();
+    }
+    SpinDensity::combine(this->spin, grids, this->gridptr.data(), this->gridsize);
 }
 
 /*
@@ -454,47 +567,127 @@ void ScalarField::read_grid() {
  * The trilinear interpolation algorithm has been extracted from:
  * http://paulbourke.net/miscellaneous/interpolation/
  *
- * Future algorithm can make use of a cubic interpolation.
+ * A cubic B-spline interpolation can be selected instead (see
+ * set_interpolation()).
+ *
+ * Points outside the unit cell yield zero. When the grid has been
+ * padded (see pad()) or tiled (see tile()), the cells are read from
+ * that copy.
  *
  */
 fpt ScalarField::get_value_interp(fpt x, fpt y, fpt z) const {
-    if(!this->is_inside(x,y,z)) {
+    // the direct coordinates serve both the test and the interpolation
+    const Vec3 d = this->realspace_to_direct(x,y,z);
+    if(!(d[0] >= 0 && d[0] <= 1.0 && d[1] >= 0 && d[1] <= 1.0 && d[2] >= 0 && d[2] <= 1.0)) {
         return 0.0f;
     }
 
+    return this->get_value_interp_direct(d);
+}
+
+/**
+ * @brief      interpolation at a position in direct coordinates
+ *
+ * @param[in]  d     direct coordinates (inside the unit cell)
+ *
+ * @return     interpolated value
+ */
+fpt ScalarField::get_value_interp_direct(const Vec3& d) const {
+    if(this->spline) {
+        return this->spline->get_value_bspline(d[0], d[1], d[2]);
+    }
+    if(this->tiles) {
+        return this->tiles->get_value_interp(d[0], d[1], d[2]);
+    }
+    if(this->padded) {
+        return this->padded->get_value_interp(d[0], d[1], d[2]);
+    }
+
     // cast the input to grid space
-    Vec3 r = this->realspace_to_grid(x,y,z);// - Vec3(0.5f, 0.5f, 0.5f);
-
-    // recast
-    if(r[0] < 0) r[0] += (fpt)this->grid_dimensions[0];
-    if(r[1] < 0) r[1] += (fpt)this->grid_dimensions[1];
-    if(r[2] < 0) r[2] += (fpt)this->grid_dimensions[2];
-
-    // calculate value using trilinear interpolation
-    fpt xd = remainderf(r[0], 1.0);
-    fpt yd = remainderf(r[1], 1.0);
-    fpt zd = remainderf(r[2], 1.0);
-
-    if(xd < 0.0f) xd += 1.0f;
-    if(yd < 0.0f) yd += 1.0f;
-    if(zd < 0.0f) zd += 1.0f;
-
-    fpt x0 = fmod(floor(r[0]), this->grid_dimensions[0]);
-    fpt x1 = fmod(ceil(r[0]), this->grid_dimensions[0]);
-    fpt y0 = fmod(floor(r[1]), this->grid_dimensions[1]);
-    fpt y1 = fmod(ceil(r[1]), this->grid_dimensions[1]);
-    fpt z0 = fmod(floor(r[2]), this->grid_dimensions[2]);
-    fpt z1 = fmod(ceil(r[2]), this->grid_dimensions[2]);
-
-    return
-    this->get_value(x0, y0, z0) * (1.0 - xd) * (1.0 - yd) * (1.0 - zd) +
-    this->get_value(x1, y0, z0) * xd                 * (1.0 - yd) * (1.0 - zd) +
-    this->get_value(x0, y1, z0) * (1.0 - xd) * yd                 * (1.0 - zd) +
-    this->get_value(x0, y0, z1) * (1.0 - xd) * (1.0 - yd) * zd                 +
-    this->get_value(x1, y0, z1) * xd                 * (1.0 - yd) * zd                 +
-    this->get_value(x0, y1, z1) * (1.0 - xd) * yd                 * zd                 +
-    this->get_value(x1, y1, z0) * xd                 * yd                 * (1.0 - zd) +
-    this->get_value(x1, y1, z1) * xd                 * yd                 * zd;
+    return this->interp_grid(Vec3(d[0] * fpt(this->grid_dimensions[0]),
+                                  d[1] * fpt(this->grid_dimensions[1]),
+                                  d[2] * fpt(this->grid_dimensions[2])));
+}
+
+/**
+ * @brief      trilinear interpolation at a position in grid space
+ *
+ * @param[in]  r     position in grid space (inside the unit cell)
+ *
+ * @return     interpolated value
+ */
+fpt ScalarField::interp_grid(Vec3 r) const {
+    // lower and upper corner of the cell; a point on the upper face of the
+    // unit cell coincides with the lower one
+    unsigned int c0[3], c1[3];
+    fpt w[3];
+    for(unsigned int a=0; a<3; a++) {
+        const fpt f = std::floor(r[a]);
+        w[a] = r[a] - f;
+        c0[a] = (unsigned int)f;
+        if(c0[a] >= this->grid_dimensions[a]) {
+            c0[a] -= this->grid_dimensions[a];
+        }
+        c1[a] = c0[a] + (w[a] > 0 ? 1 : 0);
+        if(c1[a] >= this->grid_dimensions[a]) {
+            c1[a] -= this->grid_dimensions[a];
+        }
+    }
+
+    // cells inside a constant brick (e.g. in the vacuum) need no interpolation
+    fpt constant;
+    if(this->bricks && this->bricks->is_constant(c0[0], c0[1], c0[2], c1[0], c1[1], c1[2], &constant)) {
+        return constant;
+    }
+
+    const fpt v00 = this->get_value(c0[0], c0[1], c0[2]);
+    const fpt v10 = this->get_value(c0[0], c1[1], c0[2]);
+    const fpt v01 = this->get_value(c0[0], c0[1], c1[2]);
+    const fpt v11 = this->get_value(c0[0], c1[1], c1[2]);
+    const fpt x00 = v00 + w[0] * (this->get_value(c1[0], c0[1], c0[2]) - v00);
+    const fpt x10 = v10 + w[0] * (this->get_value(c1[0], c1[1], c0[2]) - v10);
+    const fpt x01 = v01 + w[0] * (this->get_value(c1[0], c0[1], c1[2]) - v01);
+    const fpt x11 = v11 + w[0] * (this->get_value(c1[0], c1[1], c1[2]) - v11);
+    const fpt y0 = x00 + w[1] * (x10 - x00);
+    const fpt y1 = x01 + w[1] * (x11 - x01);
+    return y0 + w[2] * (y1 - y0);
+}
+
+/**
+ * @brief      interpolate the grid at a set of points (see BatchSampler)
+ *
+ * Grids in a compact representation are interpolated point by point.
+ *
+ * @param[in]  x         x coordinates in angstrom
+ * @param[in]  y         y coordinates in angstrom
+ * @param[in]  z         z coordinates in angstrom
+ * @param      out       interpolated values
+ * @param[in]  n         number of points
+ * @param[in]  periodic  whether points outside the unit cell are mapped
+ *                       into it; otherwise their value is zero
+ */
+void ScalarField::get_values_interp(const fpt* x, const fpt* y, const fpt* z, fpt* out, size_t n, bool periodic) const {
+    if(this->tiles && !this->spline) {
+        BatchSampler(this->tiles.get(), this->imat).sample(x, y, z, out, n, periodic);
+        return;
+    }
+    if(!(this->compact_storage || this->bricks || this->tiles || this->spline)) {
+        BatchSampler(this->get_grid_ptr(), this->grid_dimensions, this->imat).sample(x, y, z, out, n, periodic);
+        return;
+    }
+
+    #pragma omp parallel for schedule(dynamic, BatchSampler::CHUNK)
+    for(size_t i=0; i<n; i++) {
+        Vec3 d = this->realspace_to_direct(x[i], y[i], z[i]);
+        bool inside = true;
+        for(unsigned int a=0; a<3; a++) {
+            if(periodic) {
+                d[a] -= std::floor(d[a]);
+            }
+            inside = inside && d[a] >= 0 && d[a] <= 1.0;
+        }
+        out[i] = inside ? this->get_value_interp_direct(d) : 0.0f;
+    }
 }
 
 /**
@@ -547,9 +740,20 @@ fpt ScalarField::get_max_direction(unsigned int dim) {
  *
  */
 fpt ScalarField::get_value(unsigned int i, unsigned int j, unsigned int k) const {
-    unsigned int idx = k * this->grid_dimensions[0] * this->grid_dimensions[1] +
-                       j * this->grid_dimensions[0] +
-                       i;
+    if(this->bricks) {
+        return this->bricks->get_value(i, j, k);
+    }
+    if(this->tiles) {
+        return this->tiles->get_value(i, j, k);
+    }
+    if(this->slab_loader) {
+        this->slab_loader->require(k);
+    }
+    // grids may hold more than 2^32 points
+    const size_t idx = ((size_t)k * this->grid_dimensions[1] + j) * this->grid_dimensions[0] + i;
+    if(this->compact_storage) {
+        return HalfFloat::decode(this->compact_grid[idx]);
+    }
     return this->gridptr[idx];
 }
 
@@ -602,11 +806,262 @@ Vec3 ScalarField::realspace_to_direct(fpt x, fpt y, fpt z) const {
 }
 
 fpt ScalarField::get_max() const {
-    return *std::max_element(this->gridptr.begin(), this->gridptr.end());
+    if(this->bricks) {
+        return this->bricks->get_max();
+    }
+    if(this->tiles) {
+        return this->tiles->get_max();
+    }
+    if(this->compact_storage) {
+        return HalfFloat::decode(*std::max_element(this->compact_grid.begin(), this->compact_grid.end(),
+            [](uint16_t a, uint16_t b) {
+                return HalfFloat::decode(a) < HalfFloat::decode(b);
+            }));
+    }
+    const fpt* grid = this->get_grid_ptr();
+    return *std::max_element(grid, grid + this->gridptr.size());
 }
 
 fpt ScalarField::get_min() const {
-    return *std::min_element(this->gridptr.begin(), this->gridptr.end());
+    if(this->bricks) {
+        return this->bricks->get_min();
+    }
+    if(this->tiles) {
+        return this->tiles->get_min();
+    }
+    if(this->compact_storage) {
+        return HalfFloat::decode(*std::min_element(this->compact_grid.begin(), this->compact_grid.end(),
+            [](uint16_t a, uint16_t b) {
+                return HalfFloat::decode(a) < HalfFloat::decode(b);
+            }));
+    }
+    const fpt* grid = this->get_grid_ptr();
+    return *std::min_element(grid, grid + this->gridptr.size());
+}
+
+/**
+ * @brief      store the grid in half precision
+ *
+ * The grid is converted in parallel blocks, after which the original grid
+ * (and the mapping or slab loader backing it) is released.
+ */
+void ScalarField::compact() {
+    if(this->compact_storage) {
+        return;
+    }
+    if(this->bricks) {
+        throw std::runtime_error("Cannot compact the grid of " + this->filename + "; it is stored in bricks.");
+    }
+    if(this->tiles) {
+        throw std::runtime_error("Cannot compact the grid of " + this->filename + "; it is stored in tiles.");
+    }
+    if(!this->has_read) {
+        throw std::runtime_error("Cannot compact the grid of " + this->filename + "; it has not been read.");
+    }
+
+    const fpt* grid = this->get_grid_ptr();
+    const size_t n = this->gridptr.size();
+    this->compact_grid.resize(n);
+
+    static const size_t BLOCK_SIZE = 1 << 16;
+    const size_t nr_blocks = (n + BLOCK_SIZE - 1) / BLOCK_SIZE;
+    #pragma omp parallel for schedule(static)
+    for(size_t b=0; b<nr_blocks; b++) {
+        const size_t start = b * BLOCK_SIZE;
+        HalfFloat::encode_block(grid + start, this->compact_grid.data() + start, std::min(BLOCK_SIZE, n - start));
+    }
+
+    this->release_grid();
+    this->compact_storage = true;
+}
+
+/**
+ * @brief      store the grid in bricks, skipping the vacuum
+ *
+ * @param[in]  threshold  largest spread of the values of a constant brick
+ */
+void ScalarField::sparsify(fpt threshold) {
+    if(this->compact_storage) {
+        throw std::runtime_error("Cannot store the grid of " + this->filename + " in bricks; it has been compacted.");
+    }
+    if(this->tiles) {
+        throw std::runtime_error("Cannot store the grid of " + this->filename + " in bricks; it is stored in tiles.");
+    }
+    if(!this->has_read) {
+        throw std::runtime_error("Cannot store the grid of " + this->filename + " in bricks; it has not been read.");
+    }
+
+    this->bricks = std::make_unique<BrickedGrid>(this->get_grid_ptr(), this->grid_dimensions, threshold);
+    this->release_grid();
+}
+
+/**
+ * @brief      store the grid in cache-blocked tiles
+ *
+ * The tiles are filled in parallel, after which the original grid (and
+ * the mapping backing it) is released.
+ */
+void ScalarField::tile() {
+    if(this->tiles) {
+        return;
+    }
+    if(this->compact_storage || this->bricks) {
+        throw std::runtime_error("Cannot store the grid of " + this->filename + " in tiles; "
+                                 "it is stored in a compact representation.");
+    }
+    if(this->slab_loader) {
+        throw std::runtime_error("Cannot store the grid of " + this->filename + " in tiles; it is read lazily.");
+    }
+    if(!this->has_read) {
+        throw std::runtime_error("Cannot store the grid of " + this->filename + " in tiles; it has not been read.");
+    }
+
+    this->tiles = std::make_unique<TiledGrid>(this->get_grid_ptr(), this->grid_dimensions);
+    this->release_grid();
+}
+
+/**
+ * @brief      add a copy of the grid surrounded by periodic ghost layers
+ *
+ * @return     whether the grid is padded
+ */
+bool ScalarField::pad() {
+    if(this->padded) {
+        return true;
+    }
+    if(!this->has_read || this->compact_storage || this->bricks || this->tiles || this->slab_loader) {
+        return false;
+    }
+
+    this->padded = std::make_unique<PaddedGrid>(this->gridptr.data(), this->grid_dimensions);
+    return true;
+}
+
+/**
+ * @brief      select the interpolation of the grid
+ *
+ * @param[in]  mode  interpolation
+ */
+void ScalarField::set_interpolation(Interpolation mode) {
+    if(mode == Interpolation::LINEAR) {
+        this->spline.reset();
+        return;
+    }
+    if(this->spline) {
+        return;
+    }
+    if(this->compact_storage || this->bricks || this->tiles) {
+        throw std::runtime_error("Cannot interpolate the grid of " + this->filename + " with cubic B-splines; "
+                                 "it is stored in a compact representation.");
+    }
+    if(!this->has_read) {
+        throw std::runtime_error("Cannot interpolate the grid of " + this->filename + " with cubic B-splines; "
+                                 "it has not been read.");
+    }
+
+    const fpt* grid = this->get_grid_ptr();
+    GridBuffer coefficients;
+    coefficients.allocate(this->gridsize, false);
+    std::copy(grid, grid + this->gridsize, coefficients.data());
+    CubicBSpline::prefilter(coefficients.data(), this->grid_dimensions);
+    this->spline = std::make_unique<PaddedGrid>(coefficients.data(), this->grid_dimensions, 2);
+}
+
+/**
+ * @brief      sum of the values in a plane of constant z
+ *
+ * @param[in]  k     index of the plane
+ *
+ * @return     sum
+ */
+fpa ScalarField::get_slab_sum(unsigned int k) const {
+    if(this->bricks) {
+        return this->bricks->get_slab_sum(k);
+    }
+    if(this->tiles) {
+        return this->tiles->get_slab_sum(k);
+    }
+    if(this->slab_loader) {
+        this->slab_loader->require(k);
+    }
+
+    const size_t n = (size_t)this->grid_dimensions[0] * this->grid_dimensions[1];
+    fpa sum = 0.0;
+    if(this->compact_storage) {
+        const uint16_t* slab = this->compact_grid.data() + k * n;
+        #pragma omp parallel for reduction(+:sum)
+        for(size_t i=0; i<n; i++) {
+            sum += HalfFloat::decode(slab[i]);
+        }
+    } else {
+        const fpt* slab = this->gridptr.data() + k * n;
+        #pragma omp parallel for reduction(+:sum)
+        for(size_t i=0; i<n; i++) {
+            sum += slab[i];
+        }
+    }
+    return sum;
+}
+
+/**
+ * @brief      release the grid after it has been converted to a compact
+ *             representation
+ */
+void ScalarField::release_grid() {
+    // the cache writer still reads the original grid
+    if(this->cache_writer.valid()) {
+        this->cache_writer.get();
+    }
+    this->slab_loader.reset();
+    this->padded.reset();
+    this->gridptr.clear();
+}
+
+/**
+ * @brief      number of z-slabs of the grid that have been parsed
+ *
+ * @return     number of slabs
+ */
+unsigned int ScalarField::get_nr_slabs_loaded() const {
+    if(this->slab_loader) {
+        return this->slab_loader->get_nr_loaded();
+    }
+    return this->has_read ? this->grid_dimensions[2] : 0;
+}
+
+/**
+ * @brief      PAW augmentation occupancies of every atom
+ *
+ * The occupancies are skipped when reading the grid and are only parsed
+ * upon the first call of this function, for all grids at once. This
+ * requires an uncompressed VASP file.
+ *
+ * @param[in]  grid  index of the grid (0: total density; see SpinDensity)
+ *
+ * @return     occupancies per atom (empty for files without occupancies)
+ */
+const AugmentationOccupancies& ScalarField::get_augmentation_occupancies(unsigned int grid) {
+    this->read_header_and_atoms();
+
+    if(this->augmentation.empty()) {
+        if(this->streamed_input || this->binary_input || !this->reader->has_fixed_layout()) {
+            throw std::runtime_error("Augmentation occupancies can only be read from uncompressed VASP files, not from " +
+                                     this->filename);
+        }
+
+        MappedFile mf(this->filename);
+        const char* start = mf.data() + std::min(this->grid_offset, mf.size());
+        for(const char* p : VaspReader::locate_grids(start, mf.end(), this->grid_dimensions)) {
+            const char* grid_end = VaspReader::skip_grid(p, mf.end(), this->gridsize);
+            this->augmentation.push_back(VaspReader::read_augmentation(grid_end, mf.end(), this->atom_pos.size()));
+        }
+    }
+
+    if(grid >= this->augmentation.size()) {
+        throw std::runtime_error("Cannot read the augmentation occupancies of grid " + std::to_string(grid) + "; " +
+                                 this->filename + " holds " + std::to_string(this->augmentation.size()) + " grid(s)");
+    }
+    return this->augmentation[grid];
 }
 
 Vec3 ScalarField::get_atom_position(unsigned int atid) const {
@@ -27,7 +27,9 @@
 #include <ios>
 #include <sstream>
 #include <fstream>
+#include <cstring>
 #include <math.h>
+#include <future>
 
 #include <boost/regex.hpp>
 #include <boost/lexical_cast.hpp>
@@ -36,12 +38,23 @@
 #include <boost/filesystem.hpp>
 
 #include "math.h"
-#include "float_parser.h"
+#include "mapped_file.h"
+#include "grid_buffer.h"
+#include "half_float.h"
+#include "bricked_grid.h"
+#include "padded_grid.h"
+#include "tiled_grid.h"
+#include "float_tokenizer.h"
+#include "stream_reader.h"
+#include "slab_loader.h"
+#include "field_reader.h"
 #include "periodic_table.h"
+#include "spin_density.h"
 
 class ScalarField{
 private:
     std::string filename;
+    std::string comment;
     fpt scalar;
 
     MatrixUnitcell mat;
@@ -59,24 +72,61 @@ private:
     std::vector<unsigned int> atom_charges_exp;
 
     std::string gridline;
-    std::vector<fpt> gridptr;
+    GridBuffer gridptr;
     std::vector<fpt> gridptr2;
-    unsigned int gridsize;
+    std::vector<uint16_t> compact_grid;     // half precision copy of the grid (see compact())
+    bool compact_storage;
+    std::unique_ptr<BrickedGrid> bricks;    // block-sparse copy of the grid (see sparsify())
+    std::unique_ptr<PaddedGrid> padded;     // ghost-padded copy of the grid (see pad())
+    std::unique_ptr<PaddedGrid> spline;     // coefficients of the cubic B-spline (see set_interpolation())
+    std::unique_ptr<TiledGrid> tiles;       // cache-blocked copy of the grid (see tile())
+    size_t gridsize;
+    size_t grid_offset;     // byte offset of the grid in the file
     bool vasp5_input;
+    bool binary_input;      // file is in the native binary format
+    const FieldReader* reader;  // reader for the format of the file
+    bool streamed_input;    // file is compressed, archived or read from stdin
+    std::unique_ptr<StreamReader> stream_reader;    // stream positioned after the header
+    std::unique_ptr<SlabLoader> slab_loader;        // loads the grid on demand
     bool has_read;
     bool header_read;
-    std::ifstream infile;
     bool flag_is_locpot;
+    SpinDensity::Component spin;    // spin component that is read into the grid
+    std::vector<AugmentationOccupancies> augmentation;  // per grid; parsed on request
+    std::future<void> cache_writer; // pending write of the grid cache
+
+    friend class BinaryField;
+    friend class CompressedField;
+    friend class FieldInfo;
+    friend class FieldWriter;
+    friend class FieldReader;
 
 public:
+    /**
+     * @brief      interpolation of the grid between the grid points
+     */
+    enum class Interpolation {
+        LINEAR,     // trilinear interpolation
+        CUBIC       // cubic B-spline (see set_interpolation())
+    };
+
 
     /**
      * @brief      constructor
      *
+     * The format of the file (VASP, native binary, compressed, Gaussian cube
+     * or XSF) is detected from its contents; for files in the native binary format,
+     * the LOCPOT flag stored in the file takes precedence.
+     * Compressed files (gzip, bzip2, xz and zstd) are recognized by their
+     * magic bytes and a filename of "-" reads from standard input. Members
+     * of tar archives are designated as "archive.tar.bz2:CHGCAR".
+     *
      * @param[in]  _filename   url to filename
      * @param[in]  _flag_is_locpot  whether this file is a locpot
+     * @param[in]  _spin       spin component to read (see SpinDensity)
      */
-    ScalarField(const std::string &_filename, bool _flag_is_locpot);
+    ScalarField(const std::string &_filename, bool _flag_is_locpot,
+                SpinDensity::Component _spin = SpinDensity::Component::TOTAL);
 
     /*
      * @brief output()
@@ -113,6 +163,15 @@ public:
         return this->flag_is_locpot;
     }
 
+    /**
+     * @brief      spin component that is read into the grid
+     *
+     * @return     spin component
+     */
+    inline SpinDensity::Component get_spin_component() const {
+        return this->spin;
+    }
+
     /*
      * void read()
      *
@@ -123,6 +182,26 @@ public:
      */
     void read();
 
+    /**
+     * @brief      read the header and load the grid on demand
+     *
+     * Only the z-slabs of the grid that are touched by get_value() are
+     * parsed, which is much faster than read() when e.g. a single plane
+     * is extracted. This requires a format whose slabs can be located
+     * directly (VASP files, vaspout.h5 and the lossy compressed format of
+     * CompressedField); other files (and files compressed with e.g. gzip)
+     * are read completely, as are spin components other than the total
+     * density.
+     */
+    void read_lazy();
+
+    /**
+     * @brief      read the header and the atoms of the file
+     *
+     * This function can be called separately from read() to obtain the unit
+     * cell, the atomic positions and the grid dimensions without reading the
+     * (much larger) grid itself.
+     */
     void read_header_and_atoms();
 
     /*
@@ -134,11 +213,44 @@ public:
      * The trilinear interpolation algorithm has been extracted from:
      * http://paulbourke.net/miscellaneous/interpolation/
      *
-     * Future algorithm can make use of a cubic interpolation.
+     * A cubic B-spline interpolation can be selected instead (see
+     * set_interpolation()).
+     *
+     * Points outside the unit cell yield zero. When the grid has been
+     * padded (see pad()) or tiled (see tile()), the cells are read from
+     * that copy.
      *
      */
     fpt get_value_interp(fpt x, fpt y, fpt z) const;
 
+    /**
+     * @brief      interpolation at a position in direct coordinates
+     *
+     * As get_value_interp(), for callers that have established that the
+     * point lies inside the unit cell, e.g. by stepping through a plane in
+     * direct coordinates.
+     *
+     * @param[in]  d     direct coordinates (inside the unit cell)
+     *
+     * @return     interpolated value
+     */
+    fpt get_value_interp_direct(const Vec3& d) const;
+
+    /**
+     * @brief      interpolate the grid at a set of points (see BatchSampler)
+     *
+     * Grids in a compact representation are interpolated point by point.
+     *
+     * @param[in]  x         x coordinates in angstrom
+     * @param[in]  y         y coordinates in angstrom
+     * @param[in]  z         z coordinates in angstrom
+     * @param      out       interpolated values
+     * @param[in]  n         number of points
+     * @param[in]  periodic  whether points outside the unit cell are mapped
+     *                       into it; otherwise their value is zero
+     */
+    void get_values_interp(const fpt* x, const fpt* y, const fpt* z, fpt* out, size_t n, bool periodic = false) const;
+
     /**
      * @brief      test whether point is inside unit cell
      *
@@ -173,104 +285,264 @@ public:
     }
 
     inline const fpt* get_grid_ptr() const {
-        return &this->gridptr[0];
+        if(this->compact_storage || this->bricks || this->tiles) {
+            throw std::runtime_error("The grid of " + this->filename + " is stored in a compact representation "
+                                     "and can only be accessed through get_value()");
+        }
+        // the complete grid is required
+        if(this->slab_loader) {
+            this->slab_loader->require_all();
+        }
+        return this->gridptr.data();
     }
 
-    unsigned int get_size() const {
-        return this->gridptr.size();
+    size_t get_size() const {
+        if(this->bricks) {
+            return this->bricks->get_size();
+        }
+        if(this->tiles) {
+            return this->tiles->get_size();
+        }
+        return this->compact_storage ? this->compact_grid.size() : this->gridptr.size();
     }
 
-    inline const std::string& get_filename() const {
-        return this->filename;
+    /**
+     * @brief      sum of the values in a plane of constant z
+     *
+     * Only this plane of the grid needs to have been loaded.
+     *
+     * @param[in]  k     index of the plane
+     *
+     * @return     sum
+     */
+    fpa get_slab_sum(unsigned int k) const;
+
+    /**
+     * @brief      store the grid in half precision
+     *
+     * The (read) grid is converted to IEEE half precision numbers, which
+     * halves the memory footprint (relative to single precision) and the
+     * memory traffic of the interpolation, at the expense of a relative
+     * error of at most 4.9e-4. Magnitudes below 6.1e-5 lose further
+     * significant digits and magnitudes above 65504 are clamped. The values
+     * are decoded on access by get_value(); get_grid_ptr() is no longer
+     * available.
+     */
+    void compact();
+
+    /**
+     * @brief      whether the grid is stored in half precision
+     *
+     * @return     True if compact, False otherwise.
+     */
+    inline bool is_compact() const {
+        return this->compact_storage;
     }
 
-private:
-    /*
-     * void test_vasp5()
+    /**
+     * @brief      store the grid in bricks, skipping the vacuum
      *
-     * Test if the input file is a VASP5 output file
+     * The (read) grid is divided into bricks of 8x8x8 points (see
+     * BrickedGrid). Bricks whose values span at most the threshold are
+     * replaced by a single value, such that the vacuum of slabs and
+     * molecules takes up hardly any memory and is skipped by the
+     * interpolation and by get_slab_sum(). The extrema are retained
+     * exactly; other values deviate by at most half the threshold.
+     * get_grid_ptr() is no longer available.
      *
+     * @param[in]  threshold  largest spread of the values of a constant brick
      */
-    void test_vasp5();
+    void sparsify(fpt threshold);
 
-    /*
-     * void read_scalar()
+    /**
+     * @brief      block-sparse grid
      *
-     * Read the scalar value from the 2nd line of the
-     * CHGCAR file. Note that all read_* functions can
-     * be used seperately, although they may depend
-     * on each other and have to be used in some
-     * consecutive order as is done in the read()
-     * wrapper function.
+     * @return     grid; nullptr unless sparsify() has been called
+     */
+    inline const BrickedGrid* get_bricked_grid() const {
+        return this->bricks.get();
+    }
+
+    /**
+     * @brief      store the grid in cache-blocked tiles
+     *
+     * The (read) grid is rearranged into tiles of 8x8x8 cells (see
+     * TiledGrid), such that the eight corners of every cell lie close
+     * together in memory. This speeds up the interpolation along planes
+     * that are not aligned with the grid axes, at the expense of at least 40%
+     * more memory. It is only available for grids that are held completely
+     * in single or double precision. get_grid_ptr() is no longer
+     * available.
+     */
+    void tile();
+
+    /**
+     * @brief      cache-blocked grid
      *
+     * @return     grid; nullptr unless tile() has been called
      */
-    void read_scalar();
+    inline const TiledGrid* get_tiled_grid() const {
+        return this->tiles.get();
+    }
 
-    /*
-     * void read_matrix()
+    /**
+     * @brief      add a copy of the grid surrounded by periodic ghost layers
      *
-     * Reads the matrix that defines the unit cell
-     * in the CHGCAR file. The inverse of that matrix
-     * is automatically constructed.
+     * The copy (see PaddedGrid) is used by get_value_interp(), which then
+     * interpolates without wrapping indices. It takes up slightly more
+     * memory than the grid itself and is only made when the complete grid
+     * is held in single or double precision, i.e. not for compact, bricked,
+     * tiled or lazily read grids.
      *
-     * Note that all read_* functions can
-     * be used seperately, although they may depend
-     * on each other and have to be used in some
-     * consecutive order as is done in the read()
-     * wrapper function.
+     * @return     whether the grid is padded
+     */
+    bool pad();
+
+    /**
+     * @brief      select the interpolation of the grid
      *
+     * Cubic B-spline interpolation prefilters a copy of the (read) grid
+     * once (see CubicBSpline); get_value_interp() then evaluates the spline
+     * from the 4x4x4 surrounding coefficients. The spline passes through
+     * the grid points and, unlike trilinear interpolation, has smooth
+     * derivatives, such that fewer samples are needed for smooth contours.
+     * It is not available for grids in a compact or tiled representation.
+     *
+     * @param[in]  mode  interpolation
      */
-    void read_matrix();
+    void set_interpolation(Interpolation mode);
 
-    /*
-     * void read_grid_dimensions()
+    /**
+     * @brief      selected interpolation of the grid
+     */
+    inline Interpolation get_interpolation() const {
+        return this->spline ? Interpolation::CUBIC : Interpolation::LINEAR;
+    }
+
+    /**
+     * @brief      ghost-padded grid
      *
-     * Read the number of gridpoints in each
-     * direction.
+     * @return     grid; nullptr unless pad() has succeeded
+     */
+    inline const PaddedGrid* get_padded_grid() const {
+        return this->padded.get();
+    }
+
+    /**
+     * @brief      whether the file is in the native binary format
      *
-     * Note that all read_* functions can
-     * be used seperately, although they may depend
-     * on each other and have to be used in some
-     * consecutive order as is done in the read()
-     * wrapper function.
+     * @return     True if binary, False otherwise.
+     */
+    inline bool is_binary() const {
+        return this->binary_input;
+    }
+
+    inline const std::string& get_filename() const {
+        return this->filename;
+    }
+
+    /**
+     * @brief      name of the format of the file (e.g. "vasp" or "cube")
      *
+     * @return     name of the format
      */
-    void read_grid_dimensions();
+    inline const char* get_format() const {
+        return this->reader->get_name();
+    }
 
-    /*
-     * void read_nr_atoms()
+    /**
+     * @brief      number of z-slabs of the grid that have been parsed
+     *
+     * @return     number of slabs
+     */
+    unsigned int get_nr_slabs_loaded() const;
+
+    /**
+     * @brief      PAW augmentation occupancies of every atom
      *
-     * Read the number of atoms of each element. These
-     * numbers are used to skip the required amount of
-     * lines.
+     * The occupancies are skipped when reading the grid and are only parsed
+     * upon the first call of this function, for all grids at once. This
+     * requires an uncompressed VASP file.
      *
-     * Note that all read_* functions can
-     * be used seperately, although they may depend
-     * on each other and have to be used in some
-     * consecutive order as is done in the read()
-     * wrapper function.
+     * @param[in]  grid  index of the grid (0: total density; see SpinDensity)
      *
+     * @return     occupancies per atom (empty for files without occupancies)
      */
-    void read_nr_atoms();
+    const AugmentationOccupancies& get_augmentation_occupancies(unsigned int grid = 0);
 
-    void read_atom_positions();
+private:
+    /*
+     * void read_header()
+     *
+     * Read the header of the CHGCAR file in a single pass,
+     * i.e. the scalar, the unit cell matrix, the elements and
+     * number of atoms, the atomic positions and the grid
+     * dimensions. The byte offset of the grid is stored
+     * such that read_grid() can directly seek to it.
+     *
+     */
+    void read_header();
 
     /*
      * void read_grid()
      *
      * Read all the grid points. This function depends
-     * on the the gridsize being set via the
-     * read_grid_dimensions() function.
-     *
-     * Note that all read_* functions can
-     * be used seperately, although they may depend
-     * on each other and have to be used in some
-     * consecutive order as is done in the read()
-     * wrapper function.
+     * on the the gridsize and the grid offset being set
+     * via the read_header() function.
+     *
+     * The grid is read by the reader for the format of the
+     * file (see FieldReader). For VASP files, the file is
+     * memory-mapped and exactly gridsize values are tokenized
+     * straight into the preallocated grid, distributing the
+     * work over all available threads. Compressed files and
+     * standard input are tokenized while being decompressed
+     * by a StreamReader.
+     *
+     * When a valid entry of the grid cache (see GridCache)
+     * exists, it is mapped instead; otherwise the entry is
+     * written in the background after parsing. Only the
+     * total density is cached.
      *
      */
     void read_grid();
 
+    /**
+     * @brief      map the grid from the grid cache
+     *
+     * @param[in]  cachefile  path to the cache entry (may be empty)
+     *
+     * @return     whether a valid cache entry was mapped
+     */
+    bool read_grid_from_cache(const std::string& cachefile);
+
+    /**
+     * @brief      parse the grid of a VASP file into the allocated grid
+     */
+    void parse_grid();
+
+    /**
+     * @brief      parse the grids of a VASP file from which the selected
+     *             spin component is derived
+     *
+     * @param[in]  divisor  value by which each number is divided
+     */
+    void parse_spin_grids(fpt divisor);
+
+    /**
+     * @brief      release the grid after it has been converted to a compact
+     *             representation
+     */
+    void release_grid();
+
+    /**
+     * @brief      trilinear interpolation at a position in grid space
+     *
+     * @param[in]  r     position in grid space (inside the unit cell)
+     *
+     * @return     interpolated value
+     */
+    fpt interp_grid(Vec3 r) const;
+
     /*
      * fpt get_max_direction(dim)
      *
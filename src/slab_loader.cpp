@@ -0,0 +1,174 @@
+/**************************************************************************
+ *                                                                        *
+ *   Author: Ivo Filot <i.a.w.filot@tue.nl>                               *
+ *                                                                        *
+ *   EDP is free software:                                                *
+ *   you can redistribute it and/or modify it under the terms of the      *
+ *   GNU General Public License as published by the Free Software         *
+ *   Foundation, either version 3 of the License, or (at your option)     *
+ *   any later version.                                                   *
+ *                                                                        *
+ *   EDP is distributed in the hope that it will be useful,               *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty          *
+ *   of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.              *
+ *   See the GNU General Public License for more details.                 *
+ *                                                                        *
+ *   You should have received a copy of the GNU General Public License    *
+ *   along with this program.  If not, see http://www.gnu.org/licenses/.  *
+ *                                                                        *
+ **************************************************************************/
+
+#include "slab_loader.h"
+#include "float_tokenizer.h"
+
+#include <algorithm>
+#include <exception>
+#include <stdexcept>
+
+/**
+ * @brief      create a loader when the grid has a fixed layout
+ *
+ * @param[in]  mf                mapped file holding the grid
+ * @param[in]  offset            byte offset of the grid (start of a line)
+ * @param      grid              (allocated) storage for the grid
+ * @param[in]  grid_dimensions   dimensions of the grid
+ * @param[in]  divisor           value by which each number is divided
+ *
+ * @return     loader; empty if the layout of the grid is not fixed
+ */
+std::unique_ptr<SlabLoader> SlabLoader::create(const std::shared_ptr<MappedFile>& mf, size_t offset, fpt* grid,
+                                               const std::array<unsigned int, 3>& grid_dimensions, fpt divisor) {
+    const size_t slab_size = (size_t)grid_dimensions[0] * grid_dimensions[1];
+    const size_t n = slab_size * grid_dimensions[2];
+    if(n == 0 || offset >= mf->size()) {
+        return nullptr;
+    }
+
+    const char* begin = mf->data() + offset;
+    size_t line_width = 0;
+    size_t values_per_line = 0;
+    if(!FloatTokenizer::detect_fixed_layout(begin, mf->end(), n, &line_width, &values_per_line)) {
+        return nullptr;
+    }
+
+    std::unique_ptr<SlabLoader> loader(new SlabLoader());
+    loader->mf = mf;
+    loader->begin = begin;
+    loader->line_width = line_width;
+    loader->values_per_line = values_per_line;
+    loader->divisor = divisor;
+    loader->initialize(grid, grid_dimensions);
+
+    return loader;
+}
+
+/**
+ * @brief      create a loader that obtains the slabs from a function
+ *
+ * @param[in]  source            function reading a single slab
+ * @param      grid              (allocated) storage for the grid
+ * @param[in]  grid_dimensions   dimensions of the grid
+ *
+ * @return     loader
+ */
+std::unique_ptr<SlabLoader> SlabLoader::create(const SlabSource& source, fpt* grid,
+                                               const std::array<unsigned int, 3>& grid_dimensions) {
+    std::unique_ptr<SlabLoader> loader(new SlabLoader());
+    loader->source = source;
+    loader->initialize(grid, grid_dimensions);
+
+    return loader;
+}
+
+/**
+ * @brief      load all remaining slabs using all available threads
+ */
+void SlabLoader::require_all() {
+    // exceptions cannot cross the boundary of the parallel region
+    std::exception_ptr error;
+    #pragma omp parallel for schedule(dynamic)
+    for(unsigned int k=0; k<this->nr_slabs; k++) {
+        try {
+            this->require(k);
+        } catch(...) {
+            #pragma omp critical
+            error = std::current_exception();
+        }
+    }
+
+    if(error) {
+        std::rethrow_exception(error);
+    }
+}
+
+/**
+ * @brief      number of slabs that have been loaded
+ */
+unsigned int SlabLoader::get_nr_loaded() const {
+    unsigned int count = 0;
+    for(unsigned int k=0; k<this->nr_slabs; k++) {
+        count += this->loaded[k].load() ? 1 : 0;
+    }
+    return count;
+}
+
+/**
+ * @brief      parse a single slab
+ *
+ * @param[in]  k     index of the slab
+ */
+void SlabLoader::load(unsigned int k) {
+    std::lock_guard<std::mutex> lock(this->locks[k]);
+    if(this->loaded[k].load(std::memory_order_relaxed)) {
+        return;
+    }
+
+    const size_t i0 = k * this->slab_size;
+    if(this->source) {
+        this->source(k, this->grid + i0);
+        this->loaded[k].store(true, std::memory_order_release);
+        return;
+    }
+
+    // the slab generally starts halfway a line; skip the preceding values
+    const size_t line = i0 / this->values_per_line;
+    const char* p = this->begin + line * this->line_width;
+    const char* end = this->mf->end();
+    double value;
+    for(size_t i=line * this->values_per_line; i<i0; i++) {
+        FloatTokenizer::parse(p, end, value);
+    }
+
+    const size_t line_end = (i0 + this->slab_size + this->values_per_line - 1) / this->values_per_line;
+    end = std::min(end, this->begin + line_end * this->line_width);
+    if(FloatTokenizer::parse_block(p, end, this->grid + i0, this->slab_size, this->divisor) != this->slab_size) {
+        throw std::runtime_error("Could not read slab " + std::to_string(k) + " from " + this->mf->get_filename());
+    }
+
+    // except for the last, the slab should be consumed up to its final line
+    // ending; the values following it on that line belong to the next slab
+    if(k + 1 < this->nr_slabs) {
+        for(size_t i=i0 + this->slab_size; i<line_end * this->values_per_line; i++) {
+            FloatTokenizer::parse(p, end, value);
+        }
+        if(FloatTokenizer::skip_whitespace(p, end) != end) {
+            throw std::runtime_error("Unexpected data at the end of slab " + std::to_string(k) + " in " + this->mf->get_filename());
+        }
+    }
+
+    this->loaded[k].store(true, std::memory_order_release);
+}
+
+/**
+ * @brief      set up the bookkeeping of the slabs
+ */
+void SlabLoader::initialize(fpt* _grid, const std::array<unsigned int, 3>& grid_dimensions) {
+    this->grid = _grid;
+    this->slab_size = (size_t)grid_dimensions[0] * grid_dimensions[1];
+    this->nr_slabs = grid_dimensions[2];
+    this->loaded.reset(new std::atomic<bool>[this->nr_slabs]);
+    this->locks.reset(new std::mutex[this->nr_slabs]);
+    for(unsigned int k=0; k<this->nr_slabs; k++) {
+        this->loaded[k].store(false);
+    }
+}
@@ -0,0 +1,129 @@
+/**************************************************************************
+ *                                                                        *
+ *   Author: Ivo Filot <i.a.w.filot@tue.nl>                               *
+ *                                                                        *
+ *   EDP is free software:                                                *
+ *   you can redistribute it and/or modify it under the terms of the      *
+ *   GNU General Public License as published by the Free Software         *
+ *   Foundation, either version 3 of the License, or (at your option)     *
+ *   any later version.                                                   *
+ *                                                                        *
+ *   EDP is distributed in the hope that it will be useful,               *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty          *
+ *   of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.              *
+ *   See the GNU General Public License for more details.                 *
+ *                                                                        *
+ *   You should have received a copy of the GNU General Public License    *
+ *   along with this program.  If not, see http://www.gnu.org/licenses/.  *
+ *                                                                        *
+ **************************************************************************/
+
+#ifndef _SLAB_LOADER_H
+#define _SLAB_LOADER_H
+
+#include <array>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+
+#include "math.h"
+#include "mapped_file.h"
+
+/**
+ * @brief      On-demand loader for the z-slabs of a grid
+ *
+ * VASP writes the grid in lines of fixed width, such that the byte offset
+ * of every value (and hence of every xy-slab) follows from its index. A
+ * slab is only parsed the first time one of its values is requested; slabs
+ * that are never touched are never read from disk. Slabs can be requested
+ * concurrently from multiple threads.
+ *
+ * Formats that can address slabs in another way (e.g. HDF5 hyperslabs)
+ * supply a function that reads a single slab instead.
+ */
+class SlabLoader {
+public:
+    // reads slab k into the given storage (holding one slab)
+    typedef std::function<void(unsigned int, fpt*)> SlabSource;
+
+private:
+    SlabSource source;          // empty when the slabs are parsed from mf
+    std::shared_ptr<MappedFile> mf;
+    const char* begin;          // start of the grid in the file
+    size_t line_width;          // number of bytes per line
+    size_t values_per_line;     // number of values per line
+
+    fpt* grid;
+    size_t slab_size;           // number of values per slab
+    unsigned int nr_slabs;
+    fpt divisor;
+
+    std::unique_ptr<std::atomic<bool>[]> loaded;
+    std::unique_ptr<std::mutex[]> locks;
+
+public:
+    /**
+     * @brief      create a loader when the grid has a fixed layout
+     *
+     * @param[in]  mf                mapped file holding the grid
+     * @param[in]  offset            byte offset of the grid (start of a line)
+     * @param      grid              (allocated) storage for the grid
+     * @param[in]  grid_dimensions   dimensions of the grid
+     * @param[in]  divisor           value by which each number is divided
+     *
+     * @return     loader; empty if the layout of the grid is not fixed
+     */
+    static std::unique_ptr<SlabLoader> create(const std::shared_ptr<MappedFile>& mf, size_t offset, fpt* grid,
+                                              const std::array<unsigned int, 3>& grid_dimensions, fpt divisor);
+
+    /**
+     * @brief      create a loader that obtains the slabs from a function
+     *
+     * @param[in]  source            function reading a single slab
+     * @param      grid              (allocated) storage for the grid
+     * @param[in]  grid_dimensions   dimensions of the grid
+     *
+     * @return     loader
+     */
+    static std::unique_ptr<SlabLoader> create(const SlabSource& source, fpt* grid,
+                                              const std::array<unsigned int, 3>& grid_dimensions);
+
+    /**
+     * @brief      make sure a slab has been loaded
+     *
+     * @param[in]  k     index of the slab (z-coordinate)
+     */
+    inline void require(unsigned int k) {
+        if(!this->loaded[k].load(std::memory_order_acquire)) {
+            this->load(k);
+        }
+    }
+
+    /**
+     * @brief      load all remaining slabs using all available threads
+     */
+    void require_all();
+
+    /**
+     * @brief      number of slabs that have been loaded
+     */
+    unsigned int get_nr_loaded() const;
+
+private:
+    SlabLoader() = default;
+
+    /**
+     * @brief      set up the bookkeeping of the slabs
+     */
+    void initialize(fpt* grid, const std::array<unsigned int, 3>& grid_dimensions);
+
+    /**
+     * @brief      parse a single slab
+     *
+     * @param[in]  k     index of the slab
+     */
+    void load(unsigned int k);
+};
+
+#endif // _SLAB_LOADER_H
@@ -0,0 +1,146 @@
+/**************************************************************************
+ *                                                                        *
+ *   Author: Ivo Filot <i.a.w.filot@tue.nl>                               *
+ *                                                                        *
+ *   EDP is free software:                                                *
+ *   you can redistribute it and/or modify it under the terms of the      *
+ *   GNU General Public License as published by the Free Software         *
+ *   Foundation, either version 3 of the License, or (at your option)     *
+ *   any later version.                                                   *
+ *                                                                        *
+ *   EDP is distributed in the hope that it will be useful,               *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty          *
+ *   of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.              *
+ *   See the GNU General Public License for more details.                 *
+ *                                                                        *
+ *   You should have received a copy of the GNU General Public License    *
+ *   along with this program.  If not, see http://www.gnu.org/licenses/.  *
+ *                                                                        *
+ **************************************************************************/
+
+#include "spin_density.h"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+namespace {
+
+static const char* const NAMES[] = {"total", "up", "down", "mag", "mx", "my", "mz"};
+
+} // namespace
+
+/**
+ * @brief      get a component from its name
+ *
+ * @param[in]  name  name (total, up, down, mag, mx, my or mz)
+ *
+ * @return     component
+ */
+SpinDensity::Component SpinDensity::parse(const std::string& name) {
+    for(unsigned int i=0; i<sizeof(NAMES) / sizeof(NAMES[0]); i++) {
+        if(name == NAMES[i]) {
+            return static_cast<Component>(i);
+        }
+    }
+    throw std::runtime_error("Unknown spin component " + name);
+}
+
+/**
+ * @brief      get the name of a component
+ *
+ * @param[in]  component  component
+ *
+ * @return     name
+ */
+const char* SpinDensity::get_name(Component component) {
+    return NAMES[static_cast<unsigned int>(component)];
+}
+
+/**
+ * @brief      indices of the grids from which a component is derived
+ *
+ * @param[in]  component  component
+ * @param[in]  nr_grids   number of grids in the file
+ * @param[in]  filename   name of the file (for error messages)
+ *
+ * @return     indices of the grids, in the order expected by combine()
+ */
+std::vector<unsigned int> SpinDensity::get_grids(Component component, unsigned int nr_grids, const std::string& filename) {
+    if(component == Component::TOTAL) {
+        return {0};
+    }
+
+    const bool collinear = nr_grids == 2;
+    const bool noncollinear = nr_grids == 4;
+    if(!collinear && !noncollinear) {
+        throw std::runtime_error("Cannot select the " + std::string(get_name(component)) + " component; " +
+                                 filename + " holds " + std::to_string(nr_grids) + " grid(s) instead of 2 or 4");
+    }
+    if((component == Component::MX || component == Component::MY) && !noncollinear) {
+        throw std::runtime_error("Cannot select the " + std::string(get_name(component)) + " component; " +
+                                 filename + " is not from a non-collinear calculation");
+    }
+
+    const unsigned int mz = nr_grids - 1;
+    switch(component) {
+        case Component::UP:
+        case Component::DOWN:
+            return {0, mz};
+        case Component::MAG:
+            return collinear ? std::vector<unsigned int>{1} : std::vector<unsigned int>{1, 2, 3};
+        case Component::MX:
+            return {1};
+        case Component::MY:
+            return {2};
+        default:
+            return {mz};
+    }
+}
+
+/**
+ * @brief      derive a component from its grids
+ *
+ * @param[in]  component  component
+ * @param[in]  grids      grids as listed by get_grids()
+ * @param      out        output grid (may coincide with the first grid)
+ * @param[in]  n          number of grid points
+ */
+void SpinDensity::combine(Component component, const std::vector<const fpt*>& grids, fpt* out, size_t n) {
+    const fpt* a = grids[0];
+    const fpt* b = grids.size() > 1 ? grids[1] : nullptr;
+    const fpt* c = grids.size() > 2 ? grids[2] : nullptr;
+
+    switch(component) {
+        case Component::UP:
+            #pragma omp parallel for schedule(static)
+            for(size_t i=0; i<n; i++) {
+                out[i] = (a[i] + b[i]) * 0.5f;
+            }
+        break;
+        case Component::DOWN:
+            #pragma omp parallel for schedule(static)
+            for(size_t i=0; i<n; i++) {
+                out[i] = (a[i] - b[i]) * 0.5f;
+            }
+        break;
+        case Component::MAG:
+            if(c) {
+                #pragma omp parallel for schedule(static)
+                for(size_t i=0; i<n; i++) {
+                    out[i] = std::sqrt(a[i] * a[i] + b[i] * b[i] + c[i] * c[i]);
+                }
+            } else {
+                #pragma omp parallel for schedule(static)
+                for(size_t i=0; i<n; i++) {
+                    out[i] = std::abs(a[i]);
+                }
+            }
+        break;
+        default:
+            if(out != a) {
+                std::copy(a, a + n, out);
+            }
+        break;
+    }
+}
@@ -0,0 +1,89 @@
+/**************************************************************************
+ *                                                                        *
+ *   Author: Ivo Filot <i.a.w.filot@tue.nl>                               *
+ *                                                                        *
+ *   EDP is free software:                                                *
+ *   you can redistribute it and/or modify it under the terms of the      *
+ *   GNU General Public License as published by the Free Software         *
+ *   Foundation, either version 3 of the License, or (at your option)     *
+ *   any later version.                                                   *
+ *                                                                        *
+ *   EDP is distributed in the hope that it will be useful,               *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty          *
+ *   of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.              *
+ *   See the GNU General Public License for more details.                 *
+ *                                                                        *
+ *   You should have received a copy of the GNU General Public License    *
+ *   along with this program.  If not, see http://www.gnu.org/licenses/.  *
+ *                                                                        *
+ **************************************************************************/
+
+#ifndef _SPIN_DENSITY_H
+#define _SPIN_DENSITY_H
+
+#include <string>
+#include <vector>
+
+#include "math.h"
+
+/**
+ * @brief      Selection of a spin component from the grids of a file
+ *
+ * Spin-polarized calculations store the magnetization density mz after the
+ * total density; non-collinear calculations store mx, my and mz. The spin-up
+ * and spin-down densities and the magnitude of the magnetization are derived
+ * from these grids.
+ */
+class SpinDensity {
+public:
+    enum class Component {
+        TOTAL,      // total density
+        UP,         // (total + mz) / 2
+        DOWN,       // (total - mz) / 2
+        MAG,        // |m|
+        MX,
+        MY,
+        MZ
+    };
+
+    /**
+     * @brief      get a component from its name
+     *
+     * @param[in]  name  name (total, up, down, mag, mx, my or mz)
+     *
+     * @return     component
+     */
+    static Component parse(const std::string& name);
+
+    /**
+     * @brief      get the name of a component
+     *
+     * @param[in]  component  component
+     *
+     * @return     name
+     */
+    static const char* get_name(Component component);
+
+    /**
+     * @brief      indices of the grids from which a component is derived
+     *
+     * @param[in]  component  component
+     * @param[in]  nr_grids   number of grids in the file
+     * @param[in]  filename   name of the file (for error messages)
+     *
+     * @return     indices of the grids, in the order expected by combine()
+     */
+    static std::vector<unsigned int> get_grids(Component component, unsigned int nr_grids, const std::string& filename);
+
+    /**
+     * @brief      derive a component from its grids
+     *
+     * @param[in]  component  component
+     * @param[in]  grids      grids as listed by get_grids()
+     * @param      out        output grid (may coincide with the first grid)
+     * @param[in]  n          number of grid points
+     */
+    static void combine(Component component, const std::vector<const fpt*>& grids, fpt* out, size_t n);
+};
+
+#endif // _SPIN_DENSITY_H
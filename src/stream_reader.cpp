@@ -0,0 +1,342 @@
+/**************************************************************************
+ *                                                                        *
+ *   Author: Ivo Filot <i.a.w.filot@tue.nl>                               *
+ *                                                                        *
+ *   EDP is free software:                                                *
+ *   you can redistribute it and/or modify it under the terms of the      *
+ *   GNU General Public License as published by the Free Software         *
+ *   Foundation, either version 3 of the License, or (at your option)     *
+ *   any later version.                                                   *
+ *                                                                        *
+ *   EDP is distributed in the hope that it will be useful,               *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty          *
+ *   of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.              *
+ *   See the GNU General Public License for more details.                 *
+ *                                                                        *
+ *   You should have received a copy of the GNU General Public License    *
+ *   along with this program.  If not, see http://www.gnu.org/licenses/.  *
+ *                                                                        *
+ **************************************************************************/
+
+#include "stream_reader.h"
+#include "float_tokenizer.h"
+#include "tar_archive.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <stdexcept>
+#include <boost/iostreams/filtering_stream.hpp>
+#include <boost/iostreams/device/file.hpp>
+#include <boost/iostreams/filter/gzip.hpp>
+#include <boost/iostreams/filter/bzip2.hpp>
+#include <boost/iostreams/filter/lzma.hpp>
+#include <boost/iostreams/filter/zstd.hpp>
+
+/**
+ * @brief      start reading a file
+ *
+ * @param[in]  _filename    path to the file; "-" for standard input
+ *                          or "archive:member" for a member of an archive
+ * @param[in]  chunk_size   size of a single chunk in bytes
+ * @param[in]  nr_chunks    number of chunks in the ring buffer
+ */
+StreamReader::StreamReader(const std::string& _filename, size_t chunk_size, size_t nr_chunks) {
+    this->filename = _filename;
+    if(!TarArchive::split(this->filename, &this->source, &this->member)) {
+        this->source = this->filename;
+    }
+    this->compression = detect(this->source);
+    this->head = 0;
+    this->tail = 0;
+    this->finished = false;
+    this->stopping = false;
+    this->holds_chunk = false;
+
+    this->chunks.resize(std::max<size_t>(nr_chunks, 2));
+    for(auto& chunk : this->chunks) {
+        chunk.data.resize(std::max<size_t>(chunk_size, 1));
+    }
+
+    this->setg(nullptr, nullptr, nullptr);
+    this->producer = std::thread(&StreamReader::produce, this);
+}
+
+/**
+ * @brief      detect the compression of a file from its magic bytes
+ *
+ * @param[in]  filename  path to the file
+ *
+ * @return     compression format
+ */
+StreamReader::Compression StreamReader::detect(const std::string& filename) {
+    if(filename == "-") {
+        return Compression::NONE;
+    }
+
+    std::ifstream infile(filename, std::ios::binary);
+    unsigned char magic[6] = {0};
+    infile.read(reinterpret_cast<char*>(magic), sizeof(magic));
+    const size_t nread = infile.gcount();
+
+    if(nread >= 2 && magic[0] == 0x1F && magic[1] == 0x8B) {
+        return Compression::GZIP;
+    }
+    if(nread >= 3 && std::memcmp(magic, "BZh", 3) == 0) {
+        return Compression::BZIP2;
+    }
+    if(nread >= 6 && std::memcmp(magic, "\xFD" "7zXZ\0", 6) == 0) {
+        return Compression::XZ;
+    }
+    if(nread >= 4 && magic[0] == 0x28 && magic[1] == 0xB5 && magic[2] == 0x2F && magic[3] == 0xFD) {
+        return Compression::ZSTD;
+    }
+
+    return Compression::NONE;
+}
+
+/**
+ * @brief      whether a file has to be read via a StreamReader
+ *
+ * This is the case for compressed files, members of tar archives
+ * and for standard input.
+ *
+ * @param[in]  filename  path to the file
+ *
+ * @return     True if streamed, False otherwise.
+ */
+bool StreamReader::is_streamed(const std::string& filename) {
+    std::string archive, member;
+    return filename == "-" || TarArchive::split(filename, &archive, &member) ||
+           detect(filename) != Compression::NONE;
+}
+
+/**
+ * @brief      parse a block of numbers and divide them by a constant
+ *
+ * Numbers are read from the current position in the stream onwards;
+ * numbers that straddle two chunks are reassembled.
+ *
+ * @param      out      output array (should hold at least n values)
+ * @param[in]  n        number of values to read
+ * @param[in]  divisor  value by which each number is divided
+ *
+ * @return     number of values that have been read
+ */
+size_t StreamReader::parse_block(fpt* out, size_t n, fpt divisor) {
+    static const auto is_whitespace = [](char c) {
+        return c == ' ' || c == '\n' || c == '\r' || c == '\t';
+    };
+
+    size_t i = 0;
+    std::string carry;  // characters of a number that straddles two chunks
+    while(i < n) {
+        if(this->gptr() == this->egptr() && !this->next_chunk()) {
+            const char* p = carry.data();
+            i += FloatTokenizer::parse_block(p, carry.data() + carry.size(), out + i, n - i, divisor);
+            break;
+        }
+
+        char* p = this->gptr();
+        char* end = this->egptr();
+
+        // complete the number that started in the previous chunk
+        if(!carry.empty()) {
+            char* s = p;
+            while(s < end && !is_whitespace(*s)) {
+                ++s;
+            }
+            carry.append(p, s);
+            this->setg(this->eback(), s, end);
+            if(s == end) {
+                continue;
+            }
+
+            const char* c = carry.data();
+            const size_t nread = FloatTokenizer::parse_block(c, carry.data() + carry.size(), out + i, n - i, divisor);
+            i += nread;
+            if(nread == 0 || c != carry.data() + carry.size()) {
+                break;
+            }
+            carry.clear();
+            continue;
+        }
+
+        // only parse up to the last whitespace; the remainder may continue
+        // in the next chunk
+        char* cut = end;
+        while(cut > p && !is_whitespace(cut[-1])) {
+            --cut;
+        }
+
+        const char* q = p;
+        i += FloatTokenizer::parse_block(q, cut, out + i, n - i, divisor);
+        this->setg(this->eback(), const_cast<char*>(q), end);
+        if(i == n) {
+            break;
+        }
+        if(FloatTokenizer::skip_whitespace(q, cut) != cut) {
+            break;  // not a number
+        }
+
+        carry.assign(cut, end);
+        this->setg(this->eback(), end, end);
+    }
+
+    return i;
+}
+
+/**
+ * @brief      stop the producer thread
+ */
+StreamReader::~StreamReader() {
+    {
+        std::lock_guard<std::mutex> lock(this->mtx);
+        this->stopping = true;
+    }
+    this->cv.notify_all();
+    this->producer.join();
+}
+
+/**
+ * @brief      make the next chunk available to the stream
+ *
+ * @return     first character of the chunk or EOF
+ */
+StreamReader::int_type StreamReader::underflow() {
+    if(this->gptr() < this->egptr() || this->next_chunk()) {
+        return traits_type::to_int_type(*this->gptr());
+    }
+    return traits_type::eof();
+}
+
+/**
+ * @brief      decompress the input into the ring buffer
+ */
+void StreamReader::produce() {
+    try {
+        std::ifstream file;     // should outlive the filtering stream
+        boost::iostreams::filtering_istream in;
+        switch(this->compression) {
+            case Compression::GZIP:
+                in.push(boost::iostreams::gzip_decompressor());
+            break;
+            case Compression::BZIP2:
+                in.push(boost::iostreams::bzip2_decompressor());
+            break;
+            case Compression::XZ:
+                in.push(boost::iostreams::lzma_decompressor());
+            break;
+            case Compression::ZSTD:
+                in.push(boost::iostreams::zstd_decompressor());
+            break;
+            case Compression::NONE:
+            break;
+        }
+
+        // number of bytes to pass on
+        uint64_t remaining = std::numeric_limits<uint64_t>::max();
+
+        if(!this->member.empty() && this->compression == Compression::NONE) {
+            // uncompressed archives allow seeking straight to the member
+            const TarArchive::Member location = TarArchive::find_member(this->source, this->member);
+            file.open(this->source, std::ios::binary);
+            if(!file.is_open()) {
+                throw std::runtime_error("Cannot open " + this->source + "!");
+            }
+            file.seekg(location.offset);
+            in.push(file);
+            remaining = location.size;
+        } else {
+            if(this->source == "-") {
+                in.push(std::cin);
+            } else {
+                boost::iostreams::file_source input(this->source, std::ios::binary);
+                if(!input.is_open()) {
+                    throw std::runtime_error("Cannot open " + this->source + "!");
+                }
+                in.push(input);
+            }
+
+            // compressed archives have to be scanned sequentially
+            if(!this->member.empty()) {
+                remaining = TarArchive::seek_member(in, this->member);
+            }
+        }
+
+        while(true) {
+            Chunk* chunk = nullptr;
+            {
+                std::unique_lock<std::mutex> lock(this->mtx);
+                this->cv.wait(lock, [this] {
+                    return this->stopping || this->head - this->tail < this->chunks.size();
+                });
+                if(this->stopping) {
+                    return;
+                }
+                chunk = &this->chunks[this->head % this->chunks.size()];
+            }
+
+            const size_t requested = std::min<uint64_t>(chunk->data.size(), remaining);
+            in.read(chunk->data.data(), requested);
+            chunk->size = in.gcount();
+            remaining -= chunk->size;
+            if(chunk->size == 0) {
+                break;
+            }
+
+            {
+                std::lock_guard<std::mutex> lock(this->mtx);
+                this->head++;
+            }
+            this->cv.notify_all();
+
+            if(chunk->size < requested || remaining == 0) {
+                break;
+            }
+        }
+    } catch(const std::exception& e) {
+        std::lock_guard<std::mutex> lock(this->mtx);
+        this->error = std::make_exception_ptr(
+            std::runtime_error("Error encountered in reading " + this->filename + ": " + e.what()));
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(this->mtx);
+        this->finished = true;
+    }
+    this->cv.notify_all();
+}
+
+/**
+ * @brief      release the current chunk and wait for the next one
+ *
+ * @return     whether a non-empty chunk is available
+ */
+bool StreamReader::next_chunk() {
+    std::unique_lock<std::mutex> lock(this->mtx);
+    if(this->holds_chunk) {
+        this->tail++;
+        this->holds_chunk = false;
+        this->cv.notify_all();
+    }
+
+    this->cv.wait(lock, [this] {
+        return this->head > this->tail || this->finished;
+    });
+
+    if(this->head > this->tail) {
+        Chunk& chunk = this->chunks[this->tail % this->chunks.size()];
+        this->holds_chunk = true;
+        this->setg(chunk.data.data(), chunk.data.data(), chunk.data.data() + chunk.size);
+        return true;
+    }
+
+    this->setg(nullptr, nullptr, nullptr);
+    if(this->error) {
+        std::rethrow_exception(this->error);
+    }
+    return false;
+}
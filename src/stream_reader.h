@@ -0,0 +1,168 @@
+/**************************************************************************
+ *                                                                        *
+ *   Author: Ivo Filot <i.a.w.filot@tue.nl>                               *
+ *                                                                        *
+ *   EDP is free software:                                                *
+ *   you can redistribute it and/or modify it under the terms of the      *
+ *   GNU General Public License as published by the Free Software         *
+ *   Foundation, either version 3 of the License, or (at your option)     *
+ *   any later version.                                                   *
+ *                                                                        *
+ *   EDP is distributed in the hope that it will be useful,               *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty          *
+ *   of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.              *
+ *   See the GNU General Public License for more details.                 *
+ *                                                                        *
+ *   You should have received a copy of the GNU General Public License    *
+ *   along with this program.  If not, see http://www.gnu.org/licenses/.  *
+ *                                                                        *
+ **************************************************************************/
+
+#ifndef _STREAM_READER_H
+#define _STREAM_READER_H
+
+#include <string>
+#include <vector>
+#include <streambuf>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <exception>
+
+#include "math.h"
+
+/**
+ * @brief      Sequential reader for compressed files and standard input
+ *
+ * A producer thread decompresses the input and deposits fixed-size chunks
+ * in a bounded ring buffer, from which the consumer reads. Decompression
+ * and parsing thereby overlap, while the amount of memory in use is bounded
+ * by the size of the ring buffer. The reader acts as a std::streambuf such
+ * that the header can be read line by line using a std::istream, after
+ * which the grid is tokenized straight from the chunks.
+ *
+ * Members of tar archives ("archive.tar.bz2:CHGCAR") are read in the same
+ * way; only the data of the requested member is passed on.
+ */
+class StreamReader : public std::streambuf {
+public:
+    enum class Compression {
+        NONE,
+        GZIP,
+        BZIP2,
+        XZ,
+        ZSTD
+    };
+
+    static constexpr size_t DEFAULT_CHUNK_SIZE = 1 << 20;
+    static constexpr size_t DEFAULT_NR_CHUNKS = 8;
+
+private:
+    /**
+     * @brief      block of (decompressed) data in the ring buffer
+     */
+    struct Chunk {
+        std::vector<char> data;
+        size_t size = 0;
+    };
+
+    std::string filename;
+    std::string source;         // file that is read (the archive for members)
+    std::string member;         // name of the member; empty if not an archive
+    Compression compression;
+
+    std::vector<Chunk> chunks;
+    size_t head;                // number of chunks filled by the producer
+    size_t tail;                // number of chunks released by the consumer
+    bool finished;              // producer has reached the end of the input
+    bool stopping;              // consumer is no longer interested
+    std::exception_ptr error;   // exception raised by the producer
+    std::mutex mtx;
+    std::condition_variable cv;
+    std::thread producer;
+
+    bool holds_chunk;           // consumer currently holds chunk tail
+
+public:
+    /**
+     * @brief      start reading a file
+     *
+     * @param[in]  _filename    path to the file; "-" for standard input
+     *                          or "archive:member" for a member of an archive
+     * @param[in]  chunk_size   size of a single chunk in bytes
+     * @param[in]  nr_chunks    number of chunks in the ring buffer
+     */
+    StreamReader(const std::string& _filename,
+                 size_t chunk_size = DEFAULT_CHUNK_SIZE,
+                 size_t nr_chunks = DEFAULT_NR_CHUNKS);
+
+    StreamReader(const StreamReader&) = delete;
+    StreamReader& operator=(const StreamReader&) = delete;
+
+    /**
+     * @brief      detect the compression of a file from its magic bytes
+     *
+     * @param[in]  filename  path to the file
+     *
+     * @return     compression format
+     */
+    static Compression detect(const std::string& filename);
+
+    /**
+     * @brief      whether a file has to be read via a StreamReader
+     *
+     * This is the case for compressed files, members of tar archives
+     * and for standard input.
+     *
+     * @param[in]  filename  path to the file
+     *
+     * @return     True if streamed, False otherwise.
+     */
+    static bool is_streamed(const std::string& filename);
+
+    /**
+     * @brief      parse a block of numbers and divide them by a constant
+     *
+     * Numbers are read from the current position in the stream onwards;
+     * numbers that straddle two chunks are reassembled.
+     *
+     * @param      out      output array (should hold at least n values)
+     * @param[in]  n        number of values to read
+     * @param[in]  divisor  value by which each number is divided
+     *
+     * @return     number of values that have been read
+     */
+    size_t parse_block(fpt* out, size_t n, fpt divisor);
+
+    inline const std::string& get_filename() const {
+        return this->filename;
+    }
+
+    /**
+     * @brief      stop the producer thread
+     */
+    ~StreamReader();
+
+protected:
+    /**
+     * @brief      make the next chunk available to the stream
+     *
+     * @return     first character of the chunk or EOF
+     */
+    int_type underflow() override;
+
+private:
+    /**
+     * @brief      decompress the input into the ring buffer
+     */
+    void produce();
+
+    /**
+     * @brief      release the current chunk and wait for the next one
+     *
+     * @return     whether a non-empty chunk is available
+     */
+    bool next_chunk();
+};
+
+#endif // _STREAM_READER_H
@@ -0,0 +1,358 @@
+/**************************************************************************
+ *                                                                        *
+ *   Author: Ivo Filot <i.a.w.filot@tue.nl>                               *
+ *                                                                        *
+ *   EDP is free software:                                                *
+ *   you can redistribute it and/or modify it under the terms of the      *
+ *   GNU General Public License as published by the Free Software         *
+ *   Foundation, either version 3 of the License, or (at your option)     *
+ *   any later version.                                                   *
+ *                                                                        *
+ *   EDP is distributed in the hope that it will be useful,               *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty          *
+ *   of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.              *
+ *   See the GNU General Public License for more details.                 *
+ *                                                                        *
+ *   You should have received a copy of the GNU General Public License    *
+ *   along with this program.  If not, see http://www.gnu.org/licenses/.  *
+ *                                                                        *
+ **************************************************************************/
+
+#include "tar_archive.h"
+#include "binary_field.h"
+#include "grid_cache.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <boost/filesystem.hpp>
+
+/**
+ * @brief      strip a leading "./" from the name of a member
+ */
+static std::string normalize_name(const std::string& name) {
+    size_t start = 0;
+    while(name.compare(start, 2, "./") == 0) {
+        start += 2;
+    }
+    return name.substr(start);
+}
+
+/**
+ * @brief      split a path into an archive and a member
+ *
+ * @param[in]  path     path of the form archive:member
+ * @param      archive  path to the archive
+ * @param      member   name of the member
+ *
+ * @return     whether the path designates a member of an archive
+ */
+bool TarArchive::split(const std::string& path, std::string* archive, std::string* member) {
+    boost::system::error_code ec;
+    if(boost::filesystem::exists(path, ec)) {
+        return false;
+    }
+
+    // the archive is the shortest prefix that is an existing file
+    for(size_t pos = path.find(':'); pos != std::string::npos && pos + 1 < path.size(); pos = path.find(':', pos + 1)) {
+        const std::string prefix = path.substr(0, pos);
+        if(boost::filesystem::is_regular_file(prefix, ec)) {
+            *archive = prefix;
+            *member = normalize_name(path.substr(pos + 1));
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/**
+ * @brief      get the file on disk that holds the data of a path
+ *
+ * @param[in]  path  path to a file or to a member of an archive
+ *
+ * @return     path to the archive for members, else the path itself
+ */
+std::string TarArchive::get_source(const std::string& path) {
+    std::string archive, member;
+    return split(path, &archive, &member) ? archive : path;
+}
+
+/**
+ * @brief      read the next header from an archive
+ *
+ * Extended headers (GNU long names and pax headers) are consumed as
+ * well, such that the stream is positioned at the data of the member.
+ *
+ * @param      in        archive stream positioned at a header
+ * @param      position  byte offset in the archive; advanced past the header
+ * @param      member    member described by the header
+ *
+ * @return     whether a member was found (False at the end of the archive)
+ */
+bool TarArchive::read_header(std::istream& in, uint64_t* position, Member* member) {
+    std::string longname;
+    char block[BLOCK_SIZE];
+
+    while(in.read(block, BLOCK_SIZE)) {
+        *position += BLOCK_SIZE;
+
+        // the archive is terminated by blocks of zeros
+        if(std::all_of(block, block + BLOCK_SIZE, [](char c) { return c == '\0'; })) {
+            return false;
+        }
+
+        // the checksum is calculated with the checksum field taken as spaces
+        uint64_t checksum = 0;
+        for(unsigned int i=0; i<BLOCK_SIZE; i++) {
+            checksum += (i >= 148 && i < 156) ? ' ' : (unsigned char)block[i];
+        }
+        if(checksum != parse_number(block + 148, 8)) {
+            throw std::runtime_error("Invalid header encountered in tar archive at byte " + std::to_string(*position - BLOCK_SIZE));
+        }
+
+        const uint64_t size = parse_number(block + 124, 12);
+        const char type = block[156];
+
+        // extended headers hold information on the member that follows
+        if(type == 'L' || type == 'x' || type == 'g') {
+            std::string data(padded(size), '\0');
+            if(!in.read(&data[0], data.size())) {
+                break;
+            }
+            *position += data.size();
+            data.resize(size);
+
+            if(type == 'L') {
+                longname = data.c_str();
+            } else if(type == 'x') {
+                // records are formatted as "<length> <key>=<value>\n"
+                size_t pos = 0;
+                while(pos < data.size()) {
+                    const size_t space = data.find(' ', pos);
+                    if(space == std::string::npos) {
+                        break;
+                    }
+                    const size_t length = std::strtoull(data.c_str() + pos, nullptr, 10);
+                    if(length == 0 || pos + length > data.size()) {
+                        break;
+                    }
+                    const std::string record = data.substr(space + 1, pos + length - space - 2);
+                    if(record.compare(0, 5, "path=") == 0) {
+                        longname = record.substr(5);
+                    }
+                    pos += length;
+                }
+            }
+            continue;
+        }
+
+        if(!longname.empty()) {
+            member->name = longname;
+        } else {
+            member->name = std::string(block, strnlen(block, 100));
+            // ustar archives store long paths as prefix and name
+            if(std::memcmp(block + 257, "ustar", 5) == 0 && block[345] != '\0') {
+                member->name = std::string(block + 345, strnlen(block + 345, 155)) + "/" + member->name;
+            }
+        }
+        member->name = normalize_name(member->name);
+        member->offset = *position;
+        member->size = size;
+        return true;
+    }
+
+    if(in.bad() || (in.fail() && !in.eof())) {
+        throw std::runtime_error("Error encountered in reading tar archive");
+    }
+    return false;
+}
+
+/**
+ * @brief      advance a sequential stream to the data of a member
+ *
+ * @param      in      archive stream positioned at the start of the archive
+ * @param[in]  name    name of the member
+ *
+ * @return     size of the member in bytes
+ */
+uint64_t TarArchive::seek_member(std::istream& in, const std::string& name) {
+    const std::string target = normalize_name(name);
+    uint64_t position = 0;
+    Member member;
+    while(read_header(in, &position, &member)) {
+        if(member.name == target) {
+            return member.size;
+        }
+        in.ignore(padded(member.size));
+        position += padded(member.size);
+    }
+
+    throw std::runtime_error("Cannot find " + name + " in archive");
+}
+
+/**
+ * @brief      locate a member in an uncompressed archive
+ *
+ * The index of the archive is used when it is up to date; otherwise the
+ * headers are scanned (seeking past the data of each member) and the
+ * index is (re)written.
+ *
+ * @param[in]  archive  path to the archive
+ * @param[in]  name     name of the member
+ *
+ * @return     location of the member
+ */
+TarArchive::Member TarArchive::find_member(const std::string& archive, const std::string& name) {
+    std::vector<Member> members;
+    if(!load_index(archive, &members)) {
+        members = scan(archive);
+        save_index(archive, members);
+    }
+
+    const std::string target = normalize_name(name);
+    for(const Member& member : members) {
+        if(member.name == target) {
+            return member;
+        }
+    }
+
+    throw std::runtime_error("Cannot find " + name + " in " + archive);
+}
+
+/**
+ * @brief      collect the locations of all members of an archive
+ *
+ * @param[in]  archive  path to the (uncompressed) archive
+ *
+ * @return     members
+ */
+std::vector<TarArchive::Member> TarArchive::scan(const std::string& archive) {
+    std::ifstream infile(archive, std::ios::binary);
+    if(!infile.is_open()) {
+        throw std::runtime_error("Cannot open " + archive + "!");
+    }
+
+    std::vector<Member> members;
+    uint64_t position = 0;
+    Member member;
+    while(read_header(infile, &position, &member)) {
+        members.push_back(member);
+        position += padded(member.size);
+        infile.seekg(position);
+    }
+
+    return members;
+}
+
+/**
+ * @brief      load the index of an archive
+ *
+ * @param[in]  archive  path to the archive
+ * @param      members  members listed in the index
+ *
+ * @return     whether an up-to-date index was found
+ */
+bool TarArchive::load_index(const std::string& archive, std::vector<Member>* members) {
+    const std::string indexfile = GridCache::locate(archive, INDEX_EXTENSION);
+    if(indexfile.empty()) {
+        return false;
+    }
+
+    std::ifstream infile(indexfile);
+    std::string line;
+    if(!std::getline(infile, line)) {
+        return false;
+    }
+
+    try {
+        // the index is only valid for the archive it was built from
+        std::istringstream header(line);
+        std::string magic;
+        unsigned int version = 0;
+        uint64_t size = 0;
+        int64_t mtime = 0;
+        header >> magic >> version >> size >> mtime;
+        if(magic != "EDPINDEX" || version != 1 ||
+           size != boost::filesystem::file_size(archive) ||
+           mtime != BinaryField::get_mtime(archive)) {
+            return false;
+        }
+    } catch(const std::exception&) {
+        return false;
+    }
+
+    members->clear();
+    while(std::getline(infile, line)) {
+        std::istringstream entry(line);
+        Member member;
+        if(!(entry >> member.offset >> member.size)) {
+            return false;
+        }
+        entry.get();
+        std::getline(entry, member.name);
+        members->push_back(member);
+    }
+
+    return true;
+}
+
+/**
+ * @brief      store the index of an archive; errors are ignored
+ *
+ * @param[in]  archive  path to the archive
+ * @param[in]  members  members of the archive
+ */
+void TarArchive::save_index(const std::string& archive, const std::vector<Member>& members) {
+    try {
+        const std::string indexfile = GridCache::locate(archive, INDEX_EXTENSION);
+        if(indexfile.empty()) {
+            return;
+        }
+        boost::filesystem::create_directories(boost::filesystem::path(indexfile).parent_path());
+
+        const std::string tmpfile = BinaryField::get_temp_name(indexfile);
+        {
+            std::ofstream outfile(tmpfile);
+            outfile << "EDPINDEX 1 " << boost::filesystem::file_size(archive) << " "
+                    << BinaryField::get_mtime(archive) << "\n";
+            for(const Member& member : members) {
+                outfile << member.offset << " " << member.size << " " << member.name << "\n";
+            }
+            if(!outfile) {
+                boost::filesystem::remove(tmpfile);
+                return;
+            }
+        }
+        boost::filesystem::rename(tmpfile, indexfile);
+    } catch(const std::exception&) {
+        // the index is merely an optimization
+    }
+}
+
+/**
+ * @brief      parse a numeric header field (octal or base-256)
+ */
+uint64_t TarArchive::parse_number(const char* field, size_t length) {
+    // GNU tar stores large numbers in big-endian base-256
+    if((unsigned char)field[0] & 0x80) {
+        uint64_t value = (unsigned char)field[0] & 0x7F;
+        for(size_t i=1; i<length; i++) {
+            value = (value << 8) | (unsigned char)field[i];
+        }
+        return value;
+    }
+
+    uint64_t value = 0;
+    size_t i = 0;
+    while(i < length && (field[i] == ' ' || field[i] == '\0')) {
+        i++;
+    }
+    while(i < length && field[i] >= '0' && field[i] <= '7') {
+        value = value * 8 + (field[i] - '0');
+        i++;
+    }
+    return value;
+}
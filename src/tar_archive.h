@@ -0,0 +1,154 @@
+/**************************************************************************
+ *                                                                        *
+ *   Author: Ivo Filot <i.a.w.filot@tue.nl>                               *
+ *                                                                        *
+ *   EDP is free software:                                                *
+ *   you can redistribute it and/or modify it under the terms of the      *
+ *   GNU General Public License as published by the Free Software         *
+ *   Foundation, either version 3 of the License, or (at your option)     *
+ *   any later version.                                                   *
+ *                                                                        *
+ *   EDP is distributed in the hope that it will be useful,               *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty          *
+ *   of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.              *
+ *   See the GNU General Public License for more details.                 *
+ *                                                                        *
+ *   You should have received a copy of the GNU General Public License    *
+ *   along with this program.  If not, see http://www.gnu.org/licenses/.  *
+ *                                                                        *
+ **************************************************************************/
+
+#ifndef _TAR_ARCHIVE_H
+#define _TAR_ARCHIVE_H
+
+#include <string>
+#include <vector>
+#include <istream>
+#include <cstdint>
+
+/**
+ * @brief      Access to the members of tar archives
+ *
+ * A member of an archive is designated as "archive.tar:member", e.g.
+ * "dataset.tar.bz2:CHGCAR_CH4". Compressed archives can only be read
+ * sequentially, such that the headers are scanned until the member is found.
+ * For uncompressed archives, the offsets of all members are stored in an
+ * index next to the archive (or in EDP_CACHE_DIR, see GridCache) such that
+ * later reads directly seek to the member.
+ *
+ * Both POSIX (ustar/pax) and GNU archives are supported.
+ */
+class TarArchive {
+public:
+    static constexpr uint64_t BLOCK_SIZE = 512;
+    static constexpr const char* INDEX_EXTENSION = ".edpi";
+
+    /**
+     * @brief      location of a member in the archive
+     */
+    struct Member {
+        std::string name;
+        uint64_t offset = 0;    // byte offset of the data of the member
+        uint64_t size = 0;      // size of the member in bytes
+    };
+
+    /**
+     * @brief      split a path into an archive and a member
+     *
+     * @param[in]  path     path of the form archive:member
+     * @param      archive  path to the archive
+     * @param      member   name of the member
+     *
+     * @return     whether the path designates a member of an archive
+     */
+    static bool split(const std::string& path, std::string* archive, std::string* member);
+
+    /**
+     * @brief      get the file on disk that holds the data of a path
+     *
+     * @param[in]  path  path to a file or to a member of an archive
+     *
+     * @return     path to the archive for members, else the path itself
+     */
+    static std::string get_source(const std::string& path);
+
+    /**
+     * @brief      read the next header from an archive
+     *
+     * Extended headers (GNU long names and pax headers) are consumed as
+     * well, such that the stream is positioned at the data of the member.
+     *
+     * @param      in        archive stream positioned at a header
+     * @param      position  byte offset in the archive; advanced past the header
+     * @param      member    member described by the header
+     *
+     * @return     whether a member was found (False at the end of the archive)
+     */
+    static bool read_header(std::istream& in, uint64_t* position, Member* member);
+
+    /**
+     * @brief      advance a sequential stream to the data of a member
+     *
+     * @param      in      archive stream positioned at the start of the archive
+     * @param[in]  name    name of the member
+     *
+     * @return     size of the member in bytes
+     */
+    static uint64_t seek_member(std::istream& in, const std::string& name);
+
+    /**
+     * @brief      locate a member in an uncompressed archive
+     *
+     * The index of the archive is used when it is up to date; otherwise the
+     * headers are scanned (seeking past the data of each member) and the
+     * index is (re)written.
+     *
+     * @param[in]  archive  path to the archive
+     * @param[in]  name     name of the member
+     *
+     * @return     location of the member
+     */
+    static Member find_member(const std::string& archive, const std::string& name);
+
+private:
+    /**
+     * @brief      collect the locations of all members of an archive
+     *
+     * @param[in]  archive  path to the (uncompressed) archive
+     *
+     * @return     members
+     */
+    static std::vector<Member> scan(const std::string& archive);
+
+    /**
+     * @brief      load the index of an archive
+     *
+     * @param[in]  archive  path to the archive
+     * @param      members  members listed in the index
+     *
+     * @return     whether an up-to-date index was found
+     */
+    static bool load_index(const std::string& archive, std::vector<Member>* members);
+
+    /**
+     * @brief      store the index of an archive; errors are ignored
+     *
+     * @param[in]  archive  path to the archive
+     * @param[in]  members  members of the archive
+     */
+    static void save_index(const std::string& archive, const std::vector<Member>& members);
+
+    /**
+     * @brief      parse a numeric header field (octal or base-256)
+     */
+    static uint64_t parse_number(const char* field, size_t length);
+
+    /**
+     * @brief      round a size up to a multiple of the block size
+     */
+    static inline uint64_t padded(uint64_t size) {
+        return (size + BLOCK_SIZE - 1) / BLOCK_SIZE * BLOCK_SIZE;
+    }
+};
+
+#endif // _TAR_ARCHIVE_H
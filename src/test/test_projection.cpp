@@ -20,6 +20,12 @@
 
 #include "test_projection.h"
 
+#include <fstream>
+#include <limits>
+#include <boost/filesystem.hpp>
+
+#include "compressed_field.h"
+
 CPPUNIT_TEST_SUITE_REGISTRATION( TestProjection );
 
 void TestProjection::setUp() {
@@ -58,6 +64,51 @@ void TestProjection::testProjection() {
                      ref);
 }
 
+void TestProjection::testLazyProjection() {
+    setenv("EDP_NO_CACHE", "1", 1);
+
+    // a line of the first slab holding an extra value
+    {
+        std::ifstream infile("CHGCAR_CH4");
+        std::ofstream outfile("CHGCAR_CH4_corrupt");
+        std::string line;
+        for(unsigned int i=1; std::getline(infile, line); i++) {
+            if(i == 100) {
+                std::string extra = " 0.1 0.2 0.3 0.4 0.5 0.6";
+                line = extra + std::string(line.size() - extra.size(), ' ');
+            }
+            outfile << line << "\n";
+        }
+    }
+
+    // the slabs are loaded while the plane is sampled; the error is reported
+    // rather than terminating the program
+    ScalarField sf("CHGCAR_CH4_corrupt", false);
+    sf.read_lazy();
+    PlaneProjector pp(&sf, 0);
+    CPPUNIT_ASSERT_THROW( pp.extract(Vec3(1,0,0), Vec3(0,0,1), Vec3(5,5,5), 10, -20, 20, -20, 20), std::runtime_error );
+    boost::filesystem::remove("CHGCAR_CH4_corrupt");
+
+    // the same holds for a compressed field with a corrupt brick index
+    ScalarField sfr("CHGCAR_CH4", false);
+    sfr.read();
+    CompressedField::write(sfr, "CHGCAR_CH4_corrupt.edpz", 1e-3);
+    {
+        const uint64_t offset = CompressedField::read_file_header("CHGCAR_CH4_corrupt.edpz").index_offset;
+        std::fstream file("CHGCAR_CH4_corrupt.edpz", std::ios::in | std::ios::out | std::ios::binary);
+        file.seekp(offset + sizeof(uint64_t));
+        const uint64_t invalid = std::numeric_limits<uint64_t>::max();
+        file.write(reinterpret_cast<const char*>(&invalid), sizeof(invalid));
+    }
+    ScalarField sfz("CHGCAR_CH4_corrupt.edpz", false);
+    sfz.read_lazy();
+    PlaneProjector ppz(&sfz, 0);
+    CPPUNIT_ASSERT_THROW( ppz.extract(Vec3(1,0,0), Vec3(0,0,1), Vec3(5,5,5), 10, -20, 20, -20, 20), std::runtime_error );
+    boost::filesystem::remove("CHGCAR_CH4_corrupt.edpz");
+
+    unsetenv("EDP_NO_CACHE");
+}
+
 void TestProjection::test_plane(ScalarField* sf, const Vec3& v, const Vec3& w, const Vec3& p, fpt ref) {
     // create plane projector
     PlaneProjector pp(sf, 0);
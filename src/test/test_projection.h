@@ -30,6 +30,7 @@ class TestProjection : public CppUnit::TestFixture
 {
   CPPUNIT_TEST_SUITE( TestProjection );
   CPPUNIT_TEST( testProjection );
+  CPPUNIT_TEST( testLazyProjection );
   CPPUNIT_TEST_SUITE_END();
 
 public:
@@ -37,6 +38,7 @@ public:
   void tearDown();
 
   void testProjection();
+  void testLazyProjection();
 
 private:
   void test_plane(ScalarField* sf, const Vec3& v, const Vec3& w, const Vec3& p, fpt ref);
@@ -20,6 +20,23 @@
 
 #include "test_scalarfield.h"
 
+#include <algorithm>
+#include <iomanip>
+#include <limits>
+#include <random>
+#include <thread>
+#include <boost/iostreams/filtering_stream.hpp>
+#include <boost/iostreams/filter/gzip.hpp>
+#include <boost/iostreams/filter/bzip2.hpp>
+
+#ifdef HAS_HDF5
+#include <hdf5.h>
+#endif
+
+#ifdef __linux__
+#include <sched.h>
+#endif
+
 CPPUNIT_TEST_SUITE_REGISTRATION( TestScalarField );
 
 void TestScalarField::setUp() {
@@ -31,11 +48,11 @@ void TestScalarField::tearDown() {
 void TestScalarField::testReading() {
     // create scalar field
     ScalarField sf("CHGCAR_CH4", false);
-    CPPUNIT_ASSERT_EQUAL( (uint)0, sf.get_size() );
+    CPPUNIT_ASSERT_EQUAL( (size_t)0, sf.get_size() );
 
     // read atoms and check this
     sf.read_header_and_atoms();
-    CPPUNIT_ASSERT_EQUAL( (uint)0, sf.get_size() );
+    CPPUNIT_ASSERT_EQUAL( (size_t)0, sf.get_size() );
     auto p = sf.get_atom_position(0);
     CPPUNIT_ASSERT_EQUAL( (fpt)5.0, p(0) );
     CPPUNIT_ASSERT_EQUAL( (fpt)5.0, p(1) );
@@ -44,7 +61,7 @@ void TestScalarField::testReading() {
     // read scalar field and test this
     sf.read();
     fpt V = sf.get_volume();
-    CPPUNIT_ASSERT_EQUAL( (uint)1000000, sf.get_size() );
+    CPPUNIT_ASSERT_EQUAL( (size_t)1000000, sf.get_size() );
     CPPUNIT_ASSERT_DOUBLES_EQUAL( (fpt)-0.276298 / V, sf.get_min(), 1e-8 );
     CPPUNIT_ASSERT_DOUBLES_EQUAL( (fpt)2047.064424 / V, sf.get_max(), 1e-4 );
 
@@ -90,3 +107,1172 @@ void TestScalarField::testReading() {
                                   sf.get_value_interp(0.0,0.0,10.0),
                                   1e-12);
 }
+
+void TestScalarField::testTokenizer() {
+    // Fortran-style numbers, including glued values and marker-less exponents
+    const std::string str = " 0.12345678901E+01-0.50000000000E-02 0.1-100 1.5D+03\n 42";
+    const char* p = str.data();
+    std::vector<fpt> vals(5);
+    CPPUNIT_ASSERT_EQUAL( (size_t)5, FloatTokenizer::parse_block(p, str.data() + str.size(), &vals[0], 5, 1.0f) );
+    CPPUNIT_ASSERT_DOUBLES_EQUAL( 1.2345678901, vals[0], 1e-6 );
+    CPPUNIT_ASSERT_DOUBLES_EQUAL( -0.005, vals[1], 1e-9 );
+    CPPUNIT_ASSERT_DOUBLES_EQUAL( 0.0, vals[2], 1e-12 );
+    CPPUNIT_ASSERT_DOUBLES_EQUAL( 1500.0, vals[3], 1e-4 );
+    CPPUNIT_ASSERT_DOUBLES_EQUAL( 42.0, vals[4], 1e-6 );
+
+    // build a fixed-width block and a block with irregular line lengths
+    const size_t n = 200003;
+    std::string fixed, irregular;
+    for(size_t i=0; i<n; i++) {
+        const std::string val = (boost::format(" %17.11E") % (std::sin((double)i) * 100.0)).str();
+        fixed += val;
+        irregular += val;
+        if(i % 5 == 4) {
+            fixed += "\n";
+        }
+        if(i % 7 == 6 || i % 11 == 3) {
+            irregular += "\n";
+        }
+    }
+    fixed += "\naugmentation occupancies 1 16\n";
+    irregular += "\naugmentation occupancies 1 16\n";
+
+    // parallel parsing should give exactly the same result as serial parsing
+    for(const std::string* block : {&fixed, &irregular}) {
+        std::vector<fpt> serial(n), parallel(n);
+        const char* p1 = block->data();
+        const char* p2 = block->data();
+        const char* end = block->data() + block->size();
+        CPPUNIT_ASSERT_EQUAL( n, FloatTokenizer::parse_block(p1, end, &serial[0], n, 2.0f) );
+        CPPUNIT_ASSERT_EQUAL( n, FloatTokenizer::parse_block_parallel(p2, end, &parallel[0], n, 2.0f) );
+        CPPUNIT_ASSERT( p1 == p2 );
+        CPPUNIT_ASSERT( serial == parallel );
+    }
+}
+
+void TestScalarField::testBinaryFormat() {
+    ScalarField sf("CHGCAR_CH4", false);
+    sf.read();
+    CPPUNIT_ASSERT( !sf.is_binary() );
+    BinaryField::write(sf, "CHGCAR_CH4.edpf");
+
+    // the binary file is detected automatically and yields the same field
+    ScalarField sfb("CHGCAR_CH4.edpf", true);
+    CPPUNIT_ASSERT( sfb.is_binary() );
+    CPPUNIT_ASSERT( !sfb.is_locpot() );
+    CPPUNIT_ASSERT_EQUAL( (size_t)0, sfb.get_size() );
+
+    sfb.read_header_and_atoms();
+    CPPUNIT_ASSERT( sf.get_grid_dimensions() == sfb.get_grid_dimensions() );
+    CPPUNIT_ASSERT( sf.get_unitcell_matrix() == sfb.get_unitcell_matrix() );
+    CPPUNIT_ASSERT_EQUAL( sf.get_volume(), sfb.get_volume() );
+    CPPUNIT_ASSERT( sf.get_atom_position(4) == sfb.get_atom_position(4) );
+
+    sfb.read();
+    CPPUNIT_ASSERT_EQUAL( sf.get_size(), sfb.get_size() );
+    CPPUNIT_ASSERT( std::equal(sf.get_grid_ptr(), sf.get_grid_ptr() + sf.get_size(), sfb.get_grid_ptr()) );
+    CPPUNIT_ASSERT_EQUAL( sf.get_value_interp(4.95,4.95,4.95), sfb.get_value_interp(4.95,4.95,4.95) );
+
+    // the grid is mapped at a page boundary
+    CPPUNIT_ASSERT_EQUAL( (uint64_t)0, BinaryField::read_file_header("CHGCAR_CH4.edpf").grid_offset % 4096 );
+}
+
+void TestScalarField::testGridCache() {
+    setenv("EDP_CACHE_DIR", "cache", 1);
+    const std::string cachefile = GridCache::locate("CHGCAR_CH4");
+    CPPUNIT_ASSERT( boost::filesystem::path(cachefile).parent_path() == "cache" );
+    boost::filesystem::remove_all("cache");
+
+    // the first read parses the file and writes the cache entry
+    std::vector<fpt> grid;
+    {
+        ScalarField sf("CHGCAR_CH4", false);
+        sf.read();
+        grid.assign(sf.get_grid_ptr(), sf.get_grid_ptr() + sf.get_size());
+    }
+    CPPUNIT_ASSERT( GridCache::is_valid(cachefile, "CHGCAR_CH4", false) );
+    CPPUNIT_ASSERT( !GridCache::is_valid(cachefile, "CHGCAR_CH4", true) );
+
+    // the second read maps the cache entry
+    ScalarField sf("CHGCAR_CH4", false);
+    sf.read();
+    CPPUNIT_ASSERT( !sf.is_binary() );
+    CPPUNIT_ASSERT_EQUAL( grid.size(), sf.get_size() );
+    CPPUNIT_ASSERT( std::equal(grid.begin(), grid.end(), sf.get_grid_ptr()) );
+
+    // concurrent writers of an entry use distinct temporary files
+    CPPUNIT_ASSERT( BinaryField::get_temp_name(cachefile) != BinaryField::get_temp_name(cachefile) );
+    const std::string stale = cachefile + ".part-stale";
+    const std::string fresh = cachefile + ".part-fresh";
+    std::ofstream(stale) << "interrupted";
+    std::ofstream(fresh) << "in progress";
+    boost::filesystem::last_write_time(stale, std::time(nullptr) - 2 * GridCache::STALE_AGE);
+
+    // entries exceeding the size cap are evicted, as are abandoned temporary files
+    GridCache::evict("cache", 0);
+    CPPUNIT_ASSERT( !boost::filesystem::exists(cachefile) );
+    CPPUNIT_ASSERT( !boost::filesystem::exists(stale) );
+    CPPUNIT_ASSERT( boost::filesystem::exists(fresh) );
+
+    boost::filesystem::remove_all("cache");
+    unsetenv("EDP_CACHE_DIR");
+}
+
+void TestScalarField::testCompressed() {
+    setenv("EDP_NO_CACHE", "1", 1);
+    ScalarField sf("CHGCAR_CH4", false);
+    sf.read();
+
+    // compress the file
+    {
+        std::ifstream infile("CHGCAR_CH4", std::ios::binary);
+        std::ofstream outfile("CHGCAR_CH4.gz", std::ios::binary);
+        boost::iostreams::filtering_ostream out;
+        out.push(boost::iostreams::gzip_compressor());
+        out.push(outfile);
+        out << infile.rdbuf();
+    }
+    CPPUNIT_ASSERT( StreamReader::detect("CHGCAR_CH4.gz") == StreamReader::Compression::GZIP );
+    CPPUNIT_ASSERT( StreamReader::detect("CHGCAR_CH4") == StreamReader::Compression::NONE );
+
+    ScalarField sfz("CHGCAR_CH4.gz", false);
+    sfz.read();
+    CPPUNIT_ASSERT( sf.get_grid_dimensions() == sfz.get_grid_dimensions() );
+    CPPUNIT_ASSERT( sf.get_atom_position(4) == sfz.get_atom_position(4) );
+    CPPUNIT_ASSERT_EQUAL( sf.get_size(), sfz.get_size() );
+    CPPUNIT_ASSERT( std::equal(sf.get_grid_ptr(), sf.get_grid_ptr() + sf.get_size(), sfz.get_grid_ptr()) );
+
+    // numbers straddling the chunks of a (tiny) ring buffer are reassembled
+    StreamReader reader("CHGCAR_CH4.gz", 7, 3);
+    std::istream in(&reader);
+    std::string line;
+    for(unsigned int i=0; i<15; i++) {
+        std::getline(in, line);
+    }
+    std::vector<fpt> grid(sf.get_size());
+    CPPUNIT_ASSERT_EQUAL( grid.size(), reader.parse_block(&grid[0], grid.size(), sf.get_volume()) );
+    CPPUNIT_ASSERT( std::equal(grid.begin(), grid.end(), sf.get_grid_ptr()) );
+
+    unsetenv("EDP_NO_CACHE");
+}
+
+void TestScalarField::testArchive() {
+    setenv("EDP_NO_CACHE", "1", 1);
+    ScalarField sf("CHGCAR_CH4", false);
+    sf.read();
+
+    std::string archive, member;
+    CPPUNIT_ASSERT( TarArchive::split("dataset.tar.bz2:CHGCAR_CH4", &archive, &member) );
+    CPPUNIT_ASSERT_EQUAL( std::string("dataset.tar.bz2"), archive );
+    CPPUNIT_ASSERT_EQUAL( std::string("CHGCAR_CH4"), member );
+    CPPUNIT_ASSERT( !TarArchive::split("CHGCAR_CH4", &archive, &member) );
+
+    // compressed archives are scanned sequentially
+    ScalarField sfa("dataset.tar.bz2:CHGCAR_CH4", false);
+    sfa.read();
+    CPPUNIT_ASSERT_EQUAL( sf.get_size(), sfa.get_size() );
+    CPPUNIT_ASSERT( std::equal(sf.get_grid_ptr(), sf.get_grid_ptr() + sf.get_size(), sfa.get_grid_ptr()) );
+
+    // uncompressed archives are indexed
+    {
+        std::ifstream infile("dataset.tar.bz2", std::ios::binary);
+        std::ofstream outfile("dataset.tar", std::ios::binary);
+        boost::iostreams::filtering_istream in;
+        in.push(boost::iostreams::bzip2_decompressor());
+        in.push(infile);
+        outfile << in.rdbuf();
+    }
+    unsetenv("EDP_NO_CACHE");
+    const std::string indexfile = GridCache::locate("dataset.tar", TarArchive::INDEX_EXTENSION);
+    boost::filesystem::remove(indexfile);
+
+    const TarArchive::Member location = TarArchive::find_member("dataset.tar", "./CHGCAR_CH4");
+    CPPUNIT_ASSERT( boost::filesystem::exists(indexfile) );
+    const boost::filesystem::path indexdir = boost::filesystem::absolute(indexfile).parent_path();
+    for(boost::filesystem::directory_iterator it(indexdir), end; it != end; ++it) {
+        CPPUNIT_ASSERT( it->path().filename().string().find(".edpi.part") == std::string::npos );
+    }
+    CPPUNIT_ASSERT_EQUAL( (uint64_t)512, location.offset );
+    CPPUNIT_ASSERT_EQUAL( (uint64_t)boost::filesystem::file_size("CHGCAR_CH4"), location.size );
+
+    setenv("EDP_NO_CACHE", "1", 1);
+    ScalarField sft("dataset.tar:CHGCAR_CH4", false);
+    sft.read();
+    CPPUNIT_ASSERT( std::equal(sf.get_grid_ptr(), sf.get_grid_ptr() + sf.get_size(), sft.get_grid_ptr()) );
+    CPPUNIT_ASSERT_THROW( ScalarField("dataset.tar:CHGCAR_XX", false).read(), std::runtime_error );
+
+    unsetenv("EDP_NO_CACHE");
+}
+
+void TestScalarField::testLazyReading() {
+    setenv("EDP_NO_CACHE", "1", 1);
+    ScalarField sf("CHGCAR_CH4", false);
+    sf.read();
+
+    // only the slabs surrounding the point are parsed
+    ScalarField sfl("CHGCAR_CH4", false);
+    sfl.read_lazy();
+    CPPUNIT_ASSERT_EQUAL( (uint)0, sfl.get_nr_slabs_loaded() );
+    CPPUNIT_ASSERT_EQUAL( sf.get_value_interp(4.95,4.95,4.95), sfl.get_value_interp(4.95,4.95,4.95) );
+    CPPUNIT_ASSERT_EQUAL( (uint)2, sfl.get_nr_slabs_loaded() );
+
+    // requesting the grid loads the remaining slabs
+    CPPUNIT_ASSERT( std::equal(sf.get_grid_ptr(), sf.get_grid_ptr() + sf.get_size(), sfl.get_grid_ptr()) );
+    CPPUNIT_ASSERT_EQUAL( sf.get_grid_dimensions()[2], sfl.get_nr_slabs_loaded() );
+
+    // a line of the first slab holding an extra value does not shift the grid
+    {
+        std::ifstream infile("CHGCAR_CH4");
+        std::ofstream outfile("CHGCAR_CH4_extra");
+        std::string line;
+        for(unsigned int i=1; std::getline(infile, line); i++) {
+            if(i == 100) {
+                std::string extra = " 0.1 0.2 0.3 0.4 0.5 0.6";
+                line = extra + std::string(line.size() - extra.size(), ' ');
+            }
+            outfile << line << "\n";
+        }
+    }
+    ScalarField sfe("CHGCAR_CH4_extra", false);
+    sfe.read_lazy();
+    CPPUNIT_ASSERT_THROW( sfe.get_grid_ptr(), std::runtime_error );
+    boost::filesystem::remove("CHGCAR_CH4_extra");
+
+    unsetenv("EDP_NO_CACHE");
+}
+
+void TestScalarField::testInfo() {
+    FieldInfo info = FieldInfo::probe("CHGCAR_CH4");
+    CPPUNIT_ASSERT( info.error.empty() );
+    CPPUNIT_ASSERT_EQUAL( std::string("CHGCAR"), info.type );
+    CPPUNIT_ASSERT_EQUAL( std::string("vasp5"), info.format );
+    CPPUNIT_ASSERT_EQUAL( (uint64_t)boost::filesystem::file_size("CHGCAR_CH4"), info.file_size );
+    CPPUNIT_ASSERT_DOUBLES_EQUAL( 10.0, info.lattice[1][1], 1e-12 );
+    CPPUNIT_ASSERT_EQUAL( (uint)100, info.grid_dimensions[2] );
+    CPPUNIT_ASSERT( info.elements == std::vector<std::string>({"C", "H"}) );
+    CPPUNIT_ASSERT( info.counts == std::vector<unsigned int>({1, 4}) );
+    CPPUNIT_ASSERT_EQUAL( 1, info.nr_grids );
+    CPPUNIT_ASSERT_EQUAL( 1, info.augmentation );
+
+    // append a magnetization density to mimic a spin-polarized calculation
+    boost::filesystem::create_directories("info/spin");
+    {
+        std::ifstream infile("CHGCAR_CH4");
+        std::ofstream outfile("info/spin/CHGCAR");
+        std::string line;
+        std::vector<std::string> grid;
+        bool in_grid = false;
+        while(std::getline(infile, line)) {
+            outfile << line << "\n";
+            if(line.find("augmentation") != std::string::npos) {
+                in_grid = false;
+            }
+            if(in_grid) {
+                grid.push_back(line);
+            }
+            if(line == "  100  100  100") {
+                in_grid = true;
+            }
+        }
+        outfile << "  0.000  0.000  0.000  0.000  0.000\n" << "  100  100  100\n";
+        for(const auto& l : grid) {
+            outfile << l << "\n";
+        }
+    }
+    info = FieldInfo::probe("info/spin/CHGCAR");
+    CPPUNIT_ASSERT_EQUAL( 2, info.nr_grids );
+    CPPUNIT_ASSERT( info.to_json().find("\"spin\": \"collinear\"") != std::string::npos );
+
+    // unreadable files are reported rather than thrown
+    boost::filesystem::copy_file("CHGCAR_CH4", "info/CHGCAR_CH4", boost::filesystem::copy_options::overwrite_existing);
+    std::ofstream("info/LOCPOT") << "garbage\n";
+    std::ofstream("info/OUTCAR") << "not a volumetric file\n";
+    auto infos = FieldInfo::scan("info");
+    CPPUNIT_ASSERT_EQUAL( (size_t)3, infos.size() );
+    CPPUNIT_ASSERT_EQUAL( std::string("info/CHGCAR_CH4"), infos[0].filename );
+    CPPUNIT_ASSERT( !infos[1].error.empty() );
+    CPPUNIT_ASSERT_EQUAL( 2, infos[2].nr_grids );
+
+    FieldInfo::write_catalogue(infos, "info/catalogue.json");
+    std::ifstream catalogue("info/catalogue.json");
+    std::string line;
+    unsigned int nr_lines = 0;
+    while(std::getline(catalogue, line)) {
+        nr_lines++;
+    }
+    CPPUNIT_ASSERT_EQUAL( (uint)5, nr_lines );
+}
+
+void TestScalarField::testWriters() {
+    setenv("EDP_NO_CACHE", "1", 1);
+    ScalarField sf("CHGCAR_CH4", false);
+    sf.read();
+
+    // a written CHGCAR reproduces the field and keeps the fixed layout
+    FieldWriter::write_chgcar(sf, "CHGCAR_written");
+    ScalarField sfw("CHGCAR_written", false);
+    sfw.read_lazy();
+    CPPUNIT_ASSERT_EQUAL( (uint)0, sfw.get_nr_slabs_loaded() );
+    CPPUNIT_ASSERT( sf.get_grid_dimensions() == sfw.get_grid_dimensions() );
+    CPPUNIT_ASSERT( (sf.get_atom_position(4) - sfw.get_atom_position(4)).norm() < 1e-4 );
+    CPPUNIT_ASSERT_DOUBLES_EQUAL( sf.get_volume(), sfw.get_volume(), 1e-3 );
+    const fpt* grid = sf.get_grid_ptr();
+    const fpt* gridw = sfw.get_grid_ptr();
+    for(unsigned int i=0; i<sf.get_size(); i++) {
+        CPPUNIT_ASSERT_DOUBLES_EQUAL( grid[i], gridw[i], 1e-6 * std::fabs(grid[i]) );
+    }
+
+    // cube files run with z fastest and are expressed in atomic units
+    FieldWriter::write_cube(sf, "CHGCAR_CH4.cube");
+    std::ifstream infile("CHGCAR_CH4.cube");
+    std::string line;
+    std::getline(infile, line);
+    std::getline(infile, line);
+    unsigned int nr_atoms = 0;
+    double origin[3];
+    infile >> nr_atoms >> origin[0] >> origin[1] >> origin[2];
+    CPPUNIT_ASSERT_EQUAL( (uint)5, nr_atoms );
+    unsigned int dims[3];
+    double axes[3][3];
+    for(unsigned int i=0; i<3; i++) {
+        infile >> dims[i] >> axes[i][0] >> axes[i][1] >> axes[i][2];
+        CPPUNIT_ASSERT_EQUAL( sf.get_grid_dimensions()[i], dims[i] );
+    }
+    CPPUNIT_ASSERT_DOUBLES_EQUAL( 0.1 / FieldWriter::BOHR, axes[0][0], 1e-5 );
+    unsigned int elnr = 0;
+    double charge, x, y, z;
+    infile >> elnr >> charge >> x >> y >> z;
+    CPPUNIT_ASSERT_EQUAL( (uint)6, elnr );
+    CPPUNIT_ASSERT_DOUBLES_EQUAL( 5.0 / FieldWriter::BOHR, x, 1e-5 );
+    for(unsigned int i=1; i<nr_atoms; i++) {
+        infile >> elnr >> charge >> x >> y >> z;
+    }
+    std::vector<double> values;
+    double value;
+    while(infile >> value) {
+        values.push_back(value);
+    }
+    CPPUNIT_ASSERT_EQUAL( (size_t)sf.get_size(), values.size() );
+    const double bohr3 = FieldWriter::BOHR * FieldWriter::BOHR * FieldWriter::BOHR;
+    const unsigned int ix = 48, iy = 51, iz = 53;
+    CPPUNIT_ASSERT_DOUBLES_EQUAL( sf.get_value(ix, iy, iz) * bohr3,
+                                  values[(ix * dims[1] + iy) * dims[2] + iz],
+                                  1e-5 * sf.get_value(ix, iy, iz) * bohr3 );
+
+    unsetenv("EDP_NO_CACHE");
+}
+
+void TestScalarField::testReaders() {
+    setenv("EDP_NO_CACHE", "1", 1);
+    ScalarField sf("CHGCAR_CH4", false);
+    sf.read();
+    CPPUNIT_ASSERT_EQUAL( std::string("vasp"), std::string(sf.get_format()) );
+    const auto& dims = sf.get_grid_dimensions();
+
+    // cube files are recognized by their contents and transposed on reading
+    FieldWriter::write_cube(sf, "CHGCAR_CH4.cube");
+    boost::filesystem::rename("CHGCAR_CH4.cube", "CHGCAR_CH4_density");
+    ScalarField sfc("CHGCAR_CH4_density", false);
+    sfc.read();
+    CPPUNIT_ASSERT_EQUAL( std::string("cube"), std::string(sfc.get_format()) );
+    CPPUNIT_ASSERT( dims == sfc.get_grid_dimensions() );
+    CPPUNIT_ASSERT_DOUBLES_EQUAL( sf.get_volume(), sfc.get_volume(), 1e-2 );
+    CPPUNIT_ASSERT( (sf.get_atom_position(4) - sfc.get_atom_position(4)).norm() < 1e-4 );
+    for(unsigned int i=0; i<sf.get_size(); i++) {
+        CPPUNIT_ASSERT_DOUBLES_EQUAL( sf.get_grid_ptr()[i], sfc.get_grid_ptr()[i], 1e-5 * std::fabs(sf.get_grid_ptr()[i]) + 1e-30 );
+    }
+
+    // the atoms are stored relative to the origin of the grid
+    {
+        const Vec3 origin(1.5, 2.0, -0.5);     // in bohr
+        std::ifstream in("CHGCAR_CH4_density");
+        std::ofstream out("CHGCAR_CH4_shifted");
+        std::string line;
+        for(unsigned int l=0; std::getline(in, line); l++) {
+            if(l == 2) {
+                out << boost::format("%5i%12.6f%12.6f%12.6f") % 5 % origin[0] % origin[1] % origin[2] << "\n";
+            } else if(l >= 6 && l < 11) {
+                std::istringstream ss(line);
+                int elnr;
+                fpt charge;
+                Vec3 pos;
+                ss >> elnr >> charge >> pos[0] >> pos[1] >> pos[2];
+                pos += origin;
+                out << boost::format("%5i%12.6f%12.6f%12.6f%12.6f") % elnr % charge % pos[0] % pos[1] % pos[2] << "\n";
+            } else {
+                out << line << "\n";
+            }
+        }
+    }
+    ScalarField sfs("CHGCAR_CH4_shifted", false);
+    sfs.read();
+    CPPUNIT_ASSERT_EQUAL( std::string("cube"), std::string(sfs.get_format()) );
+    for(unsigned int i=0; i<5; i++) {
+        CPPUNIT_ASSERT( (sf.get_atom_position(i) - sfs.get_atom_position(i)).norm() < 1e-4 );
+    }
+
+    // XSF files hold a general grid, which includes the periodic images
+    {
+        std::ofstream out("CHGCAR_CH4.xsf");
+        out << "# CH4" << std::endl << "CRYSTAL" << std::endl << "PRIMVEC" << std::endl;
+        for(unsigned int i=0; i<3; i++) {
+            const auto& mat = sf.get_mat_unitcell();
+            out << mat(i,0) << " " << mat(i,1) << " " << mat(i,2) << std::endl;
+        }
+        out << "PRIMCOORD" << std::endl << "5 1" << std::endl;
+        for(unsigned int i=0; i<5; i++) {
+            const Vec3 pos = sf.get_atom_position(i);
+            out << (i == 0 ? "C" : "1") << " " << pos[0] + 0.5 << " " << pos[1] - 1.0 << " " << pos[2] + 2.0 << std::endl;
+        }
+        out << "BEGIN_BLOCK_DATAGRID_3D" << std::endl << "density" << std::endl << "BEGIN_DATAGRID_3D_rho" << std::endl;
+        out << dims[0] + 1 << " " << dims[1] + 1 << " " << dims[2] + 1 << std::endl << "0.5 -1.0 2.0" << std::endl;
+        for(unsigned int i=0; i<3; i++) {
+            const auto& mat = sf.get_mat_unitcell();
+            out << mat(i,0) << " " << mat(i,1) << " " << mat(i,2) << std::endl;
+        }
+        out << std::setprecision(std::numeric_limits<fpt>::max_digits10);
+        for(unsigned int k=0; k<=dims[2]; k++) {
+            for(unsigned int j=0; j<=dims[1]; j++) {
+                for(unsigned int i=0; i<=dims[0]; i++) {
+                    out << sf.get_value(i % dims[0], j % dims[1], k % dims[2]) << "\n";
+                }
+            }
+        }
+        out << "END_DATAGRID_3D" << std::endl << "END_BLOCK_DATAGRID_3D" << std::endl;
+    }
+    ScalarField sfx("CHGCAR_CH4.xsf", false);
+    sfx.read();
+    CPPUNIT_ASSERT_EQUAL( std::string("xsf"), std::string(sfx.get_format()) );
+    CPPUNIT_ASSERT( dims == sfx.get_grid_dimensions() );
+    CPPUNIT_ASSERT( (sf.get_atom_position(4) - sfx.get_atom_position(4)).norm() < 1e-4 );
+
+    // the tokenizer rounds correctly to float, but not necessarily to double
+    CPPUNIT_ASSERT( std::equal(sf.get_grid_ptr(), sf.get_grid_ptr() + sf.get_size(), sfx.get_grid_ptr(), [](fpt a, fpt b) {
+        return std::abs(a - b) <= 4 * std::numeric_limits<fpt>::epsilon() * std::abs(a);
+    }) );
+
+    unsetenv("EDP_NO_CACHE");
+}
+
+void TestScalarField::testSpin() {
+    setenv("EDP_NO_CACHE", "1", 1);
+    ScalarField sf("CHGCAR_CH4", false);
+    sf.read();
+    const fpt* grid = sf.get_grid_ptr();
+
+    // append the negated density as the magnetization density mz
+    {
+        std::ifstream infile("CHGCAR_CH4");
+        std::ofstream outfile("CHGCAR_CH4_spin");
+        std::string line;
+        std::vector<std::string> lines;
+        bool in_grid = false;
+        while(std::getline(infile, line)) {
+            outfile << line << "\n";
+            if(line.find("augmentation") != std::string::npos) {
+                in_grid = false;
+            }
+            if(in_grid) {
+                // flip the sign of every value, retaining the fixed width
+                for(size_t i=0; i+2<line.size(); i++) {
+                    if(line[i+1] == '0' && line[i+2] == '.') {
+                        line[i] = line[i] == '-' ? ' ' : '-';
+                    }
+                }
+                lines.push_back(line);
+            }
+            if(line == "  100  100  100") {
+                in_grid = true;
+            }
+        }
+        outfile << "  0.000  0.000  0.000  0.000  0.000\n" << "  100  100  100\n";
+        for(const auto& l : lines) {
+            outfile << l << "\n";
+        }
+        outfile << "augmentation occupancies   1   8\n";
+        outfile << "  0.1000000E+00  0.0000000E+00  0.0000000E+00  0.0000000E+00  0.0000000E+00\n";
+    }
+
+    ScalarField sft("CHGCAR_CH4_spin", false);
+    sft.read();
+    CPPUNIT_ASSERT( std::equal(grid, grid + sf.get_size(), sft.get_grid_ptr()) );
+
+    ScalarField sfu("CHGCAR_CH4_spin", false, SpinDensity::Component::UP);
+    ScalarField sfd("CHGCAR_CH4_spin", false, SpinDensity::Component::DOWN);
+    ScalarField sfm("CHGCAR_CH4_spin", false, SpinDensity::Component::MAG);
+    ScalarField sfz("CHGCAR_CH4_spin", false, SpinDensity::Component::MZ);
+    sfu.read();
+    sfd.read();
+    sfm.read_lazy();
+    sfz.read();
+    for(size_t i=0; i<sf.get_size(); i++) {
+        CPPUNIT_ASSERT_EQUAL( (fpt)0.0, sfu.get_grid_ptr()[i] );
+        CPPUNIT_ASSERT_EQUAL( grid[i], sfd.get_grid_ptr()[i] );
+        CPPUNIT_ASSERT_EQUAL( std::abs(grid[i]), sfm.get_grid_ptr()[i] );
+        CPPUNIT_ASSERT_EQUAL( -grid[i], sfz.get_grid_ptr()[i] );
+    }
+
+    // compressed files are parsed in a single pass
+    {
+        std::ifstream infile("CHGCAR_CH4_spin", std::ios::binary);
+        std::ofstream outfile("CHGCAR_CH4_spin.gz", std::ios::binary);
+        boost::iostreams::filtering_ostream out;
+        out.push(boost::iostreams::gzip_compressor());
+        out.push(outfile);
+        out << infile.rdbuf();
+    }
+    ScalarField sfzc("CHGCAR_CH4_spin.gz", false, SpinDensity::Component::DOWN);
+    sfzc.read();
+    CPPUNIT_ASSERT( std::equal(grid, grid + sf.get_size(), sfzc.get_grid_ptr()) );
+
+    // the components of non-collinear calculations are not available
+    ScalarField sfx("CHGCAR_CH4_spin", false, SpinDensity::Component::MX);
+    CPPUNIT_ASSERT_THROW( sfx.read(), std::runtime_error );
+    ScalarField sf1("CHGCAR_CH4", false, SpinDensity::Component::MZ);
+    CPPUNIT_ASSERT_THROW( sf1.read(), std::runtime_error );
+    CPPUNIT_ASSERT( SpinDensity::parse("mag") == SpinDensity::Component::MAG );
+    CPPUNIT_ASSERT_THROW( SpinDensity::parse("spin"), std::runtime_error );
+
+    unsetenv("EDP_NO_CACHE");
+}
+
+void TestScalarField::testAugmentation() {
+    setenv("EDP_NO_CACHE", "1", 1);
+
+    // the occupancies are only parsed on request
+    ScalarField sf("CHGCAR_CH4", false);
+    sf.read();
+    const auto& occupancies = sf.get_augmentation_occupancies();
+    CPPUNIT_ASSERT_EQUAL( (size_t)5, occupancies.size() );
+    for(const auto& values : occupancies) {
+        CPPUNIT_ASSERT_EQUAL( (size_t)8, values.size() );
+    }
+    CPPUNIT_ASSERT_DOUBLES_EQUAL( 0.1234567, occupancies[0][0], 1e-7 );
+    CPPUNIT_ASSERT_DOUBLES_EQUAL( -0.2345678e-1, occupancies[4][1], 1e-8 );
+    CPPUNIT_ASSERT_DOUBLES_EQUAL( -0.125, occupancies[4][7], 1e-8 );
+    CPPUNIT_ASSERT_THROW( sf.get_augmentation_occupancies(1), std::runtime_error );
+
+    // grids without a fixed layout are skipped by tokenizing them
+    {
+        std::ifstream infile("CHGCAR_CH4");
+        std::ofstream outfile("CHGCAR_CH4_unaligned");
+        std::string line;
+        bool first = true;
+        while(std::getline(infile, line)) {
+            outfile << line << "\n";
+            if(first && line == "  100  100  100") {
+                std::getline(infile, line);
+                outfile << line.substr(0, 18) << "\n" << line.substr(18) << "\n";
+                first = false;
+            }
+        }
+    }
+    ScalarField sfu("CHGCAR_CH4_unaligned", false);
+    CPPUNIT_ASSERT( occupancies == sfu.get_augmentation_occupancies() );
+    sfu.read();
+    CPPUNIT_ASSERT( std::equal(sf.get_grid_ptr(), sf.get_grid_ptr() + sf.get_size(), sfu.get_grid_ptr()) );
+
+    unsetenv("EDP_NO_CACHE");
+}
+
+void TestScalarField::testLargeGrid() {
+    ScalarField sf("CHGCAR_CH4", false);
+    sf.read();
+    BinaryField::write(sf, "CHGCAR_CH4_large.edpf");
+
+    // enlarge the grid beyond 2^32 points; the file is sparse and only
+    // the touched pages of the mapping are ever read
+    const uint64_t dims[3] = {2048, 2048, 1025};
+    const uint64_t n = dims[0] * dims[1] * dims[2];
+    const fpt markers[2] = {1.5f, 2.5f};
+    const BinaryField::Header header = BinaryField::read_file_header("CHGCAR_CH4_large.edpf");
+    boost::filesystem::resize_file("CHGCAR_CH4_large.edpf", header.grid_offset + n * sizeof(fpt));
+    {
+        std::fstream file("CHGCAR_CH4_large.edpf", std::ios::in | std::ios::out | std::ios::binary);
+        file.seekp(offsetof(BinaryField::Header, grid_dimensions));
+        file.write(reinterpret_cast<const char*>(dims), sizeof(dims));
+        file.seekp(header.grid_offset + (1ULL << 32) * sizeof(fpt));
+        file.write(reinterpret_cast<const char*>(&markers[0]), sizeof(fpt));
+        file.seekp(header.grid_offset + (n - 1) * sizeof(fpt));
+        file.write(reinterpret_cast<const char*>(&markers[1]), sizeof(fpt));
+    }
+
+    ScalarField sfl("CHGCAR_CH4_large.edpf", false);
+    sfl.read();
+    CPPUNIT_ASSERT( n > std::numeric_limits<uint32_t>::max() );
+    CPPUNIT_ASSERT_EQUAL( (size_t)n, sfl.get_size() );
+    CPPUNIT_ASSERT_EQUAL( sf.get_value(0,0,0), sfl.get_value(0,0,0) );
+    CPPUNIT_ASSERT_EQUAL( markers[0], sfl.get_value(0,0,1024) );
+    CPPUNIT_ASSERT_EQUAL( markers[1], sfl.get_value(2047,2047,1024) );
+
+    boost::filesystem::remove("CHGCAR_CH4_large.edpf");
+}
+
+void TestScalarField::testCompact() {
+    // the codec rounds to nearest even, also for subnormals, and clamps
+    const float exact[] = {0.0f, 1.0f, -2.5f, 65504.0f, 6.103515625e-5f, 5.9604644775390625e-8f};
+    for(float f : exact) {
+        CPPUNIT_ASSERT_EQUAL((fpt)f, HalfFloat::decode(HalfFloat::encode(f)));
+    }
+    CPPUNIT_ASSERT_EQUAL((uint16_t)0x3c00, HalfFloat::encode(1.0f + 1.0f / 2048.0f));
+    CPPUNIT_ASSERT_EQUAL((uint16_t)0x3c02, HalfFloat::encode(1.0f + 3.0f / 2048.0f));
+    CPPUNIT_ASSERT_EQUAL((uint16_t)0x0001, HalfFloat::encode(4.0e-8f));
+    CPPUNIT_ASSERT_EQUAL((fpt)HalfFloat::MAX, HalfFloat::decode(HalfFloat::encode(1.0e6f)));
+
+    // the block conversions agree with the scalar ones
+    std::vector<fpt> values(1000);
+    for(size_t i=0; i<values.size(); i++) {
+        values[i] = std::pow((fpt)-1.37, (fpt)(i % 41)) * (fpt)1e-6;
+    }
+    std::vector<uint16_t> halves(values.size());
+    std::vector<fpt> decoded(values.size());
+    HalfFloat::encode_block(values.data(), halves.data(), values.size());
+    HalfFloat::decode_block(halves.data(), decoded.data(), values.size());
+    for(size_t i=0; i<values.size(); i++) {
+        CPPUNIT_ASSERT_EQUAL(HalfFloat::encode(values[i]), halves[i]);
+        CPPUNIT_ASSERT_EQUAL(HalfFloat::decode(halves[i]), decoded[i]);
+    }
+
+    setenv("EDP_NO_CACHE", "1", 1);
+    ScalarField sf("CHGCAR_CH4", false);
+    sf.read();
+    ScalarField sfc("CHGCAR_CH4", false);
+    sfc.read();
+    sfc.compact();
+    CPPUNIT_ASSERT(sfc.is_compact());
+    CPPUNIT_ASSERT_EQUAL(sf.get_size(), sfc.get_size());
+    CPPUNIT_ASSERT_THROW(sfc.get_grid_ptr(), std::runtime_error);
+
+    // values within the range of normal half precision numbers retain
+    // three significant digits
+    const auto& dims = sf.get_grid_dimensions();
+    for(unsigned int k=0; k<dims[2]; k+=7) {
+        for(unsigned int j=0; j<dims[1]; j+=3) {
+            for(unsigned int i=0; i<dims[0]; i++) {
+                const fpt v = sf.get_value(i,j,k);
+                if(std::fabs(v) > 1e-4) {
+                    CPPUNIT_ASSERT_DOUBLES_EQUAL(v, sfc.get_value(i,j,k), std::fabs(v) * 5e-4);
+                }
+            }
+        }
+    }
+    CPPUNIT_ASSERT_DOUBLES_EQUAL(sf.get_max(), sfc.get_max(), sf.get_max() * 5e-4);
+    const Vec3 p = sf.get_atom_position(0) + Vec3(0.1, 0.2, 0.3);
+    const fpt v = sf.get_value_interp(p[0], p[1], p[2]);
+    CPPUNIT_ASSERT(v > 1e-2);
+    CPPUNIT_ASSERT_DOUBLES_EQUAL(v, sfc.get_value_interp(p[0], p[1], p[2]), v * 5e-4);
+    unsetenv("EDP_NO_CACHE");
+}
+
+void TestScalarField::testBricks() {
+    setenv("EDP_NO_CACHE", "1", 1);
+    ScalarField sf("CHGCAR_CH4", false);
+    sf.read();
+    ScalarField sfb("CHGCAR_CH4", false);
+    sfb.read();
+    const fpt threshold = 1e-4;
+    sfb.sparsify(threshold);
+    CPPUNIT_ASSERT_THROW(sfb.get_grid_ptr(), std::runtime_error);
+    CPPUNIT_ASSERT_THROW(sfb.compact(), std::runtime_error);
+
+    // the grid of 100^3 points ends in truncated bricks; the vacuum
+    // around the molecule is constant
+    const BrickedGrid* bricks = sfb.get_bricked_grid();
+    CPPUNIT_ASSERT_EQUAL((size_t)13 * 13 * 13, bricks->get_nr_bricks());
+    CPPUNIT_ASSERT(bricks->get_nr_stored_bricks() < bricks->get_nr_bricks() / 2);
+    CPPUNIT_ASSERT(bricks->get_nr_stored_bricks() > 0);
+    CPPUNIT_ASSERT_EQUAL(sf.get_size(), sfb.get_size());
+
+    // extrema are exact; values deviate by at most half the threshold
+    CPPUNIT_ASSERT_EQUAL(sf.get_min(), sfb.get_min());
+    CPPUNIT_ASSERT_EQUAL(sf.get_max(), sfb.get_max());
+    const auto& dims = sf.get_grid_dimensions();
+    for(unsigned int k=0; k<dims[2]; k+=3) {
+        for(unsigned int j=0; j<dims[1]; j++) {
+            for(unsigned int i=0; i<dims[0]; i++) {
+                CPPUNIT_ASSERT_DOUBLES_EQUAL(sf.get_value(i,j,k), sfb.get_value(i,j,k), threshold / 2);
+            }
+        }
+    }
+    for(unsigned int k=0; k<dims[2]; k++) {
+        CPPUNIT_ASSERT_DOUBLES_EQUAL(sf.get_slab_sum(k), sfb.get_slab_sum(k), (fpa)dims[0] * dims[1] * threshold / 2);
+    }
+    const Vec3 p = sf.get_atom_position(0) + Vec3(0.1, 0.2, 0.3);
+    CPPUNIT_ASSERT_EQUAL(sf.get_value_interp(p[0], p[1], p[2]), sfb.get_value_interp(p[0], p[1], p[2]));
+    CPPUNIT_ASSERT_DOUBLES_EQUAL(sf.get_value_interp(0.5, 0.5, 0.5), sfb.get_value_interp(0.5, 0.5, 0.5), threshold / 2);
+
+    // without a threshold, only bricks of equal values are constant
+    ScalarField sfe("CHGCAR_CH4", false);
+    sfe.read();
+    sfe.sparsify(0.0);
+    for(unsigned int k=0; k<dims[2]; k+=7) {
+        for(unsigned int j=0; j<dims[1]; j++) {
+            for(unsigned int i=0; i<dims[0]; i++) {
+                CPPUNIT_ASSERT_EQUAL(sf.get_value(i,j,k), sfe.get_value(i,j,k));
+            }
+        }
+    }
+    unsetenv("EDP_NO_CACHE");
+}
+
+void TestScalarField::testCompressedField() {
+    setenv("EDP_NO_CACHE", "1", 1);
+    ScalarField sf("CHGCAR_CH4", false);
+    sf.read();
+    unsetenv("EDP_NO_CACHE");
+
+    const fpt bound = 1e-4;
+    CPPUNIT_ASSERT_THROW(CompressedField::write(sf, "CHGCAR_CH4.edpz", 0.0), std::runtime_error);
+    CPPUNIT_ASSERT_DOUBLES_EQUAL(1e-5 * (sf.get_max() - sf.get_min()), CompressedField::get_relative_error_bound(sf, 1e-5),
+                                 1e-6 * sf.get_max());
+    CompressedField::write(sf, "CHGCAR_CH4.edpz", bound);
+    CPPUNIT_ASSERT(CompressedField::probe("CHGCAR_CH4.edpz"));
+    CPPUNIT_ASSERT(!CompressedField::probe("CHGCAR_CH4"));
+    CPPUNIT_ASSERT(boost::filesystem::file_size("CHGCAR_CH4.edpz") * 4 < sf.get_size() * sizeof(fpt));
+
+    // every value is restored within the bound (up to rounding to fpt)
+    const fpt tolerance = bound + std::numeric_limits<fpt>::epsilon() * sf.get_max();
+    CPPUNIT_ASSERT(CompressedField::verify(sf, "CHGCAR_CH4.edpz") <= tolerance);
+
+    // the format is recognized from the contents and the grid is not cached
+    ScalarField sfz("CHGCAR_CH4.edpz", false);
+    sfz.read();
+    CPPUNIT_ASSERT_EQUAL(std::string("compressed"), std::string(sfz.get_format()));
+    CPPUNIT_ASSERT(!sfz.is_locpot());
+    CPPUNIT_ASSERT(!boost::filesystem::exists(GridCache::locate("CHGCAR_CH4.edpz")));
+    CPPUNIT_ASSERT_EQUAL(sf.get_atom_position(3), sfz.get_atom_position(3));
+    CPPUNIT_ASSERT(sf.get_unitcell_matrix() == sfz.get_unitcell_matrix());
+    CPPUNIT_ASSERT_DOUBLES_EQUAL(sf.get_value(10,20,30), sfz.get_value(10,20,30), tolerance);
+
+    // a single plane only decodes the layer of bricks holding it
+    ScalarField sfl("CHGCAR_CH4.edpz", false);
+    sfl.read_lazy();
+    const auto& dims = sf.get_grid_dimensions();
+    for(unsigned int j=0; j<dims[1]; j++) {
+        for(unsigned int i=0; i<dims[0]; i++) {
+            CPPUNIT_ASSERT_EQUAL(sfz.get_value(i,j,40), sfl.get_value(i,j,40));
+        }
+    }
+    CPPUNIT_ASSERT_EQUAL(1u, sfl.get_nr_slabs_loaded());
+    CPPUNIT_ASSERT_EQUAL(sfz.get_value(99,99,99), sfl.get_value(99,99,99));
+    CPPUNIT_ASSERT_EQUAL(sfz.get_value(1,2,33), sfl.get_value(1,2,33));
+
+    // the LOCPOT flag is retained
+    ScalarField sfp("CHGCAR_CH4", true);
+    sfp.read();
+    CompressedField::write(sfp, "LOCPOT_CH4.edpz", bound);
+    ScalarField sfpz("LOCPOT_CH4.edpz", false);
+    CPPUNIT_ASSERT(sfpz.is_locpot());
+
+    boost::filesystem::remove("CHGCAR_CH4.edpz");
+    boost::filesystem::remove("LOCPOT_CH4.edpz");
+
+    // a constant grid (e.g. an empty band) still receives a positive bound
+    for(fpt value : {(fpt)0.0, (fpt)2.5}) {
+        {
+            std::ifstream in("CHGCAR_CH4");
+            std::ofstream out("CHGCAR_constant");
+            std::string line;
+            for(unsigned int l=0; l<13 && std::getline(in, line); l++) {
+                out << line << "\n";
+            }
+            out << "\n    4    4    4\n";
+            for(unsigned int i=0; i<64; i++) {
+                out << value * sf.get_volume() << (i % 5 == 4 ? "\n" : " ");
+            }
+            out << "\n";
+        }
+        setenv("EDP_NO_CACHE", "1", 1);
+        ScalarField sfc("CHGCAR_constant", false);
+        sfc.read();
+        unsetenv("EDP_NO_CACHE");
+        const fpt constant_bound = CompressedField::get_relative_error_bound(sfc, 1e-5);
+        CPPUNIT_ASSERT(constant_bound > 0);
+        CompressedField::write(sfc, "CHGCAR_constant.edpz", constant_bound);
+        CPPUNIT_ASSERT(CompressedField::verify(sfc, "CHGCAR_constant.edpz") <= constant_bound + std::numeric_limits<fpt>::epsilon() * value);
+        boost::filesystem::remove("CHGCAR_constant");
+        boost::filesystem::remove("CHGCAR_constant.edpz");
+    }
+}
+
+void TestScalarField::testPlacement() {
+    // large grids are mapped at a huge page boundary and zeroed by all threads
+    for(size_t n : {(size_t)1000, (size_t)3000001}) {
+        GridBuffer buffer;
+        buffer.allocate(n);
+        CPPUNIT_ASSERT_EQUAL(n, buffer.size());
+        CPPUNIT_ASSERT_EQUAL((uintptr_t)0, reinterpret_cast<uintptr_t>(buffer.data()) % 64);
+        CPPUNIT_ASSERT(std::all_of(buffer.data(), buffer.data() + n, [](fpt v) { return v == 0; }));
+        buffer[n-1] = 1.0;
+        CPPUNIT_ASSERT_EQUAL((fpt)1.0, buffer[n-1]);
+        buffer.allocate(n / 2, false);
+        CPPUNIT_ASSERT_EQUAL(n / 2, buffer.size());
+    }
+
+    const unsigned int nr_threads = ThreadPlacement::get_nr_threads();
+    ThreadPlacement::set_nr_threads(2);
+    CPPUNIT_ASSERT_EQUAL(2u, ThreadPlacement::get_nr_threads());
+    CPPUNIT_ASSERT_EQUAL((size_t)2, ThreadPlacement::get_cpus().size());
+    CPPUNIT_ASSERT_THROW(ThreadPlacement::set_nr_threads(0), std::runtime_error);
+    CPPUNIT_ASSERT_THROW(ThreadPlacement::bind("scatter"), std::runtime_error);
+
+#ifdef __linux__
+    // threads started besides OpenMP may still use every CPU
+    cpu_set_t available;
+    CPPUNIT_ASSERT_EQUAL(0, sched_getaffinity(0, sizeof(available), &available));
+    ThreadPlacement::bind("close");
+    cpu_set_t inherited;
+    CPU_ZERO(&inherited);
+    std::thread helper([&inherited]() {
+        sched_getaffinity(0, sizeof(inherited), &inherited);
+    });
+    helper.join();
+    CPPUNIT_ASSERT(CPU_EQUAL(&available, &inherited));
+    ThreadPlacement::unbind();
+#endif
+    ThreadPlacement::set_nr_threads(nr_threads);
+}
+
+void TestScalarField::testSampling() {
+    setenv("EDP_NO_CACHE", "1", 1);
+    ScalarField sf("CHGCAR_CH4", false);
+    sf.read();
+    unsetenv("EDP_NO_CACHE");
+
+    // points partly outside the unit cell, on grid points and on the upper
+    // faces of the cell; the number of points is not a multiple of 16
+    const MatrixUnitcell& mat = sf.get_mat_unitcell();
+    const auto& dims = sf.get_grid_dimensions();
+    std::mt19937 rng(42);
+    std::uniform_real_distribution<fpt> dist(-0.2, 1.2);
+    const size_t n = 10007;
+    std::vector<fpt> x(n), y(n), z(n);
+    for(size_t i=0; i<n; i++) {
+        Vec3 d(dist(rng), dist(rng), dist(rng));
+        if(i % 5 == 0) {
+            d = Vec3(fpt(i % dims[0]) / dims[0], fpt(i % 7) / dims[1], 1.0);
+        }
+        const Vec3 r = mat.transpose() * d;
+        x[i] = r[0];
+        y[i] = r[1];
+        z[i] = r[2];
+    }
+
+    // the batch and the point-wise interpolation differ only by rounding
+    std::vector<fpt> values(n);
+    sf.get_values_interp(x.data(), y.data(), z.data(), values.data(), n);
+    const fpt tolerance = 1e-5 * sf.get_max();
+    size_t nr_inside = 0;
+    for(size_t i=0; i<n; i++) {
+        CPPUNIT_ASSERT_DOUBLES_EQUAL(sf.get_value_interp(x[i], y[i], z[i]), values[i], tolerance);
+        nr_inside += sf.is_inside(x[i], y[i], z[i]) ? 1 : 0;
+    }
+    CPPUNIT_ASSERT(nr_inside > n / 4 && nr_inside < n);
+
+    // periodic images of a point have the same value
+    std::vector<fpt> periodic(n);
+    sf.get_values_interp(x.data(), y.data(), z.data(), periodic.data(), n, true);
+    for(size_t i=0; i<n; i++) {
+        const Vec3 r = sf.realspace_to_direct(x[i], y[i], z[i]);
+        const Vec3 d(r[0] - std::floor(r[0]), r[1] - std::floor(r[1]), r[2] - std::floor(r[2]));
+        const Vec3 p = mat.transpose() * d;
+        if(sf.is_inside(p[0], p[1], p[2])) {
+            CPPUNIT_ASSERT_DOUBLES_EQUAL(sf.get_value_interp(p[0], p[1], p[2]), periodic[i], tolerance);
+        }
+    }
+
+    // compact grids are interpolated point by point
+    ScalarField sfc("CHGCAR_CH4", false);
+    sfc.read();
+    sfc.compact();
+    std::vector<fpt> compact(n);
+    sfc.get_values_interp(x.data(), y.data(), z.data(), compact.data(), n);
+    for(size_t i=0; i<n; i+=13) {
+        CPPUNIT_ASSERT_EQUAL(sfc.get_value_interp(x[i], y[i], z[i]), compact[i]);
+    }
+
+    // points and values are exchanged through text files
+    {
+        std::ofstream out("points.txt");
+        out << std::setprecision(9);
+        for(size_t i=0; i<n; i++) {
+            out << x[i] << " " << y[i] << "\t" << z[i] << "\n";
+        }
+    }
+    std::vector<fpt> xr, yr, zr;
+    BatchSampler::read_points("points.txt", xr, yr, zr);
+    CPPUNIT_ASSERT(xr == x && yr == y && zr == z);
+    BatchSampler::write_values("values.txt", values);
+    std::vector<fpt> vr(n);
+    {
+        MappedFile mf("values.txt");
+        const char* p = mf.data();
+        CPPUNIT_ASSERT_EQUAL(n, FloatTokenizer::parse_block(p, mf.end(), vr.data(), n, 1.0));
+    }
+    CPPUNIT_ASSERT(vr == values);
+    {
+        std::ofstream out("points_bad.txt");
+        out << "1.0 2.0 3.0\n4.0 5.0\n";
+    }
+    CPPUNIT_ASSERT_THROW(BatchSampler::read_points("points_bad.txt", xr, yr, zr), std::runtime_error);
+}
+
+void TestScalarField::testPadding() {
+    setenv("EDP_NO_CACHE", "1", 1);
+    ScalarField sf("CHGCAR_CH4", false);
+    sf.read();
+    ScalarField sfp("CHGCAR_CH4", false);
+    sfp.read();
+    unsetenv("EDP_NO_CACHE");
+    CPPUNIT_ASSERT(sfp.pad());
+    const PaddedGrid* padded = sfp.get_padded_grid();
+    CPPUNIT_ASSERT(padded != nullptr);
+
+    // the ghost layers hold the opposite faces
+    const auto& dims = sf.get_grid_dimensions();
+    const int nx = dims[0];
+    const int ny = dims[1];
+    const int nz = dims[2];
+    CPPUNIT_ASSERT_EQUAL((size_t)(nx + 2) * (ny + 2) * (nz + 2), padded->get_size());
+    for(int k=-1; k<=nz; k+=3) {
+        for(int j=-1; j<=ny; j++) {
+            for(int i=-1; i<=nx; i++) {
+                CPPUNIT_ASSERT_EQUAL(sf.get_value((i + nx) % nx, (j + ny) % ny, (k + nz) % nz), padded->get_value(i, j, k));
+            }
+        }
+    }
+
+    // the interpolation is unchanged, including on the faces of the cell
+    const MatrixUnitcell& mat = sf.get_mat_unitcell();
+    std::mt19937 rng(7);
+    std::uniform_real_distribution<fpt> dist(-0.1, 1.1);
+    const fpt tolerance = 1e-6 * sf.get_max();
+    for(unsigned int i=0; i<20000; i++) {
+        Vec3 d(dist(rng), dist(rng), dist(rng));
+        if(i % 4 == 0) {
+            d[i % 3] = (i % 8 == 0) ? 1.0 : 0.0;
+        }
+        const Vec3 r = mat.transpose() * d;
+        CPPUNIT_ASSERT_DOUBLES_EQUAL(sf.get_value_interp(r[0], r[1], r[2]), sfp.get_value_interp(r[0], r[1], r[2]), tolerance);
+    }
+
+    // compact grids are not padded
+    sfp.compact();
+    CPPUNIT_ASSERT(sfp.get_padded_grid() == nullptr);
+    CPPUNIT_ASSERT(!sfp.pad());
+}
+
+void TestScalarField::testBSpline() {
+    // a smooth periodic function is reproduced far better than by
+    // trilinear interpolation, and exactly at the grid points
+    const std::array<unsigned int, 3> dims = {24, 20, 16};
+    auto f = [](fpt x, fpt y, fpt z) -> fpt {
+        return std::sin(2.0 * M_PI * x) * std::cos(2.0 * M_PI * y) + std::sin(2.0 * M_PI * z);
+    };
+    std::vector<fpt> grid((size_t)dims[0] * dims[1] * dims[2]);
+    for(unsigned int k=0; k<dims[2]; k++) {
+        for(unsigned int j=0; j<dims[1]; j++) {
+            for(unsigned int i=0; i<dims[0]; i++) {
+                grid[(k * dims[1] + j) * dims[0] + i] = f(fpt(i) / dims[0], fpt(j) / dims[1], fpt(k) / dims[2]);
+            }
+        }
+    }
+    const PaddedGrid linear(grid.data(), dims);
+    std::vector<fpt> coefficients = grid;
+    CubicBSpline::prefilter(coefficients.data(), dims);
+    const PaddedGrid spline(coefficients.data(), dims, 2);
+
+    for(unsigned int k=0; k<dims[2]; k+=3) {
+        for(unsigned int j=0; j<dims[1]; j++) {
+            for(unsigned int i=0; i<dims[0]; i++) {
+                CPPUNIT_ASSERT_DOUBLES_EQUAL(grid[(k * dims[1] + j) * dims[0] + i],
+                                             spline.get_value_bspline(fpt(i) / dims[0], fpt(j) / dims[1], fpt(k) / dims[2]), 1e-5);
+            }
+        }
+    }
+    CPPUNIT_ASSERT_DOUBLES_EQUAL(f(0, 0, 0), spline.get_value_bspline(1.0, 1.0, 1.0), 1e-5);
+
+    std::mt19937 rng(3);
+    std::uniform_real_distribution<fpt> dist(0.0, 1.0);
+    fpt error_linear = 0.0;
+    fpt error_cubic = 0.0;
+    for(unsigned int n=0; n<10000; n++) {
+        const fpt x = dist(rng);
+        const fpt y = dist(rng);
+        const fpt z = dist(rng);
+        error_linear = std::max(error_linear, std::fabs(linear.get_value_interp(x, y, z) - f(x, y, z)));
+        error_cubic = std::max(error_cubic, std::fabs(spline.get_value_bspline(x, y, z) - f(x, y, z)));
+    }
+    CPPUNIT_ASSERT(error_linear > 1e-2);
+    CPPUNIT_ASSERT(error_cubic < error_linear / 10);
+
+    // the scalar field passes through its grid points with either interpolation
+    setenv("EDP_NO_CACHE", "1", 1);
+    ScalarField sf("CHGCAR_CH4", false);
+    sf.read();
+    unsetenv("EDP_NO_CACHE");
+    CPPUNIT_ASSERT(sf.get_interpolation() == ScalarField::Interpolation::LINEAR);
+    sf.set_interpolation(ScalarField::Interpolation::CUBIC);
+    CPPUNIT_ASSERT(sf.get_interpolation() == ScalarField::Interpolation::CUBIC);
+    const auto& sdims = sf.get_grid_dimensions();
+    const MatrixUnitcell& mat = sf.get_mat_unitcell();
+    const fpt tolerance = 1e-5 * sf.get_max();
+    for(unsigned int n=0; n<2000; n++) {
+        const unsigned int i = rng() % sdims[0];
+        const unsigned int j = rng() % sdims[1];
+        const unsigned int k = rng() % sdims[2];
+        const Vec3 r = mat.transpose() * Vec3(fpt(i) / sdims[0], fpt(j) / sdims[1], fpt(k) / sdims[2]);
+        CPPUNIT_ASSERT_DOUBLES_EQUAL(sf.get_value(i, j, k), sf.get_value_interp(r[0], r[1], r[2]), tolerance);
+    }
+
+    // the batch interpolation evaluates the spline as well
+    std::vector<fpt> x(1000), y(1000), z(1000), values(1000);
+    for(size_t n=0; n<x.size(); n++) {
+        const Vec3 r = mat.transpose() * Vec3(dist(rng), dist(rng), dist(rng));
+        x[n] = r[0];
+        y[n] = r[1];
+        z[n] = r[2];
+    }
+    sf.get_values_interp(x.data(), y.data(), z.data(), values.data(), x.size());
+    for(size_t n=0; n<x.size(); n++) {
+        CPPUNIT_ASSERT_EQUAL(sf.get_value_interp(x[n], y[n], z[n]), values[n]);
+    }
+
+    sf.set_interpolation(ScalarField::Interpolation::LINEAR);
+    sf.compact();
+    CPPUNIT_ASSERT_THROW(sf.set_interpolation(ScalarField::Interpolation::CUBIC), std::runtime_error);
+}
+
+void TestScalarField::testTiling() {
+    setenv("EDP_NO_CACHE", "1", 1);
+    ScalarField sf("CHGCAR_CH4", false);
+    sf.read();
+    ScalarField sft("CHGCAR_CH4", false);
+    sft.read();
+    unsetenv("EDP_NO_CACHE");
+    sft.tile();
+    const TiledGrid* tiles = sft.get_tiled_grid();
+    CPPUNIT_ASSERT(tiles != nullptr);
+    CPPUNIT_ASSERT_THROW(sft.get_grid_ptr(), std::runtime_error);
+
+    // the grid (100 points along each axis) does not fill the last tiles
+    const auto& dims = sf.get_grid_dimensions();
+    for(unsigned int a=0; a<3; a++) {
+        CPPUNIT_ASSERT_EQUAL((dims[a] + TiledGrid::TILE - 1) / TiledGrid::TILE, tiles->get_nr_tiles()[a]);
+    }
+    for(unsigned int k=0; k<dims[2]; k+=7) {
+        for(unsigned int j=0; j<dims[1]; j++) {
+            for(unsigned int i=0; i<dims[0]; i++) {
+                CPPUNIT_ASSERT_EQUAL(sf.get_value(i, j, k), sft.get_value(i, j, k));
+            }
+        }
+        CPPUNIT_ASSERT_DOUBLES_EQUAL(sf.get_slab_sum(k), sft.get_slab_sum(k), 1e-5 * std::abs(sf.get_slab_sum(k)));
+    }
+    CPPUNIT_ASSERT_EQUAL(sf.get_min(), sft.get_min());
+    CPPUNIT_ASSERT_EQUAL(sf.get_max(), sft.get_max());
+
+    // the interpolation is unchanged, including on the faces of the cell
+    const MatrixUnitcell& mat = sf.get_mat_unitcell();
+    std::mt19937 rng(11);
+    std::uniform_real_distribution<fpt> dist(-0.1, 1.1);
+    const fpt tolerance = 1e-6 * sf.get_max();
+    std::vector<fpt> x, y, z;
+    for(unsigned int i=0; i<20000; i++) {
+        Vec3 d(dist(rng), dist(rng), dist(rng));
+        if(i % 4 == 0) {
+            d[i % 3] = (i % 8 == 0) ? 1.0 : 0.0;
+        }
+        const Vec3 r = mat.transpose() * d;
+        CPPUNIT_ASSERT_DOUBLES_EQUAL(sf.get_value_interp(r[0], r[1], r[2]), sft.get_value_interp(r[0], r[1], r[2]), tolerance);
+        x.push_back(r[0]);
+        y.push_back(r[1]);
+        z.push_back(r[2]);
+    }
+
+    // as does the batch sampler, with and without mapping the points into the cell
+    std::vector<fpt> expected(x.size()), values(x.size());
+    for(bool periodic : {false, true}) {
+        sf.get_values_interp(x.data(), y.data(), z.data(), expected.data(), x.size(), periodic);
+        sft.get_values_interp(x.data(), y.data(), z.data(), values.data(), x.size(), periodic);
+        for(size_t n=0; n<x.size(); n++) {
+            CPPUNIT_ASSERT_DOUBLES_EQUAL(expected[n], values[n], tolerance);
+        }
+    }
+
+    // the tiles exclude the other representations
+    CPPUNIT_ASSERT(!sft.pad());
+    CPPUNIT_ASSERT_THROW(sft.compact(), std::runtime_error);
+    CPPUNIT_ASSERT_THROW(sft.sparsify(1e-5), std::runtime_error);
+    CPPUNIT_ASSERT_THROW(sft.set_interpolation(ScalarField::Interpolation::CUBIC), std::runtime_error);
+}
+
+#ifdef HAS_HDF5
+void TestScalarField::testVaspout() {
+    setenv("EDP_NO_CACHE", "1", 1);
+    ScalarField sf("CHGCAR_CH4", false);
+    sf.read();
+    const auto& dims = sf.get_grid_dimensions();
+    const auto& mat = sf.get_mat_unitcell();
+
+    // store the structure and the grid as VASP 6 does in vaspout.h5
+    {
+        hid_t file = H5Fcreate("CHGCAR_CH4.h5", H5F_ACC_TRUNC, H5P_DEFAULT, H5P_DEFAULT);
+        hid_t lcpl = H5Pcreate(H5P_LINK_CREATE);
+        H5Pset_create_intermediate_group(lcpl, 1);
+        auto write = [file, lcpl](const char* path, hid_t type, const std::vector<hsize_t>& shape, const void* data) {
+            hid_t space = H5Screate_simple(shape.size(), shape.data(), nullptr);
+            hid_t dataset = H5Dcreate2(file, path, type, space, lcpl, H5P_DEFAULT, H5P_DEFAULT);
+            H5Dwrite(dataset, type, H5S_ALL, H5S_ALL, H5P_DEFAULT, data);
+            H5Dclose(dataset);
+            H5Sclose(space);
+        };
+
+        const double scale = 1.0;
+        std::vector<double> lattice, direct;
+        for(unsigned int i=0; i<9; i++) {
+            lattice.push_back(mat(i / 3, i % 3));
+        }
+        for(unsigned int i=0; i<5; i++) {
+            const Vec3 pos = mat.transpose().inverse() * sf.get_atom_position(i);
+            direct.insert(direct.end(), {pos[0], pos[1], pos[2]});
+        }
+        const char types[2][2] = {{'C', ' '}, {'H', ' '}};
+        const int counts[2] = {1, 4};
+        std::vector<fpt> charge(sf.get_size());
+        for(size_t i=0; i<charge.size(); i++) {
+            charge[i] = sf.get_grid_ptr()[i] * sf.get_volume();
+        }
+
+        hid_t strtype = H5Tcopy(H5T_C_S1);
+        H5Tset_size(strtype, 2);
+        write("results/positions/scale", H5T_NATIVE_DOUBLE, {1}, &scale);
+        write("results/positions/lattice_vectors", H5T_NATIVE_DOUBLE, {3, 3}, lattice.data());
+        write("results/positions/position_ions", H5T_NATIVE_DOUBLE, {5, 3}, direct.data());
+        write("results/positions/ion_types", strtype, {2}, types);
+        write("results/positions/number_ion_types", H5T_NATIVE_INT, {2}, counts);
+        write("results/charge/charge", sizeof(fpt) == sizeof(double) ? H5T_NATIVE_DOUBLE : H5T_NATIVE_FLOAT, {1, dims[2], dims[1], dims[0]}, charge.data());
+        H5Tclose(strtype);
+        H5Pclose(lcpl);
+        H5Fclose(file);
+    }
+
+    ScalarField sfh("CHGCAR_CH4.h5", false);
+    sfh.read();
+    CPPUNIT_ASSERT_EQUAL( std::string("vaspout"), std::string(sfh.get_format()) );
+    CPPUNIT_ASSERT( dims == sfh.get_grid_dimensions() );
+    CPPUNIT_ASSERT( (sf.get_atom_position(4) - sfh.get_atom_position(4)).norm() < 1e-4 );
+    for(size_t i=0; i<sf.get_size(); i++) {
+        CPPUNIT_ASSERT_DOUBLES_EQUAL( sf.get_grid_ptr()[i], sfh.get_grid_ptr()[i], 1e-6 * std::abs(sf.get_grid_ptr()[i]) );
+    }
+
+    // slabs are read as hyperslabs on demand
+    ScalarField sfl("CHGCAR_CH4.h5", false);
+    sfl.read_lazy();
+    CPPUNIT_ASSERT_EQUAL( (uint)0, sfl.get_nr_slabs_loaded() );
+    CPPUNIT_ASSERT_EQUAL( sfh.get_value_interp(4.95,4.95,4.95), sfl.get_value_interp(4.95,4.95,4.95) );
+    CPPUNIT_ASSERT_EQUAL( (uint)2, sfl.get_nr_slabs_loaded() );
+    CPPUNIT_ASSERT( std::equal(sfh.get_grid_ptr(), sfh.get_grid_ptr() + sfh.get_size(), sfl.get_grid_ptr()) );
+
+    unsetenv("EDP_NO_CACHE");
+}
+#endif
@@ -25,11 +25,43 @@
 
 #include "scalar_field.h"
 #include "planeprojector.h"
+#include "binary_field.h"
+#include "grid_cache.h"
+#include "stream_reader.h"
+#include "tar_archive.h"
+#include "field_info.h"
+#include "field_writer.h"
+#include "compressed_field.h"
+#include "thread_placement.h"
+#include "batch_sampler.h"
 
 class TestScalarField : public CppUnit::TestFixture
 {
   CPPUNIT_TEST_SUITE( TestScalarField );
   CPPUNIT_TEST( testReading );
+  CPPUNIT_TEST( testTokenizer );
+  CPPUNIT_TEST( testBinaryFormat );
+  CPPUNIT_TEST( testGridCache );
+  CPPUNIT_TEST( testCompressed );
+  CPPUNIT_TEST( testArchive );
+  CPPUNIT_TEST( testLazyReading );
+  CPPUNIT_TEST( testInfo );
+  CPPUNIT_TEST( testWriters );
+  CPPUNIT_TEST( testReaders );
+  CPPUNIT_TEST( testSpin );
+  CPPUNIT_TEST( testAugmentation );
+  CPPUNIT_TEST( testLargeGrid );
+  CPPUNIT_TEST( testCompact );
+  CPPUNIT_TEST( testBricks );
+  CPPUNIT_TEST( testCompressedField );
+  CPPUNIT_TEST( testPlacement );
+  CPPUNIT_TEST( testSampling );
+  CPPUNIT_TEST( testPadding );
+  CPPUNIT_TEST( testBSpline );
+  CPPUNIT_TEST( testTiling );
+#ifdef HAS_HDF5
+  CPPUNIT_TEST( testVaspout );
+#endif
   CPPUNIT_TEST_SUITE_END();
 
 public:
@@ -37,6 +69,29 @@ public:
   void tearDown();
 
   void testReading();
+  void testTokenizer();
+  void testBinaryFormat();
+  void testGridCache();
+  void testCompressed();
+  void testArchive();
+  void testLazyReading();
+  void testInfo();
+  void testWriters();
+  void testReaders();
+  void testSpin();
+  void testAugmentation();
+  void testLargeGrid();
+  void testCompact();
+  void testBricks();
+  void testCompressedField();
+  void testPlacement();
+  void testSampling();
+  void testPadding();
+  void testBSpline();
+  void testTiling();
+#ifdef HAS_HDF5
+  void testVaspout();
+#endif
 
 private:
 };
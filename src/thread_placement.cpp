@@ -0,0 +1,148 @@
+/**************************************************************************
+ *                                                                        *
+ *   Author: Ivo Filot <i.a.w.filot@tue.nl>                               *
+ *                                                                        *
+ *   EDP is free software:                                                *
+ *   you can redistribute it and/or modify it under the terms of the      *
+ *   GNU General Public License as published by the Free Software         *
+ *   Foundation, either version 3 of the License, or (at your option)     *
+ *   any later version.                                                   *
+ *                                                                        *
+ *   EDP is distributed in the hope that it will be useful,               *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty          *
+ *   of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.              *
+ *   See the GNU General Public License for more details.                 *
+ *                                                                        *
+ *   You should have received a copy of the GNU General Public License    *
+ *   along with this program.  If not, see http://www.gnu.org/licenses/.  *
+ *                                                                        *
+ **************************************************************************/
+
+#include "thread_placement.h"
+
+#include <stdexcept>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+/**
+ * @brief      set the number of threads of subsequent parallel regions
+ *
+ * @param[in]  n     number of threads (at least one)
+ */
+void ThreadPlacement::set_nr_threads(unsigned int n) {
+    if(n == 0) {
+        throw std::runtime_error("The number of threads should be at least one.");
+    }
+#ifdef _OPENMP
+    omp_set_num_threads(n);
+#endif
+}
+
+/**
+ * @brief      number of threads of subsequent parallel regions
+ */
+unsigned int ThreadPlacement::get_nr_threads() {
+#ifdef _OPENMP
+    return omp_get_max_threads();
+#else
+    return 1;
+#endif
+}
+
+/**
+ * @brief      pin every thread to a single CPU
+ *
+ * @param[in]  policy  "close" or "spread"
+ */
+void ThreadPlacement::bind(const std::string& policy) {
+    if(policy != "close" && policy != "spread") {
+        throw std::runtime_error("Unknown binding policy " + policy + "; use close or spread.");
+    }
+
+#ifdef __linux__
+    // the main thread keeps the CPUs of the process, such that the threads
+    // it starts besides OpenMP (reading, caching, writing) do so as well
+    cpu_set_t available;
+    if(sched_getaffinity(0, sizeof(available), &available) != 0) {
+        throw std::runtime_error("Cannot determine the CPUs available to the process.");
+    }
+    std::vector<int> cpus;
+    for(int cpu=0; cpu<CPU_SETSIZE; cpu++) {
+        if(CPU_ISSET(cpu, &available)) {
+            cpus.push_back(cpu);
+        }
+    }
+
+    bool failed = false;
+    #pragma omp parallel reduction(||:failed)
+    {
+#ifdef _OPENMP
+        const size_t t = omp_get_thread_num();
+        const size_t nt = omp_get_num_threads();
+#else
+        const size_t t = 0;
+        const size_t nt = 1;
+#endif
+        if(t != 0) {
+            // with more threads than CPUs, threads share CPUs round-robin
+            const size_t idx = policy == "close" || nt > cpus.size() ? t % cpus.size() : t * cpus.size() / nt;
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            CPU_SET(cpus[idx], &set);
+            failed = pthread_setaffinity_np(pthread_self(), sizeof(set), &set) != 0;
+        }
+    }
+    if(failed) {
+        throw std::runtime_error("Cannot bind the threads to CPUs.");
+    }
+#else
+    throw std::runtime_error("Binding threads to CPUs is only supported on Linux.");
+#endif
+}
+
+/**
+ * @brief      allow every thread to run on all CPUs of the process again
+ */
+void ThreadPlacement::unbind() {
+#ifdef __linux__
+    // the main thread has kept the CPUs of the process
+    cpu_set_t available;
+    if(sched_getaffinity(0, sizeof(available), &available) != 0) {
+        throw std::runtime_error("Cannot determine the CPUs available to the process.");
+    }
+
+    bool failed = false;
+    #pragma omp parallel reduction(||:failed)
+    {
+        failed = pthread_setaffinity_np(pthread_self(), sizeof(available), &available) != 0;
+    }
+    if(failed) {
+        throw std::runtime_error("Cannot unbind the threads from their CPUs.");
+    }
+#endif
+}
+
+/**
+ * @brief      CPU that each thread currently runs on
+ *
+ * @return     CPU per thread (-1 if unknown)
+ */
+std::vector<int> ThreadPlacement::get_cpus() {
+    std::vector<int> cpus(get_nr_threads(), -1);
+    #pragma omp parallel
+    {
+#if defined(__linux__) && defined(_OPENMP)
+        cpus[omp_get_thread_num()] = sched_getcpu();
+#elif defined(__linux__)
+        cpus[0] = sched_getcpu();
+#endif
+    }
+    return cpus;
+}
@@ -0,0 +1,81 @@
+/**************************************************************************
+ *                                                                        *
+ *   Author: Ivo Filot <i.a.w.filot@tue.nl>                               *
+ *                                                                        *
+ *   EDP is free software:                                                *
+ *   you can redistribute it and/or modify it under the terms of the      *
+ *   GNU General Public License as published by the Free Software         *
+ *   Foundation, either version 3 of the License, or (at your option)     *
+ *   any later version.                                                   *
+ *                                                                        *
+ *   EDP is distributed in the hope that it will be useful,               *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty          *
+ *   of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.              *
+ *   See the GNU General Public License for more details.                 *
+ *                                                                        *
+ *   You should have received a copy of the GNU General Public License    *
+ *   along with this program.  If not, see http://www.gnu.org/licenses/.  *
+ *                                                                        *
+ **************************************************************************/
+
+#ifndef _THREAD_PLACEMENT_H
+#define _THREAD_PLACEMENT_H
+
+#include <string>
+#include <vector>
+
+/**
+ * @brief      Control over the number of OpenMP threads and the CPUs they
+ *             run on
+ *
+ * The binding policy of OpenMP (OMP_PROC_BIND) is fixed once the runtime
+ * has started, so the threads are pinned through the affinity interface of
+ * the operating system instead. As the OpenMP runtime keeps its threads
+ * alive in between parallel regions, the threads stay pinned as long as the
+ * number of threads does not change. Threads should be placed before the
+ * grid is allocated, such that its pages are touched first (and hence
+ * placed) by the threads that will use them.
+ */
+class ThreadPlacement {
+public:
+    /**
+     * @brief      set the number of threads of subsequent parallel regions
+     *
+     * @param[in]  n     number of threads (at least one)
+     */
+    static void set_nr_threads(unsigned int n);
+
+    /**
+     * @brief      number of threads of subsequent parallel regions
+     */
+    static unsigned int get_nr_threads();
+
+    /**
+     * @brief      pin every thread to a single CPU
+     *
+     * With "close", consecutive threads are pinned to consecutive CPUs
+     * (filling one socket before the next, for the usual numbering of the
+     * CPUs); with "spread", the threads are distributed evenly over all
+     * CPUs available to the process. The main thread (OpenMP thread 0)
+     * is not pinned: threads inherit the CPUs of the thread that starts
+     * them, so the threads that overlap reading, caching and writing with
+     * the computation would otherwise all share its CPU.
+     *
+     * @param[in]  policy  "close" or "spread"
+     */
+    static void bind(const std::string& policy);
+
+    /**
+     * @brief      allow every thread to run on all CPUs of the process again
+     */
+    static void unbind();
+
+    /**
+     * @brief      CPU that each thread currently runs on
+     *
+     * @return     CPU per thread (-1 if unknown)
+     */
+    static std::vector<int> get_cpus();
+};
+
+#endif // _THREAD_PLACEMENT_H
@@ -0,0 +1,119 @@
+/**************************************************************************
+ *                                                                        *
+ *   Author: Ivo Filot <i.a.w.filot@tue.nl>                               *
+ *                                                                        *
+ *   EDP is free software:                                                *
+ *   you can redistribute it and/or modify it under the terms of the      *
+ *   GNU General Public License as published by the Free Software         *
+ *   Foundation, either version 3 of the License, or (at your option)     *
+ *   any later version.                                                   *
+ *                                                                        *
+ *   EDP is distributed in the hope that it will be useful,               *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty          *
+ *   of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.              *
+ *   See the GNU General Public License for more details.                 *
+ *                                                                        *
+ *   You should have received a copy of the GNU General Public License    *
+ *   along with this program.  If not, see http://www.gnu.org/licenses/.  *
+ *                                                                        *
+ **************************************************************************/
+
+#include "tiled_grid.h"
+
+#include <limits>
+
+/**
+ * @brief      construct the tiles from a grid in parallel
+ *
+ * Every tile is filled (and first touched) by a single thread. Positions
+ * beyond the upper faces of the grid hold periodic images, such that every
+ * value of the tiles is a value of the grid.
+ *
+ * @param[in]  grid   grid (x running fastest)
+ * @param[in]  _dims  grid dimensions
+ */
+TiledGrid::TiledGrid(const fpt* grid, const std::array<unsigned int, 3>& _dims) :
+    dims(_dims) {
+
+    for(unsigned int d=0; d<3; d++) {
+        this->fdims[d] = (fpt)this->dims[d];
+        this->ntiles[d] = (this->dims[d] + TILE - 1) / TILE;
+    }
+    const size_t nr_tiles = (size_t)this->ntiles[0] * this->ntiles[1] * this->ntiles[2];
+    this->values.allocate(nr_tiles * TILE_SIZE, false);
+
+    const size_t nx = this->dims[0];
+    const size_t ny = this->dims[1];
+    const size_t nz = this->dims[2];
+
+    #pragma omp parallel for schedule(static)
+    for(size_t t=0; t<nr_tiles; t++) {
+        const size_t ti = t % this->ntiles[0];
+        const size_t tj = (t / this->ntiles[0]) % this->ntiles[1];
+        const size_t tk = t / ((size_t)this->ntiles[0] * this->ntiles[1]);
+
+        // indices of the points along x (wrapped into the grid)
+        size_t xs[STRIDE];
+        for(unsigned int l=0; l<STRIDE; l++) {
+            xs[l] = (ti * TILE + l) % nx;
+        }
+
+        fpt* dest = this->values.data() + t * TILE_SIZE;
+        for(unsigned int lk=0; lk<STRIDE; lk++) {
+            const size_t k = (tk * TILE + lk) % nz;
+            for(unsigned int lj=0; lj<STRIDE; lj++) {
+                const size_t j = (tj * TILE + lj) % ny;
+                const fpt* row = grid + (k * ny + j) * nx;
+                for(unsigned int l=0; l<STRIDE; l++) {
+                    *dest++ = row[xs[l]];
+                }
+            }
+        }
+    }
+}
+
+/**
+ * @brief      sum of the values in a plane of constant z
+ *
+ * @param[in]  k     index of the plane
+ *
+ * @return     sum
+ */
+fpa TiledGrid::get_slab_sum(unsigned int k) const {
+    fpa sum = 0.0;
+    #pragma omp parallel for reduction(+:sum)
+    for(unsigned int j=0; j<this->dims[1]; j++) {
+        for(unsigned int i=0; i<this->dims[0]; i++) {
+            sum += this->get_value(i, j, k);
+        }
+    }
+    return sum;
+}
+
+/**
+ * @brief      minimum value of the grid
+ *
+ * The overlap between the tiles only holds copies of values of the grid.
+ */
+fpt TiledGrid::get_min() const {
+    fpt vmin = std::numeric_limits<fpt>::max();
+    #pragma omp parallel for reduction(min:vmin)
+    for(size_t i=0; i<this->values.size(); i++) {
+        vmin = std::min(vmin, this->values[i]);
+    }
+    return vmin;
+}
+
+/**
+ * @brief      maximum value of the grid
+ *
+ * The overlap between the tiles only holds copies of values of the grid.
+ */
+fpt TiledGrid::get_max() const {
+    fpt vmax = std::numeric_limits<fpt>::lowest();
+    #pragma omp parallel for reduction(max:vmax)
+    for(size_t i=0; i<this->values.size(); i++) {
+        vmax = std::max(vmax, this->values[i]);
+    }
+    return vmax;
+}
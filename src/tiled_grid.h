@@ -0,0 +1,170 @@
+/**************************************************************************
+ *                                                                        *
+ *   Author: Ivo Filot <i.a.w.filot@tue.nl>                               *
+ *                                                                        *
+ *   EDP is free software:                                                *
+ *   you can redistribute it and/or modify it under the terms of the      *
+ *   GNU General Public License as published by the Free Software         *
+ *   Foundation, either version 3 of the License, or (at your option)     *
+ *   any later version.                                                   *
+ *                                                                        *
+ *   EDP is distributed in the hope that it will be useful,               *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty          *
+ *   of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.              *
+ *   See the GNU General Public License for more details.                 *
+ *                                                                        *
+ *   You should have received a copy of the GNU General Public License    *
+ *   along with this program.  If not, see http://www.gnu.org/licenses/.  *
+ *                                                                        *
+ **************************************************************************/
+
+#ifndef _TILED_GRID_H
+#define _TILED_GRID_H
+
+#include <algorithm>
+#include <array>
+
+#include "math.h"
+#include "grid_buffer.h"
+
+/**
+ * @brief      Cache-blocked storage for a periodic grid
+ *
+ * With x running fastest, the corners of neighbouring cells along y and z
+ * lie a row or a plane apart in memory. Planes that are not aligned with
+ * the grid axes therefore touch a different set of distant cache lines for
+ * every pixel. Here, the grid is stored as a sequence of tiles of TILE^3
+ * cells instead, tile by tile with x running fastest. Every tile holds the
+ * (TILE+1)^3 points at the corners of its cells, i.e. it overlaps with its
+ * neighbours by one layer of points (holding periodic images at the upper
+ * faces of the grid). Consequently, the eight corners of a cell always lie
+ * in a single tile of a few kilobytes, which remains cached while the
+ * neighbouring pixels of any plane are sampled, and can be read at fixed
+ * offsets without wrapping indices.
+ */
+class TiledGrid {
+public:
+    static constexpr unsigned int TILE_SHIFT = 3;
+    static constexpr unsigned int TILE = 1 << TILE_SHIFT;          // number of cells per tile along each axis
+    static constexpr unsigned int STRIDE = TILE + 1;                // number of points per tile along each axis
+    static constexpr unsigned int TILE_SIZE = STRIDE * STRIDE * STRIDE;
+
+private:
+    std::array<unsigned int, 3> dims;       // grid dimensions
+    std::array<fpt, 3> fdims;               // grid dimensions as fpt
+    std::array<unsigned int, 3> ntiles;     // number of tiles along each axis
+    GridBuffer values;
+
+public:
+    /**
+     * @brief      construct the tiles from a grid in parallel
+     *
+     * @param[in]  grid   grid (x running fastest)
+     * @param[in]  _dims  grid dimensions
+     */
+    TiledGrid(const fpt* grid, const std::array<unsigned int, 3>& _dims);
+
+    TiledGrid(const TiledGrid&) = delete;
+    TiledGrid& operator=(const TiledGrid&) = delete;
+
+    /**
+     * @brief      position of a grid point in the tiles
+     *
+     * @param[in]  i,j,k  indices (inside the grid)
+     */
+    inline size_t get_index(unsigned int i, unsigned int j, unsigned int k) const {
+        const size_t tile = ((size_t)(k >> TILE_SHIFT) * this->ntiles[1] + (j >> TILE_SHIFT)) * this->ntiles[0] + (i >> TILE_SHIFT);
+        const unsigned int local = ((k & (TILE - 1)) * STRIDE + (j & (TILE - 1))) * STRIDE + (i & (TILE - 1));
+        return tile * TILE_SIZE + local;
+    }
+
+    /**
+     * @brief      value at a grid point
+     */
+    inline fpt get_value(unsigned int i, unsigned int j, unsigned int k) const {
+        return this->values[this->get_index(i, j, k)];
+    }
+
+    /**
+     * @brief      trilinear interpolation at a position in direct coordinates
+     *
+     * @param[in]  dx,dy,dz  direct coordinates (inside [0,1])
+     *
+     * @return     interpolated value
+     */
+    inline fpt get_value_interp(fpt dx, fpt dy, fpt dz) const {
+        const fpt gx = dx * this->fdims[0];
+        const fpt gy = dy * this->fdims[1];
+        const fpt gz = dz * this->fdims[2];
+
+        // the coordinates are not negative, so truncation equals floor
+        const unsigned int i = std::min((unsigned int)gx, this->dims[0] - 1);
+        const unsigned int j = std::min((unsigned int)gy, this->dims[1] - 1);
+        const unsigned int k = std::min((unsigned int)gz, this->dims[2] - 1);
+        const fpt wx = gx - (fpt)i;
+        const fpt wy = gy - (fpt)j;
+        const fpt wz = gz - (fpt)k;
+
+        const fpt* p00 = this->values.data() + this->get_index(i, j, k);
+        const fpt* p10 = p00 + STRIDE;
+        const fpt* p01 = p00 + STRIDE * STRIDE;
+        const fpt* p11 = p01 + STRIDE;
+
+        const fpt c00 = p00[0] + wx * (p00[1] - p00[0]);
+        const fpt c10 = p10[0] + wx * (p10[1] - p10[0]);
+        const fpt c01 = p01[0] + wx * (p01[1] - p01[0]);
+        const fpt c11 = p11[0] + wx * (p11[1] - p11[0]);
+        const fpt c0 = c00 + wy * (c10 - c00);
+        const fpt c1 = c01 + wy * (c11 - c01);
+        return c0 + wz * (c1 - c0);
+    }
+
+    /**
+     * @brief      sum of the values in a plane of constant z
+     *
+     * @param[in]  k     index of the plane
+     *
+     * @return     sum
+     */
+    fpa get_slab_sum(unsigned int k) const;
+
+    /**
+     * @brief      minimum value of the grid
+     */
+    fpt get_min() const;
+
+    /**
+     * @brief      maximum value of the grid
+     */
+    fpt get_max() const;
+
+    /**
+     * @brief      grid dimensions
+     */
+    inline const std::array<unsigned int, 3>& get_dimensions() const {
+        return this->dims;
+    }
+
+    /**
+     * @brief      number of tiles along each axis
+     */
+    inline const std::array<unsigned int, 3>& get_nr_tiles() const {
+        return this->ntiles;
+    }
+
+    /**
+     * @brief      values of the tiles
+     */
+    inline const fpt* data() const {
+        return this->values.data();
+    }
+
+    /**
+     * @brief      number of values in the tiles (including the overlap)
+     */
+    inline size_t get_size() const {
+        return this->values.size();
+    }
+};
+
+#endif // _TILED_GRID_H
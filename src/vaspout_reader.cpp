@@ -0,0 +1,350 @@
+/**************************************************************************
+ *                                                                        *
+ *   Author: Ivo Filot <i.a.w.filot@tue.nl>                               *
+ *                                                                        *
+ *   EDP is free software:                                                *
+ *   you can redistribute it and/or modify it under the terms of the      *
+ *   GNU General Public License as published by the Free Software         *
+ *   Foundation, either version 3 of the License, or (at your option)     *
+ *   any later version.                                                   *
+ *                                                                        *
+ *   EDP is distributed in the hope that it will be useful,               *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty          *
+ *   of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.              *
+ *   See the GNU General Public License for more details.                 *
+ *                                                                        *
+ *   You should have received a copy of the GNU General Public License    *
+ *   along with this program.  If not, see http://www.gnu.org/licenses/.  *
+ *                                                                        *
+ **************************************************************************/
+
+#include "vaspout_reader.h"
+
+#ifdef HAS_HDF5
+
+#include "scalar_field.h"
+
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <type_traits>
+#include <hdf5.h>
+
+namespace {
+
+// the (serial) HDF5 library is not thread-safe
+std::mutex hdf5_mutex;
+
+/**
+ * @brief      HDF5 identifier that is closed when going out of scope
+ */
+class Handle {
+private:
+    hid_t id;
+    herr_t (*closer)(hid_t);
+
+public:
+    Handle(hid_t _id, herr_t (*_closer)(hid_t)) : id(_id), closer(_closer) {}
+
+    Handle(const Handle&) = delete;
+    Handle& operator=(const Handle&) = delete;
+
+    ~Handle() {
+        if(this->id >= 0) {
+            this->closer(this->id);
+        }
+    }
+
+    inline operator hid_t() const {
+        return this->id;
+    }
+
+    inline bool valid() const {
+        return this->id >= 0;
+    }
+};
+
+/**
+ * @brief      open a dataset
+ *
+ * @param[in]  file      HDF5 file
+ * @param[in]  path      path of the dataset
+ * @param[in]  filename  name of the file (for error messages)
+ *
+ * @return     dataset
+ */
+std::unique_ptr<Handle> open_dataset(hid_t file, const std::string& path, const std::string& filename) {
+    if(H5Lexists(file, path.c_str(), H5P_DEFAULT) <= 0) {
+        throw std::runtime_error("Cannot find dataset " + path + " in " + filename);
+    }
+    std::unique_ptr<Handle> dataset(new Handle(H5Dopen2(file, path.c_str(), H5P_DEFAULT), H5Dclose));
+    if(!dataset->valid()) {
+        throw std::runtime_error("Cannot open dataset " + path + " in " + filename);
+    }
+    return dataset;
+}
+
+/**
+ * @brief      read a numeric dataset in its entirety
+ *
+ * @param[in]  file      HDF5 file
+ * @param[in]  path      path of the dataset
+ * @param[in]  filename  name of the file (for error messages)
+ * @param[in]  type      type in memory
+ *
+ * @return     values
+ */
+template<typename T>
+std::vector<T> read_dataset(hid_t file, const std::string& path, const std::string& filename, hid_t type) {
+    auto dataset = open_dataset(file, path, filename);
+    Handle space(H5Dget_space(*dataset), H5Sclose);
+    const hssize_t n = H5Sget_simple_extent_npoints(space);
+    std::vector<T> values(std::max<hssize_t>(n, 0));
+    if(n < 0 || H5Dread(*dataset, type, H5S_ALL, H5S_ALL, H5P_DEFAULT, values.data()) < 0) {
+        throw std::runtime_error("Cannot read dataset " + path + " from " + filename);
+    }
+    return values;
+}
+
+/**
+ * @brief      read a dataset of (fixed or variable length) strings
+ *
+ * @param[in]  file      HDF5 file
+ * @param[in]  path      path of the dataset
+ * @param[in]  filename  name of the file (for error messages)
+ *
+ * @return     strings (trimmed)
+ */
+std::vector<std::string> read_strings(hid_t file, const std::string& path, const std::string& filename) {
+    auto dataset = open_dataset(file, path, filename);
+    Handle space(H5Dget_space(*dataset), H5Sclose);
+    Handle filetype(H5Dget_type(*dataset), H5Tclose);
+    const hssize_t n = H5Sget_simple_extent_npoints(space);
+    if(n < 0) {
+        throw std::runtime_error("Cannot read dataset " + path + " from " + filename);
+    }
+
+    std::vector<std::string> strings;
+    if(H5Tis_variable_str(filetype) > 0) {
+        Handle memtype(H5Tcopy(H5T_C_S1), H5Tclose);
+        H5Tset_size(memtype, H5T_VARIABLE);
+        std::vector<char*> buffer(n, nullptr);
+        if(H5Dread(*dataset, memtype, H5S_ALL, H5S_ALL, H5P_DEFAULT, buffer.data()) < 0) {
+            throw std::runtime_error("Cannot read dataset " + path + " from " + filename);
+        }
+        for(char* str : buffer) {
+            strings.emplace_back(str ? str : "");
+        }
+        H5Dvlen_reclaim(memtype, space, H5P_DEFAULT, buffer.data());
+    } else {
+        const size_t size = H5Tget_size(filetype);
+        Handle memtype(H5Tcopy(H5T_C_S1), H5Tclose);
+        H5Tset_size(memtype, size);
+        std::vector<char> buffer(n * size + 1, '\0');
+        if(H5Dread(*dataset, memtype, H5S_ALL, H5S_ALL, H5P_DEFAULT, buffer.data()) < 0) {
+            throw std::runtime_error("Cannot read dataset " + path + " from " + filename);
+        }
+        for(hssize_t i=0; i<n; i++) {
+            const char* str = buffer.data() + i * size;
+            strings.emplace_back(str, strnlen(str, size));
+        }
+    }
+
+    for(auto& str : strings) {
+        boost::trim(str);
+    }
+    return strings;
+}
+
+} // namespace
+
+/**
+ * @brief      Open dataset of a vaspout.h5 file from which slabs are read
+ */
+class VaspoutReader::Source {
+private:
+    std::string filename;
+    Handle file;
+    std::unique_ptr<Handle> dataset;
+    int rank;
+    unsigned int nr_components;
+    fpt divisor;
+
+public:
+    /**
+     * @brief      open the dataset holding the grid of a scalar field
+     *
+     * @param[in]  sf    scalar field (header should have been read)
+     */
+    Source(const ScalarField* sf) :
+        filename(sf->get_filename()),
+        file(H5Fopen(sf->get_filename().c_str(), H5F_ACC_RDONLY, H5P_DEFAULT), H5Fclose) {
+        if(!this->file.valid()) {
+            throw std::runtime_error("Cannot open " + this->filename + "!");
+        }
+        this->dataset = open_dataset(this->file, sf->is_locpot() ? POTENTIAL_DATASET : CHARGE_DATASET, this->filename);
+        Handle space(H5Dget_space(*this->dataset), H5Sclose);
+        this->rank = H5Sget_simple_extent_ndims(space);
+        hsize_t dims[4] = {1, 1, 1, 1};
+        H5Sget_simple_extent_dims(space, dims, nullptr);
+        this->nr_components = this->rank == 4 ? dims[0] : 1;
+        this->divisor = sf->is_locpot() ? 1.0f : sf->get_volume();
+    }
+
+    /**
+     * @brief      number of spin components (total, mz or total, mx, my, mz)
+     */
+    inline unsigned int get_nr_components() const {
+        return this->nr_components;
+    }
+
+    /**
+     * @brief      read a range of z-slabs of a component
+     *
+     * @param[in]  component  index of the component
+     * @param[in]  k0         first slab
+     * @param[in]  nk         number of slabs
+     * @param[in]  nx         number of points along x
+     * @param[in]  ny         number of points along y
+     * @param      out        storage for the slabs
+     */
+    void read(unsigned int component, size_t k0, size_t nk, size_t nx, size_t ny, fpt* out) const {
+        // the components (if any) run slowest, followed by z, y and x
+        hsize_t start[4] = {component, 0, 0, 0};
+        hsize_t count[4] = {1, 1, 1, 1};
+        const int offset = this->rank - 3;
+        start[offset] = k0;
+        count[offset] = nk;
+        count[offset+1] = ny;
+        count[offset+2] = nx;
+
+        Handle filespace(H5Dget_space(*this->dataset), H5Sclose);
+        const hsize_t n = nk * ny * nx;
+        Handle memspace(H5Screate_simple(1, &n, nullptr), H5Sclose);
+        const hid_t memtype = std::is_same<fpt, double>::value ? H5T_NATIVE_DOUBLE : H5T_NATIVE_FLOAT;
+        if(H5Sselect_hyperslab(filespace, H5S_SELECT_SET, start, nullptr, count, nullptr) < 0 ||
+           H5Dread(*this->dataset, memtype, memspace, filespace, H5P_DEFAULT, out) < 0) {
+            throw std::runtime_error("Cannot read grid from " + this->filename);
+        }
+
+        if(this->divisor != 1.0f) {
+            for(size_t i=0; i<n; i++) {
+                out[i] /= this->divisor;
+            }
+        }
+    }
+};
+
+/**
+ * @brief      HDF5 files start with a signature
+ */
+bool VaspoutReader::sniff(const std::string& head) const {
+    static const char SIGNATURE[8] = {'\x89', 'H', 'D', 'F', '\r', '\n', '\x1a', '\n'};
+    return head.size() >= sizeof(SIGNATURE) && std::memcmp(head.data(), SIGNATURE, sizeof(SIGNATURE)) == 0;
+}
+
+/**
+ * @brief      read the unit cell, the ions and the grid dimensions
+ *
+ * @param      sf    scalar field
+ */
+void VaspoutReader::read_header(ScalarField* sf) const {
+    std::lock_guard<std::mutex> lock(hdf5_mutex);
+    H5Eset_auto2(H5E_DEFAULT, nullptr, nullptr);
+
+    const std::string& filename = sf->get_filename();
+    Handle file(H5Fopen(filename.c_str(), H5F_ACC_RDONLY, H5P_DEFAULT), H5Fclose);
+    if(!file.valid()) {
+        throw std::runtime_error("Cannot open " + filename + "!");
+    }
+
+    const auto scale = read_dataset<double>(file, "results/positions/scale", filename, H5T_NATIVE_DOUBLE);
+    const auto lattice = read_dataset<double>(file, "results/positions/lattice_vectors", filename, H5T_NATIVE_DOUBLE);
+    const auto direct = read_dataset<double>(file, "results/positions/position_ions", filename, H5T_NATIVE_DOUBLE);
+    const auto types = read_strings(file, "results/positions/ion_types", filename);
+    const auto counts = read_dataset<int>(file, "results/positions/number_ion_types", filename, H5T_NATIVE_INT);
+    if(scale.empty() || lattice.size() < 9 || types.size() != counts.size()) {
+        throw std::runtime_error("Error encountered in reading the structure from " + filename);
+    }
+
+    MatrixUnitcell mat;
+    for(unsigned int i=0; i<3; i++) {
+        for(unsigned int j=0; j<3; j++) {
+            mat(i,j) = lattice[i*3+j] * scale[0];
+        }
+    }
+
+    std::vector<unsigned int> elnrs;
+    for(size_t i=0; i<types.size(); i++) {
+        elnrs.insert(elnrs.end(), counts[i], PeriodicTable::get().get_elnr(types[i]));
+    }
+    if(direct.size() != elnrs.size() * 3) {
+        throw std::runtime_error("Error encountered in reading atomic positions from " + filename);
+    }
+    std::vector<Vec3> positions;
+    for(size_t i=0; i<elnrs.size(); i++) {
+        positions.push_back(mat.transpose() * Vec3(direct[i*3], direct[i*3+1], direct[i*3+2]));
+    }
+
+    // the grid runs with x fastest, preceded by the components (if any)
+    auto dataset = open_dataset(file, sf->is_locpot() ? POTENTIAL_DATASET : CHARGE_DATASET, filename);
+    Handle space(H5Dget_space(*dataset), H5Sclose);
+    const int rank = H5Sget_simple_extent_ndims(space);
+    if(rank < 3 || rank > 4) {
+        throw std::runtime_error("Unexpected shape of the grid in " + filename);
+    }
+    hsize_t dims[4];
+    H5Sget_simple_extent_dims(space, dims, nullptr);
+    const std::array<unsigned int, 3> grid_dimensions = {(unsigned int)dims[rank-1],
+                                                         (unsigned int)dims[rank-2],
+                                                         (unsigned int)dims[rank-3]};
+
+    set_header(sf, boost::filesystem::path(filename).filename().string(), mat, elnrs, positions, grid_dimensions, 0);
+}
+
+/**
+ * @brief      read the grid into the (allocated) grid of the scalar field
+ *
+ * @param      sf    scalar field
+ */
+void VaspoutReader::read_grid(ScalarField* sf) const {
+    std::lock_guard<std::mutex> lock(hdf5_mutex);
+    const auto& dims = sf->get_grid_dimensions();
+    const size_t n = (size_t)dims[0] * dims[1] * dims[2];
+    Source source(sf);
+
+    // the first grid is read into the grid itself
+    std::deque<GridBuffer> buffers;
+    std::vector<const fpt*> grids;
+    for(unsigned int idx : SpinDensity::get_grids(sf->get_spin_component(), source.get_nr_components(), sf->get_filename())) {
+        fpt* out = get_grid(sf);
+        if(!grids.empty()) {
+            buffers.emplace_back();
+            buffers.back().allocate(n);
+            out = buffers.back().data();
+        }
+        source.read(idx, 0, dims[2], dims[0], dims[1], out);
+        grids.push_back(out);
+    }
+    SpinDensity::combine(sf->get_spin_component(), grids, get_grid(sf), n);
+}
+
+/**
+ * @brief      slabs (of the total component) are read as hyperslabs of
+ *             the dataset
+ */
+std::unique_ptr<SlabLoader> VaspoutReader::create_slab_loader(ScalarField* sf) const {
+    std::shared_ptr<Source> source;
+    {
+        std::lock_guard<std::mutex> lock(hdf5_mutex);
+        source = std::make_shared<Source>(sf);
+    }
+
+    const auto dims = sf->get_grid_dimensions();
+    return SlabLoader::create([source, dims](unsigned int k, fpt* out) {
+        std::lock_guard<std::mutex> lock(hdf5_mutex);
+        source->read(0, k, 1, dims[0], dims[1], out);
+    }, get_grid(sf), dims);
+}
+
+#endif // HAS_HDF5
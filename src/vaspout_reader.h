@@ -0,0 +1,65 @@
+/**************************************************************************
+ *                                                                        *
+ *   Author: Ivo Filot <i.a.w.filot@tue.nl>                               *
+ *                                                                        *
+ *   EDP is free software:                                                *
+ *   you can redistribute it and/or modify it under the terms of the      *
+ *   GNU General Public License as published by the Free Software         *
+ *   Foundation, either version 3 of the License, or (at your option)     *
+ *   any later version.                                                   *
+ *                                                                        *
+ *   EDP is distributed in the hope that it will be useful,               *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty          *
+ *   of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.              *
+ *   See the GNU General Public License for more details.                 *
+ *                                                                        *
+ *   You should have received a copy of the GNU General Public License    *
+ *   along with this program.  If not, see http://www.gnu.org/licenses/.  *
+ *                                                                        *
+ **************************************************************************/
+
+#ifndef _VASPOUT_READER_H
+#define _VASPOUT_READER_H
+
+#include "field_reader.h"
+
+#ifdef HAS_HDF5
+
+/**
+ * @brief      Reader for the HDF5 output (vaspout.h5) of VASP 6
+ *
+ * The charge density is taken from results/charge/charge and, for files
+ * that are read as a LOCPOT, the potential from results/potential/total.
+ * Both are stored as raw floating point values with x running fastest, so
+ * the components are read straight into the grid using HDF5 hyperslabs,
+ * either as a whole or slab by slab. As in CHGCAR files, the density is
+ * multiplied by the cell volume.
+ */
+class VaspoutReader : public FieldReader {
+public:
+    static constexpr const char* CHARGE_DATASET = "results/charge/charge";
+    static constexpr const char* POTENTIAL_DATASET = "results/potential/total";
+
+    const char* get_name() const override {
+        return "vaspout";
+    }
+
+    bool sniff(const std::string& head) const override;
+
+    void read_header(ScalarField* sf) const override;
+
+    void read_grid(ScalarField* sf) const override;
+
+    std::unique_ptr<SlabLoader> create_slab_loader(ScalarField* sf) const override;
+
+    bool has_spin_components() const override {
+        return true;
+    }
+
+private:
+    class Source;
+};
+
+#endif // HAS_HDF5
+
+#endif // _VASPOUT_READER_H
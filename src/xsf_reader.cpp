@@ -0,0 +1,227 @@
+/**************************************************************************
+ *                                                                        *
+ *   Author: Ivo Filot <i.a.w.filot@tue.nl>                               *
+ *                                                                        *
+ *   EDP is free software:                                                *
+ *   you can redistribute it and/or modify it under the terms of the      *
+ *   GNU General Public License as published by the Free Software         *
+ *   Foundation, either version 3 of the License, or (at your option)     *
+ *   any later version.                                                   *
+ *                                                                        *
+ *   EDP is distributed in the hope that it will be useful,               *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty          *
+ *   of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.              *
+ *   See the GNU General Public License for more details.                 *
+ *                                                                        *
+ *   You should have received a copy of the GNU General Public License    *
+ *   along with this program.  If not, see http://www.gnu.org/licenses/.  *
+ *                                                                        *
+ **************************************************************************/
+
+#include "xsf_reader.h"
+#include "scalar_field.h"
+
+#include <cstring>
+
+/**
+ * @brief      whether the start of a file is in this format
+ *
+ * The first line (ignoring comments) of an XSF file is a keyword. The
+ * second line is checked as well, since the first line of a VASP file is a
+ * free-form comment; its second line holds the scaling factor.
+ *
+ * @param[in]  head  first (at most SNIFF_SIZE) bytes of the file
+ *
+ * @return     True if recognized, False otherwise.
+ */
+bool XsfReader::sniff(const std::string& head) const {
+    const char* p = head.data();
+    const char* end = p + head.size();
+    std::string line;
+    std::vector<std::string> lines;
+    while(lines.size() < 2 && next_line(p, end, line)) {
+        boost::trim(line);
+        if(!line.empty() && line[0] != '#') {
+            lines.push_back(line);
+        }
+    }
+
+    if(lines.empty() || !is_keyword(lines[0])) {
+        return false;
+    }
+    const auto pieces = split(lines.size() > 1 ? lines[1] : "");
+    return !(pieces.size() == 1 && is_number(pieces[0]));
+}
+
+/**
+ * @brief      read the unit cell, the atoms and the grid dimensions
+ *
+ * The unit cell is taken from the spanning vectors of the datagrid and the
+ * atoms from the PRIMCOORD or ATOMS section.
+ *
+ * @param      sf    scalar field
+ */
+void XsfReader::read_header(ScalarField* sf) const {
+    const std::string& filename = sf->get_filename();
+    MappedFile mf(filename);
+    const char* p = mf.data();
+    const char* end = mf.end();
+
+    std::string comment = "XSF";
+    std::vector<unsigned int> elnrs;
+    std::vector<Vec3> positions;
+    std::string line;
+
+    // reads an atom as "Z x y z", wherein Z is an atomic number or an element
+    auto read_atom = [&](const std::string& line) {
+        const auto pieces = split(line);
+        if(pieces.size() < 4) {
+            throw std::runtime_error("Error encountered in reading atomic positions from " + filename);
+        }
+        elnrs.push_back(is_integer(pieces[0]) ? boost::lexical_cast<unsigned int>(pieces[0]) :
+                                                PeriodicTable::get().get_elnr(pieces[0]));
+        positions.emplace_back(boost::lexical_cast<fpt>(pieces[1]),
+                               boost::lexical_cast<fpt>(pieces[2]),
+                               boost::lexical_cast<fpt>(pieces[3]));
+    };
+
+    // reads the next line that is neither empty nor a comment
+    auto read_line = [&]() {
+        while(next_line(p, end, line)) {
+            boost::trim(line);
+            if(!line.empty() && line[0] != '#') {
+                return;
+            }
+        }
+        throw std::runtime_error("Unexpected end of header encountered in " + filename);
+    };
+
+    try {
+        while(true) {
+            read_line();
+            const std::string keyword = split(line)[0];
+
+            if(keyword == "PRIMCOORD") {
+                read_line();
+                const unsigned int nr_atoms = boost::lexical_cast<unsigned int>(split(line)[0]);
+                elnrs.clear();
+                positions.clear();
+                for(unsigned int i=0; i<nr_atoms; i++) {
+                    read_line();
+                    read_atom(line);
+                }
+            } else if(keyword == "ATOMS") {
+                // atoms are listed up to the next keyword
+                elnrs.clear();
+                positions.clear();
+                const char* q = p;
+                while(next_line(q, end, line)) {
+                    boost::trim(line);
+                    if(is_keyword(line)) {
+                        break;
+                    }
+                    if(!line.empty() && line[0] != '#') {
+                        read_atom(line);
+                    }
+                    p = q;
+                }
+            } else if(keyword == "BEGIN_BLOCK_DATAGRID_3D" || keyword == "BEGIN_BLOCK_DATAGRID3D") {
+                read_line();
+                comment = line;
+            } else if(boost::starts_with(keyword, "BEGIN_DATAGRID_3D") || boost::starts_with(keyword, "DATAGRID_3D")) {
+                read_line();
+                const auto pieces = split(line);
+                std::array<unsigned int, 3> grid_dimensions;
+                for(unsigned int i=0; i<3; i++) {
+                    // drop the duplicate points of the general grid
+                    const unsigned int n = boost::lexical_cast<unsigned int>(pieces.at(i));
+                    if(n < 2) {
+                        throw std::runtime_error("Error encountered in reading grid dimensions from " + filename);
+                    }
+                    grid_dimensions[i] = n - 1;
+                }
+
+                // the grid is taken to start at the origin of the unit cell
+                read_line();
+                const auto origin = split(line);
+                for(Vec3& position : positions) {
+                    for(unsigned int j=0; j<3; j++) {
+                        position[j] -= boost::lexical_cast<fpt>(origin.at(j));
+                    }
+                }
+
+                MatrixUnitcell mat;
+                for(unsigned int i=0; i<3; i++) {
+                    read_line();
+                    const auto vec = split(line);
+                    for(unsigned int j=0; j<3; j++) {
+                        mat(i,j) = boost::lexical_cast<fpt>(vec.at(j));
+                    }
+                }
+
+                set_header(sf, comment, mat, elnrs, positions, grid_dimensions, p - mf.data());
+                return;
+            }
+        }
+    } catch(const boost::bad_lexical_cast&) {
+        throw std::runtime_error("Error encountered in reading header of XSF file " + filename);
+    } catch(const std::out_of_range&) {
+        throw std::runtime_error("Error encountered in reading header of XSF file " + filename);
+    }
+}
+
+/**
+ * @brief      read the grid into the (allocated) grid of the scalar field
+ *
+ * @param      sf    scalar field
+ */
+void XsfReader::read_grid(ScalarField* sf) const {
+    const auto& grid_dimensions = sf->get_grid_dimensions();
+    const size_t nx = grid_dimensions[0];
+    const size_t ny = grid_dimensions[1];
+    const size_t nz = grid_dimensions[2];
+    const size_t gridsize = (nx + 1) * (ny + 1) * (nz + 1);
+
+    MappedFile mf(sf->get_filename());
+    const char* p = mf.data() + std::min(get_grid_offset(sf), mf.size());
+    const char* end = mf.end();
+    mf.advise_sequential(p - mf.data(), end - p);
+
+    GridBuffer scratch;
+    scratch.allocate(gridsize);
+    const size_t nread = FloatTokenizer::parse_block_parallel(p, end, scratch.data(), gridsize, 1.0);
+    if(nread != gridsize) {
+        throw std::runtime_error("Could only read " + std::to_string(nread) + " out of " +
+                                 std::to_string(gridsize) + " grid points from " +
+                                 sf->get_filename());
+    }
+
+    // both grids run with x fastest; copy all but the last point of every row
+    const fpt* in = scratch.data();
+    fpt* out = get_grid(sf);
+    #pragma omp parallel for collapse(2) schedule(static)
+    for(size_t iz=0; iz<nz; iz++) {
+        for(size_t iy=0; iy<ny; iy++) {
+            std::memcpy(out + (iz * ny + iy) * nx, in + (iz * (ny + 1) + iy) * (nx + 1), nx * sizeof(fpt));
+        }
+    }
+}
+
+/**
+ * @brief      whether a line starts a section of an XSF file
+ */
+bool XsfReader::is_keyword(const std::string& line) {
+    static const std::vector<std::string> keywords = {
+        "ANIMSTEPS", "CRYSTAL", "SLAB", "POLYMER", "MOLECULE", "ATOMS",
+        "PRIMVEC", "CONVVEC", "PRIMCOORD", "CONVCOORD"
+    };
+
+    const auto pieces = split(line);
+    if(pieces.empty()) {
+        return false;
+    }
+    const std::string& keyword = pieces[0];
+    return std::find(keywords.begin(), keywords.end(), keyword) != keywords.end() ||
+           boost::starts_with(keyword, "BEGIN_") || boost::starts_with(keyword, "END_") ||
+           boost::starts_with(keyword, "DATAGRID_");
+}
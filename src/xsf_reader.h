@@ -0,0 +1,53 @@
+/**************************************************************************
+ *                                                                        *
+ *   Author: Ivo Filot <i.a.w.filot@tue.nl>                               *
+ *                                                                        *
+ *   EDP is free software:                                                *
+ *   you can redistribute it and/or modify it under the terms of the      *
+ *   GNU General Public License as published by the Free Software         *
+ *   Foundation, either version 3 of the License, or (at your option)     *
+ *   any later version.                                                   *
+ *                                                                        *
+ *   EDP is distributed in the hope that it will be useful,               *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty          *
+ *   of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.              *
+ *   See the GNU General Public License for more details.                 *
+ *                                                                        *
+ *   You should have received a copy of the GNU General Public License    *
+ *   along with this program.  If not, see http://www.gnu.org/licenses/.  *
+ *                                                                        *
+ **************************************************************************/
+
+#ifndef _XSF_READER_H
+#define _XSF_READER_H
+
+#include "field_reader.h"
+
+/**
+ * @brief      Reader for XCrySDen structure files (XSF) holding a 3D datagrid
+ *
+ * XSF files store a general grid, i.e. the points on the far faces of the
+ * cell duplicate those on the near faces. These duplicate points are
+ * dropped, such that the grid becomes periodic as in VASP files. Only the
+ * first datagrid of a file is read; its values are used as is.
+ */
+class XsfReader : public FieldReader {
+public:
+    const char* get_name() const override {
+        return "xsf";
+    }
+
+    bool sniff(const std::string& head) const override;
+
+    void read_header(ScalarField* sf) const override;
+
+    void read_grid(ScalarField* sf) const override;
+
+private:
+    /**
+     * @brief      whether a line starts a section of an XSF file
+     */
+    static bool is_keyword(const std::string& line);
+};
+
+#endif // _XSF_READER_H